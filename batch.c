@@ -0,0 +1,170 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "modes.h"
+
+/* Compute a stream of specs, one per line.  Each worker reads the next
+   chunk of lines under the input lock, so chunk numbers follow input
+   order, computes it with its own fpc_context and writes it back
+   through an ordered_output.  Blank lines and lines starting with '#'
+   are skipped. */
+
+#define CHUNK 256
+#define ROW_SIZE 320
+
+struct batch {
+  FILE *in;
+  unsigned long next_chunk;
+  unsigned long errors;
+  bool eof;
+  pthread_mutex_t in_lock;
+  struct ordered_output out;
+};
+
+/* read up to CHUNK specs into lines, returns the count */
+static
+int read_chunk(struct batch *b, char **lines, size_t *sizes, unsigned long *seq) {
+  int n = 0;
+  pthread_mutex_lock(&b->in_lock);
+  *seq = b->next_chunk++;
+  while(n < CHUNK && !b->eof) {
+    ssize_t len = getline(&lines[n], &sizes[n], b->in);
+    if(len < 0) {
+      b->eof = true;
+      break;
+    }
+    char *p = lines[n] + strspn(lines[n], " \t\r\n");
+    if(*p && *p != '#') n++;
+  }
+  pthread_mutex_unlock(&b->in_lock);
+  return n;
+}
+
+static
+int compute(struct fpc_context *ctx, char *line, char *buf, size_t size, bool *failed) {
+  struct fpc_parameters param;
+  char *arg[4];
+  int n = 0;
+  char *save, *tok = strtok_r(line, " \t\r\n", &save);
+  while(tok && n < 4) {
+    arg[n++] = tok;
+    tok = strtok_r(NULL, " \t\r\n", &save);
+  }
+  *failed = true;
+  if(n != 3) {
+    return snprintf(buf, size, "{\"error\":\"expected [min] [max] [precision]\"}\n");
+  }
+
+  memset(&param, 0, sizeof(param));
+  if(!fpc_context_calculate_from_strings(ctx, arg[0], arg[1], arg[2], &param)) {
+    return snprintf(buf, size, "{\"error\":\"%s\"}\n", param.error);
+  }
+  *failed = false;
+  return format_json(buf, size, &param);
+}
+
+static
+void *work(void *arg) {
+  struct batch *b = arg;
+  char *lines[CHUNK] = { NULL };
+  size_t sizes[CHUNK] = { 0 };
+  char *buf = malloc(CHUNK * ROW_SIZE);
+  struct fpc_context ctx;
+  unsigned long seq;
+  int i, n;
+
+  // leave the input to the other workers
+  if(!buf) return NULL;
+  fpc_context_init(&ctx);
+  while(true) {
+    n = read_chunk(b, lines, sizes, &seq);
+    size_t len = 0;
+    for(i = 0; i < n; i++) {
+      bool failed;
+      int row = compute(&ctx, lines[i], buf + len, ROW_SIZE, &failed);
+      // snprintf() gives the untruncated length, which would end the chunk early
+      if(row < 0 || row >= ROW_SIZE) {
+        row = snprintf(buf + len, ROW_SIZE, "{\"error\":\"row longer than %d characters\"}\n", ROW_SIZE - 1);
+        failed = true;
+      }
+      len += row;
+      if(failed) __atomic_fetch_add(&b->errors, 1, __ATOMIC_RELAXED);
+    }
+    ordered_write(&b->out, seq, buf, len);
+    fflush(b->out.f);
+    if(n < CHUNK) break;
+  }
+  for(i = 0; i < CHUNK; i++) free(lines[i]);
+  free(buf);
+  return NULL;
+}
+
+int batch_main(int argc, char **argv) {
+  struct batch b;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int i;
+
+  memset(&b, 0, sizeof(b));
+  b.in = stdin;
+  if(argc >= 2 && strcmp(argv[0], "-j") == 0) {
+    threads = atol(argv[1]);
+    argc -= 2;
+    argv += 2;
+  }
+  if(argc > 1) {
+    fprintf(stderr, "fpc --batch [-j threads] [file]\n");
+    return -1;
+  }
+  if(argc == 1 && strcmp(argv[0], "-") != 0) {
+    b.in = fopen(argv[0], "r");
+    if(!b.in) {
+      perror(argv[0]);
+      return -1;
+    }
+  }
+  if(threads < 1) threads = 1;
+
+  pthread_t *workers = calloc(threads, sizeof(*workers));
+  if(!workers) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    if(b.in != stdin) fclose(b.in);
+    return -1;
+  }
+  pthread_mutex_init(&b.in_lock, NULL);
+  ordered_init(&b.out, stdout);
+  // chunks are read as workers go, so fewer threads still cover them
+  for(i = 0; i < threads; i++) {
+    if(pthread_create(&workers[i], NULL, work, &b) != 0) break;
+  }
+  if(i == 0) {
+    work(&b);
+  } else {
+    threads = i;
+    for(i = 0; i < threads; i++) pthread_join(workers[i], NULL);
+  }
+  free(workers);
+  ordered_destroy(&b.out);
+  pthread_mutex_destroy(&b.in_lock);
+  if(b.in != stdin) fclose(b.in);
+  // every worker's buffer failed, so the input was never read
+  if(!b.eof) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    return -1;
+  }
+  return b.errors ? -1 : 0;
+}
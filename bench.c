@@ -0,0 +1,315 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fpc.h"
+#include "fpc_plan.h"
+#include "fixnum_string.h"
+
+/* fpc_bench [spec ...]
+   time the library and fixnum_string.c routines, each spec is
+   "min max precision", and print one CSV row per benchmark:
+   benchmark,case,ns_per_op,mops_per_s */
+
+#define N 4096
+#define MIN_TIME 0.02 // seconds per measurement
+#define RUNS 3        // best of
+
+static volatile long double sink;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* each call of fn does ops operations */
+static
+void run(const char *name, const char *label, void (*fn)(void *), void *arg, size_t ops) {
+  unsigned long reps = 1, i;
+  double t, best = 0;
+  int r;
+
+  // calibrate
+  while(true) {
+    t = now();
+    for(i = 0; i < reps; i++) fn(arg);
+    t = now() - t;
+    if(t >= MIN_TIME) break;
+    reps *= t > MIN_TIME / 16 ? 2 : 16;
+  }
+  for(r = 0; r < RUNS; r++) {
+    t = now();
+    for(i = 0; i < reps; i++) fn(arg);
+    t = (now() - t) / ((double)reps * ops);
+    if(r == 0 || t < best) best = t;
+  }
+  printf("%s,%s,%.3f,%.3f\n", name, label, best * 1e9, 1e-6 / best);
+}
+
+/* expressions */
+
+struct expr {
+  char *str;
+  struct fpc_program prog;
+  double *columns[3];
+  double out[N];
+};
+
+static void eval_expr(void *arg) {
+  struct expr *e = arg;
+  sink = fpc_eval_expr(e->str);
+}
+
+static void compile_expr(void *arg) {
+  struct expr *e = arg;
+  fpc_compile_expr(e->str, &e->prog);
+  sink = e->prog.length;
+}
+
+static void run_program(void *arg) {
+  struct expr *e = arg;
+  sink = fpc_run_program(&e->prog);
+}
+
+static void run_program_n(void *arg) {
+  struct expr *e = arg;
+  fpc_run_program_n(&e->prog, "lhp", (const double *const *)e->columns, e->out, N);
+  sink = e->out[N - 1];
+}
+
+static
+void bench_expr(char *str) {
+  struct expr *e = calloc(1, sizeof(*e));
+  int i, j;
+  e->str = str;
+  fpc_set_var('l', 30);
+  fpc_set_var('h', 1800);
+  fpc_set_var('p', 0.1);
+  if(!fpc_compile_expr(str, &e->prog)) {
+    fprintf(stderr, "ERROR: can't compile %s\n", str);
+    exit(1);
+  }
+  for(i = 0; i < 3; i++) {
+    e->columns[i] = malloc(N * sizeof(double));
+    for(j = 0; j < N; j++) e->columns[i][j] = 1 + (j * (i + 1)) % 97;
+  }
+  run("fpc_eval_expr", str, eval_expr, e, 1);
+  run("fpc_compile_expr", str, compile_expr, e, 1);
+  run("fpc_run_program", str, run_program, e, 1);
+  run("fpc_run_program_n", str, run_program_n, e, N);
+  for(i = 0; i < 3; i++) free(e->columns[i]);
+  free(e);
+}
+
+/* formats */
+
+struct spec {
+  char min[64], max[64], precision[64];
+  struct fpc_parameters param;
+  struct fpc_plan plan;
+  uint64_t codes[N];
+  double values[N];
+};
+
+static void calculate(void *arg) {
+  struct spec *s = arg;
+  struct fpc_parameters param = { .min = s->param.min, .max = s->param.max,
+                                  .precision = s->param.precision };
+  fpc_calculate(&param);
+  sink = param.fractional_bits;
+}
+
+static void calculate_from_strings(void *arg) {
+  struct spec *s = arg;
+  struct fpc_parameters param;
+  fpc_calculate_from_strings(s->min, s->max, s->precision, &param);
+  sink = param.fractional_bits;
+}
+
+static void plan_to_double(void *arg) {
+  struct spec *s = arg;
+  fpc_plan_to_double(&s->plan, s->codes, s->values, N);
+}
+
+static void plan_from_double(void *arg) {
+  struct spec *s = arg;
+  fpc_plan_from_double(&s->plan, s->values, s->codes, N, NULL);
+}
+
+static
+void bench_spec(const char *label) {
+  static struct spec s;
+  int i;
+  if(sscanf(label, "%63s %63s %63s", s.min, s.max, s.precision) != 3 ||
+     !fpc_calculate_from_strings(s.min, s.max, s.precision, &s.param)) {
+    fprintf(stderr, "ERROR: bad spec %s\n", label);
+    exit(1);
+  }
+  run("fpc_calculate", label, calculate, &s, 1);
+  run("fpc_calculate_from_strings", label, calculate_from_strings, &s, 1);
+
+  // the plan kernels on values spread over [min, max]
+  if(fpc_plan_init(&s.plan, &s.param)) {
+    for(i = 0; i < N; i++) {
+      s.values[i] = (double)(s.param.min + (s.param.max - s.param.min) * i / (N - 1));
+    }
+    run("fpc_plan_from_double", label, plan_from_double, &s, N);
+    run("fpc_plan_to_double", label, plan_to_double, &s, N);
+  }
+}
+
+/* fixnum_string.c on N values */
+
+struct fixnum {
+  unsigned int fractional_bits;
+  int64_t fixed[N], mantissas[N];
+  __int128 mantissas128[N];
+  int exponents[N];
+  char strings[N][48];
+  int lengths[N];
+  char buf[N * 48];
+  size_t size;
+};
+
+static void read_float_n(void *arg) {
+  struct fixnum *x = arg;
+  int i;
+  for(i = 0; i < N; i++) read_float(x->strings[i], x->lengths[i], &x->exponents[i], &x->mantissas[i]);
+}
+
+static void read_float128_n(void *arg) {
+  struct fixnum *x = arg;
+  int i;
+  for(i = 0; i < N; i++) read_float128(x->strings[i], x->lengths[i], &x->exponents[i], &x->mantissas128[i]);
+}
+
+static void show_float_n(void *arg) {
+  struct fixnum *x = arg;
+  char buf[48];
+  int i;
+  for(i = 0; i < N; i++) sink = show_float(buf, sizeof(buf), x->exponents[i], x->mantissas[i]);
+}
+
+static void show_float128_n(void *arg) {
+  struct fixnum *x = arg;
+  char buf[48];
+  int i;
+  for(i = 0; i < N; i++) sink = show_float128(buf, sizeof(buf), x->exponents[i], x->mantissas128[i]);
+}
+
+static void float_to_fixed_n(void *arg) {
+  struct fixnum *x = arg;
+  int64_t fixed;
+  int i;
+  for(i = 0; i < N; i++) {
+    float_to_fixed(x->exponents[i], x->mantissas128[i], x->fractional_bits, &fixed);
+    sink = fixed;
+  }
+}
+
+static void fixed_to_float_n(void *arg) {
+  struct fixnum *x = arg;
+  int exponent, i;
+  for(i = 0; i < N; i++) sink = fixed_to_float(x->fractional_bits, x->fixed[i], &exponent);
+}
+
+static void read_fixed_each(void *arg) {
+  struct fixnum *x = arg;
+  int64_t fixed;
+  int i;
+  for(i = 0; i < N; i++) {
+    read_fixed(x->strings[i], x->lengths[i], x->fractional_bits, &fixed);
+    sink = fixed;
+  }
+}
+
+static void show_fixed_each(void *arg) {
+  struct fixnum *x = arg;
+  char buf[48];
+  int i;
+  for(i = 0; i < N; i++) sink = show_fixed(buf, sizeof(buf), x->fractional_bits, x->fixed[i]);
+}
+
+static void read_fixed_buf(void *arg) {
+  struct fixnum *x = arg;
+  int64_t fixed[N];
+  size_t used;
+  sink = read_fixed_n(x->buf, x->size, '\n', x->fractional_bits, fixed, N, &used);
+}
+
+static void show_fixed_buf(void *arg) {
+  struct fixnum *x = arg;
+  static char buf[N * 48];
+  size_t used;
+  sink = show_fixed_n(buf, sizeof(buf), '\n', x->fractional_bits, x->fixed, N, &used);
+}
+
+static
+void bench_fixnum(unsigned int fractional_bits) {
+  struct fixnum *x = calloc(1, sizeof(*x));
+  char label[32];
+  size_t used;
+  int i;
+
+  x->fractional_bits = fractional_bits;
+  srand(fractional_bits);
+  for(i = 0; i < N; i++) {
+    // values with up to 6 integer digits
+    int64_t limit = 1000000LL << fractional_bits;
+    x->fixed[i] = ((((int64_t)rand() << 31) ^ rand()) % limit) * (i % 2 ? -1 : 1);
+    x->lengths[i] = show_fixed(x->strings[i], sizeof(x->strings[i]), fractional_bits, x->fixed[i]);
+    read_float128(x->strings[i], x->lengths[i], &x->exponents[i], &x->mantissas128[i]);
+    x->mantissas[i] = x->mantissas128[i];
+  }
+  x->size = 0;
+  show_fixed_n(x->buf, sizeof(x->buf), '\n', fractional_bits, x->fixed, N, &x->size);
+  if(read_fixed_n(x->buf, x->size, '\n', fractional_bits, x->fixed, N, &used) != N) {
+    fprintf(stderr, "ERROR: fixnum_string round trip failed\n");
+    exit(1);
+  }
+
+  snprintf(label, sizeof(label), "Q%u", fractional_bits);
+  run("read_float", label, read_float_n, x, N);
+  run("read_float128", label, read_float128_n, x, N);
+  run("show_float", label, show_float_n, x, N);
+  run("show_float128", label, show_float128_n, x, N);
+  run("float_to_fixed", label, float_to_fixed_n, x, N);
+  run("fixed_to_float", label, fixed_to_float_n, x, N);
+  run("read_fixed", label, read_fixed_each, x, N);
+  run("show_fixed", label, show_fixed_each, x, N);
+  run("read_fixed_n", label, read_fixed_buf, x, N);
+  run("show_fixed_n", label, show_fixed_buf, x, N);
+  free(x);
+}
+
+int main(int argc, char **argv) {
+  static char *exprs[] = { "1+2*3^4", "(h-l)/p", "-2^-(2)+l*h/p" };
+  unsigned int i;
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  printf("benchmark,case,ns_per_op,mops_per_s\n");
+  for(i = 0; i < sizeof(exprs) / sizeof(exprs[0]); i++) {
+    bench_expr(exprs[i]);
+  }
+  for(i = 1; i < (unsigned int)argc; i++) {
+    bench_spec(argv[i]);
+  }
+  bench_fixnum(16);
+  bench_fixnum(40);
+  return 0;
+}
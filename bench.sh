@@ -0,0 +1,67 @@
+#!/bin/bash
+
+# Copyright 2016 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Time the hot paths over some representative formats and write the
+# results to bench_output.txt as CSV.  If there is a bench_baseline.txt
+# (make bench_baseline) compare against it and fail if anything is more
+# than BENCH_THRESHOLD (default 1.25) times slower.
+
+set -e
+
+formats=(
+    "0 1 2^-8"
+    "30 1800 0.1"
+    "-1 1 0.003"
+    "-2^40 2^40 2^-20"
+    "2^70 l+256 1"
+)
+
+out=bench_output.txt
+./fpc_bench "${formats[@]}" > $out
+for spec in "${formats[@]}"; do
+    ./fpc -g $spec > /dev/null
+    rm -f convert convert.o
+    make -s convert
+    ./convert -B "$spec" >> $out
+done
+
+if [ ! -f bench_baseline.txt ]; then
+    awk -F , '{ printf "%-28s %-18s %12s %12s\n", $1, $2, $3, $4 }' $out
+    exit 0
+fi
+
+awk -F , -v threshold="${BENCH_THRESHOLD:-1.25}" '
+    NR == FNR { if(FNR > 1) base[$1 "," $2] = $3; next }
+    FNR == 1 {
+        printf "%-28s %-18s %12s %12s %8s\n", "benchmark", "case", "baseline ns", "ns", "ratio"
+        next
+    }
+    {
+        key = $1 "," $2
+        if(!(key in base)) {
+            printf "%-28s %-18s %12s %12.3f\n", $1, $2, "-", $3
+            next
+        }
+        ratio = $3 / base[key]
+        slow = ratio > threshold
+        bad += slow
+        printf "%-28s %-18s %12.3f %12.3f %7.2fx%s\n", $1, $2, base[key], $3, ratio,
+            slow ? "  REGRESSION" : ""
+    }
+    END {
+        if(bad) printf "%d regressions\n", bad
+        exit bad > 0
+    }' bench_baseline.txt $out
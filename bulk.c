@@ -0,0 +1,415 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#define _GNU_SOURCE // memrchr
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fixnum_string.h"
+#include "fpc_plan.h"
+#include "modes.h"
+
+/* Convert whole files between values (raw doubles or floats, or a CSV
+   column) and codes (the format's machine integers, native byte order).
+   A regular input file is mapped, anything else is read in large
+   blocks.  Each worker claims the next chunk of whole records under the
+   input lock, so chunk numbers follow input order, converts it with the
+   fpc_plan kernels into a private buffer and writes that through an
+   ordered_output: one fwrite per chunk rather than a stdio call per
+   value. */
+
+#define CHUNK_VALUES 65536   // binary values per chunk
+#define TEXT_CHUNK (1 << 20) // bytes of CSV per chunk
+#define TEXT_SIZE 48         // most bytes written per CSV value
+
+enum bulk_type { BULK_F64, BULK_F32, BULK_CSV, BULK_CODES };
+
+struct bulk {
+  struct fpc_parameters param;
+  struct fpc_plan plan;
+  enum bulk_type from, to;
+  unsigned int column; // of CSV input, from 1
+  size_t record;       // bytes per binary input value, 0 for CSV
+  size_t chunk;        // most bytes of input per chunk
+  size_t max_values;   // per chunk
+
+  int fd;
+  const char *map;
+  size_t size, pos;    // of the mapping
+  char *carry;         // input read past the last whole record
+  size_t carry_len;
+  bool eof;
+  unsigned long next_chunk;
+  unsigned long lines;  // of CSV input claimed
+  pthread_mutex_t in_lock;
+
+  unsigned long errors; // values out of range
+  unsigned long bad_fields, bad_line; // CSV fields that aren't numbers, the first one's line
+  const char *failure;
+  struct ordered_output out;
+};
+
+static
+bool parse_type(const char *s, struct bulk *b, enum bulk_type *t) {
+  if(strcmp(s, "f64") == 0) *t = BULK_F64;
+  else if(strcmp(s, "f32") == 0) *t = BULK_F32;
+  else if(strcmp(s, "codes") == 0) *t = BULK_CODES;
+  else if(strcmp(s, "csv") == 0) *t = BULK_CSV;
+  else if(strncmp(s, "csv:", 4) == 0 && atoi(s + 4) > 0) {
+    *t = BULK_CSV;
+    b->column = atoi(s + 4);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static
+void fail(struct bulk *b, const char *failure) {
+  if(!b->failure) b->failure = failure;
+}
+
+/* the end of the last whole record in p[0, n) */
+static
+size_t record_end(const struct bulk *b, const char *p, size_t n) {
+  if(b->record) return n - n % b->record;
+  const char *nl = memrchr(p, '\n', n);
+  return nl ? (size_t)(nl - p) + 1 : 0;
+}
+
+/* claim the next chunk of input, in buf unless the input is mapped,
+   and the line it starts on for CSV, returns false once the input is
+   used up */
+static
+bool read_chunk(struct bulk *b, char *buf, const char **data, size_t *len, unsigned long *seq,
+                unsigned long *line) {
+  pthread_mutex_lock(&b->in_lock);
+  *seq = b->next_chunk++;
+  if(b->map) {
+    size_t start = b->pos, end = b->size - start > b->chunk ? start + b->chunk : b->size;
+    if(end < b->size && b->record) {
+      end = start + record_end(b, b->map + start, end - start);
+    } else if(end < b->size) {
+      // finish the line, however long
+      const char *nl = memchr(b->map + end, '\n', b->size - end);
+      end = nl ? (size_t)(nl - b->map) + 1 : b->size;
+    }
+    b->pos = end;
+    *data = b->map + start;
+    *len = end - start;
+  } else {
+    size_t n = b->carry_len, end;
+    memcpy(buf, b->carry, n);
+    while(n < b->chunk && !b->eof) {
+      ssize_t r = read(b->fd, buf + n, b->chunk - n);
+      if(r < 0 && errno == EINTR) continue;
+      if(r < 0) fail(b, strerror(errno));
+      if(r <= 0) b->eof = true;
+      else n += r;
+    }
+    end = b->eof ? n : record_end(b, buf, n);
+    if(end == 0 && n == b->chunk) {
+      fail(b, "line too long");
+      end = n;
+    }
+    b->carry_len = n - end;
+    memcpy(b->carry, buf + end, b->carry_len);
+    *data = buf;
+    *len = end;
+  }
+  if(b->record && *len % b->record) {
+    fail(b, "input ends with a partial value");
+    *len -= *len % b->record;
+  }
+  if(!b->record) {
+    const char *p = *data, *end = *data + *len;
+    *line = b->lines + 1;
+    while((p = memchr(p, '\n', end - p))) {
+      b->lines++;
+      p++;
+    }
+  }
+  pthread_mutex_unlock(&b->in_lock);
+  return *len > 0;
+}
+
+/* field b->column of each CSV line to values, skipping blank lines and
+   '#' comments, anything but a number is NAN and counted in *bad with
+   the line of the first in *bad_line */
+static
+size_t parse_csv(const struct bulk *b, const char *p, size_t len, unsigned long line,
+                 double *values, size_t *bad, unsigned long *bad_line) {
+  const char *end = p + len;
+  size_t n = 0;
+  for(; p < end; line++) {
+    const char *eol = memchr(p, '\n', end - p), *q;
+    unsigned int k;
+    char field[64], *e;
+    if(!eol) eol = end;
+    for(q = p; q < eol && (*q == ' ' || *q == '\t' || *q == '\r'); q++);
+    if(q == eol || *q == '#') {
+      p = eol + 1;
+      continue;
+    }
+    for(k = 1; k < b->column && q; k++) {
+      q = memchr(q, ',', eol - q);
+      if(q) q++;
+    }
+    double v = NAN;
+    bool parsed = false;
+    if(q) {
+      const char *comma = memchr(q, ',', eol - q);
+      size_t flen = (comma ? comma : eol) - q;
+      if(flen < sizeof(field)) {
+        memcpy(field, q, flen);
+        field[flen] = 0;
+        v = strtod(field, &e);
+        if(e == field || e[strspn(e, " \t\r")]) v = NAN;
+        else parsed = true;
+      }
+    }
+    if(!parsed && !(*bad)++) *bad_line = line;
+    values[n++] = v;
+    p = eol + 1;
+  }
+  return n;
+}
+
+/* code i of an array of the plan's machine integer type */
+static
+int128_t code_at(const struct fpc_plan *plan, const void *codes, size_t i) {
+  switch(plan->fixed_encoding_width * (plan->use_signed ? -1 : 1)) {
+  case 8: return ((const uint8_t *)codes)[i];
+  case -8: return ((const int8_t *)codes)[i];
+  case 16: return ((const uint16_t *)codes)[i];
+  case -16: return ((const int16_t *)codes)[i];
+  case 32: return ((const uint32_t *)codes)[i];
+  case -32: return ((const int32_t *)codes)[i];
+  case 64: return ((const uint64_t *)codes)[i];
+  default: return ((const int64_t *)codes)[i];
+  }
+}
+
+/* codes as the shortest decimals that read back the same, one per line,
+   nan for codes out of range */
+static
+size_t show_codes(struct bulk *b, const void *codes, size_t n, char *out, size_t *errors) {
+  const struct fpc_parameters *p = &b->param;
+  int f = p->fractional_bits;
+  char *o = out;
+  size_t i;
+  for(i = 0; i < n; i++) {
+    int128_t x = code_at(&b->plan, codes, i) + p->offset;
+    int len;
+    if(x < p->lower_bound || x > p->upper_bound) {
+      len = snprintf(o, TEXT_SIZE, "nan");
+      ++*errors;
+    } else if(f >= 0 && f <= 63 && x >= INT64_MIN && x <= INT64_MAX) {
+      len = show_fixed(o, TEXT_SIZE, f, (int64_t)x);
+    } else if(f <= 0 && f > -64 && x >> (126 + f) == x >> 127) {
+      len = strlen(int128_str(x * ((int128_t)1 << -f), o));
+    } else {
+      len = -1;
+    }
+    if(len < 0) len = snprintf(o, TEXT_SIZE, "%.19Lg", ldexpl(x, -f));
+    o += len;
+    *o++ = '\n';
+  }
+  return o - out;
+}
+
+/* convert a chunk starting on line into out, returns the bytes written */
+static
+size_t convert_chunk(struct bulk *b, const char *data, size_t len, unsigned long line,
+                     double *values, char *out) {
+  size_t code_size = fpc_plan_code_size(&b->plan), n = 0, i, errors = 0, written = 0, bad = 0;
+  unsigned long bad_line = 0;
+  const double *x = values;
+  switch(b->from) {
+  case BULK_F64:
+    n = len / sizeof(double);
+    x = (const double *)data;
+    break;
+  case BULK_F32:
+    n = len / sizeof(float);
+    for(i = 0; i < n; i++) values[i] = ((const float *)data)[i];
+    break;
+  case BULK_CSV:
+    n = parse_csv(b, data, len, line, values, &bad, &bad_line);
+    if(bad) {
+      pthread_mutex_lock(&b->in_lock);
+      if(!b->bad_fields || bad_line < b->bad_line) b->bad_line = bad_line;
+      b->bad_fields += bad;
+      pthread_mutex_unlock(&b->in_lock);
+    }
+    break;
+  case BULK_CODES:
+    n = len / code_size;
+    break;
+  }
+
+  switch(b->to) {
+  case BULK_CODES:
+    // the NANs of fields that aren't numbers are counted apart
+    errors = fpc_plan_from_double(&b->plan, x, out, n, NULL) - bad;
+    written = n * code_size;
+    break;
+  case BULK_F64:
+    errors = fpc_plan_to_double(&b->plan, data, (double *)out, n);
+    written = n * sizeof(double);
+    break;
+  case BULK_F32:
+    errors = fpc_plan_to_double(&b->plan, data, values, n);
+    for(i = 0; i < n; i++) ((float *)out)[i] = values[i];
+    written = n * sizeof(float);
+    break;
+  case BULK_CSV:
+    written = show_codes(b, data, n, out, &errors);
+    break;
+  }
+  if(errors) __atomic_fetch_add(&b->errors, errors, __ATOMIC_RELAXED);
+  return written;
+}
+
+static
+void *work(void *arg) {
+  struct bulk *b = arg;
+  size_t out_size = b->to == BULK_CSV ? TEXT_SIZE + 1 :
+    b->to == BULK_CODES ? fpc_plan_code_size(&b->plan) : sizeof(double);
+  char *in = b->map ? NULL : malloc(b->chunk);
+  double *values = malloc(b->max_values * sizeof(double));
+  char *out = malloc(b->max_values * out_size);
+  const char *data;
+  size_t len;
+  unsigned long seq, line = 0;
+  bool more;
+
+  do {
+    more = read_chunk(b, in, &data, &len, &seq, &line);
+    len = more ? convert_chunk(b, data, len, line, values, out) : 0;
+    ordered_write(&b->out, seq, out, len);
+  } while(more);
+  free(in);
+  free(values);
+  free(out);
+  return NULL;
+}
+
+int bulk_main(int argc, char **argv) {
+  static const char usage[] =
+    "fpc --convert [-j threads] [--from=type] [--to=type] [min] [max] [precision] [in] [out]\n"
+    "  type is f64 (default from), f32, csv, csv:column or codes (default to)\n";
+  struct bulk b;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *in = "-", *out = "-";
+  FILE *f = stdout;
+  struct stat st;
+  int i;
+
+  memset(&b, 0, sizeof(b));
+  b.from = BULK_F64;
+  b.to = BULK_CODES;
+  b.column = 1;
+  for(; argc > 0; argc--, argv++) {
+    if(argc >= 2 && strcmp(argv[0], "-j") == 0) {
+      threads = atol(argv[1]);
+      argc--, argv++;
+    } else if(strncmp(argv[0], "--from=", 7) == 0) {
+      if(!parse_type(argv[0] + 7, &b, &b.from)) argc = 0;
+    } else if(strncmp(argv[0], "--to=", 5) == 0) {
+      if(!parse_type(argv[0] + 5, &b, &b.to)) argc = 0;
+    } else {
+      break;
+    }
+  }
+  if(argc < 3 || argc > 5 || (b.from == BULK_CODES) == (b.to == BULK_CODES)) {
+    fprintf(stderr, "%s", usage);
+    return -1;
+  }
+  if(!fpc_calculate_from_strings(argv[0], argv[1], argv[2], &b.param) ||
+     !fpc_plan_init(&b.plan, &b.param)) {
+    fprintf(stderr, "ERROR: %s\n", b.param.error ? b.param.error : b.plan.error);
+    return -1;
+  }
+  if(argc > 3) in = argv[3];
+  if(argc > 4) out = argv[4];
+  if(threads < 1) threads = 1;
+
+  switch(b.from) {
+  case BULK_F64: b.record = sizeof(double); break;
+  case BULK_F32: b.record = sizeof(float); break;
+  case BULK_CSV: b.record = 0; break;
+  case BULK_CODES: b.record = fpc_plan_code_size(&b.plan); break;
+  }
+  b.chunk = b.record ? CHUNK_VALUES * b.record : TEXT_CHUNK;
+  // a mapped CSV chunk runs on to the end of its last line
+  b.max_values = b.record ? CHUNK_VALUES : TEXT_CHUNK / 2 + 2;
+
+  b.fd = strcmp(in, "-") == 0 ? STDIN_FILENO : open(in, O_RDONLY);
+  if(b.fd < 0) {
+    perror(in);
+    return -1;
+  }
+  if(fstat(b.fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    b.size = st.st_size;
+    b.map = mmap(NULL, b.size, PROT_READ, MAP_PRIVATE, b.fd, 0);
+    if(b.map == MAP_FAILED) b.map = NULL;
+    else madvise((void *)b.map, b.size, MADV_SEQUENTIAL);
+  }
+  if(!b.map) b.carry = malloc(b.chunk);
+  if(strcmp(out, "-") != 0) {
+    f = fopen(out, "wb");
+    if(!f) {
+      perror(out);
+      return -1;
+    }
+  }
+
+  pthread_mutex_init(&b.in_lock, NULL);
+  ordered_init(&b.out, f);
+  pthread_t *workers = calloc(threads, sizeof(*workers));
+  for(i = 0; i < threads; i++) {
+    pthread_create(&workers[i], NULL, work, &b);
+  }
+  for(i = 0; i < threads; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+  ordered_destroy(&b.out);
+  pthread_mutex_destroy(&b.in_lock);
+
+  if(fflush(f) != 0 || ferror(f)) fail(&b, "write failed");
+  if(f != stdout) fclose(f);
+  if(b.map) munmap((void *)b.map, b.size);
+  if(b.fd != STDIN_FILENO) close(b.fd);
+  free(b.carry);
+  if(b.failure) {
+    fprintf(stderr, "ERROR: %s\n", b.failure);
+    return -1;
+  }
+  if(b.bad_fields) {
+    if(b.bad_fields == 1) fprintf(stderr, "ERROR: line %lu: not a number\n", b.bad_line);
+    else fprintf(stderr, "ERROR: %lu fields aren't numbers, the first on line %lu\n", b.bad_fields, b.bad_line);
+  }
+  if(b.errors) {
+    fprintf(stderr, "ERROR: values out of range: %lu\n", b.errors);
+  }
+  return b.bad_fields || b.errors ? -1 : 0;
+}
@@ -0,0 +1,119 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fpc.h"
+
+/* context_test [threads] [rounds]
+   stress test for the fpc_context API: each thread resolves the specs
+   over and over with its own context, and a variable k set to its
+   thread number, and compares every result to one computed before the
+   threads started.  Built with -fsanitize=thread by make. */
+
+#define MAX_THREADS 64
+
+static const char *specs[][3] = {
+  { "-256", "-l-p", "0.01" },
+  { "2^70", "l+256", "1" },
+  { "1", "2", "3" },
+  { "1", "2", "0" },
+  { "-h-p", "2^8-p", "0.01" },
+  { "-2^63", "-l-p", "1" },
+  { "30", "1800", "0.1" },
+  { "-1", "1", "0.003" },
+  { "-k", "k*100+1", "2^-k" },
+  { "k", "l*1000", "k/7" },
+  { "-(h/2)", "k+h-k+10", "p" },
+  { "p*k", "2^(k+3)", "0.5^k" },
+};
+#define N_SPECS (sizeof(specs) / sizeof(specs[0]))
+
+static struct fpc_parameters expected[MAX_THREADS][N_SPECS];
+static int rounds = 2000;
+
+static
+void calculate(struct fpc_context *ctx, int thread, int spec, struct fpc_parameters *param) {
+  char buf[3][32];
+  int i;
+  for(i = 0; i < 3; i++) snprintf(buf[i], sizeof(buf[i]), "%s", specs[spec][i]);
+  memset(param, 0, sizeof(*param));
+  fpc_context_set_var(ctx, 'k', thread + 1);
+  fpc_context_calculate_from_strings(ctx, buf[0], buf[1], buf[2], param);
+}
+
+static
+bool same(const struct fpc_parameters *a, const struct fpc_parameters *b) {
+  if(a->error || b->error) return a->error == b->error;
+  return (a->min == b->min || (isnan(a->min) && isnan(b->min))) &&
+    (a->max == b->max || (isnan(a->max) && isnan(b->max))) &&
+    (a->precision == b->precision || (isnan(a->precision) && isnan(b->precision))) &&
+    a->lower_bound == b->lower_bound && a->upper_bound == b->upper_bound &&
+    a->offset == b->offset && a->fractional_bits == b->fractional_bits &&
+    a->integer_bits == b->integer_bits && a->fixed_encoding_width == b->fixed_encoding_width &&
+    a->use_signed == b->use_signed && a->large_offset == b->large_offset;
+}
+
+static
+void *work(void *arg) {
+  int thread = (int)(long)arg, r, i;
+  unsigned long bad = 0;
+  struct fpc_context ctx;
+  struct fpc_parameters param;
+  fpc_context_init(&ctx);
+  for(r = 0; r < rounds; r++) {
+    for(i = 0; i < (int)N_SPECS; i++) {
+      // and some plain expressions in between
+      char expr[] = "k*(k+1)/2";
+      calculate(&ctx, thread, (i + r + thread) % N_SPECS, &param);
+      if(!same(&param, &expected[thread][(i + r + thread) % N_SPECS])) bad++;
+      if(fpc_context_eval_expr(&ctx, expr) != (thread + 1) * (thread + 2) / 2) bad++;
+    }
+  }
+  return (void *)bad;
+}
+
+int main(int argc, char **argv) {
+  int threads = argc > 1 ? atoi(argv[1]) : 8, i, j;
+  unsigned long bad = 0;
+  pthread_t workers[MAX_THREADS];
+  if(argc > 2) rounds = atoi(argv[2]);
+  if(threads < 1 || threads > MAX_THREADS) {
+    fprintf(stderr, "ERROR: 1 to %d threads\n", MAX_THREADS);
+    return -1;
+  }
+
+  for(i = 0; i < threads; i++) {
+    for(j = 0; j < (int)N_SPECS; j++) {
+      struct fpc_context ctx = { { 0 } };
+      calculate(&ctx, i, j, &expected[i][j]);
+    }
+  }
+  for(i = 0; i < threads; i++) {
+    pthread_create(&workers[i], NULL, work, (void *)(long)i);
+  }
+  for(i = 0; i < threads; i++) {
+    void *ret;
+    pthread_join(workers[i], &ret);
+    bad += (unsigned long)ret;
+  }
+  printf("%d threads, %lu calculations each: %lu mismatches\n",
+         threads, (unsigned long)rounds * N_SPECS, bad);
+  printf("%s\n", bad ? "FAIL" : "ok");
+  return bad != 0;
+}
@@ -0,0 +1,291 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen.h"
+#include "modes.h"
+
+/* Read the counters of converters generated with --instrument and
+   propose a format for the values they actually saw.
+
+   A dump starts with a line "fpc-stats min max precision scale" naming
+   the format, has lines of counters and ends with "end"; anything
+   outside a dump is ignored, so dumps can be mixed into logs.  The
+   dumps, one per thread or process, must all be of the same format and
+   are added up.  The proposal keeps the precision and scale and takes
+   the smallest and largest values converted, widened by --margin
+   percent of their span on each side, with --outliers the values
+   rejected too, rounded outward to the decimals of the precision. */
+
+#define MAX_BUCKETS 64
+
+struct feedback {
+  char spec[4][48]; /* min, max, precision, scale */
+  unsigned int dumps;
+  uint64_t from_calls, low, high, nan, to_calls, bad_codes;
+  double min, max, rejected_min, rejected_max;
+  int shift, buckets;
+  uint64_t histogram[MAX_BUCKETS];
+};
+
+/* parse the n numbers after the word at the start of line into u or d */
+static
+bool numbers(const char *line, int n, uint64_t *u, double *d) {
+  const char *p = line;
+  char *end;
+  int i;
+  while(*p && !isspace((unsigned char)*p)) p++;
+  for(i = 0; i < n; i++) {
+    if(u) u[i] = strtoull(p, &end, 10);
+    else d[i] = strtod(p, &end);
+    if(end == p) return false;
+    p = end;
+  }
+  while(isspace((unsigned char)*p)) p++;
+  return !*p;
+}
+
+static
+bool word(const char *line, const char *w) {
+  size_t n = strlen(w);
+  return strncmp(line, w, n) == 0 && (line[n] == ' ' || !line[n] || line[n] == '\n');
+}
+
+/* add the dumps in path (or - for stdin), returns false on an error */
+static
+bool read_dumps(struct feedback *fb, const char *path) {
+  FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  char line[2048];
+  unsigned long n = 0;
+  bool inside = false, failed = false;
+  if(!in) {
+    fprintf(stderr, "ERROR: %s: cannot read\n", path);
+    return false;
+  }
+  while(fgets(line, sizeof(line), in)) {
+    uint64_t u[MAX_BUCKETS + 1];
+    double d[4];
+    bool ok = true;
+    n++;
+    if(word(line, "fpc-stats")) {
+      char spec[4][48];
+      memset(spec, 0, sizeof(spec));
+      ok = sscanf(line + 9, "%47s %47s %47s %47s", spec[0], spec[1], spec[2], spec[3]) == 4;
+      if(ok && fb->dumps == 0 && !inside) {
+        memcpy(fb->spec, spec, sizeof(spec));
+      } else if(ok && memcmp(fb->spec, spec, sizeof(spec)) != 0) {
+        fprintf(stderr, "ERROR: %s:%lu: dumps of different formats\n", path, n);
+        failed = true;
+        break;
+      }
+      inside = true;
+    } else if(!inside) {
+      continue;
+    } else if(word(line, "from_double")) {
+      ok = numbers(line, 4, u, NULL);
+      fb->from_calls += u[0];
+      fb->low += u[1];
+      fb->high += u[2];
+      fb->nan += u[3];
+    } else if(word(line, "to_double")) {
+      ok = numbers(line, 2, u, NULL);
+      fb->to_calls += u[0];
+      fb->bad_codes += u[1];
+    } else if(word(line, "values")) {
+      ok = numbers(line, 4, NULL, d);
+      fb->min = d[0] < fb->min ? d[0] : fb->min;
+      fb->max = d[1] > fb->max ? d[1] : fb->max;
+      fb->rejected_min = d[2] < fb->rejected_min ? d[2] : fb->rejected_min;
+      fb->rejected_max = d[3] > fb->rejected_max ? d[3] : fb->rejected_max;
+    } else if(word(line, "histogram")) {
+      int k = 0;
+      char *p = line + 9, *end;
+      for(;; k++) {
+        uint64_t x = strtoull(p, &end, 10);
+        if(end == p || k > MAX_BUCKETS) break;
+        u[k] = x;
+        p = end;
+      }
+      ok = k >= 2 && (fb->buckets == 0 || (fb->shift == (int)u[0] && fb->buckets == k - 1));
+      if(ok) {
+        fb->shift = (int)u[0];
+        fb->buckets = k - 1;
+        for(k = 0; k < fb->buckets; k++) fb->histogram[k] += u[k + 1];
+      }
+    } else if(word(line, "end")) {
+      inside = false;
+      fb->dumps++;
+    } else {
+      ok = false;
+    }
+    if(!ok) {
+      fprintf(stderr, "ERROR: %s:%lu: bad line in a dump\n", path, n);
+      failed = true;
+      break;
+    }
+  }
+  if(in != stdin) fclose(in);
+  if(failed) return false;
+  if(inside) {
+    fprintf(stderr, "ERROR: %s: a dump without an end\n", path);
+    return false;
+  }
+  return true;
+}
+
+/* the decimals of a multiple of precision */
+static
+int decimals(long double precision) {
+  int d = (int)ceill(-log10l(precision) - 1e-9L);
+  return d > 0 ? d : 0;
+}
+
+/* x rounded down (or up) to a multiple of 1 / scale, ignoring the
+   error of a double that was meant to be one */
+static
+long double outward(long double x, long double scale, bool up) {
+  long double v = x * scale, r = roundl(v);
+  if(fabsl(v - r) < 1e-6L * (fabsl(v) > 1 ? fabsl(v) : 1)) v = r;
+  return (up ? ceill(v) : floorl(v)) / scale;
+}
+
+/* the format of min, max and precision in scale, false on an error */
+static
+bool calculate(long double min, long double max, long double precision, enum fpc_scale scale,
+               struct fpc_parameters *out) {
+  struct fpc_parameters p;
+  struct fpc_scaled scaled;
+  memset(&p, 0, sizeof(p));
+  p.min = min;
+  p.max = max;
+  p.precision = precision;
+  if(!fpc_calculate(&p)) {
+    *out = p;
+    return false;
+  }
+  if(scale != FPC_SCALE_POW2) {
+    if(!fpc_calculate_scaled(&p, scale, &scaled)) {
+      *out = scaled.param;
+      return false;
+    }
+    p = scaled.param;
+  }
+  *out = p;
+  return true;
+}
+
+int feedback_main(int argc, char **argv) {
+  struct feedback fb;
+  struct fpc_parameters was, now;
+  enum fpc_scale scale;
+  double margin = 0;
+  bool outliers = false;
+  int i, used = 0;
+
+  memset(&fb, 0, sizeof(fb));
+  fb.min = fb.rejected_min = INFINITY;
+  fb.max = fb.rejected_max = -INFINITY;
+  for(; argc > 0 && strncmp(argv[0], "--", 2) == 0; argc--, argv++) {
+    if(strcmp(argv[0], "--outliers") == 0) {
+      outliers = true;
+    } else if(strncmp(argv[0], "--margin=", 9) == 0) {
+      char *end;
+      margin = strtod(argv[0] + 9, &end);
+      if(*end || !(margin >= 0)) {
+        fprintf(stderr, "ERROR: %s: the margin is a percentage\n", argv[0]);
+        return -1;
+      }
+    } else {
+      break;
+    }
+  }
+  if(argc < 1) {
+    fprintf(stderr, "fpc --feedback [--margin=percent] [--outliers] [dump file] ...\n");
+    return -1;
+  }
+  for(i = 0; i < argc; i++) {
+    if(!read_dumps(&fb, argv[i])) return -1;
+  }
+  if(fb.dumps == 0) {
+    fprintf(stderr, "ERROR: no dumps\n");
+    return -1;
+  }
+  if(!gen_parse_scale(fb.spec[3], &scale)) {
+    fprintf(stderr, "ERROR: unknown scale: %s\n", fb.spec[3]);
+    return -1;
+  }
+  if(!calculate(fpc_eval_expr(fb.spec[0]), fpc_eval_expr(fb.spec[1]), fpc_eval_expr(fb.spec[2]),
+                scale, &was)) {
+    fprintf(stderr, "ERROR: %s\n", was.error);
+    return -1;
+  }
+  uint64_t range = (uint64_t)(was.upper_bound - was.lower_bound);
+  if(fb.buckets && (fb.shift != gen_stats_shift(&was) || (uint64_t)fb.buckets != (range >> fb.shift) + 1)) {
+    fprintf(stderr, "ERROR: the histogram isn't of %s %s %s\n", fb.spec[0], fb.spec[1], fb.spec[2]);
+    return -1;
+  }
+  for(i = 0; i < fb.buckets; i++) used += fb.histogram[i] != 0;
+
+  printf("[OBSERVED]\n");
+  printf("  format: %s %s %s, %s scale\n", fb.spec[0], fb.spec[1], fb.spec[2], fb.spec[3]);
+  printf("  dumps: %u\n", fb.dumps);
+  printf("  from double: %" PRIu64 " calls, %" PRIu64 " below, %" PRIu64 " above, %" PRIu64 " NaN\n",
+         fb.from_calls, fb.low, fb.high, fb.nan);
+  printf("  to double: %" PRIu64 " calls, %" PRIu64 " codes out of range\n", fb.to_calls, fb.bad_codes);
+  if(fb.min <= fb.max) printf("  converted: [%.17g, %.17g]\n", fb.min, fb.max);
+  if(fb.rejected_min <= fb.rejected_max) {
+    printf("  rejected: [%.17g, %.17g]\n", fb.rejected_min, fb.rejected_max);
+  }
+  printf("  histogram: %d of %d buckets of %" PRIu64 " codes used\n", used, fb.buckets,
+         (uint64_t)1 << fb.shift);
+
+  double lo = fb.min, hi = fb.max;
+  if(outliers && fb.rejected_min <= fb.rejected_max) {
+    lo = fb.rejected_min < lo ? fb.rejected_min : lo;
+    hi = fb.rejected_max > hi ? fb.rejected_max : hi;
+  }
+  if(!(lo <= hi)) {
+    fprintf(stderr, "ERROR: no values were converted\n");
+    return -1;
+  }
+  long double precision = was.precision, span = (long double)hi - lo, scale10;
+  int d = decimals(precision);
+  scale10 = powl(10, d);
+  long double min = outward(lo - span * margin / 100, scale10, false);
+  long double max = outward(hi + span * margin / 100, scale10, true);
+  if(max - min < precision) max = min + precision;
+  if(!calculate(min, max, precision, scale, &now)) {
+    fprintf(stderr, "ERROR: %s\n", now.error);
+    return -1;
+  }
+
+  printf("\n[PROPOSED]\n");
+  printf("  min: %.*Lf (was %s)\n", d, min, fb.spec[0]);
+  printf("  max: %.*Lf (was %s)\n", d, max, fb.spec[1]);
+  printf("  bits used: %d (was %d)\n", now.integer_bits + now.fractional_bits,
+         was.integer_bits + was.fractional_bits);
+  printf("  machine bit width: %d (was %d)\n", now.fixed_encoding_width, was.fixed_encoding_width);
+  printf("  fpc%s%s %.*Lf %.*Lf %s\n", scale != FPC_SCALE_POW2 ? " --scale=" : "",
+         scale != FPC_SCALE_POW2 ? fb.spec[3] : "", d, min, d, max, fb.spec[2]);
+  if(fb.low || fb.high) {
+    printf("  %" PRIu64 " values were out of range%s\n", fb.low + fb.high,
+           outliers ? ", now included" : ", add --outliers to include them");
+  }
+  return 0;
+}
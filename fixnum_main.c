@@ -0,0 +1,129 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "fixnum_string.h"
+
+#define BUF_SIZE 65536
+#define VALUES 4096
+
+/* fixnum_string [-f fractional_bits] [value]
+   trace a value through each conversion, or without one, read
+   newline-separated values from stdin and write them back as they
+   read at that precision */
+
+static
+int trace(char *arg, unsigned int fractional_bits) {
+  char buf[64] = {0};
+  int len = strlen(arg), exponent = 0, ret;
+  char digits[64];
+  __int128 mantissa = 0, wide = 0;
+  int64_t fixed = 0;
+
+  ret = read_float128(arg, len, &exponent, &mantissa);
+  show_float128(buf, sizeof buf - 1, 0, mantissa);
+  printf("read_float128(\"%s\", %d) = %d, %s, %d\n", arg, len, ret, buf, exponent);
+  if(ret < 0) return -1;
+  ret = float_to_fixed(exponent, mantissa, fractional_bits, &fixed);
+  printf("float_to_fixed(%d, %s, %u) = %d, %lld\n",
+         exponent, buf, fractional_bits, ret, (long long)fixed);
+  mantissa = fixed_to_float(fractional_bits, fixed, &exponent);
+  show_float128(buf, sizeof buf - 1, 0, mantissa);
+  printf("fixed_to_float(%u, %lld) = %s, %d\n",
+         fractional_bits, (long long)fixed, buf, exponent);
+  ret = show_float128(buf, sizeof buf - 1, exponent, mantissa);
+  printf("show_float128(\"%s\", %d, %d) = %d\n", buf, (int)sizeof buf - 1, exponent, ret);
+  ret = read_fixed(arg, len, fractional_bits, &fixed);
+  printf("read_fixed(\"%s\", %d, %u) = %d, %lld\n", arg, len, fractional_bits, ret, (long long)fixed);
+  ret = show_fixed(buf, sizeof buf - 1, fractional_bits, fixed);
+  printf("show_fixed(\"%s\", %d, %u, %lld) = %d\n",
+         buf, (int)sizeof buf - 1, fractional_bits, (long long)fixed, ret);
+  ret = read_fixed128(arg, len, fractional_bits, &wide);
+  show_float128(buf, sizeof buf - 1, 0, wide);
+  printf("read_fixed128(\"%s\", %d, %u) = %d, %s\n", arg, len, fractional_bits, ret, buf);
+  strcpy(digits, buf);
+  ret = show_fixed128(buf, sizeof buf - 1, fractional_bits, wide);
+  printf("show_fixed128(\"%s\", %d, %u, %s) = %d\n",
+         buf, (int)sizeof buf - 1, fractional_bits, digits, ret);
+  return 0;
+}
+
+/* values may span reads, so the unparsed tail is kept for the next one */
+static
+int round_trip(unsigned int fractional_bits) {
+  char *in = malloc(BUF_SIZE), *out = malloc(BUF_SIZE);
+  int64_t *values = malloc(VALUES * sizeof(*values));
+  size_t have = 0, used, line = 1;
+  int status = 0;
+  bool eof = false;
+
+  while(!eof || have) {
+    if(!eof) {
+      size_t n = fread(in + have, 1, BUF_SIZE - have, stdin);
+      have += n;
+      eof = n == 0;
+    }
+    // parse up to the last complete line unless it's the end
+    size_t complete = have;
+    if(!eof) {
+      while(complete && in[complete - 1] != '\n') complete--;
+      if(!complete) {
+        fprintf(stderr, "ERROR: line %zu too long\n", line);
+        status = -1;
+        break;
+      }
+    }
+    size_t count = read_fixed_n(in, complete, '\n', fractional_bits, values, VALUES, &used);
+    size_t done = 0, written;
+    while(done < count) {
+      done += show_fixed_n(out, BUF_SIZE, '\n', fractional_bits,
+                           values + done, count - done, &written);
+      fwrite(out, 1, written, stdout);
+    }
+    for(size_t i = 0; i < used; i++) line += in[i] == '\n';
+    if(count < VALUES && used < complete) {
+      int64_t fixed;
+      int ret = read_fixed(in + used, complete - used, fractional_bits, &fixed);
+      fflush(stdout);
+      fprintf(stderr, "ERROR: line %zu: %s\n", line, strerror(ret < 0 ? -ret : EINVAL));
+      status = -1;
+      break;
+    }
+    memmove(in, in + used, have - used);
+    have -= used;
+    if(eof && !count) break;
+  }
+  free(in);
+  free(out);
+  free(values);
+  return status;
+}
+
+int main(int argc, char **argv) {
+  unsigned int fractional_bits = 16;
+  if(argc >= 3 && strcmp(argv[1], "-f") == 0) {
+    fractional_bits = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+  if(argc >= 2) {
+    return trace(argv[1], fractional_bits);
+  }
+  return round_trip(fractional_bits);
+}
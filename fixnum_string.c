@@ -12,218 +12,357 @@
  * See the License for the specific language governing permissions and
  * limitations under the License. */
 
-#include <stdio.h>
-#include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 #include <stdbool.h>
-#include <limits.h>
-#include <stdint.h>
+
+#include "fixnum_string.h"
 
 #define RADIX 10
 #define LOG2_RATIO 1292913986 // 2^32 * (log 2 / log RADIX)
-#define MAX_EXP 19
-#define SENTINEL (INT_MAX / RADIX)
-
-int main(int argc, char **argv) {
-  char buf[64] = {0};
-  if(argc >= 2) {
-    int exponent, mantissa;
-    char *arg = argv[1];
-    int len = strlen(arg);
-    int ret = read_float(arg, len, &exponent, &mantissa);
-    printf("read_float(\"%s\", %d, %d, %d) = %d\n", arg, len, exponent, mantissa, ret);
-    int fractional_bits = 16;
-    int fixed = float_to_fixed(exponent, mantissa, fractional_bits);
-    printf("float_to_fixed(%d, %d, %d) = %d\n", exponent, mantissa, fractional_bits, fixed);
-    mantissa = fixed_to_float(fractional_bits, fixed, &exponent);
-    printf("fixed_to_float(%d, %d, %d) = %d\n", fractional_bits, fixed, exponent, mantissa);
-    ret = show_float(buf, sizeof buf - 1, exponent, mantissa);
-    printf("show_float(\"%s\", %d, %d, %d) = %d\n", buf, (int)sizeof buf - 1, exponent, mantissa, ret);
-    fixed = read_fixed(arg, len, fractional_bits);
-    printf("read_fixed(\"%s\", %d, %d) = %d\n", arg, len, fractional_bits, fixed);
-    ret = show_fixed(buf, sizeof buf - 1, fractional_bits, fixed);
-    printf("show_fixed(\"%s\", %d, %d, %d) = %d\n", buf, (int)sizeof buf - 1, fractional_bits, fixed, ret);
-  }
-  return 0;
+#define MAX_EXP 38
+#define SEGMENT 19 // digits that always fit in a uint64_t
+#define MAX_FRACTIONAL_BITS 63
+
+typedef unsigned __int128 uint128_t;
+
+static const uint64_t powers[SEGMENT + 1] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+  1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+  1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static const char digit_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+/* RADIX^n for n <= MAX_EXP */
+static
+uint128_t exp_radix(unsigned int n) {
+  if(n <= SEGMENT) return powers[n];
+  return (uint128_t)powers[n - SEGMENT] * powers[SEGMENT];
 }
 
-char num_to_digit(unsigned int num) {
-  if(num < 10) {
-    return '0' + num;
-  } else return '?';
+static
+int count_digits64(uint64_t n) {
+  int t = ((64 - __builtin_clzll(n | 1)) * 1233) >> 12; // ~ log10(2^bits)
+  return t + ((n | 1) >= powers[t]);
 }
 
-int digit_to_num(char digit) {
-  if(digit < '0') {
-    return -1;
-  } else if(digit <= '9') {
-    return digit - '0';
-  } else {
-    return -1;
+static
+int count_digits(uint128_t n) {
+  if(!(n >> 64)) return count_digits64(n);
+  if(n >= exp_radix(MAX_EXP)) return MAX_EXP + 1;
+  return SEGMENT + count_digits64(n / powers[SEGMENT]);
+}
+
+/* write the low width digits of n ending at end, two at a time */
+static
+void put_digits64(char *end, uint64_t n, int width) {
+  while(width >= 2) {
+    unsigned int pair = n % 100;
+    n /= 100;
+    end -= 2;
+    memcpy(end, digit_pairs + 2 * pair, 2);
+    width -= 2;
   }
+  if(width) *--end = '0' + n % 10;
 }
 
-void reverse(char *buf, size_t size) {
-  char
-    *left = buf,
-    *right = buf + size - 1,
-    tmp;
+static
+void put_digits(char *end, uint128_t n, int width) {
+  while(width > SEGMENT) {
+    put_digits64(end, n % powers[SEGMENT], SEGMENT);
+    n /= powers[SEGMENT];
+    end -= SEGMENT;
+    width -= SEGMENT;
+  }
+  put_digits64(end, n, width);
+}
 
-  while(left < right) {
-    tmp = *left;
-    *left = *right;
-    *right = tmp;
-    left++;
-    right--;
+/* are all eight bytes of v '0' to '9'? */
+static
+bool eight_digits(uint64_t v) {
+  return ((v & 0xF0F0F0F0F0F0F0F0ULL) |
+          (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+    0x3333333333333333ULL;
+}
+
+/* the value of eight digits, first digit in the low byte */
+static
+uint64_t parse_eight(uint64_t v) {
+  const uint64_t mask = 0x000000FF000000FFULL;
+  v -= 0x3030303030303030ULL;
+  v = v * 10 + (v >> 8);
+  return ((v & mask) * (100 + (1000000ULL << 32)) +
+          ((v >> 16) & mask) * (1 + (10000ULL << 32))) >> 32;
+}
+
+/* read up to SEGMENT digits into *segment, returns how many */
+static
+int scan_digits(const char *cursor, const char *end, uint64_t *segment) {
+  uint64_t n = 0;
+  int count = 0;
+  while(SEGMENT - count >= 8 && end - cursor >= 8) {
+    uint64_t v;
+    memcpy(&v, cursor, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    if(!eight_digits(v)) break;
+    n = n * 100000000 + parse_eight(v);
+    cursor += 8;
+    count += 8;
+  }
+  while(count < SEGMENT && cursor < end && *cursor >= '0' && *cursor <= '9') {
+    n = n * RADIX + (*cursor++ - '0');
+    count++;
   }
+  *segment = n;
+  return count;
 }
 
-int read_float(char *buf, size_t size, int *exponent_out, int *mantissa_out) {
-  int mantissa = 0;
-  int exponent = 0;
-  bool neg = false;
-  char *cursor = buf;
-  char *end = buf + size;
+/* [-]digits[.digits] with at most max_digits significant digits in the
+   whole part, the fraction rounded to max_digits, ties away from zero */
+static
+int read_decimal(const char *buf, size_t size, int max_digits,
+                 int *exponent_out, uint128_t *magnitude_out, bool *neg_out) {
+  const char *cursor = buf, *end = buf + size;
+  uint128_t n = 0;
+  uint64_t segment;
+  int exponent = 0, digits = 0, first = -1, k;
+  bool any = false;
 
   // sign
-  if(cursor < end && *cursor == '-') {
-    neg = true;
-    cursor++;
-  }
+  bool neg = cursor < end && *cursor == '-';
+  if(neg) cursor++;
 
-  // whole part
-  while(cursor < end) {
-    int digit = digit_to_num(*cursor);
-    if(digit < 0) break;
-    if(mantissa >= SENTINEL) return -EOVERFLOW;
-    mantissa *= RADIX;
-    mantissa += digit;
+  // whole part, leading zeroes aren't significant
+  while(cursor < end && *cursor == '0') {
     cursor++;
+    any = true;
+  }
+  while((k = scan_digits(cursor, end, &segment)) > 0) {
+    if(digits + k > max_digits) return -EOVERFLOW;
+    n = n ? n * exp_radix(k) + segment : segment;
+    digits += k;
+    cursor += k;
+    any = true;
+    if(k < SEGMENT) break;
   }
 
   // fractional part
   if(cursor < end && *cursor == '.') {
     cursor++;
-    while(cursor < end) {
-      int digit = digit_to_num(*cursor);
-      if(digit < 0) break;
-      if(mantissa >= SENTINEL) return -EOVERFLOW;
-      mantissa *= RADIX;
-      mantissa += digit;
+    while(!n && cursor < end && *cursor == '0') {
       cursor++;
       exponent--;
+      any = true;
+    }
+    while((k = scan_digits(cursor, end, &segment)) > 0) {
+      // keep the digits up to max_digits and the first one after them
+      int keep = max_digits - digits < k ? max_digits - digits : k;
+      if(keep < k && first < 0) first = segment / powers[k - keep - 1] % RADIX;
+      segment /= powers[k - keep];
+      n = n ? n * exp_radix(keep) + segment : segment;
+      digits += keep;
+      exponent -= keep;
+      cursor += k;
+      any = true;
+      if(k < SEGMENT) break;
+    }
+    if(first >= RADIX / 2 && ++n == exp_radix(max_digits)) {
+      n = exp_radix(max_digits - 1);
+      exponent++;
     }
   }
+
+  if(!any) return -EINVAL;
   *exponent_out = exponent;
-  *mantissa_out = neg ? -mantissa : mantissa;
+  *magnitude_out = n;
+  *neg_out = neg;
   return cursor - buf;
 }
 
-int show_float(char *buf, size_t size, int exponent, int mantissa) {
-  int n = mantissa < 0 ? -mantissa : mantissa;
-  char *cursor = buf;
-  char *end = buf + size;
-  if(exponent >= 0) exponent = 1;
+int read_float(const char *buf, size_t size, int *exponent, int64_t *mantissa) {
+  uint128_t n;
+  bool neg;
+  int ret = read_decimal(buf, size, SEGMENT, exponent, &n, &neg);
+  if(ret < 0) return ret;
+  if(n > (uint128_t)INT64_MAX + neg) return -EOVERFLOW;
+  *mantissa = neg ? (int64_t)-(uint64_t)n : (int64_t)n;
+  return ret;
+}
 
-  // remove trailing zeroes
-  while(exponent < 0 && n % RADIX == 0) {
-    n /= RADIX;
-    exponent++;
-  }
+int read_float128(const char *buf, size_t size, int *exponent, __int128 *mantissa) {
+  uint128_t n;
+  bool neg;
+  int ret = read_decimal(buf, size, MAX_EXP, exponent, &n, &neg);
+  if(ret < 0) return ret;
+  *mantissa = neg ? -(__int128)n : (__int128)n;
+  return ret;
+}
 
-  // fractional part
-  if(exponent < 0) {
+int show_float128(char *buf, size_t size, int exponent, __int128 mantissa) {
+  bool neg = mantissa < 0;
+  uint128_t n = neg ? -(uint128_t)mantissa : (uint128_t)mantissa;
+  uint128_t whole, part = 0;
+  int frac = 0, zeroes = 0;
 
-    while(exponent < 0) {
-      if(cursor >= end) return -EOVERFLOW;
-      *cursor++ = num_to_digit(n % RADIX);
+  if(exponent < 0) {
+    // remove trailing zeroes
+    while(exponent < 0 && !(n >> 64) && (uint64_t)n % RADIX == 0) {
+      n = (uint64_t)n / RADIX;
+      exponent++;
+    }
+    while(exponent < 0 && n % RADIX == 0) {
       n /= RADIX;
       exponent++;
     }
-
-    if(cursor >= end) return -EOVERFLOW;
-    *cursor++ = '.';
+    frac = -exponent;
+  } else if(n) {
+    zeroes = exponent;
   }
-
-  // whole part
-  do {
-    if(cursor >= end) return -EOVERFLOW;
-    *cursor++ = num_to_digit(n % RADIX);
-    n /= RADIX;
-    exponent++;
-  } while(n);
-
-  // sign
-  if(mantissa < 0) {
-    if(cursor >= end) return -EOVERFLOW;
-    *cursor++ = '-';
+  whole = n;
+
+  // split at the decimal point
+  if(frac > MAX_EXP) {
+    whole = 0;
+    part = n;
+  } else if(frac && !(n >> 64) && frac <= SEGMENT) {
+    whole = (uint64_t)n / powers[frac];
+    part = (uint64_t)n % powers[frac];
+  } else if(frac) {
+    uint128_t p = exp_radix(frac);
+    whole = n / p;
+    part = n % p;
   }
 
-  // flip it
-  int written = cursor - buf;
-  reverse(buf, written);
+  int whole_digits = count_digits(whole);
+  size_t length = neg + whole_digits + zeroes + (frac ? 1 + frac : 0);
+  if(length >= size) return -EOVERFLOW;
 
-  // add a null terminator
-  if(cursor >= end) return -EOVERFLOW;
+  char *cursor = buf;
+  if(neg) *cursor++ = '-';
+  cursor += whole_digits;
+  put_digits(cursor, whole, whole_digits);
+  memset(cursor, '0', zeroes);
+  cursor += zeroes;
+  if(frac) {
+    *cursor++ = '.';
+    cursor += frac;
+    put_digits(cursor, part, frac);
+  }
   *cursor = 0;
+  return length;
+}
 
-  return written;
+int show_float(char *buf, size_t size, int exponent, int64_t mantissa) {
+  return show_float128(buf, size, exponent, mantissa);
 }
 
-#define SQUARED(X) ((unsigned long)(X) * (X))
-#define RADIX2 SQUARED(RADIX)
-#define RADIX4 SQUARED(RADIX2)
-#define RADIX8 SQUARED(RADIX4)
-#define RADIX16 SQUARED(RADIX8)
-uint64_t exp_radix(unsigned int n) {
-  int64_t x = 1;
-  if(n > MAX_EXP) return 0;
-  if(n >= 16) {
-    x *= RADIX16;
-    n -= 16;
-  }
-  if(n >= 8) {
-    x *= RADIX8;
-    n -= 8;
-  }
-  if(n >= 4) {
-    x *= RADIX4;
-    n -= 4;
+/* r * 2^fractional_bits / 10^k rounded, ties away from zero, for r < 10^k */
+static
+uint128_t scale_fraction(uint128_t r, unsigned int k, unsigned int fractional_bits) {
+  uint128_t d = exp_radix(k), frac = 0;
+  unsigned int i;
+  if(k <= SEGMENT && !((r << fractional_bits) >> 63)) {
+    frac = ((uint64_t)r << fractional_bits) + (uint64_t)d / 2;
+    return (uint64_t)frac / (uint64_t)d;
   }
-  if(n >= 2) {
-    x *= RADIX2;
-    n -= 2;
-  }
-  if(n >= 1) {
-    x *= RADIX;
-    n -= 1;
+  if(k <= SEGMENT) return ((r << fractional_bits) + d / 2) / d;
+  for(i = 0; i < fractional_bits; i++) {
+    r <<= 1;
+    frac <<= 1;
+    if(r >= d) {
+      r -= d;
+      frac |= 1;
+    }
   }
-  return x;
+  if(r >= d - r) frac++;
+  return frac;
 }
 
-#define SIGN(x, y) ((x) < 0 ? -(y) : (y))
-#define ROUND(type, frac, x) (((x) + SIGN((x), (1 << ((frac) - 1)))) >> (frac))
-#define CEILING(type, frac, x) (((x) + (((type)1) << (frac)) - 1) >> (frac))
+int float_to_fixed(int exponent, __int128 mantissa, unsigned int fractional_bits,
+                   int64_t *fixed) {
+  bool neg = mantissa < 0;
+  uint128_t m = neg ? -(uint128_t)mantissa : (uint128_t)mantissa;
+  uint128_t limit = ((uint128_t)1 << 63) - !neg;
+  uint128_t result;
 
-int32_t float_to_fixed(int exponent, int32_t mantissa, unsigned int fractional_bits) {
-  int64_t fixed = (int64_t)mantissa << fractional_bits;
-  if(exponent < 0) {
-    int64_t divisor = exp_radix(-exponent) / 2;
-    fixed /= divisor;
-    fixed = (fixed + SIGN(mantissa, 1)) / 2;
+  if(fractional_bits > MAX_FRACTIONAL_BITS) return -EOVERFLOW;
+  if(!m) {
+    *fixed = 0;
+    return 0;
+  }
+
+  if(exponent >= 0) {
+    if(exponent > MAX_EXP) return -EOVERFLOW;
+    uint128_t p = exp_radix(exponent);
+    if(m > (limit >> fractional_bits) / p) return -EOVERFLOW;
+    result = (m * p) << fractional_bits;
   } else {
-    fixed *= exp_radix(exponent);
+    unsigned int k = -exponent;
+    if(k > MAX_EXP) {
+      // round to MAX_EXP digits first
+      if(k - MAX_EXP > MAX_EXP) {
+        *fixed = 0;
+        return 0;
+      }
+      uint128_t d = exp_radix(k - MAX_EXP);
+      m = (m + d / 2) / d;
+      k = MAX_EXP;
+    }
+    uint128_t d = exp_radix(k), q, r;
+    if(!(m >> 64) && k <= SEGMENT) {
+      q = (uint64_t)m / (uint64_t)d;
+      r = (uint64_t)m % (uint64_t)d;
+    } else {
+      q = m / d;
+      r = m % d;
+    }
+    if(q > limit >> fractional_bits) return -EOVERFLOW;
+    result = (q << fractional_bits) + scale_fraction(r, k, fractional_bits);
   }
-  return fixed;
+
+  if(result > limit) return -EOVERFLOW;
+  *fixed = neg ? (int64_t)-(uint64_t)result : (int64_t)result;
+  return 0;
 }
 
-int fixed_to_float(unsigned int fractional_bits, int32_t fixed, int *exponent_out) {
-  int exponent = CEILING(uint64_t, 32, (uint64_t)fractional_bits * LOG2_RATIO);
-  int floating = ROUND(int64_t, fractional_bits, fixed * exp_radix(exponent));
+__int128 fixed_to_float(unsigned int fractional_bits, int64_t fixed, int *exponent_out) {
+  if(fractional_bits > MAX_FRACTIONAL_BITS) fractional_bits = MAX_FRACTIONAL_BITS;
+  int exponent = ((uint64_t)fractional_bits * LOG2_RATIO + 0xFFFFFFFF) >> 32;
+  __int128 floating = (__int128)fixed * (__int128)exp_radix(exponent);
+
+  // round to an integer, ties away from zero
+  if(fractional_bits) {
+    __int128 half = (__int128)1 << (fractional_bits - 1);
+    floating = floating < 0 ?
+      -((-floating + half) >> fractional_bits) :
+      (floating + half) >> fractional_bits;
+  }
 
   // trim zeroes
-  while(floating % RADIX == 0 && exponent > 0) {
+  if(floating == (int64_t)floating) {
+    int64_t f64 = floating;
+    while(exponent > 0 && f64 % RADIX == 0) {
+      exponent--;
+      f64 /= RADIX;
+    }
+    floating = f64;
+  }
+  while(exponent > 0 && floating % RADIX == 0) {
     exponent--;
     floating /= RADIX;
   }
@@ -232,22 +371,140 @@ int fixed_to_float(unsigned int fractional_bits, int32_t fixed, int *exponent_ou
   return floating;
 }
 
-int read_fixed(char *buf, size_t size, unsigned int fractional_bits) {
-  int ret;
-  int mantissa, exponent;
+int read_fixed(const char *buf, size_t size, unsigned int fractional_bits, int64_t *fixed) {
+  __int128 mantissa;
+  int exponent;
+  int ret = read_float128(buf, size, &exponent, &mantissa);
+  if(ret < 0) return ret;
+  int err = float_to_fixed(exponent, mantissa, fractional_bits, fixed);
+  return err < 0 ? err : ret;
+}
 
-  ret = read_float(buf, size, &mantissa, &exponent);
+int show_fixed(char *buf, size_t size, unsigned int fractional_bits, int64_t fixed) {
+  int exponent;
+  __int128 mantissa = fixed_to_float(fractional_bits, fixed, &exponent);
+  return show_float128(buf, size, exponent, mantissa);
+}
 
-  if(ret < 0)
-    return 0;
+/* The whole part of a 128 bit number can take all 38 digits, so these
+   keep it apart from the fraction instead of going through a decimal
+   float. */
+int read_fixed128(const char *buf, size_t size, unsigned int fractional_bits, __int128 *fixed) {
+  const char *cursor = buf, *end = buf + size;
+  uint128_t whole = 0, part = 0;
+  uint64_t segment;
+  int k, digits = 0, first = -1;
+  bool any = false;
+
+  if(fractional_bits > MAX_FRACTIONAL_BITS) return -EOVERFLOW;
+  bool neg = cursor < end && *cursor == '-';
+  if(neg) cursor++;
+  uint128_t limit = ((uint128_t)1 << 127) - !neg;
+
+  while(cursor < end && *cursor == '0') {
+    cursor++;
+    any = true;
+  }
+  while((k = scan_digits(cursor, end, &segment)) > 0) {
+    if(whole > (limit - segment) / exp_radix(k)) return -EOVERFLOW;
+    whole = whole * exp_radix(k) + segment;
+    cursor += k;
+    any = true;
+    if(k < SEGMENT) break;
+  }
+  if(whole > limit >> fractional_bits) return -EOVERFLOW;
 
-  return float_to_fixed(mantissa, exponent, fractional_bits);
+  // the fraction rounded to MAX_EXP digits, like read_decimal()
+  if(cursor < end && *cursor == '.') {
+    cursor++;
+    while((k = scan_digits(cursor, end, &segment)) > 0) {
+      int keep = MAX_EXP - digits < k ? MAX_EXP - digits : k;
+      if(keep < k && first < 0) first = segment / powers[k - keep - 1] % RADIX;
+      part = part * exp_radix(keep) + segment / powers[k - keep];
+      digits += keep;
+      cursor += k;
+      any = true;
+      if(k < SEGMENT) break;
+    }
+    if(first >= RADIX / 2 && ++part == exp_radix(digits)) {
+      part = 0;
+      whole++;
+    }
+  }
+
+  if(!any) return -EINVAL;
+  uint128_t result = (whole << fractional_bits) + scale_fraction(part, digits, fractional_bits);
+  if(result > limit) return -EOVERFLOW;
+  *fixed = neg ? -(__int128)(result - 1) - 1 : (__int128)result;
+  return cursor - buf;
+}
+
+int show_fixed128(char *buf, size_t size, unsigned int fractional_bits, __int128 fixed) {
+  if(fractional_bits > MAX_FRACTIONAL_BITS) return -EOVERFLOW;
+  bool neg = fixed < 0;
+  uint128_t n = neg ? -(uint128_t)fixed : (uint128_t)fixed;
+  uint128_t whole = n >> fractional_bits;
+  uint64_t part = (uint64_t)n & (((uint64_t)1 << fractional_bits) - 1);
+  int frac = ((uint64_t)fractional_bits * LOG2_RATIO + 0xFFFFFFFF) >> 32;
+
+  // the fraction to frac digits, ties away from zero, as fixed_to_float()
+  if(part) {
+    uint128_t scaled = (uint128_t)part * powers[frac] + ((uint128_t)1 << (fractional_bits - 1));
+    part = scaled >> fractional_bits;
+    if(part == powers[frac]) {
+      whole++;
+      part = 0;
+    }
+  }
+  if(!part) frac = 0;
+  while(frac && part % RADIX == 0) {
+    part /= RADIX;
+    frac--;
+  }
+  neg = neg && (whole || part);
+
+  int whole_digits = count_digits(whole);
+  size_t length = neg + whole_digits + (frac ? 1 + frac : 0);
+  if(length >= size) return -EOVERFLOW;
+
+  char *cursor = buf;
+  if(neg) *cursor++ = '-';
+  cursor += whole_digits;
+  put_digits(cursor, whole, whole_digits);
+  if(frac) {
+    *cursor++ = '.';
+    cursor += frac;
+    put_digits64(cursor, part, frac);
+  }
+  *cursor = 0;
+  return length;
 }
 
-int show_fixed(char *buf, size_t size, unsigned int fractional_bits, int fixed) {
-  int ret;
-  int mantissa, exponent;
+size_t read_fixed_n(const char *buf, size_t size, char delim, unsigned int fractional_bits,
+                    int64_t *fixed, size_t n, size_t *used) {
+  const char *cursor = buf, *end = buf + size;
+  size_t i;
+  for(i = 0; i < n && cursor < end; i++) {
+    int ret = read_fixed(cursor, end - cursor, fractional_bits, &fixed[i]);
+    if(ret < 0 || (cursor + ret < end && cursor[ret] != delim)) break;
+    cursor += ret;
+    if(cursor < end) cursor++; // delimiter
+  }
+  *used = cursor - buf;
+  return i;
+}
 
-  mantissa = fixed_to_float(fractional_bits, fixed, &exponent);
-  return show_float(buf, size, exponent, mantissa);
+size_t show_fixed_n(char *buf, size_t size, char delim, unsigned int fractional_bits,
+                    const int64_t *fixed, size_t n, size_t *used) {
+  char *cursor = buf, *end = buf + size;
+  size_t i;
+  for(i = 0; i < n; i++) {
+    // the null terminator's place takes the delimiter
+    int ret = show_fixed(cursor, end - cursor, fractional_bits, fixed[i]);
+    if(ret < 0) break;
+    cursor += ret;
+    *cursor++ = delim;
+  }
+  *used = cursor - buf;
+  return i;
 }
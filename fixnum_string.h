@@ -0,0 +1,69 @@
+/* Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#ifndef __FIXNUM_STRING__
+#define __FIXNUM_STRING__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Decimal strings to and from fixed-point numbers without floating
+   point.  A decimal float is mantissa * 10^exponent, a fixed-point
+   number is fixed * 2^-fractional_bits with fractional_bits <= 63.
+
+   The read functions take a buffer that need not be null terminated,
+   stop at the first character that isn't part of the number, and
+   return the number of characters read or -EINVAL (no digits) or
+   -EOVERFLOW.  The show functions write a null terminated string of at
+   most size bytes and return its length or -EOVERFLOW. */
+
+/* [-]digits[.digits], up to 19 significant digits: more in the whole
+   part overflow, more in the fraction are rounded, ties away from zero */
+int read_float(const char *buf, size_t size, int *exponent, int64_t *mantissa);
+
+/* the same with up to 38 significant digits */
+int read_float128(const char *buf, size_t size, int *exponent, __int128 *mantissa);
+
+/* shortest [-]digits[.digits] for mantissa * 10^exponent */
+int show_float(char *buf, size_t size, int exponent, int64_t mantissa);
+int show_float128(char *buf, size_t size, int exponent, __int128 mantissa);
+
+/* mantissa * 10^exponent rounded to the nearest fixed-point number,
+   ties away from zero, returns 0 or -EOVERFLOW */
+int float_to_fixed(int exponent, __int128 mantissa, unsigned int fractional_bits,
+                   int64_t *fixed);
+
+/* fixed as a decimal float with enough digits to read back the same */
+__int128 fixed_to_float(unsigned int fractional_bits, int64_t fixed, int *exponent);
+
+int read_fixed(const char *buf, size_t size, unsigned int fractional_bits, int64_t *fixed);
+int show_fixed(char *buf, size_t size, unsigned int fractional_bits, int64_t fixed);
+
+/* the same for 128 bit fixed-point numbers; read_fixed128() rounds the
+   digits after the point to 38 first */
+int read_fixed128(const char *buf, size_t size, unsigned int fractional_bits, __int128 *fixed);
+int show_fixed128(char *buf, size_t size, unsigned int fractional_bits, __int128 fixed);
+
+/* Whole buffers of values, each followed by delim (the last may end
+   the buffer instead).  read_fixed_n() parses up to n values, stopping
+   at a malformed one; read_fixed() at buf + *used then gives the error.
+   show_fixed_n() formats values until n are done or the next doesn't
+   fit, without a null terminator.  Both return the number of values
+   and set *used to the bytes read or written. */
+size_t read_fixed_n(const char *buf, size_t size, char delim, unsigned int fractional_bits,
+                    int64_t *fixed, size_t n, size_t *used);
+size_t show_fixed_n(char *buf, size_t size, char delim, unsigned int fractional_bits,
+                    const int64_t *fixed, size_t n, size_t *used);
+
+#endif
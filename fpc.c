@@ -48,27 +48,13 @@ unsigned int int128_log2(int128_t x) {
   return x <= 1 ? 0 : 128 - clz128(x - 1);
 }
 
-bool fpc_calculate(struct fpc_parameters *param) {
-  if(param->max < param->min + param->precision) {
-    param->error = "max < min + precision";
-    return false;
-  }
-  if(param->precision <= 0.0L) {
-    param->error = "zero or negative precision";
-    return false;
-  }
-  param->fractional_bits = -floor_log2l(param->precision);
-  param->lower_bound = ceill(ldexpl(param->min - param->precision / 2, param->fractional_bits));
-  param->upper_bound = floorl(ldexpl(param->max + param->precision / 2, param->fractional_bits));
-
+/* the machine width, offset and signedness for lower_bound and upper_bound */
+static
+bool fit(struct fpc_parameters *param) {
   param->fixed_encoding_width = int128_log2(param->upper_bound - param->lower_bound + 1);
   param->integer_bits = param->fixed_encoding_width - param->fractional_bits;
 
-  if(param->fixed_encoding_width > 64) {
-    param->error = "fixed_encoding_width > 64";
-    return false;
-  }
-  if(param->fixed_encoding_width < 8) { // could disable this lower bound to support packed formats
+  if(param->fixed_encoding_width < 8) { // packed formats (-g --packed) use integer_bits + fractional_bits
     param->fixed_encoding_width = 8;
   } else {
     param->fixed_encoding_width = 1 << int_log2(param->fixed_encoding_width);
@@ -80,7 +66,12 @@ bool fpc_calculate(struct fpc_parameters *param) {
     param->large_offset = true;
   }
   param->use_signed = false;
-  if(param->min < 0.0L) {
+  if(param->fixed_encoding_width == 128) {
+    // bounds within 2^126 always fit, and the shifts below would overflow
+    param->offset = 0;
+    param->large_offset = false;
+    param->use_signed = param->min < 0.0L;
+  } else if(param->min < 0.0L) {
     if(param->upper_bound <= (((int128_t)1) << (param->fixed_encoding_width - 1)) - 1 &&
        param->lower_bound >= (((int128_t)-1) << (param->fixed_encoding_width - 1))) {
       param->offset = 0;
@@ -94,6 +85,133 @@ bool fpc_calculate(struct fpc_parameters *param) {
   return true;
 }
 
+bool fpc_calculate(struct fpc_parameters *param) {
+  if(param->max < param->min + param->precision) {
+    param->error = "max < min + precision";
+    return false;
+  }
+  if(param->precision <= 0.0L) {
+    param->error = "zero or negative precision";
+    return false;
+  }
+  param->fractional_bits = -floor_log2l(param->precision);
+  long double lower = ldexpl(param->min - param->precision / 2, param->fractional_bits);
+  long double upper = ldexpl(param->max + param->precision / 2, param->fractional_bits);
+  // the bounds must fit an int128_t, and 128 bit codes have no offset
+  if(lower <= -0x1p127L || upper >= 0x1p127L ||
+     (upper - lower >= 0x1p64L && (lower <= -0x1p126L || upper >= 0x1p126L))) {
+    param->error = "fixed_encoding_width > 128";
+    return false;
+  }
+  param->lower_bound = ceill(lower);
+  param->upper_bound = floorl(upper);
+
+  return fit(param);
+}
+
+const char *const fpc_scale_names[] = { "pow2", "decimal", "exact", "auto" };
+
+#define MAX_DECIMALS 15 // so 10^k is exact in a double
+
+static
+long long int gcd(long long int a, long long int b) {
+  while(b) {
+    long long int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/* x as num / 10^k in lowest terms with num < 2^53, if it is one */
+static
+bool as_decimal(long double x, long long int *num, long long int *den) {
+  long long int d = 1;
+  int k;
+  for(k = 0; k <= MAX_DECIMALS; k++, d *= 10) {
+    long double m = roundl(x * d);
+    if(m >= 1 && m < 0x1p53L && fabsl(x * d - m) <= m * 0x1p-50L) {
+      long long int g = gcd((long long int)m, d);
+      *num = (long long int)m / g;
+      *den = d / g;
+      return true;
+    }
+  }
+  return false;
+}
+
+static
+bool calculate_scaled(const struct fpc_parameters *param, enum fpc_scale scale,
+                      struct fpc_scaled *out) {
+  struct fpc_parameters *p = &out->param;
+  memset(out, 0, sizeof(*out));
+  out->scale = scale;
+  p->min = param->min;
+  p->max = param->max;
+  p->precision = param->precision;
+  if(!fpc_calculate(p)) return false;
+  if(scale == FPC_SCALE_POW2) {
+    if(p->fractional_bits <= -63 || p->fractional_bits >= 63) {
+      p->error = "no power of two scale";
+      return false;
+    }
+    out->num = p->fractional_bits < 0 ? 1LL << -p->fractional_bits : 1;
+    out->den = p->fractional_bits > 0 ? 1LL << p->fractional_bits : 1;
+    return true;
+  }
+
+  if(scale == FPC_SCALE_DECIMAL) {
+    // the largest power of ten at most the precision
+    int k = -(int)floorl(log10l(param->precision) + 1e-12L);
+    if(k > MAX_DECIMALS || k < -MAX_DECIMALS) {
+      p->error = "no decimal scale";
+      return false;
+    }
+    out->num = 1;
+    out->den = 1;
+    for(; k > 0; k--) out->den *= 10;
+    for(; k < 0; k++) out->num *= 10;
+  } else if(!as_decimal(param->precision, &out->num, &out->den)) {
+    p->error = "precision isn't a decimal";
+    return false;
+  }
+  long double step = (long double)out->num / out->den;
+  p->fractional_bits = 0;
+  p->error = NULL;
+  p->lower_bound = ceill((param->min - step / 2) / step);
+  p->upper_bound = floorl((param->max + step / 2) / step);
+  // so the converters can work exactly in doubles
+  long double limit = 0x1p52L / out->num;
+  if(p->lower_bound < -limit || p->upper_bound > limit) {
+    p->error = "values too large for an exact scale";
+    return false;
+  }
+  return fit(p);
+}
+
+/* fewer bytes, then fewer bits, then the cheaper scale */
+static
+bool cheaper(const struct fpc_scaled *a, const struct fpc_scaled *b) {
+  if(a->param.fixed_encoding_width != b->param.fixed_encoding_width) {
+    return a->param.fixed_encoding_width < b->param.fixed_encoding_width;
+  }
+  int bits_a = a->param.integer_bits + a->param.fractional_bits;
+  int bits_b = b->param.integer_bits + b->param.fractional_bits;
+  return bits_a < bits_b;
+}
+
+bool fpc_calculate_scaled(const struct fpc_parameters *param, enum fpc_scale scale,
+                          struct fpc_scaled *out) {
+  struct fpc_scaled alt;
+  int i;
+  if(scale != FPC_SCALE_AUTO) return calculate_scaled(param, scale, out);
+  calculate_scaled(param, FPC_SCALE_POW2, out);
+  for(i = FPC_SCALE_DECIMAL; i < FPC_SCALE_AUTO; i++) {
+    if(calculate_scaled(param, i, &alt) && (out->param.error || cheaper(&alt, out))) *out = alt;
+  }
+  return !out->param.error;
+}
+
 static
 const char *get_op(char c) {
   static const char *ops = "+a-a*b/b^c(())";
@@ -107,21 +225,35 @@ const char *get_op(char c) {
   return NULL;
 }
 
-static char vars[16];
-static long double values[sizeof(vars)];
-static unsigned int n_vars = 0;
+/* for the functions without a context */
+static struct fpc_context global_context;
 
-void fpc_set_var(char c, long double x) {
-  if(n_vars < sizeof(vars)) {
-    int n = n_vars++;
-    vars[n] = c;
-    values[n] = x;
+void fpc_context_init(struct fpc_context *ctx) {
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+void fpc_context_set_var(struct fpc_context *ctx, char c, long double x) {
+  long double *v = fpc_context_get_var(ctx, c);
+  if(v) {
+    *v = x;
+  } else if(c && ctx->n_vars < FPC_MAX_VARS) {
+    int n = ctx->n_vars++;
+    ctx->vars[n] = c;
+    ctx->values[n] = x;
   }
 }
 
+long double *fpc_context_get_var(struct fpc_context *ctx, char c) {
+  char *v = c ? strchr(ctx->vars, c) : NULL;
+  return v ? &ctx->values[v - ctx->vars] : NULL;
+}
+
+void fpc_set_var(char c, long double x) {
+  fpc_context_set_var(&global_context, c, x);
+}
+
 long double *fpc_get_var(char c) {
-  char *v = strchr(vars, c);
-  return v ? &values[v - vars] : NULL;
+  return fpc_context_get_var(&global_context, c);
 }
 
 static
@@ -139,78 +271,192 @@ bool do_op(char op, long double *arg) {
 }
 
 static
-long double parse_num(char **pstr) {
+bool emit(struct fpc_program *prog, char op, char var, long double value) {
+  if(prog->length >= LENGTH(prog->code)) return false;
+  prog->code[prog->length].op = op;
+  prog->code[prog->length].var = var;
+  prog->code[prog->length].value = value;
+  prog->length++;
+  return true;
+}
+
+static
+bool emit_num(struct fpc_program *prog, char **pstr) {
   char *p = *pstr;
   long double val = strtold(*pstr, pstr);
-  if(*pstr != p) return val;
+  if(*pstr != p) return emit(prog, 'k', 0, val);
   (*pstr)++;
-  long double *var = fpc_get_var(*p);
-  return var ? *var : NAN;
+  return emit(prog, 'v', *p, 0.0L);
 }
 
-/* expression parser based on the shunting-yard algorithm */
-long double fpc_eval_expr(char *str) {
-  long double args[32];
-  const char *ops[32];
+/* emit an operator, folding it into a constant if both arguments are */
+static
+bool emit_op(struct fpc_program *prog, char op) {
+  unsigned int n = prog->length;
+  if(n >= 2 && prog->code[n - 2].op == 'k' && prog->code[n - 1].op == 'k') {
+    long double args[2] = { prog->code[n - 2].value, prog->code[n - 1].value };
+    do_op(op, args);
+    prog->code[n - 2].value = args[0];
+    prog->length--;
+    return true;
+  }
+  return emit(prog, op, 0, 0.0L);
+}
+
+/* expression compiler based on the shunting-yard algorithm */
+bool fpc_compile_expr(char *str, struct fpc_program *prog) {
+  const char *ops[FPC_STACK_SIZE];
   unsigned int arg_top = 0;
   unsigned int op_top = 0;
   bool expect_num = true;
   char *p = str;
   const char *op;
+  prog->length = 0;
   while(*p) {
     while(*p == ' ') p++;
     op = get_op(*p);
     while(*p == ' ') p++;
     if(!op) {
-      if(!expect_num) return NAN;
-      if(arg_top >= LENGTH(args)) return NAN;
-      args[arg_top++] = parse_num(&p);
+      if(!expect_num) return false;
+      if(arg_top >= FPC_STACK_SIZE) return false;
+      if(!emit_num(prog, &p)) return false;
+      arg_top++;
       expect_num = false;
     } else if(*op == '(') {
       p++;
-      if(!expect_num) return NAN;
+      if(!expect_num) return false;
       ops[op_top++] = op;
     } else {
       p++;
       if(expect_num) {
         if(*op == '-') {
-          args[arg_top++] = -1.0L;
+          if(arg_top >= FPC_STACK_SIZE) return false;
+          if(!emit(prog, 'k', 0, -1.0L)) return false;
+          arg_top++;
           op += 2;
           goto checks;
-        } else return NAN;
+        } else return false;
       }
       while(op_top &&
             op[1] <= (ops[op_top - 1])[1] &&
-            do_op(*(ops[op_top - 1]), &args[arg_top - 2])) {
+            *(ops[op_top - 1]) != '(') {
+        if(!emit_op(prog, *(ops[op_top - 1]))) return false;
         arg_top--;
         op_top--;
       }
     checks:
       if(*op == ')') {
-        if(!op_top) return NAN;
+        if(!op_top) return false;
         op_top--;
         expect_num = false;
       } else {
-        if(op_top >= LENGTH(ops)) return NAN;
+        if(op_top >= LENGTH(ops)) return false;
         ops[op_top++] = op;
         expect_num = true;
       }
     }
   }
-  if(expect_num) return NAN;
+  if(expect_num) return false;
   while(op_top &&
-        do_op(*(ops[op_top - 1]), &args[arg_top - 2])) {
+        *(ops[op_top - 1]) != '(') {
+    if(!emit_op(prog, *(ops[op_top - 1]))) return false;
     arg_top--;
     op_top--;
   }
-  if(op_top) return NAN;
+  if(op_top) return false;
+  return true;
+}
+
+long double fpc_context_run_program(struct fpc_context *ctx, const struct fpc_program *prog) {
+  long double args[FPC_STACK_SIZE];
+  unsigned int i, arg_top = 0;
+  for(i = 0; i < prog->length; i++) {
+    char op = prog->code[i].op;
+    if(op == 'k') {
+      args[arg_top++] = prog->code[i].value;
+    } else if(op == 'v') {
+      long double *var = fpc_context_get_var(ctx, prog->code[i].var);
+      args[arg_top++] = var ? *var : NAN;
+    } else {
+      do_op(op, &args[arg_top - 2]);
+      arg_top--;
+    }
+  }
   return args[0];
 }
 
-bool fpc_calculate_from_strings(char *min,
-                                char *max,
-                                char *precision,
-                                struct fpc_parameters *param) {
+long double fpc_run_program(const struct fpc_program *prog) {
+  return fpc_context_run_program(&global_context, prog);
+}
+
+/* evaluate in blocks so each instruction is a simple loop over the block */
+#define BLOCK 64
+
+void fpc_run_program_n(const struct fpc_program *prog,
+                       const char *names,
+                       const double *const *columns,
+                       double *out,
+                       size_t n) {
+  double args[FPC_STACK_SIZE][BLOCK];
+  const double *vars[LENGTH(prog->code)];
+  size_t base, i, m;
+  unsigned int pc;
+
+  for(pc = 0; pc < prog->length; pc++) {
+    const char *v = NULL;
+    if(prog->code[pc].op == 'v' && prog->code[pc].var) {
+      v = strchr(names, prog->code[pc].var);
+    }
+    vars[pc] = v ? columns[v - names] : NULL;
+  }
+
+  for(base = 0; base < n; base += BLOCK) {
+    unsigned int arg_top = 0;
+    m = n - base < BLOCK ? n - base : BLOCK;
+    for(pc = 0; pc < prog->length; pc++) {
+      char op = prog->code[pc].op;
+      double *x, *y;
+      if(op == 'k' || op == 'v') {
+        x = args[arg_top++];
+        if(vars[pc]) {
+          memcpy(x, vars[pc] + base, m * sizeof(*x));
+        } else {
+          double k = op == 'k' ? prog->code[pc].value : NAN;
+          for(i = 0; i < m; i++) x[i] = k;
+        }
+        continue;
+      }
+      x = args[arg_top - 2];
+      y = args[arg_top - 1];
+      switch(op) {
+      case '+': for(i = 0; i < m; i++) x[i] += y[i]; break;
+      case '-': for(i = 0; i < m; i++) x[i] -= y[i]; break;
+      case '*': for(i = 0; i < m; i++) x[i] *= y[i]; break;
+      case '/': for(i = 0; i < m; i++) x[i] /= y[i]; break;
+      case '^': for(i = 0; i < m; i++) x[i] = pow(x[i], y[i]); break;
+      default:  for(i = 0; i < m; i++) x[i] = NAN; break;
+      }
+      arg_top--;
+    }
+    memcpy(out + base, args[0], m * sizeof(*out));
+  }
+}
+
+long double fpc_context_eval_expr(struct fpc_context *ctx, char *str) {
+  struct fpc_program prog;
+  if(!fpc_compile_expr(str, &prog)) return NAN;
+  return fpc_context_run_program(ctx, &prog);
+}
+
+long double fpc_eval_expr(char *str) {
+  return fpc_context_eval_expr(&global_context, str);
+}
+
+bool fpc_context_calculate_from_strings(struct fpc_context *ctx,
+                                        char *min,
+                                        char *max,
+                                        char *precision,
+                                        struct fpc_parameters *param) {
   struct entry {
     char *expr;
     long double *dest;
@@ -224,20 +470,32 @@ bool fpc_calculate_from_strings(char *min,
 
   unsigned int i, left = LENGTH(entries);
   bool progress;
+
+  // forget values from a previous call
+  for(i = 0; i < LENGTH(entries); i++) {
+    fpc_context_set_var(ctx, entries[i].var, NAN);
+  }
   do {
     progress = false;
     for(i = 0; i < LENGTH(entries); i++) {
       struct entry *e = &entries[i];
       if(e->complete) continue;
-      long double x = fpc_eval_expr(e->expr);
+      long double x = fpc_context_eval_expr(ctx, e->expr);
       if(!isnan(x)) {
         progress = true;
         left--;
         e->complete = true;
         *(e->dest) = x;
-        fpc_set_var(e->var, x);
+        fpc_context_set_var(ctx, e->var, x);
       }
     }
   } while(left && progress);
   return fpc_calculate(param);
 }
+
+bool fpc_calculate_from_strings(char *min,
+                                char *max,
+                                char *precision,
+                                struct fpc_parameters *param) {
+  return fpc_context_calculate_from_strings(&global_context, min, max, precision, param);
+}
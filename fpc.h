@@ -16,6 +16,11 @@
 #define __FPC__
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 typedef __int128_t int128_t;
 
@@ -46,9 +51,57 @@ struct fpc_parameters {
 };
 
 /* given an fpc_parameters struct with min, max, precision,
-   calculate the other members */
+   calculate the other members; fixed_encoding_width is 8, 16, 32, 64
+   or, for bounds within 2^126, 128 (__int128 with no offset) */
 bool fpc_calculate(struct fpc_parameters *param);
 
+/* Scales other than a power of two.  A scaled format's value is
+   (code + offset) * num / den, where num / den is at most the precision:
+   - FPC_SCALE_POW2: 2^-fractional_bits, as fpc_calculate()
+   - FPC_SCALE_DECIMAL: the largest power of ten
+   - FPC_SCALE_EXACT: the precision itself, if it is a decimal
+   - FPC_SCALE_AUTO: whichever needs the narrowest type, then the
+     fewest bits, preferring them in that order */
+enum fpc_scale {
+  FPC_SCALE_POW2,
+  FPC_SCALE_DECIMAL,
+  FPC_SCALE_EXACT,
+  FPC_SCALE_AUTO
+};
+
+extern const char *const fpc_scale_names[]; /* "pow2", ... */
+
+struct fpc_scaled {
+  enum fpc_scale scale; /* never FPC_SCALE_AUTO */
+  long long int num, den;
+
+  /* the format in units of num / den: the same as the calculated
+     parameters for FPC_SCALE_POW2, otherwise fractional_bits is 0 */
+  struct fpc_parameters param;
+};
+
+/* given param with min, max and precision, fill in out for scale,
+   returns false and sets out->param.error if there is no such format */
+bool fpc_calculate_scaled(const struct fpc_parameters *param, enum fpc_scale scale,
+                          struct fpc_scaled *out);
+
+/* Variables for expressions.  A context holds up to FPC_MAX_VARS
+   single letter variables in storage supplied by the caller and is
+   ready to use when zeroed.  The fpc_context_*() functions touch no
+   other state, so threads with their own contexts can evaluate and
+   calculate concurrently.  The functions without a context share a
+   global one and are not thread safe. */
+#define FPC_MAX_VARS 15
+
+struct fpc_context {
+  char vars[FPC_MAX_VARS + 1]; /* null terminated */
+  long double values[FPC_MAX_VARS];
+  unsigned int n_vars;
+};
+
+/* empty a context */
+void fpc_context_init(struct fpc_context *ctx);
+
 /* a simple expression evaluator
    supports (in order of precedence)
     - parenthesis: `(x)`
@@ -58,12 +111,47 @@ bool fpc_calculate(struct fpc_parameters *param);
     add variables with fpc_set_var()
 */
 long double fpc_eval_expr(char *str);
+long double fpc_context_eval_expr(struct fpc_context *ctx, char *str);
+
+/* maximum nesting of an expression */
+#define FPC_STACK_SIZE 32
+
+/* an expression compiled by fpc_compile_expr() to a stack program
+   with constant subexpressions already folded */
+struct fpc_program {
+  unsigned int length;
+  struct {
+    char op; /* 'k': push value, 'v': push variable var, else an operator */
+    char var;
+    long double value;
+  } code[128];
+};
+
+/* compile an fpc_eval_expr() expression, returns false on a syntax error */
+bool fpc_compile_expr(char *str, struct fpc_program *prog);
+
+/* evaluate a compiled expression using variables set with fpc_set_var() */
+long double fpc_run_program(const struct fpc_program *prog);
+long double fpc_context_run_program(struct fpc_context *ctx, const struct fpc_program *prog);
+
+/* evaluate a compiled expression n times, once per row of columns
+   column i holds the values of the variable names[i],
+   unlisted variables are NAN
+   computes in double, not long double like fpc_run_program(), so
+   results can differ from it in the last bits */
+void fpc_run_program_n(const struct fpc_program *prog,
+                       const char *names,
+                       const double *const *columns,
+                       double *out,
+                       size_t n);
 
 /* set a single letter variable for use in fpc_eval_expr() expressions */
 void fpc_set_var(char c, long double x);
+void fpc_context_set_var(struct fpc_context *ctx, char c, long double x);
 
-/* get a variable */
+/* get a variable, NULL if it isn't set */
 long double *fpc_get_var(char c);
+long double *fpc_context_get_var(struct fpc_context *ctx, char c);
 
 /* alternative to fpc_calculate that takes string expressions
    defines the following variables:
@@ -75,6 +163,14 @@ bool fpc_calculate_from_strings(char *min,
                                 char *max,
                                 char *precision,
                                 struct fpc_parameters *param);
+bool fpc_context_calculate_from_strings(struct fpc_context *ctx,
+                                        char *min,
+                                        char *max,
+                                        char *precision,
+                                        struct fpc_parameters *param);
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,336 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#ifndef __FPC_HPP__
+#define __FPC_HPP__
+
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+/* fpc without the code generation step (C++20, GCC or Clang).
+
+   fpc::calculate() is a constexpr port of fpc_calculate() giving the
+   same parameters, and fpc::fixed<Min, Max, Precision> stores a code
+   of the format it describes:
+
+     using temp = fpc::fixed<-40.0L, 125.0L, 0.01L>;
+     auto t = temp::from_double(21.5);  // std::optional<temp>
+     double d = (*t * *t).to_double();
+
+   to_double() and from_double() work like convert_to_double() and
+   convert_from_double() from fpc -g.  The arithmetic works like
+   fpc --arith _sat functions: exact intermediates, one rounding (ties
+   away from zero) into the format of the left operand, then clamped
+   to its range. */
+
+namespace fpc {
+
+typedef __int128 int128_t;
+
+struct parameters {
+  long double min, max, precision;
+  int128_t lower_bound, upper_bound, offset;
+  int fractional_bits, integer_bits, fixed_encoding_width;
+  bool use_signed, large_offset;
+  const char *error;
+};
+
+namespace detail {
+
+constexpr int floor_log2(long double x) {
+  int e = 0;
+  while(x >= 2.0L) { x /= 2.0L; e++; }
+  while(x < 1.0L) { x *= 2.0L; e--; }
+  return e;
+}
+
+constexpr long double ldexp(long double x, int e) {
+  for(; e > 0; e--) x *= 2.0L;
+  for(; e < 0; e++) x /= 2.0L;
+  return x;
+}
+
+// long double has a 64 bit mantissa, so anything this large is an integer
+constexpr long double integral_limit = 0x1p63L;
+
+constexpr int128_t floor(long double x) {
+  if(x >= integral_limit || x <= -integral_limit) return (int128_t)x;
+  int64_t t = (int64_t)x;
+  return (long double)t > x ? t - 1 : t;
+}
+
+constexpr int128_t ceil(long double x) {
+  return -floor(-x);
+}
+
+constexpr unsigned int int_log2(unsigned int x) {
+  unsigned int n = 0;
+  while(x > 1 && ((unsigned int)1 << n) < x) n++;
+  return n;
+}
+
+constexpr unsigned int int128_log2(int128_t x) {
+  unsigned int n = 0;
+  while(x > 1 && ((unsigned __int128)1 << n) < (unsigned __int128)x) n++;
+  return n;
+}
+
+constexpr double round(double x) {
+  if(!(x > -0x1p52 && x < 0x1p52)) return x;
+  double t = (double)(int64_t)x;
+  if(x - t >= 0.5) return t + 1;
+  if(t - x >= 0.5) return t - 1;
+  return t;
+}
+
+/* x / 2^s and n / d, ties away from zero, as fpc --arith */
+template<class W>
+constexpr W rshift(W x, int s) {
+  W h = (W)1 << (s - 1);
+  return x >= 0 ? (x + h) >> s : -((-x + h) >> s);
+}
+
+template<class W>
+constexpr W div(W n, W d) {
+  W q = n / d, r = n % d;
+  W ar = r < 0 ? -r : r, ad = d < 0 ? -d : d;
+  if(ar >= ad - ar) q += (n < 0) == (d < 0) ? 1 : -1;
+  return q;
+}
+
+template<class W>
+constexpr W align(W x, int from, int to) {
+  return to > from ? x * ((W)1 << (to - from)) : to < from ? rshift(x, from - to) : x;
+}
+
+constexpr int bit_length(int128_t x) {
+  unsigned __int128 u = x < 0 ? ~(unsigned __int128)x : (unsigned __int128)x;
+  int n = 1; // sign
+  for(; u; u >>= 1) n++;
+  return n;
+}
+
+/* bits for the scaled values (code + offset) of a format */
+constexpr int value_bits(const parameters &p) {
+  int a = bit_length(p.lower_bound), b = bit_length(p.upper_bound);
+  return a > b ? a : b;
+}
+
+/* the narrowest intermediate for bits and the values of the result r */
+template<int Bits>
+using wide_t =
+  std::conditional_t<Bits <= 32, int32_t,
+  std::conditional_t<Bits <= 64, int64_t, int128_t>>;
+
+constexpr int wide_bits(const parameters &r, int bits) {
+  return (bits > value_bits(r) ? bits : value_bits(r)) + 1; // room for rounding
+}
+
+template<int Width, bool Signed>
+using code_t =
+  std::conditional_t<Width == 8, std::conditional_t<Signed, int8_t, uint8_t>,
+  std::conditional_t<Width == 16, std::conditional_t<Signed, int16_t, uint16_t>,
+  std::conditional_t<Width == 32, std::conditional_t<Signed, int32_t, uint32_t>,
+  std::conditional_t<Width == 64, std::conditional_t<Signed, int64_t, uint64_t>,
+                                  std::conditional_t<Signed, __int128, unsigned __int128>>>>>;
+
+} // namespace detail
+
+/* fpc_calculate(), with the same error strings */
+constexpr parameters calculate(long double min, long double max, long double precision) {
+  parameters p = { min, max, precision, 0, 0, 0, 0, 0, 0, false, false, nullptr };
+  if(p.max < p.min + p.precision) {
+    p.error = "max < min + precision";
+    return p;
+  }
+  if(p.precision <= 0.0L) {
+    p.error = "zero or negative precision";
+    return p;
+  }
+  p.fractional_bits = -detail::floor_log2(p.precision);
+  long double lower = detail::ldexp(p.min - p.precision / 2, p.fractional_bits);
+  long double upper = detail::ldexp(p.max + p.precision / 2, p.fractional_bits);
+  if(lower <= -0x1p126L || upper >= 0x1p126L) {
+    p.error = "fixed_encoding_width > 128";
+    return p;
+  }
+  p.lower_bound = detail::ceil(lower);
+  p.upper_bound = detail::floor(upper);
+
+  p.fixed_encoding_width = detail::int128_log2(p.upper_bound - p.lower_bound + 1);
+  p.integer_bits = p.fixed_encoding_width - p.fractional_bits;
+
+  if(p.fixed_encoding_width < 8) {
+    p.fixed_encoding_width = 8;
+  } else {
+    p.fixed_encoding_width = 1 << detail::int_log2(p.fixed_encoding_width);
+  }
+  p.offset = p.lower_bound;
+  p.large_offset = p.offset > (((int128_t)1) << 63) - 1 || p.offset < -(((int128_t)1) << 63);
+  p.use_signed = false;
+  if(p.fixed_encoding_width == 128) {
+    p.offset = 0;
+    p.large_offset = false;
+    p.use_signed = p.min < 0.0L;
+  } else if(p.min < 0.0L) {
+    if(p.upper_bound <= (((int128_t)1) << (p.fixed_encoding_width - 1)) - 1 &&
+       p.lower_bound >= (((int128_t)-1) << (p.fixed_encoding_width - 1))) {
+      p.offset = 0;
+      p.use_signed = true;
+    }
+  } else {
+    if(p.upper_bound <= (((int128_t)1) << p.fixed_encoding_width) - 1) {
+      p.offset = 0;
+    }
+  }
+  return p;
+}
+
+template<long double Min, long double Max, long double Precision>
+class fixed {
+ public:
+  static constexpr parameters params = calculate(Min, Max, Precision);
+  static_assert(params.error == nullptr, "no format for these parameters, see fpc::calculate()");
+
+  using code_type = detail::code_t<params.fixed_encoding_width, params.use_signed>;
+  static constexpr int fractional_bits = params.fractional_bits;
+  static constexpr int128_t offset = params.offset;
+  static constexpr code_type min_code = (code_type)(params.lower_bound - params.offset);
+  static constexpr code_type max_code = (code_type)(params.upper_bound - params.offset);
+
+  /* the code nearest zero */
+  constexpr fixed() : code_(saturate_scaled(0).code_) {}
+
+  static constexpr fixed from_code(code_type c) { return fixed(c, 0); }
+
+  constexpr code_type code() const { return code_; }
+
+  /* code + offset, the value times 2^fractional_bits */
+  constexpr int128_t scaled() const { return (int128_t)code_ + offset; }
+
+  /* convert_to_double(): the value rounded to the requested precision */
+  constexpr double to_double() const {
+    double v = (double)code_ * (double)detail::ldexp(1.0L, -fractional_bits);
+    if(offset) v = v + (double)detail::ldexp((long double)offset, -fractional_bits);
+    if(Precision != 1.0L) {
+      v = detail::round(v * (double)(1.0L / Precision)) * (double)Precision;
+    }
+    return v;
+  }
+
+  explicit constexpr operator double() const { return to_double(); }
+
+  /* convert_from_double(): nothing outside [Min, Max] or NAN */
+  static constexpr std::optional<fixed> from_double(double x) {
+    if(!(x >= (double)Min && x <= (double)Max)) return std::nullopt;
+    return from_scaled(x);
+  }
+
+  /* like convert_from_double_n(), out of range values (and NAN) saturate */
+  static constexpr fixed saturate(double x) {
+    if(x >= (double)Min && x <= (double)Max) return from_scaled(x);
+    return x > 0 ? from_code(max_code) : from_code(min_code);
+  }
+
+  /* scaled value r of this format, clamped to its range */
+  static constexpr fixed saturate_scaled(int128_t r) {
+    return from_code((code_type)((r < params.lower_bound ? params.lower_bound :
+                                  r > params.upper_bound ? params.upper_bound : r) - offset));
+  }
+
+  /* b in this format, rounded and clamped */
+  template<long double M, long double N, long double P>
+  static constexpr fixed from(fixed<M, N, P> b) {
+    constexpr int fa = fractional_bits, fb = fixed<M, N, P>::fractional_bits;
+    constexpr int bits = detail::wide_bits(params,
+      detail::value_bits(fixed<M, N, P>::params) + (fa > fb ? fa - fb : 0));
+    static_assert(bits <= 128, "intermediate wider than 128 bits");
+    using W = detail::wide_t<bits>;
+    return saturate_scaled(detail::align((W)b.scaled(), fb, fa));
+  }
+
+  template<long double M, long double N, long double P>
+  constexpr fixed operator+(fixed<M, N, P> b) const { return addsub(b, 1); }
+
+  template<long double M, long double N, long double P>
+  constexpr fixed operator-(fixed<M, N, P> b) const { return addsub(b, -1); }
+
+  template<long double M, long double N, long double P>
+  constexpr fixed operator*(fixed<M, N, P> b) const {
+    using B = fixed<M, N, P>;
+    constexpr int fb = B::fractional_bits;
+    // the product, shifted left by align() if b has negative fractional bits
+    constexpr int bits = detail::wide_bits(params, detail::value_bits(params) + detail::value_bits(B::params) +
+                                           (fb < 0 ? -fb : 0));
+    static_assert(bits <= 128, "intermediate wider than 128 bits");
+    using W = detail::wide_t<bits>;
+    W r = (W)scaled() * (W)b.scaled();
+    return saturate_scaled(detail::align(r, fractional_bits + fb, fractional_bits));
+  }
+
+  /* division by zero saturates */
+  template<long double M, long double N, long double P>
+  constexpr fixed operator/(fixed<M, N, P> b) const {
+    using B = fixed<M, N, P>;
+    constexpr int fb = B::fractional_bits;
+    constexpr int n_bits = detail::value_bits(params) + (fb > 0 ? fb : 0);
+    constexpr int d_bits = detail::value_bits(B::params) + (fb < 0 ? -fb : 0);
+    constexpr int bits = detail::wide_bits(params, n_bits > d_bits ? n_bits : d_bits);
+    static_assert(bits <= 128, "intermediate wider than 128 bits");
+    using W = detail::wide_t<bits>;
+    W n = detail::align((W)scaled(), 0, fb > 0 ? fb : 0);
+    W d = detail::align((W)b.scaled(), 0, fb < 0 ? -fb : 0);
+    if(d == 0) {
+      return saturate_scaled(n > 0 ? params.upper_bound : n < 0 ? params.lower_bound : 0);
+    }
+    return saturate_scaled(detail::div(n, d));
+  }
+
+  template<class B> constexpr fixed &operator+=(B b) { return *this = *this + b; }
+  template<class B> constexpr fixed &operator-=(B b) { return *this = *this - b; }
+  template<class B> constexpr fixed &operator*=(B b) { return *this = *this * b; }
+  template<class B> constexpr fixed &operator/=(B b) { return *this = *this / b; }
+
+  // codes are in the same order as values
+  constexpr auto operator<=>(const fixed &) const = default;
+
+ private:
+  code_type code_;
+
+  constexpr fixed(code_type c, int) : code_(c) {}
+
+  static constexpr fixed from_scaled(double x) {
+    double c = detail::round(x * (double)detail::ldexp(1.0L, fractional_bits));
+    return saturate_scaled((int128_t)c);
+  }
+
+  template<long double M, long double N, long double P>
+  constexpr fixed addsub(fixed<M, N, P> b, int sign) const {
+    constexpr int fa = fractional_bits, fb = fixed<M, N, P>::fractional_bits;
+    constexpr int m = fa > fb ? fa : fb;
+    constexpr int bits_a = detail::value_bits(params) + m - fa;
+    constexpr int bits_b = detail::value_bits(fixed<M, N, P>::params) + m - fb;
+    constexpr int bits = detail::wide_bits(params, (bits_a > bits_b ? bits_a : bits_b) + 1);
+    static_assert(bits <= 128, "intermediate wider than 128 bits");
+    using W = detail::wide_t<bits>;
+    W r = detail::align((W)scaled(), fa, m) + sign * detail::align((W)b.scaled(), fb, m);
+    return saturate_scaled(detail::align(r, m, fa));
+  }
+};
+
+} // namespace fpc
+
+#endif
@@ -0,0 +1,250 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+#include "fpc.h"
+#include "fpc.hpp"
+
+/* Check fpc.hpp against fpc.c for the specs in tests.sh (as
+   expressions, which are folded to the same long doubles).  For each
+   format also check the converters against the ones fpc -g writes, and
+   the arithmetic against a long double reference, and arithmetic
+   between formats against an exact one. */
+
+static int failures;
+
+static void fail(const char *spec, const char *what) {
+  printf("  %s: %s\n", spec, what);
+  failures++;
+}
+
+/* convert_to_double() as written by fpc -g with its %.19Lg constants */
+static double reference_to_double(const struct fpc_parameters *p, double code) {
+  char buf[32];
+  double v = ldexp(code, -p->fractional_bits);
+  if(p->offset) {
+    snprintf(buf, sizeof(buf), "%.19Lg", ldexpl(p->offset, -p->fractional_bits));
+    v = v + strtod(buf, NULL);
+  }
+  if(p->precision != 1.0L) {
+    snprintf(buf, sizeof(buf), "%.19Lg", 1.0L / p->precision);
+    double k = strtod(buf, NULL);
+    snprintf(buf, sizeof(buf), "%.19Lg", p->precision);
+    v = round(v * k) * strtod(buf, NULL);
+  }
+  return v;
+}
+
+/* a long double result of the arithmetic, rounded and clamped like fpc --arith */
+static int128_t reference_result(const struct fpc_parameters *p, long double v) {
+  long double r = roundl(ldexpl(v, p->fractional_bits));
+  if(r < p->lower_bound) return p->lower_bound;
+  if(r > p->upper_bound) return p->upper_bound;
+  return (int128_t)r;
+}
+
+template<class F>
+static void check_format(const char *spec, const struct fpc_parameters *p) {
+  using code_type = typename F::code_type;
+  // not is_signed_v, which is false for __int128 outside gnu++ modes
+  if(sizeof(code_type) * 8 != (size_t)p->fixed_encoding_width ||
+     ((code_type)-1 < (code_type)0) != p->use_signed) {
+    fail(spec, "code type");
+  }
+
+  // converters, at up to 4096 codes spread over the range
+  uint64_t span = (uint64_t)(p->upper_bound - p->lower_bound), step = span / 4096 + 1, i;
+  for(i = 0; i <= span; i += step) {
+    code_type c = (code_type)((uint64_t)F::min_code + i);
+    F x = F::from_code(c);
+    double d = x.to_double(), r = reference_to_double(p, (double)c);
+    if(d != r) {
+      fail(spec, "to_double() differs from convert_to_double()");
+      break;
+    }
+    // to_double() rounds to the precision, so codes needn't come back
+    auto y = F::from_double(d);
+    if(fpc::detail::value_bits(F::params) <= 53 && (!y || y->to_double() != d)) {
+      fail(spec, "from_double() round trip");
+      break;
+    }
+    if(span - i < step) break;
+  }
+  if(F::from_double(NAN) || F::from_double((double)(p->max + fabsl(p->max) + fabsl(p->min) + 1)) ||
+     F::saturate(INFINITY).code() != F::max_code || F::saturate(-INFINITY).code() != F::min_code) {
+    fail(spec, "out of range values");
+  }
+
+  // arithmetic, where a long double holds the products exactly
+  if constexpr(fpc::detail::value_bits(F::params) <= 32) {
+    srand(p->fractional_bits + 1000);
+    for(i = 0; i < 10000; i++) {
+      F a = F::from_code((code_type)((uint64_t)F::min_code + (uint64_t)rand() * RAND_MAX % (span + 1)));
+      F b = F::from_code((code_type)((uint64_t)F::min_code + (uint64_t)rand() * RAND_MAX % (span + 1)));
+      long double va = ldexpl(a.scaled(), -p->fractional_bits);
+      long double vb = ldexpl(b.scaled(), -p->fractional_bits);
+      if((a + b).scaled() != reference_result(p, va + vb) ||
+         (a - b).scaled() != reference_result(p, va - vb) ||
+         (a * b).scaled() != reference_result(p, va * vb) ||
+         (b.scaled() != 0 && (a / b).scaled() != reference_result(p, va / vb)) ||
+         (a < b) != (va < vb)) {
+        fail(spec, "arithmetic");
+        break;
+      }
+    }
+  }
+}
+
+/* x * 2^-s rounded ties away from zero, exact for s <= 0 */
+static int128_t exact_shift(int128_t x, int s) {
+  if(s <= 0) return x * ((int128_t)1 << -s);
+  int128_t h = (int128_t)1 << (s - 1);
+  return x < 0 ? -((-x + h) >> s) : (x + h) >> s;
+}
+
+/* n / d rounded ties away from zero */
+static int128_t exact_div(int128_t n, int128_t d) {
+  int128_t q = n / d, r = n % d;
+  if(2 * (r < 0 ? -r : r) >= (d < 0 ? -d : d)) q += (n < 0) != (d < 0) ? -1 : 1;
+  return q;
+}
+
+/* A op B and A::from(B) against an exact __int128 reference, on the
+   bounds and random codes, for formats of at most 40 bits and 20
+   fractional bits either way so the reference can't overflow */
+template<class A, class B>
+static void check_mixed(const char *spec) {
+  constexpr int fa = A::fractional_bits, fb = B::fractional_bits, m = fa > fb ? fa : fb;
+  static_assert(fpc::detail::value_bits(A::params) <= 40 && fpc::detail::value_bits(B::params) <= 40 &&
+                fa <= 20 && fa >= -20 && fb <= 20 && fb >= -20);
+  uint64_t span_a = (uint64_t)(A::params.upper_bound - A::params.lower_bound);
+  uint64_t span_b = (uint64_t)(B::params.upper_bound - B::params.lower_bound);
+  auto clamp = [](int128_t x) {
+    return x < A::params.lower_bound ? A::params.lower_bound : x > A::params.upper_bound ? A::params.upper_bound : x;
+  };
+  printf("%s\n", spec);
+  srand(fa * 100 + fb + 2000);
+  for(int i = 0; i < 10000; i++) {
+    A a = A::from_code(i < 4 ? (i & 1 ? A::max_code : A::min_code) :
+                       (typename A::code_type)((uint64_t)A::min_code + (uint64_t)rand() * RAND_MAX % (span_a + 1)));
+    B b = B::from_code(i < 4 ? (i & 2 ? B::max_code : B::min_code) :
+                       (typename B::code_type)((uint64_t)B::min_code + (uint64_t)rand() * RAND_MAX % (span_b + 1)));
+    int128_t ra = a.scaled(), rb = b.scaled();
+    int128_t sum = exact_shift(exact_shift(ra, fa - m) + exact_shift(rb, fb - m), m - fa);
+    int128_t diff = exact_shift(exact_shift(ra, fa - m) - exact_shift(rb, fb - m), m - fa);
+    int128_t quotient = rb == 0 ? (ra > 0 ? A::params.upper_bound : ra < 0 ? A::params.lower_bound : 0) :
+      exact_div(exact_shift(ra, -(fb > 0 ? fb : 0)), exact_shift(rb, fb < 0 ? fb : 0));
+    if((a + b).scaled() != clamp(sum) || (a - b).scaled() != clamp(diff) ||
+       (a * b).scaled() != clamp(exact_shift(ra * rb, fb)) || (a / b).scaled() != clamp(quotient) ||
+       A::from(b).scaled() != clamp(exact_shift(rb, fb - fa))) {
+      fail(spec, "mixed arithmetic");
+      break;
+    }
+  }
+}
+
+template<long double Min, long double Max, long double Precision>
+static void check_parameters(const char *spec, const struct fpc_parameters *c) {
+  constexpr fpc::parameters cpp = fpc::calculate(Min, Max, Precision);
+  if(c->min != cpp.min || c->max != cpp.max || c->precision != cpp.precision) {
+    fail(spec, "min, max or precision differs");
+  }
+  if(c->lower_bound != cpp.lower_bound || c->upper_bound != cpp.upper_bound ||
+     c->offset != cpp.offset || c->fractional_bits != cpp.fractional_bits ||
+     c->integer_bits != cpp.integer_bits || c->fixed_encoding_width != cpp.fixed_encoding_width ||
+     c->use_signed != cpp.use_signed || c->large_offset != cpp.large_offset) {
+    fail(spec, "parameters differ");
+  }
+  check_format<fpc::fixed<Min, Max, Precision>>(spec, c);
+  printf("  %s%d_t, %d fractional bits\n", cpp.use_signed ? "int" : "uint",
+         cpp.fixed_encoding_width, cpp.fractional_bits);
+}
+
+template<long double Min, long double Max, long double Precision>
+static void check(const char *min, const char *max, const char *precision) {
+  constexpr fpc::parameters cpp = fpc::calculate(Min, Max, Precision);
+  struct fpc_parameters c;
+  char spec[128], buf[3][64];
+  memset(&c, 0, sizeof(c));
+  snprintf(spec, sizeof(spec), "%s %s %s", min, max, precision);
+  snprintf(buf[0], sizeof(buf[0]), "%s", min);
+  snprintf(buf[1], sizeof(buf[1]), "%s", max);
+  snprintf(buf[2], sizeof(buf[2]), "%s", precision);
+  printf("%s\n", spec);
+
+  bool ok = fpc_calculate_from_strings(buf[0], buf[1], buf[2], &c);
+  if constexpr(cpp.error != nullptr) {
+    if(ok || strcmp(cpp.error, c.error) != 0) fail(spec, "error differs");
+    else printf("  error: %s\n", cpp.error);
+  } else if(!ok) {
+    fail(spec, "error differs");
+  } else {
+    check_parameters<Min, Max, Precision>(spec, &c);
+  }
+}
+
+#define CHECK(min, max, precision, min_expr, max_expr, precision_expr) \
+  check<(min_expr), (max_expr), (precision_expr)>(min, max, precision)
+
+// everything folds at compile time
+using temp = fpc::fixed<-40.0L, 125.0L, 0.01L>;
+static_assert(temp::from_double(21.5)->code() == 2752);
+static_assert((*temp::from_double(21.5) * *temp::from_double(2.0)).code() == 5504);
+static_assert((temp::saturate(100) + temp::saturate(100)).code() == temp::max_code);
+static_assert(temp::saturate(1) / temp() == temp::saturate(125));
+// a product shifted left for a format with negative fractional bits
+using unit = fpc::fixed<-1.0L, 1.0L, 0x1p-15L>;
+using coarse = fpc::fixed<0.0L, 100000.0L, 16.0L>;
+static_assert((unit::from_code(24226) * coarse::from_code(6002)).code() == unit::max_code);
+
+int main(void) {
+  constexpr long double l70 = 0x1p70L;
+  CHECK("-256", "-l-p", "0.01", -256.0L, 256.0L - 0.01L, 0.01L);
+  CHECK("-512", "-l-p", "1", -512.0L, 512.0L - 1.0L, 1.0L);
+  CHECK("2^70", "l+256", "1", l70, l70 + 256.0L, 1.0L);
+  CHECK("1", "2", "3", 1.0L, 2.0L, 3.0L);
+  CHECK("2", "1", "1", 2.0L, 1.0L, 1.0L);
+  CHECK("1", "2", "0", 1.0L, 2.0L, 0.0L);
+  CHECK("-h-p", "2^8-p", "0.01", -(256.0L - 0.01L) - 0.01L, 256.0L - 0.01L, 0.01L);
+  CHECK("-2^63", "-l-p", "1", -0x1p63L, 0x1p63L - 1.0L, 1.0L);
+  CHECK("-2^100", "2^100", "1", -0x1p100L, 0x1p100L, 1.0L);
+  CHECK("0", "2^130", "1", 0.0L, 0x1p130L, 1.0L);
+  CHECK("-2^63", "-l", "1", -0x1p63L, 0x1p63L, 1.0L);
+  CHECK("30", "1800", "0.1", 30.0L, 1800.0L, 0.1L);
+  CHECK("-1", "1", "0.003", -1.0L, 1.0L, 0.003L);
+  CHECK("-100", "100", "1", -100.0L, 100.0L, 1.0L);
+  CHECK("-2^40", "2^40", "1", -0x1p40L, 0x1p40L, 1.0L);
+  CHECK("-180", "180", "0.01", -180.0L, 180.0L, 0.01L);
+  CHECK("-2^40", "2^40", "2^-20", -0x1p40L, 0x1p40L, 0x1p-20L);
+  CHECK("1000", "1001", "0.001", 1000.0L, 1001.0L, 0.001L);
+  CHECK("-3", "-1", "0.01", -3.0L, -1.0L, 0.01L);
+  CHECK("-2", "2", "0.001", -2.0L, 2.0L, 0.001L);
+  CHECK("0", "20", "1", 0.0L, 20.0L, 1.0L);
+  check_mixed<unit, coarse>("-1 1 2^-15 with 0 100000 16");
+  check_mixed<coarse, unit>("0 100000 16 with -1 1 2^-15");
+  check_mixed<temp, fpc::fixed<-1.0L, 1.0L, 0.003L>>("-40 125 0.01 with -1 1 0.003");
+  check_mixed<fpc::fixed<1000.0L, 1001.0L, 0.001L>, fpc::fixed<-180.0L, 180.0L, 0.01L>>(
+    "1000 1001 0.001 with -180 180 0.01");
+  if(failures) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,172 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <math.h>
+#include <string.h>
+
+#include "fpc_plan.h"
+
+/* The kernels are the loops gen_batch.c writes with the constants
+   replaced by loop invariants from the plan, instantiated for each
+   machine integer type with and without an offset.  As there, GCC only
+   vectorizes the selects with -fno-trapping-math, and each kernel is
+   cloned for AVX2 and picked at load time.  Rounding is ties to even
+   by adding and subtracting 2^52 on the side of zero the value is on,
+   which unlike 1.5 * 2^52 works for every code range. */
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("O3", "no-trapping-math")
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__linux__)
+#define CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define CLONES
+#endif
+
+static inline double round_even(double c) {
+  double r = c >= 0 ? (c + 0x1p52) - 0x1p52 : (c - 0x1p52) + 0x1p52;
+  return fabs(c) < 0x1p52 ? r : c;
+}
+
+#define TO_DOUBLE(name, type, with_offset)                              \
+  CLONES static                                                         \
+  size_t name(const struct fpc_plan *plan, const void *in, double *restrict y, size_t n) { \
+    const type *restrict x = in;                                        \
+    const type lb = (type)plan->lower_code, ub = (type)plan->upper_code; \
+    const double k = plan->to_scale, o = plan->to_offset;               \
+    size_t i, errors = 0;                                               \
+    for(i = 0; i < n; i++) {                                            \
+      type c = x[i];                                                    \
+      bool bad = (c < lb) | (c > ub);                                   \
+      errors += bad;                                                    \
+      y[i] = bad ? NAN : with_offset ? c * k + o : c * k;               \
+    }                                                                   \
+    return errors;                                                      \
+  }
+
+#define FROM_DOUBLE(name, type, via, with_offset)                       \
+  static inline __attribute__((always_inline))                          \
+  size_t name##_kernel(const struct fpc_plan *plan, const double *restrict x, \
+                       type *restrict y, size_t n, uint8_t *restrict err, bool mask) { \
+    const double min = plan->min, max = plan->max;                      \
+    const double lo = plan->lower_bound, hi = plan->upper_bound;        \
+    const double k = plan->from_scale, o = plan->offset;                \
+    size_t i, errors = 0;                                               \
+    for(i = 0; i < n; i++) {                                            \
+      double v = x[i];                                                  \
+      bool bad = !((v >= min) & (v <= max));                            \
+      double c = v * k;                                                 \
+      c = c >= lo ? c : lo;                                             \
+      c = c <= hi ? c : hi;                                             \
+      c = round_even(c);                                                \
+      if(with_offset) c -= o;                                           \
+      y[i] = (type)(via)c;                                              \
+      errors += bad;                                                    \
+      if(mask) err[i] = bad;                                            \
+    }                                                                   \
+    return errors;                                                      \
+  }                                                                     \
+                                                                        \
+  CLONES static                                                         \
+  size_t name(const struct fpc_plan *plan, const double *x, void *y, size_t n, uint8_t *err) { \
+    if(err) return name##_kernel(plan, x, y, n, err, true);             \
+    return name##_kernel(plan, x, y, n, NULL, false);                   \
+  }
+
+#define KERNELS(type, via)                                              \
+  TO_DOUBLE(to_double_##type, type##_t, false)                          \
+  TO_DOUBLE(to_double_##type##_offset, type##_t, true)                  \
+  FROM_DOUBLE(from_double_##type, type##_t, via, false)                 \
+  FROM_DOUBLE(from_double_##type##_offset, type##_t, via, true)
+
+KERNELS(int8, int32_t)
+KERNELS(uint8, int32_t)
+KERNELS(int16, int32_t)
+KERNELS(uint16, int32_t)
+KERNELS(int32, int32_t)
+KERNELS(uint32, uint32_t)
+KERNELS(int64, int64_t)
+KERNELS(uint64, uint64_t)
+
+#define ENTRY(type) \
+  { to_double_##type, to_double_##type##_offset, from_double_##type, from_double_##type##_offset }
+
+static const struct {
+  size_t (*to_double)(const struct fpc_plan *, const void *, double *, size_t);
+  size_t (*to_double_offset)(const struct fpc_plan *, const void *, double *, size_t);
+  size_t (*from_double)(const struct fpc_plan *, const double *, void *, size_t, uint8_t *);
+  size_t (*from_double_offset)(const struct fpc_plan *, const double *, void *, size_t, uint8_t *);
+} kernels[4][2] = { // [log2(width / 8)][signed]
+  { ENTRY(uint8), ENTRY(int8) },
+  { ENTRY(uint16), ENTRY(int16) },
+  { ENTRY(uint32), ENTRY(int32) },
+  { ENTRY(uint64), ENTRY(int64) }
+};
+
+/* the closest double to a bound that isn't outside it, so a bound like
+   2^63 - 1 doesn't saturate to a code that overflows */
+static double inward(int128_t bound, double direction) {
+  long double b = bound;
+  double d = b;
+  if(d != b && (d > b) == (direction < 0)) d = nextafter(d, direction);
+  return d;
+}
+
+bool fpc_plan_init(struct fpc_plan *plan, const struct fpc_parameters *param) {
+  int w = param->fixed_encoding_width, i;
+  memset(plan, 0, sizeof(*plan));
+  if(param->error) {
+    plan->error = param->error;
+    return false;
+  }
+  for(i = 0; i < 4 && (8 << i) != w; i++);
+  if(i == 4) {
+    plan->error = "no machine integer type";
+    return false;
+  }
+  plan->fixed_encoding_width = w;
+  plan->use_signed = param->use_signed;
+  plan->lower_code = (uint64_t)(param->lower_bound - param->offset);
+  plan->upper_code = (uint64_t)(param->upper_bound - param->offset);
+  plan->to_scale = ldexp(1.0, -param->fractional_bits);
+  plan->from_scale = ldexp(1.0, param->fractional_bits);
+  plan->to_offset = ldexpl(param->offset, -param->fractional_bits);
+  plan->offset = param->offset;
+  plan->min = param->min;
+  plan->max = param->max;
+  plan->lower_bound = inward(param->lower_bound, INFINITY);
+  plan->upper_bound = inward(param->upper_bound, -INFINITY);
+  if(param->offset) {
+    plan->to_double = kernels[i][param->use_signed].to_double_offset;
+    plan->from_double = kernels[i][param->use_signed].from_double_offset;
+  } else {
+    plan->to_double = kernels[i][param->use_signed].to_double;
+    plan->from_double = kernels[i][param->use_signed].from_double;
+  }
+  return true;
+}
+
+size_t fpc_plan_code_size(const struct fpc_plan *plan) {
+  return plan->fixed_encoding_width / 8;
+}
+
+size_t fpc_plan_to_double(const struct fpc_plan *plan, const void *x, double *y, size_t n) {
+  return plan->to_double(plan, x, y, n);
+}
+
+size_t fpc_plan_from_double(const struct fpc_plan *plan, const double *x, void *y, size_t n,
+                            uint8_t *err) {
+  return plan->from_double(plan, x, y, n, err);
+}
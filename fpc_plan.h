@@ -0,0 +1,76 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#ifndef __FPC_PLAN__
+#define __FPC_PLAN__
+
+#include <stdint.h>
+#include "fpc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Array conversions for formats known only at run time.
+
+   fpc_plan_init() picks precompiled kernels for the width, signedness
+   and offset of a calculated format, so there is one indirect call per
+   array rather than per value.  The results are the same as the
+   convert_to_double_n() and convert_from_double_n() kernels fpc -g
+   writes: exact, NAN for codes out of range, values out of [min, max]
+   (and NAN) saturated to the code range, ties to even.  Codes are
+   arrays of the format's machine integer type.  Code ranges wider than
+   a double saturate to the widest range of doubles inside them rather
+   than overflowing. */
+
+struct fpc_plan {
+  size_t (*to_double)(const struct fpc_plan *plan, const void *x, double *y, size_t n);
+  size_t (*from_double)(const struct fpc_plan *plan, const double *x, void *y, size_t n,
+                        uint8_t *err);
+  int fixed_encoding_width;
+  bool use_signed;
+
+  /* code range, as the bits of the machine integer type */
+  uint64_t lower_code, upper_code;
+
+  /* code * to_scale + offset is the value,
+     value * from_scale - offset rounds to the code */
+  double to_scale, from_scale, to_offset, offset;
+
+  /* values accepted, and the scaled bounds they saturate to */
+  double min, max, lower_bound, upper_bound;
+
+  const char *error;
+};
+
+/* plan conversions for param, returns false and sets plan->error if
+   param wasn't calculated */
+bool fpc_plan_init(struct fpc_plan *plan, const struct fpc_parameters *param);
+
+/* bytes per code */
+size_t fpc_plan_code_size(const struct fpc_plan *plan);
+
+/* n codes x to y, returns the number out of range */
+size_t fpc_plan_to_double(const struct fpc_plan *plan, const void *x, double *y, size_t n);
+
+/* n values x to codes y, returns the number out of range and, if err
+   isn't NULL, sets err[i] for each */
+size_t fpc_plan_from_double(const struct fpc_plan *plan, const double *x, void *y, size_t n,
+                            uint8_t *err);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
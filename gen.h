@@ -0,0 +1,239 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#ifndef __FPC_GEN__
+#define __FPC_GEN__
+
+#include <stdio.h>
+#include "fpc.h"
+
+/* code generators, each writes C source for the format in param to f */
+
+/* rounding in the scalar converters, see --rounding */
+enum gen_rounding {
+  ROUNDING_LIBM,    /* round() and ldexp() from libm */
+  ROUNDING_NEAREST, /* ties away from zero, same results as round() */
+  ROUNDING_EVEN,    /* ties to even by adding and subtracting 1.5 * 2^52 */
+  ROUNDING_LRINT,   /* llrint(), the current rounding mode */
+  ROUNDING_TRUNC,   /* toward zero */
+  ROUNDING_FLOOR    /* toward -infinity */
+};
+
+/* lookup tables for 8 and 16 bit formats, see --tables */
+enum gen_tables {
+  TABLES_OFF,
+  TABLES_ON,  /* wherever the format allows */
+  TABLES_AUTO /* where the table is small enough to beat arithmetic */
+};
+
+/* convert_fixed_to_string() output, see --strings */
+enum gen_strings {
+  STRINGS_SHORTEST, /* the fewest decimals, like show_fixed() */
+  STRINGS_FIXED     /* every decimal, right aligned to one width */
+};
+
+enum gen_table {
+  TABLE_TO_DOUBLE,
+  TABLE_TO_STRING,
+  TABLE_FROM_DOUBLE
+};
+
+struct gen_options {
+  enum gen_rounding rounding;
+  enum gen_tables tables;
+  enum gen_strings strings;
+  bool packed; /* --packed */
+  bool instrument; /* --instrument */
+  enum fpc_scale scale; /* --scale */
+  const struct fpc_scaled *scaled; /* the format, if it isn't a power of two */
+};
+
+/* parse a --rounding name, returns false if unknown */
+bool gen_parse_rounding(const char *name, enum gen_rounding *rounding);
+
+/* parse a --tables name, returns false if unknown */
+bool gen_parse_tables(const char *name, enum gen_tables *tables);
+
+/* one option of fpc -g (--rounding=, --tables=, ...) into opt: returns
+   1 if arg was one, 0 if it isn't an option, -1 after printing an error */
+int gen_parse_option(const char *arg, struct gen_options *opt);
+
+/* the format of min, max and precision in opt->scale, pointing
+   opt->scaled at scaled if it isn't a power of two: returns param or
+   &scaled->param to generate from, or NULL after printing an error */
+struct fpc_parameters *gen_calculate(char *min, char *max, char *precision,
+                                     struct gen_options *opt, struct fpc_parameters *param,
+                                     struct fpc_scaled *scaled);
+
+/* the converters of -g without includes, tests, benchmarks or main():
+   the scalar, array, string and (with opt->packed) packed ones */
+void gen_library(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* the footprint in bytes of a table, and whether opt uses it */
+size_t gen_table_size(struct fpc_parameters *param, enum gen_table kind);
+bool gen_table_use(struct fpc_parameters *param, struct gen_options *opt, enum gen_table kind);
+
+/* a [TABLES] section saying which converters use tables and their size */
+void gen_table_report(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* the tables opt uses, and convert_to_string() if it has a table */
+void gen_tables(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* the return statement of the table convert_to_double() */
+void gen_table_to_double(struct fpc_parameters *param, FILE *f);
+
+/* the assignment to *y in the table convert_from_double() */
+void gen_table_from_double(struct fpc_parameters *param, FILE *f);
+
+/* static inline helpers used by the libm-free converters */
+void gen_round_helpers(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* the return expression of the libm-free convert_to_double(),
+   which gives the same results as the libm version */
+void gen_round_to_double(struct fpc_parameters *param, FILE *f);
+
+/* the assignment to *y in the libm-free convert_from_double() */
+void gen_round_from_double(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* a test() function comparing the converters to the libm versions
+   named convert_to_double_ref() and convert_from_double_ref() */
+void gen_round_test(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* the SSE2/AVX2 dispatch of a batch kernel, target is the AVX2 one's,
+   static if local (for headers) */
+void gen_dispatch(const char *name, const char *kernel, const char *target,
+                  const char *args, const char *call, bool local, FILE *f);
+
+/* the pragmas and comment around batch kernels */
+void gen_batch_begin(FILE *f);
+void gen_batch_end(FILE *f);
+
+/* x as a double, rounded toward direction if it isn't one, so that
+   bounds printed for the generated code never round outward */
+double gen_inward(long double x, double direction);
+
+/* array kernels convert_to_double_n() and convert_from_double_n()
+   with SSE2/AVX2 variants selected at runtime */
+void gen_batch(struct fpc_parameters *param, FILE *f);
+
+/* a bench(label) function that times the scalar and batch converters,
+   printing CSV rows for case label unless it is NULL */
+void gen_batch_bench(struct fpc_parameters *param, FILE *f);
+
+/* a verify(threads) function checking the converters for every code,
+   or a stratified sample of them above 2^32 codes, on threads threads
+   (0 for one per core) */
+void gen_verify(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* parse a --scale name, returns false if unknown */
+bool gen_parse_scale(const char *name, enum fpc_scale *scale);
+
+/* a [SCALES] section comparing the formats of each scale for param */
+void gen_scale_report(const struct fpc_parameters *param, enum fpc_scale chosen, FILE *f);
+
+/* the return statement of convert_to_double() and the assignment to *y
+   in convert_from_double() for a scaled format */
+void gen_scale_to_double(const struct fpc_scaled *s, FILE *f);
+void gen_scale_from_double(const struct fpc_scaled *s, FILE *f);
+
+/* gen_batch() for a scaled format */
+void gen_scale_batch(const struct fpc_scaled *s, FILE *f);
+
+/* gen_verify() for a scaled format, checking exactly against
+   (code + offset) * num / den on a sample of up to 2^20 codes */
+void gen_scale_verify(const struct fpc_scaled *s, FILE *f);
+
+/* parse a --strings name, returns false if unknown */
+bool gen_parse_strings(const char *name, enum gen_strings *strings);
+
+/* whether the format gets convert_fixed_to_string() and
+   convert_string_to_fixed(), which need a power of two scale, up to 37
+   fractional bits and values that fit an int64_t */
+bool gen_string_eligible(struct fpc_parameters *param, struct gen_options *opt);
+
+/* convert_fixed_to_string() and convert_string_to_fixed(), show_fixed()
+   and read_fixed() from fixnum_string.c specialized for the format, or
+   a comment saying why there are none */
+void gen_string(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* CONVERT_STRING_SIZE of gen_string(), for an eligible format */
+int gen_string_size(struct fpc_parameters *param);
+
+/* test_strings() checking them against fixnum_string.c and
+   bench_strings() timing them, after gen_batch_bench() for now() */
+void gen_string_test(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* the bits per value of a packed format, at most its machine width */
+unsigned int gen_pack_bits(struct fpc_parameters *param);
+
+/* a [PACKED] section with the memory saved by packing */
+void gen_pack_report(struct fpc_parameters *param, FILE *f);
+
+/* convert_pack_n() and convert_unpack_n() for contiguous bitstreams of
+   packed codes, convert_pack() and convert_unpack() for random access */
+void gen_pack(struct fpc_parameters *param, FILE *f);
+
+/* a test_packed() function and a bench_packed(label) like bench() */
+void gen_pack_test(struct fpc_parameters *param, FILE *f);
+
+/* the histogram of instrumented converters counts codes >> this */
+int gen_stats_shift(struct fpc_parameters *param);
+
+/* an [INSTRUMENT] section describing the counters */
+void gen_stats_report(struct fpc_parameters *param, FILE *f);
+
+/* convert_to_double() and convert_from_double() counting into thread
+   local convert_stats around the _raw converters, convert_stats_get(),
+   convert_stats_reset() and convert_stats_dump() for fpc --feedback */
+void gen_stats(struct fpc_parameters *param, struct gen_options *opt, FILE *f);
+
+/* a test_stats() function checking the counters and dumping them */
+void gen_stats_test(struct fpc_parameters *param, FILE *f);
+
+/* a header of exact fixed-point add, sub, mul, div, cmp and
+   conversions between n formats, each typedef'd as names[i]_t */
+void gen_arith(const char **names, struct fpc_parameters *params, int n, FILE *f);
+
+/* shared with gen_formula.c: */
+
+/* bits to hold x in two's complement */
+int gen_arith_bits(int128_t x);
+
+/* the narrowest of 32, 64 and 128 at least bits, or 0 */
+int gen_arith_width(int bits);
+
+/* int32_t, int64_t or __int128 for a width */
+const char *gen_arith_type(int w);
+
+/* x as a C constant of the narrowest type holding it */
+void gen_arith_const(FILE *f, int128_t x);
+
+/* x as a code of param: INT16_C(-5), or a gen_arith_const() for 128 bits */
+void gen_code_const(struct fpc_parameters *param, int128_t x, FILE *f);
+
+/* int128_t and uint128_t, which stdint.h doesn't have, guarded like
+   gen_arith_helpers() */
+void gen_int128_types(FILE *f);
+
+/* fpc_rshiftW() and fpc_divW(), ties away from zero, for each width,
+   guarded so headers from several runs can be included together */
+void gen_arith_helpers(FILE *f);
+
+/* whether s is a C identifier */
+bool gen_valid_name(const char *s);
+
+/* whether s_t is a type of the standard headers, like off_t */
+bool gen_reserved_name(const char *s);
+
+#endif
@@ -0,0 +1,644 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "gen.h"
+#include "modes.h"
+
+/* Integer-only approximations of functions of an fpc format.
+
+   The input codes are split into 2^k segments of 2^shift codes and
+   each segment gets a polynomial of the same degree in t, the code's
+   distance from the segment's middle, fitted at Chebyshev nodes (close
+   to the minimax polynomial) and evaluated by Horner's rule in integers
+   with `work` fractional bits, then rounded to the output format.  A
+   degree 0 polynomial on segments of one code is a table of correctly
+   rounded results, degree 1 a table with linear interpolation.  Every
+   combination is tried and the cheapest meeting the error bound, by
+   multiplies and then table size, is kept, with its error measured on
+   every input code (a sample above 2^22) by running the same integer
+   arithmetic as the generated code. */
+
+#define MAX_DEGREE 6
+#define MAX_SEGMENTS_LOG2 12
+#define EXHAUSTIVE (1 << 22) /* codes measured one by one, otherwise a sample */
+#define SAMPLES_PER_SEGMENT 16
+#define PI 3.14159265358979323846264338327950288L
+
+struct function {
+  const char *name;
+  long double (*f)(long double);
+  const char *domain; /* NULL, or the condition on x */
+};
+
+static long double recipl(long double x) { return 1 / x; }
+static long double rsqrtl(long double x) { return 1 / sqrtl(x); }
+
+static const struct function functions[] = {
+  { "sin", sinl, NULL },
+  { "cos", cosl, NULL },
+  { "atan", atanl, NULL },
+  { "tanh", tanhl, NULL },
+  { "exp", expl, NULL },
+  { "exp2", exp2l, NULL },
+  { "log", logl, "x > 0" },
+  { "log2", log2l, "x > 0" },
+  { "sqrt", sqrtl, "x >= 0" },
+  { "rsqrt", rsqrtl, "x > 0" },
+  { "recip", recipl, "x != 0" },
+};
+
+struct approx {
+  const char *name;
+  const struct function *fn;
+  struct fpc_parameters in, out;
+  long double precision;   /* the error bound */
+  size_t max_table;        /* bytes */
+  int64_t x_lo, n;         /* the first scaled input and the number of codes */
+  int degree, shift, segments, work, width;
+  int coef_width;          /* storage for the coefficients */
+  bool coef_unsigned;
+  int64_t *coef;           /* segments * (degree + 1), constant term first */
+  long double max_err;
+  int64_t max_err_code;
+  bool exhaustive;
+};
+
+static
+bool in_domain(const struct function *fn, long double x) {
+  if(!fn->domain) return true;
+  if(fn->f == sqrtl) return x >= 0;
+  if(fn->f == recipl) return x != 0;
+  return x > 0;
+}
+
+/* the value of the scaled input x_lo + d */
+static
+long double input_value(const struct approx *ap, long double d) {
+  return ldexpl(ap->x_lo + d, -ap->in.fractional_bits);
+}
+
+/* the real coefficients in t for each segment, interpolating at
+   Chebyshev nodes over the codes the segment covers */
+static
+void fit(const struct approx *ap, long double *b) {
+  int s, i, j, d;
+  long double half = ap->shift ? ldexpl(1, ap->shift - 1) : 0;
+  for(s = 0; s < ap->segments; s++) {
+    long double mid = (long double)((int64_t)s << ap->shift) + half;
+    long double last = (long double)((int64_t)(s + 1) << ap->shift) - 1;
+    if(last > ap->n - 1) last = ap->n - 1;
+    long double lo = -half, hi = last - mid; // t over the segment
+    long double t[MAX_DEGREE + 1], y[MAX_DEGREE + 1], c[MAX_DEGREE + 1];
+    // a short last segment may have fewer codes than coefficients
+    d = hi - lo < ap->degree ? (int)(hi - lo) : ap->degree;
+    for(i = 0; i <= d; i++) {
+      t[i] = d ? (lo + hi) / 2 + (hi - lo) / 2 * cosl(PI * (i + 0.5L) / (d + 1)) : lo;
+      y[i] = ap->fn->f(input_value(ap, mid + t[i]));
+    }
+    // Newton's divided differences, then expanded to powers of t
+    for(i = 1; i <= d; i++) {
+      for(j = d; j >= i; j--) y[j] = (y[j] - y[j - 1]) / (t[j] - t[j - i]);
+    }
+    for(i = 0; i <= ap->degree; i++) c[i] = 0;
+    for(i = d; i >= 0; i--) {
+      // c = c * (t - t[i]) + y[i]
+      for(j = d; j > 0; j--) c[j] = c[j - 1] - c[j] * t[i];
+      c[0] = y[i] - c[0] * t[i];
+    }
+    for(i = 0; i <= ap->degree; i++) b[s * (ap->degree + 1) + i] = c[i];
+  }
+}
+
+/* the coefficients as integers for Horner's rule in the normalized
+   variable t / 2^(shift - 1), each step rescaling by that shift, with
+   the output offset taken off the constant terms */
+static
+void quantize(struct approx *ap, const long double *b) {
+  int i, s, d = ap->degree, bits;
+  int64_t lo = 0, hi = 0;
+  for(s = 0; s < ap->segments; s++) {
+    for(i = 0; i <= d; i++) {
+      long double c = ldexpl(b[s * (d + 1) + i], ap->work + (ap->shift ? (ap->shift - 1) * i : 0));
+      int64_t q = fabsl(c) < 0x1p62L ? (int64_t)roundl(c) : (c < 0 ? -(INT64_C(1) << 62) : INT64_C(1) << 62);
+      if(i == 0) q -= (int64_t)ap->out.offset << (ap->work - ap->out.fractional_bits);
+      ap->coef[s * (d + 1) + i] = q;
+      if(q < lo) lo = q;
+      if(q > hi) hi = q;
+    }
+  }
+  ap->coef_unsigned = lo >= 0;
+  bits = ap->coef_unsigned ? gen_arith_bits(hi) - 1 : gen_arith_bits(lo < -hi ? lo : hi);
+  ap->coef_width = bits <= 8 ? 8 : bits <= 16 ? 16 : bits <= 32 ? 32 : 64;
+}
+
+/* 32 or 64 bits for Horner's rule without overflow, or 0 */
+static
+int horner_width(const struct approx *ap) {
+  int i, s, d = ap->degree;
+  long double most = 0;
+  for(s = 0; s < ap->segments; s++) {
+    long double sum = d;
+    for(i = 0; i <= d; i++) sum += fabsl((long double)ap->coef[s * (d + 1) + i]);
+    if(sum > most) most = sum;
+  }
+  // |acc| <= sum, times t and the rounding, and the final rounding
+  long double need = most * (ap->shift ? ldexpl(1, ap->shift - 1) : 1) + ldexpl(1, ap->shift) +
+    ldexpl(1, ap->work - ap->out.fractional_bits);
+  if(need < 0x1p31L) return 32;
+  if(need < 0x1p63L) return 64;
+  return 0;
+}
+
+/* x / 2^s rounded half up, as the generated code does */
+static
+int64_t round_shift(int64_t x, int s) {
+  return s > 0 ? (x + (INT64_C(1) << (s - 1))) >> s : x;
+}
+
+/* the output code for the scaled input x_lo + d */
+static
+int64_t eval(const struct approx *ap, int64_t d) {
+  int i, seg = (int)(d >> ap->shift);
+  const int64_t *c = ap->coef + seg * (ap->degree + 1);
+  int64_t t = ap->shift ? (d & ((INT64_C(1) << ap->shift) - 1)) - (INT64_C(1) << (ap->shift - 1)) : 0;
+  int64_t acc = c[ap->degree];
+  for(i = ap->degree - 1; i >= 0; i--) acc = round_shift(acc * t, ap->shift - 1) + c[i];
+  int64_t r = round_shift(acc, ap->work - ap->out.fractional_bits);
+  int64_t lo = (int64_t)(ap->out.lower_bound - ap->out.offset);
+  int64_t hi = (int64_t)(ap->out.upper_bound - ap->out.offset);
+  return r < lo ? lo : r > hi ? hi : r;
+}
+
+/* the largest error of the integer evaluation over the codes d for
+   which next(ap, &d) is true */
+typedef bool (*code_iter)(const struct approx *ap, int64_t *d, int64_t *state);
+
+static
+bool every_code(const struct approx *ap, int64_t *d, int64_t *state) {
+  if(*state >= ap->n) return false;
+  *d = (*state)++;
+  return true;
+}
+
+/* both ends and evenly spaced codes of each segment */
+static
+bool segment_sample(const struct approx *ap, int64_t *d, int64_t *state) {
+  int64_t size = INT64_C(1) << ap->shift;
+  int64_t per = size < SAMPLES_PER_SEGMENT ? size : SAMPLES_PER_SEGMENT;
+  int64_t seg = *state / per, i = *state % per;
+  if(seg >= ap->segments) return false;
+  (*state)++;
+  *d = (seg << ap->shift) + (per > 1 ? i * (size - 1) / (per - 1) : 0);
+  if(*d >= ap->n) *d = ap->n - 1;
+  return true;
+}
+
+/* 2^20 evenly spaced codes and the ends of the segments */
+static
+bool wide_sample(const struct approx *ap, int64_t *d, int64_t *state) {
+  int64_t k = *state, even = 1 << 20;
+  if(k < even) {
+    *d = (int64_t)((__int128)k * (ap->n - 1) / (even - 1));
+  } else {
+    k -= even;
+    if(k >= 2 * (int64_t)ap->segments) return false;
+    *d = ((k / 2) << ap->shift) + (k % 2 ? (INT64_C(1) << ap->shift) - 1 : 0);
+    if(*d >= ap->n) *d = ap->n - 1;
+  }
+  (*state)++;
+  return true;
+}
+
+static
+long double measure(struct approx *ap, code_iter next) {
+  int64_t d, state = 0;
+  long double most = 0;
+  while(next(ap, &d, &state)) {
+    long double y = ap->fn->f(input_value(ap, d));
+    long double e = fabsl(ldexpl(eval(ap, d) + ap->out.offset, -ap->out.fractional_bits) - y);
+    if(e > most) {
+      most = e;
+      ap->max_err_code = d;
+    }
+  }
+  return most;
+}
+
+/* the error of the real polynomials alone */
+static
+long double poly_err(const struct approx *ap, const long double *b) {
+  int64_t d, state = 0;
+  long double most = 0;
+  int i;
+  while(segment_sample(ap, &d, &state)) {
+    int seg = (int)(d >> ap->shift);
+    long double t = (long double)(d - ((int64_t)seg << ap->shift)) -
+      (ap->shift ? ldexpl(1, ap->shift - 1) : 0);
+    long double p = 0;
+    for(i = ap->degree; i >= 0; i--) p = p * t + b[seg * (ap->degree + 1) + i];
+    long double e = fabsl(p - ap->fn->f(input_value(ap, d)));
+    if(e > most) most = e;
+  }
+  return most;
+}
+
+static
+size_t table_bytes(const struct approx *ap) {
+  return (size_t)ap->segments * (ap->degree + 1) * ap->coef_width / 8;
+}
+
+/* multiplies, doubled at 64 bits, and a load */
+static
+int cost(const struct approx *ap) {
+  return ap->degree * (ap->width == 64 ? 2 : 1) + 1;
+}
+
+/* the coarsest working precision meeting the bound for this degree and
+   segmentation, measured on a sample of codes or every one */
+static
+bool tune(struct approx *ap, const long double *b, code_iter next) {
+  int g;
+  long double budget = ap->precision;
+  for(g = 0; g <= 40; g++) {
+    ap->work = ap->out.fractional_bits + g;
+    quantize(ap, b);
+    ap->width = horner_width(ap);
+    if(!ap->width || table_bytes(ap) > ap->max_table) return false;
+    if(measure(ap, next) <= budget) return true;
+  }
+  return false;
+}
+
+static
+const char *search(struct approx *ap) {
+  static const char *none = "no approximation meets the precision in --max-table bytes";
+  struct approx best, c;
+  int d, k, last_shift;
+  long double *b = NULL, *best_b = NULL;
+  bool found = false;
+
+  for(d = 0; d <= MAX_DEGREE; d++) {
+    last_shift = -1;
+    for(k = 0; k <= MAX_SEGMENTS_LOG2 && (INT64_C(1) << k) <= ap->n; k++) {
+      c = *ap;
+      c.degree = d;
+      c.shift = 0;
+      while((INT64_C(1) << (c.shift + k)) < ap->n) c.shift++;
+      if(c.shift == last_shift || (d > 0 && c.shift == 0)) continue;
+      last_shift = c.shift;
+      c.segments = (int)((ap->n + (INT64_C(1) << c.shift) - 1) >> c.shift);
+      if((size_t)c.segments * (d + 1) > ap->max_table) continue;
+      b = realloc(b, sizeof(*b) * c.segments * (d + 1));
+      c.coef = malloc(sizeof(*c.coef) * c.segments * (d + 1));
+      fit(&c, b);
+      if(poly_err(&c, b) < ap->precision && tune(&c, b, segment_sample) &&
+         (!found || cost(&c) < cost(&best) ||
+          (cost(&c) == cost(&best) && table_bytes(&c) < table_bytes(&best)))) {
+        if(found) free(best.coef);
+        best = c;
+        free(best_b);
+        best_b = b;
+        b = NULL;
+        found = true;
+      } else {
+        free(c.coef);
+      }
+    }
+  }
+  free(b);
+  if(!found) return none;
+
+  // measure the best one everywhere, refining the working precision if needed
+  *ap = best;
+  ap->exhaustive = ap->n <= EXHAUSTIVE;
+  bool ok = tune(ap, best_b, ap->exhaustive ? every_code : wide_sample);
+  free(best_b);
+  if(!ok) return none;
+  ap->max_err = measure(ap, ap->exhaustive ? every_code : wide_sample);
+  return NULL;
+}
+
+static
+const char *code_type(const struct fpc_parameters *p) {
+  static char buf[2][16];
+  static int i;
+  i = !i;
+  snprintf(buf[i], sizeof(buf[i]), "%s%d_t", p->use_signed ? "int" : "uint",
+           p->fixed_encoding_width);
+  return buf[i];
+}
+
+static
+void gen_approx(struct approx *ap, FILE *f) {
+  int s, i, d = ap->degree, w = ap->width;
+  const char *W = w == 64 ? "int64_t" : "int32_t";
+  const char *ct = ap->coef_unsigned ? "uint" : "int";
+  int cb = ap->coef_width;
+  char upper[128], buf[41];
+  for(i = 0; ap->name[i] && i < (int)sizeof(upper) - 1; i++) {
+    upper[i] = toupper((unsigned char)ap->name[i]);
+  }
+  upper[i] = 0;
+  // a table of results in the output format needs no clamping
+  bool clamp = d > 0 || ap->work > ap->out.fractional_bits;
+  for(s = 0; !clamp && s < ap->segments; s++) {
+    clamp = ap->coef[s] < ap->out.lower_bound - ap->out.offset ||
+      ap->coef[s] > ap->out.upper_bound - ap->out.offset;
+  }
+
+#define printf(...) fprintf(f, __VA_ARGS__)
+
+  printf("/* generated by fpc --approx */\n"
+         "#ifndef FPC_APPROX_%s_H\n"
+         "#define FPC_APPROX_%s_H\n\n"
+         "#include <stdint.h>\n\n", upper, upper);
+  printf("/* %s_in: [%.19Lg, %.19Lg] in steps of 2^%d", ap->name,
+         ldexpl(ap->in.lower_bound, -ap->in.fractional_bits),
+         ldexpl(ap->in.upper_bound, -ap->in.fractional_bits), -ap->in.fractional_bits);
+  if(ap->in.offset) printf(" with offset %s", int128_str(ap->in.offset, buf));
+  printf(" */\n"
+         "typedef %s %s_in_t;\n\n", code_type(&ap->in), ap->name);
+  printf("/* %s: [%.19Lg, %.19Lg] in steps of 2^%d", ap->name,
+         ldexpl(ap->out.lower_bound, -ap->out.fractional_bits),
+         ldexpl(ap->out.upper_bound, -ap->out.fractional_bits), -ap->out.fractional_bits);
+  if(ap->out.offset) printf(" with offset %s", int128_str(ap->out.offset, buf));
+  printf(" */\n"
+         "typedef %s %s_t;\n\n", code_type(&ap->out), ap->name);
+
+  printf("/* %s(x) within %.3Lg, measured %.3Lg at x = %.19Lg %s,\n",
+         ap->fn->name, ap->precision, ap->max_err, input_value(ap, ap->max_err_code),
+         ap->exhaustive ? "over every code" : "on a sample of codes");
+  if(d == 0) {
+    printf("   a table of %d result%s", ap->segments, ap->segments > 1 ? "s" : "");
+    if(ap->shift) printf(", one per %lld codes", (long long int)1 << ap->shift);
+  } else {
+    printf("   degree %d polynomials on %d segment%s of %lld codes", d, ap->segments,
+           ap->segments > 1 ? "s" : "", (long long int)1 << ap->shift);
+  }
+  printf(" (%zu byte%s), working to 2^%d in %d bits */\n",
+         table_bytes(ap), table_bytes(ap) > 1 ? "s" : "", -ap->work, w);
+
+  printf("static const %s%d_t %s_table[%d][%d] = {\n", ct, cb, ap->name, ap->segments, d + 1);
+  for(s = 0; s < ap->segments; s++) {
+    printf("  {");
+    for(i = 0; i <= d; i++) {
+      int64_t c = ap->coef[s * (d + 1) + i];
+      if(cb == 64) printf("%s%sINT64_C(%lld)", i ? ", " : " ", ap->coef_unsigned ? "U" : "", (long long int)c);
+      else printf("%s%lld", i ? ", " : " ", (long long int)c);
+    }
+    printf(" },\n");
+  }
+  printf("};\n\n");
+
+  printf("static inline %s_t %s(%s_in_t x) {\n", ap->name, ap->name, ap->name);
+  // the distance from the first code, clamped to the codes
+  long long int first = ap->x_lo - ap->in.offset, last = ap->n - 1;
+  if(first) printf("  int64_t d = (int64_t)x - INT64_C(%lld);\n", first);
+  else printf("  int64_t d = x;\n");
+  if(first || ap->in.use_signed) printf("  d = d < 0 ? 0 : d > INT64_C(%lld) ? INT64_C(%lld) : d;\n", last, last);
+  else printf("  d = d > INT64_C(%lld) ? INT64_C(%lld) : d;\n", last, last);
+  if(ap->shift) printf("  const %s%d_t *c = %s_table[d >> %d];\n", ct, cb, ap->name, ap->shift);
+  else printf("  const %s%d_t *c = %s_table[d];\n", ct, cb, ap->name);
+  if(d > 0) {
+    printf("  %s t = (%s)(d & %lld) - %lld;\n", W, W,
+           (long long int)((INT64_C(1) << ap->shift) - 1),
+           (long long int)(INT64_C(1) << (ap->shift - 1)));
+  }
+  printf("  %s r = c[%d];\n", W, d);
+  for(i = d - 1; i >= 0; i--) {
+    if(ap->shift > 1) {
+      printf("  r = ((r * t + %lld) >> %d) + c[%d];\n",
+              (long long int)(INT64_C(1) << (ap->shift - 2)), ap->shift - 1, i);
+    } else {
+      printf("  r = r * t + c[%d];\n", i);
+    }
+  }
+  int sh = ap->work - ap->out.fractional_bits;
+  if(sh > 0) printf("  r = (r + %lld) >> %d;\n", (long long int)(INT64_C(1) << (sh - 1)), sh);
+  if(clamp) {
+    long long int lo = ap->out.lower_bound - ap->out.offset, hi = ap->out.upper_bound - ap->out.offset;
+    printf("  r = r < %lld ? %lld : r > %lld ? %lld : r;\n", lo, lo, hi, hi);
+  }
+  printf("  return (%s_t)r;\n"
+         "}\n\n"
+         "#endif\n", ap->name);
+#undef printf
+}
+
+/* a program measuring the error against libm in long double and, with
+   -b, timing the function against libm in double */
+static
+void gen_approx_check(struct approx *ap, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+#define REF(suffix, arg) do {                                           \
+    if(ap->fn->f == recipl) printf("1 / %s", arg);                      \
+    else if(ap->fn->f == rsqrtl) printf("1 / sqrt%s(%s)", suffix, arg); \
+    else printf("%s%s(%s)", ap->fn->name, suffix, arg);                 \
+  } while(0)
+  const char *name = ap->name;
+  printf("\n"
+         "#include <math.h>\n"
+         "#include <stdio.h>\n"
+         "#include <string.h>\n"
+         "#include <time.h>\n\n"
+         "#if defined(__x86_64__) || defined(__i386__)\n"
+         "#include <x86intrin.h>\n"
+         "#define TICKS() __rdtsc()\n"
+         "#define TICK_UNIT \"cycles\"\n"
+         "#else\n"
+         "static unsigned long long int approx_ns(void) {\n"
+         "  struct timespec ts;\n"
+         "  clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+         "  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;\n"
+         "}\n"
+         "#define TICKS() approx_ns()\n"
+         "#define TICK_UNIT \"ns\"\n"
+         "#endif\n\n");
+  printf("#define N %lld\n"
+         "#define BENCH_N 4096\n"
+         "#define BENCH_REPS 2000\n\n",
+         (long long int)(ap->n < (1 << 20) ? ap->n : (1 << 20)));
+  // N codes evenly spread over the input codes, every one if they fit
+  // called through a pointer so the name cannot clash with the locals
+  printf("static %s_t (*const approx_f)(%s_in_t) = %s;\n\n", name, name, name);
+  printf("static %s_in_t approx_code(long long int i) {\n"
+         "  return (%s_in_t)(%lldLL + (long long int)((__int128)i * %lldLL / (N > 1 ? N - 1 : 1)));\n"
+         "}\n\n", name, name, (long long int)(ap->x_lo - ap->in.offset), (long long int)ap->n - 1);
+  printf("static long double approx_in(%s_in_t x) {\n"
+         "  return ldexpl((long double)x + %lldLL, %d);\n"
+         "}\n\n", name, (long long int)ap->in.offset, -ap->in.fractional_bits);
+  printf("static long double approx_out(%s_t y) {\n"
+         "  return ldexpl((long double)y + %lldLL, %d);\n"
+         "}\n\n", name, (long long int)ap->out.offset, -ap->out.fractional_bits);
+
+  printf("static int approx_check(void) {\n"
+         "  long double most = 0, at = 0;\n"
+         "  long long int i;\n"
+         "  for(i = 0; i < N; i++) {\n"
+         "    long double x = approx_in(approx_code(i));\n"
+         "    long double err = fabsl(approx_out(approx_f(approx_code(i))) - ");
+  REF("l", "x");
+  printf(");\n"
+         "    if(err > most) {\n"
+         "      most = err;\n"
+         "      at = x;\n"
+         "    }\n"
+         "  }\n"
+         "  int bad = most > %.21Lg;\n"
+         "  printf(\"%s: %%lld codes, max error %%.3Lg at %%.19Lg (bound %.3Lg): %%s\\n\",\n"
+         "         (long long int)N, most, at, bad ? \"FAIL\" : \"ok\");\n"
+         "  return bad;\n"
+         "}\n\n", ap->precision, name, ap->precision);
+
+  printf("static void approx_bench(void) {\n"
+         "  static %s_in_t codes[BENCH_N];\n"
+         "  static double values[BENCH_N];\n"
+         "  unsigned long long int start;\n"
+         "  long long int sum = 0;\n"
+         "  double fsum = 0;\n"
+         "  int i, rep;\n"
+         "  for(i = 0; i < BENCH_N; i++) {\n"
+         "    codes[i] = approx_code((i * 2654435761u %% BENCH_N) * (N - 1LL) / (BENCH_N - 1));\n"
+         "    values[i] = (double)approx_in(codes[i]);\n"
+         "  }\n"
+         "  start = TICKS();\n"
+         "  for(rep = 0; rep < BENCH_REPS; rep++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) sum += approx_f(codes[i]);\n"
+         "    __asm__ volatile(\"\" : \"+g\"(sum));\n"
+         "  }\n"
+         "  double fixed = (double)(TICKS() - start) / ((double)BENCH_N * BENCH_REPS);\n"
+         "  start = TICKS();\n"
+         "  for(rep = 0; rep < BENCH_REPS; rep++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) fsum += ", name);
+  REF("", "values[i]");
+  printf(";\n"
+         "    __asm__ volatile(\"\" : \"+g\"(fsum));\n"
+         "  }\n"
+         "  double libm = (double)(TICKS() - start) / ((double)BENCH_N * BENCH_REPS);\n"
+         "  printf(\"%s: %%.1f \" TICK_UNIT \" per call, libm double %%.1f\\n\", fixed, libm);\n"
+         "}\n\n"
+         "int main(int argc, char **argv) {\n"
+         "  if(argc > 1 && strcmp(argv[1], \"-b\") == 0) {\n"
+         "    approx_bench();\n"
+         "    return 0;\n"
+         "  }\n"
+         "  return approx_check();\n"
+         "}\n", name);
+#undef REF
+#undef printf
+}
+
+int approx_main(int argc, char **argv) {
+  struct approx ap;
+  bool check = false;
+  size_t i;
+  memset(&ap, 0, sizeof(ap));
+  ap.max_table = 4096;
+  for(; argc > 0 && argv[0][0] == '-' && argv[0][1] == '-'; argc--, argv++) {
+    if(strcmp(argv[0], "--check") == 0) {
+      check = true;
+    } else if(strncmp(argv[0], "--max-table=", 12) == 0) {
+      ap.max_table = strtoull(argv[0] + 12, NULL, 10);
+    } else break;
+  }
+  if(argc != 6) {
+    fprintf(stderr, "fpc --approx [--check] [--max-table=bytes] [name] [function] "
+            "[min] [max] [precision] [output precision]\n"
+            "functions:");
+    for(i = 0; i < sizeof(functions) / sizeof(functions[0]); i++) {
+      fprintf(stderr, " %s", functions[i].name);
+    }
+    fprintf(stderr, "\n");
+    return -1;
+  }
+  if(!gen_valid_name(argv[0])) {
+    fprintf(stderr, "ERROR: %s: not a C identifier\n", argv[0]);
+    return -1;
+  }
+  if(gen_reserved_name(argv[0])) {
+    fprintf(stderr, "ERROR: %s: %s_t is a standard type\n", argv[0], argv[0]);
+    return -1;
+  }
+  ap.name = argv[0];
+  for(i = 0; i < sizeof(functions) / sizeof(functions[0]); i++) {
+    if(strcmp(argv[1], functions[i].name) == 0) ap.fn = &functions[i];
+  }
+  if(!ap.fn) {
+    fprintf(stderr, "ERROR: unknown function: %s\n", argv[1]);
+    return -1;
+  }
+  if(!fpc_calculate_from_strings(argv[2], argv[3], argv[4], &ap.in)) {
+    fprintf(stderr, "ERROR: %s\n", ap.in.error);
+    return -1;
+  }
+  ap.precision = fpc_eval_expr(argv[5]);
+  if(!(ap.precision > 0) || !isfinite(ap.precision)) {
+    fprintf(stderr, "ERROR: bad precision: %s\n", argv[5]);
+    return -1;
+  }
+  if(ap.in.large_offset || ap.in.upper_bound - ap.in.lower_bound >= ((int128_t)1 << 40)) {
+    fprintf(stderr, "ERROR: more than 2^40 input codes\n");
+    return -1;
+  }
+  ap.x_lo = (int64_t)ap.in.lower_bound;
+  ap.n = (int64_t)(ap.in.upper_bound - ap.in.lower_bound) + 1;
+
+  // the domains are intervals, so checking the ends is enough
+  long double first = input_value(&ap, 0), last = input_value(&ap, ap.n - 1);
+  if(!in_domain(ap.fn, first) || !in_domain(ap.fn, last) ||
+     (ap.fn->f == recipl && first < 0 && last > 0)) {
+    fprintf(stderr, "ERROR: %s(x) needs %s over [%.19Lg, %.19Lg]\n", ap.fn->name,
+            ap.fn->domain, first, last);
+    return -1;
+  }
+
+  // the output format covers the function over the input codes, or a
+  // sample including the ends of 2^MAX_SEGMENTS_LOG2 segments
+  long double lo = INFINITY, hi = -INFINITY;
+  int64_t d, state = 0;
+  while((INT64_C(1) << (ap.shift + MAX_SEGMENTS_LOG2)) < ap.n) ap.shift++;
+  ap.segments = (int)((ap.n + (INT64_C(1) << ap.shift) - 1) >> ap.shift);
+  while(ap.n <= EXHAUSTIVE ? every_code(&ap, &d, &state) : wide_sample(&ap, &d, &state)) {
+    long double y = ap.fn->f(input_value(&ap, d));
+    if(y < lo) lo = y;
+    if(y > hi) hi = y;
+  }
+  ap.out.min = lo - ap.precision;
+  ap.out.max = hi + ap.precision;
+  ap.out.precision = ap.precision;
+  if(!fpc_calculate(&ap.out)) {
+    fprintf(stderr, "ERROR: %s\n", ap.out.error);
+    return -1;
+  }
+  if(ap.out.large_offset || ap.out.fixed_encoding_width > 32) {
+    fprintf(stderr, "ERROR: output wider than 32 bits\n");
+    return -1;
+  }
+
+  const char *error = search(&ap);
+  if(error) {
+    fprintf(stderr, "ERROR: %s\n", error);
+    return -1;
+  }
+  gen_approx(&ap, stdout);
+  if(check) gen_approx_check(&ap, stdout);
+  free(ap.coef);
+  return 0;
+}
@@ -0,0 +1,743 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "gen.h"
+#include "modes.h"
+
+/* Fixed-point arithmetic between fpc formats.
+
+   A code c of a format with fractional bits f and offset o stands for
+   (c + o) * 2^-f.  Every operation widens both arguments to that
+   scaled integer, works exactly at the finest scale involved, and
+   rounds once (ties away from zero) into the result format.  The
+   intermediate type is the narrowest of int32_t, int64_t and __int128
+   that holds every value the operation can produce; products and
+   quotients of 128 bit formats that need more go through a 256 bit
+   product or a long division instead.  The _sat variants clamp to the
+   result's code range, the _wrap variants truncate to its machine
+   width. */
+
+static const int wide_types[] = { 32, 64, 128 };
+
+int gen_arith_bits(int128_t x) {
+  unsigned __int128 u = x < 0 ? ~(unsigned __int128)x : (unsigned __int128)x;
+  int n = 0;
+  while(u) {
+    n++;
+    u >>= 1;
+  }
+  return n + 1; // sign
+}
+
+/* bits for the scaled values (code + offset) of a format */
+static
+int value_bits(struct fpc_parameters *p) {
+  int a = gen_arith_bits(p->lower_bound), b = gen_arith_bits(p->upper_bound);
+  return a > b ? a : b;
+}
+
+int gen_arith_width(int bits) {
+  unsigned int i;
+  for(i = 0; i < sizeof(wide_types) / sizeof(wide_types[0]); i++) {
+    if(bits <= wide_types[i]) return wide_types[i];
+  }
+  return 0;
+}
+
+/* the intermediate width for a value needing bits and the values of
+   the result format r, or 0 if too wide */
+static
+int wide_for(struct fpc_parameters *r, int bits) {
+  if(bits < value_bits(r)) bits = value_bits(r);
+  return gen_arith_width(bits + 1); // room for rounding
+}
+
+const char *gen_arith_type(int w) {
+  return w == 128 ? "__int128" : w == 64 ? "int64_t" : "int32_t";
+}
+
+void gen_arith_const(FILE *f, int128_t x) {
+  if(x >= INT32_MIN && x <= INT32_MAX) {
+    fprintf(f, "%d", (int)x);
+  } else if(x == INT64_MIN) {
+    fprintf(f, "INT64_MIN");
+  } else if(x >= INT64_MIN && x <= INT64_MAX) {
+    fprintf(f, "INT64_C(%lld)", (long long int)x);
+  } else {
+    fprintf(f, "((__int128)INT64_C(%lld) * ((__int128)1 << 64) + UINT64_C(%llu))",
+            (long long int)(x >> 64), (unsigned long long int)x);
+  }
+}
+
+void gen_code_const(struct fpc_parameters *param, int128_t x, FILE *f) {
+  if(param->fixed_encoding_width == 128) {
+    gen_arith_const(f, x);
+  } else if(x == INT64_MIN) {
+    fprintf(f, "INT64_MIN");
+  } else if(param->use_signed) {
+    fprintf(f, "INT%d_C(%lld)", param->fixed_encoding_width, (long long int)x);
+  } else {
+    fprintf(f, "UINT%d_C(%llu)", param->fixed_encoding_width, (unsigned long long int)x);
+  }
+}
+
+void gen_int128_types(FILE *f) {
+  fprintf(f, "#ifndef FPC_INT128_TYPES\n"
+          "#define FPC_INT128_TYPES\n"
+          "typedef __int128 int128_t;\n"
+          "typedef unsigned __int128 uint128_t;\n"
+          "#endif\n\n");
+}
+
+struct format {
+  const char *name;
+  struct fpc_parameters param;
+};
+
+static
+const char *type_prefix(struct format *x) {
+  return x->param.use_signed ? "int" : "uint";
+}
+
+/* (W)c + offset */
+static
+void print_raw(FILE *f, struct format *x, const char *arg, int w) {
+  if(x->param.offset) {
+    fprintf(f, "((%s)%s + ", gen_arith_type(w), arg);
+    gen_arith_const(f, x->param.offset);
+    fprintf(f, ")");
+  } else {
+    fprintf(f, "(%s)%s", gen_arith_type(w), arg);
+  }
+}
+
+/* rescale expr from fractional bits `from` to `to`, rounding if needed */
+static
+void print_align(FILE *f, const char *expr, int from, int to, int w) {
+  if(to > from) {
+    fprintf(f, "(%s) * ((%s)1 << %d)", expr, gen_arith_type(w), to - from);
+  } else if(to < from) {
+    fprintf(f, "fpc_rshift%d(%s, %d)", w, expr, from - to);
+  } else {
+    fprintf(f, "%s", expr);
+  }
+}
+
+/* return r, a scaled value of format x, as a code of x */
+static
+void print_result(FILE *f, struct format *x, bool sat) {
+  struct fpc_parameters *p = &x->param;
+  if(p->offset) {
+    fprintf(f, "  r -= ");
+    gen_arith_const(f, p->offset);
+    fprintf(f, ";\n");
+  }
+  if(sat) {
+    fprintf(f, "  if(r < ");
+    gen_arith_const(f, p->lower_bound - p->offset);
+    fprintf(f, ") r = ");
+    gen_arith_const(f, p->lower_bound - p->offset);
+    fprintf(f, ";\n  if(r > ");
+    gen_arith_const(f, p->upper_bound - p->offset);
+    fprintf(f, ") r = ");
+    gen_arith_const(f, p->upper_bound - p->offset);
+    fprintf(f, ";\n"
+            "  return (%s_t)r;\n", x->name);
+  } else {
+    fprintf(f, "  return (%s_t)(uint%d_t)r;\n", x->name, p->fixed_encoding_width);
+  }
+}
+
+static
+void func_name(char *buf, size_t size, struct format *a, const char *op, struct format *b,
+               const char *variant) {
+  if(a == b) {
+    snprintf(buf, size, "%s_%s%s", a->name, op, variant);
+  } else {
+    snprintf(buf, size, "%s_%s_%s%s", a->name, op, b->name, variant);
+  }
+}
+
+/* a + b or a - b in the format of a */
+static
+void gen_addsub(FILE *f, struct format *a, struct format *b, char op, bool sat) {
+  int fa = a->param.fractional_bits, fb = b->param.fractional_bits;
+  int m = fa > fb ? fa : fb;
+  int bits_a = value_bits(&a->param) + m - fa;
+  int bits_b = value_bits(&b->param) + m - fb;
+  int w = wide_for(&a->param, (bits_a > bits_b ? bits_a : bits_b) + 1);
+  char name[128], raw_a[160], raw_b[160];
+  func_name(name, sizeof(name), a, op == '+' ? "add" : "sub", b, sat ? "_sat" : "_wrap");
+  if(!w) {
+    fprintf(f, "/* %s: intermediate wider than 128 bits */\n\n", name);
+    return;
+  }
+
+  FILE *s = fmemopen(raw_a, sizeof(raw_a), "w");
+  print_raw(s, a, "a", w);
+  fclose(s);
+  s = fmemopen(raw_b, sizeof(raw_b), "w");
+  print_raw(s, b, "b", w);
+  fclose(s);
+
+  fprintf(f, "static inline %s_t %s(%s_t a, %s_t b) {\n"
+          "  %s r = ", a->name, name, a->name, b->name, gen_arith_type(w));
+  print_align(f, raw_a, fa, m, w);
+  fprintf(f, " %c ", op);
+  print_align(f, raw_b, fb, m, w);
+  fprintf(f, ";\n");
+  if(m != fa) {
+    fprintf(f, "  r = ");
+    print_align(f, "r", m, fa, w);
+    fprintf(f, ";\n");
+  }
+  print_result(f, a, sat);
+  fprintf(f, "}\n\n");
+}
+
+/* a * b in the format of a */
+static
+void gen_mul(FILE *f, struct format *a, struct format *b, bool sat) {
+  int fa = a->param.fractional_bits, fb = b->param.fractional_bits;
+  // the product, shifted left after it if b has negative fractional bits
+  int w = wide_for(&a->param, value_bits(&a->param) + value_bits(&b->param) + (fb < 0 ? -fb : 0));
+  char name[128];
+  func_name(name, sizeof(name), a, "mul", b, sat ? "_sat" : "_wrap");
+  if(!w && fb >= 0) {
+    fprintf(f, "static inline %s_t %s(%s_t a, %s_t b) {\n"
+            "  __int128 r = fpc_mulshift128(", a->name, name, a->name, b->name);
+    print_raw(f, a, "a", 128);
+    fprintf(f, ", ");
+    print_raw(f, b, "b", 128);
+    fprintf(f, ", %d, %d);\n", fb, sat);
+    print_result(f, a, sat);
+    fprintf(f, "}\n\n");
+    return;
+  }
+  if(!w) {
+    fprintf(f, "/* %s: intermediate wider than 128 bits */\n\n", name);
+    return;
+  }
+  fprintf(f, "static inline %s_t %s(%s_t a, %s_t b) {\n"
+          "  %s r = ", a->name, name, a->name, b->name, gen_arith_type(w));
+  print_raw(f, a, "a", w);
+  fprintf(f, " * ");
+  print_raw(f, b, "b", w);
+  fprintf(f, ";\n");
+  if(fb) {
+    fprintf(f, "  r = ");
+    print_align(f, "r", fa + fb, fa, w);
+    fprintf(f, ";\n");
+  }
+  print_result(f, a, sat);
+  fprintf(f, "}\n\n");
+}
+
+/* a / b in the format of a, division by zero saturates */
+static
+void gen_div(FILE *f, struct format *a, struct format *b, bool sat) {
+  int fb = b->param.fractional_bits;
+  // a / b * 2^fa = (a * 2^fb) / b with a and b scaled values
+  int n_bits = value_bits(&a->param) + (fb > 0 ? fb : 0);
+  int d_bits = value_bits(&b->param) + (fb < 0 ? -fb : 0);
+  int w = wide_for(&a->param, n_bits > d_bits ? n_bits : d_bits);
+  char name[128];
+  bool wide = !w && fb >= 0 && d_bits <= 128;
+  func_name(name, sizeof(name), a, "div", b, sat ? "_sat" : "_wrap");
+  if(!w && !wide) {
+    fprintf(f, "/* %s: intermediate wider than 128 bits */\n\n", name);
+    return;
+  }
+  if(wide) w = 128; // a * 2^fb as 256 bits in fpc_divshift128()
+  fprintf(f, "static inline %s_t %s(%s_t a, %s_t b) {\n"
+          "  %s n = ", a->name, name, a->name, b->name, gen_arith_type(w));
+  print_raw(f, a, "a", w);
+  if(fb > 0 && !wide) fprintf(f, " * ((%s)1 << %d)", gen_arith_type(w), fb);
+  fprintf(f, ", d = ");
+  print_raw(f, b, "b", w);
+  if(fb < 0) fprintf(f, " * ((%s)1 << %d)", gen_arith_type(w), -fb);
+  fprintf(f, ";\n"
+          "  %s r;\n"
+          "  if(d == 0) {\n", gen_arith_type(w));
+  fprintf(f, "    r = n > 0 ? ");
+  gen_arith_const(f, a->param.upper_bound);
+  fprintf(f, " : n < 0 ? ");
+  gen_arith_const(f, a->param.lower_bound);
+  fprintf(f, " : 0;\n"
+          "  } else {\n");
+  if(wide) fprintf(f, "    r = fpc_divshift128(n, %d, d, %d);\n", fb, sat);
+  else fprintf(f, "    r = fpc_div%d(n, d);\n", w);
+  fprintf(f, "  }\n");
+  print_result(f, a, sat);
+  fprintf(f, "}\n\n");
+}
+
+/* -1, 0 or 1 as a < b, a == b or a > b */
+static
+void gen_cmp(FILE *f, struct format *a, struct format *b) {
+  int fa = a->param.fractional_bits, fb = b->param.fractional_bits;
+  int m = fa > fb ? fa : fb;
+  int bits_a = value_bits(&a->param) + m - fa;
+  int bits_b = value_bits(&b->param) + m - fb;
+  int w = wide_for(&a->param, bits_a > bits_b ? bits_a : bits_b);
+  char name[128], raw[160];
+  func_name(name, sizeof(name), a, "cmp", b, "");
+  if(!w) {
+    fprintf(f, "/* %s: intermediate wider than 128 bits */\n\n", name);
+    return;
+  }
+  fprintf(f, "static inline int %s(%s_t a, %s_t b) {\n"
+          "  %s x = ", name, a->name, b->name, gen_arith_type(w));
+  FILE *s = fmemopen(raw, sizeof(raw), "w");
+  print_raw(s, a, "a", w);
+  fclose(s);
+  print_align(f, raw, fa, m, w);
+  fprintf(f, ", y = ");
+  s = fmemopen(raw, sizeof(raw), "w");
+  print_raw(s, b, "b", w);
+  fclose(s);
+  print_align(f, raw, fb, m, w);
+  fprintf(f, ";\n"
+          "  return (x > y) - (x < y);\n"
+          "}\n\n");
+}
+
+/* b converted to the format of a */
+static
+void gen_from(FILE *f, struct format *a, struct format *b, bool sat) {
+  int fa = a->param.fractional_bits, fb = b->param.fractional_bits;
+  int bits = value_bits(&b->param) + (fa > fb ? fa - fb : 0);
+  int w = wide_for(&a->param, bits);
+  char name[128], raw[160];
+  snprintf(name, sizeof(name), "%s_from_%s%s", a->name, b->name, sat ? "_sat" : "_wrap");
+  if(!w) {
+    fprintf(f, "/* %s: intermediate wider than 128 bits */\n\n", name);
+    return;
+  }
+  fprintf(f, "static inline %s_t %s(%s_t b) {\n"
+          "  %s r = ", a->name, name, b->name, gen_arith_type(w));
+  FILE *s = fmemopen(raw, sizeof(raw), "w");
+  print_raw(s, b, "b", w);
+  fclose(s);
+  print_align(f, raw, fb, fa, w);
+  fprintf(f, ";\n");
+  print_result(f, a, sat);
+  fprintf(f, "}\n\n");
+}
+
+void gen_arith_helpers(FILE *f) {
+  unsigned int i;
+  fprintf(f, "#ifndef FPC_ARITH_HELPERS\n"
+          "#define FPC_ARITH_HELPERS\n\n");
+  for(i = 0; i < sizeof(wide_types) / sizeof(wide_types[0]); i++) {
+    int w = wide_types[i];
+    const char *t = gen_arith_type(w);
+    if(w == 128) fprintf(f, "#ifdef __SIZEOF_INT128__\n");
+    fprintf(f,
+            "/* x / 2^s, ties away from zero */\n"
+            "static inline %s fpc_rshift%d(%s x, int s) {\n"
+            "  %s h = (%s)1 << (s - 1);\n"
+            "  return x >= 0 ? (x + h) >> s : -((-x + h) >> s);\n"
+            "}\n\n", t, w, t, t, t);
+    fprintf(f,
+            "/* n / d, ties away from zero */\n"
+            "static inline %s fpc_div%d(%s n, %s d) {\n"
+            "  %s q = n / d, r = n %% d;\n"
+            "  %s ar = r < 0 ? -r : r, ad = d < 0 ? -d : d;\n"
+            "  if(ar >= ad - ar) q += (n < 0) == (d < 0) ? 1 : -1;\n"
+            "  return q;\n"
+            "}\n", t, w, t, t, t, t);
+    if(w == 128) fprintf(f, "#endif\n");
+    fprintf(f, "\n");
+  }
+  fprintf(f, "#endif\n\n");
+
+  fprintf(f,
+          "#if defined(__SIZEOF_INT128__) && !defined(FPC_ARITH_WIDE_HELPERS)\n"
+          "#define FPC_ARITH_WIDE_HELPERS\n\n"
+          "/* a result of magnitude hi:lo, the low 128 bits or, saturating, 2^126\n"
+          "   (beyond every format) if it is larger */\n"
+          "static inline __int128 fpc_wide_result(unsigned __int128 hi, unsigned __int128 lo,\n"
+          "                                       int neg, int sat) {\n"
+          "  if(sat && (hi || lo >> 126)) lo = (unsigned __int128)1 << 126;\n"
+          "  return (__int128)(neg ? -lo : lo);\n"
+          "}\n\n");
+  fprintf(f,
+          "/* x * y / 2^s for 0 <= s < 128, ties away from zero, with a 256 bit product */\n"
+          "static inline __int128 fpc_mulshift128(__int128 x, __int128 y, int s, int sat) {\n"
+          "  unsigned __int128 a = x < 0 ? -(unsigned __int128)x : (unsigned __int128)x;\n"
+          "  unsigned __int128 b = y < 0 ? -(unsigned __int128)y : (unsigned __int128)y;\n"
+          "  unsigned __int128 m = UINT64_MAX, ll = (a & m) * (b & m), lh = (a & m) * (b >> 64);\n"
+          "  unsigned __int128 hl = (a >> 64) * (b & m), mid = (ll >> 64) + (lh & m) + (hl & m);\n"
+          "  unsigned __int128 lo = mid << 64 | (ll & m);\n"
+          "  unsigned __int128 hi = (a >> 64) * (b >> 64) + (lh >> 64) + (hl >> 64) + (mid >> 64);\n"
+          "  if(s) {\n"
+          "    unsigned __int128 h = (unsigned __int128)1 << (s - 1);\n"
+          "    lo += h;\n"
+          "    hi += lo < h;\n"
+          "    lo = lo >> s | hi << (128 - s);\n"
+          "    hi >>= s;\n"
+          "  }\n"
+          "  return fpc_wide_result(hi, lo, (x < 0) != (y < 0), sat);\n"
+          "}\n\n");
+  fprintf(f,
+          "/* x * 2^s / y for 0 <= s < 128 and y != 0, ties away from zero, by long\n"
+          "   division of the 256 bit numerator */\n"
+          "static inline __int128 fpc_divshift128(__int128 x, int s, __int128 y, int sat) {\n"
+          "  unsigned __int128 a = x < 0 ? -(unsigned __int128)x : (unsigned __int128)x;\n"
+          "  unsigned __int128 d = y < 0 ? -(unsigned __int128)y : (unsigned __int128)y;\n"
+          "  unsigned __int128 r = s ? a >> (128 - s) : 0, lo = a << s, q = 0;\n"
+          "  int neg = (x < 0) != (y < 0), i;\n"
+          "  if(r >= d) return fpc_wide_result(1, 0, neg, sat); // at least 2^128\n"
+          "  for(i = 127; i >= 0; i--) {\n"
+          "    int carry = r >> 127;\n"
+          "    r = r << 1 | (lo >> i & 1);\n"
+          "    q <<= 1;\n"
+          "    if(carry || r >= d) {\n"
+          "      r -= d;\n"
+          "      q |= 1;\n"
+          "    }\n"
+          "  }\n"
+          "  int up = r >= d - r;\n"
+          "  return fpc_wide_result(up && q + 1 == 0, q + up, neg, sat);\n"
+          "}\n"
+          "#endif\n\n");
+}
+
+void gen_arith(const char **names, struct fpc_parameters *params, int n, FILE *f) {
+  struct format *formats = calloc(n, sizeof(*formats));
+  int i, j, k;
+  for(i = 0; i < n; i++) {
+    formats[i].name = names[i];
+    formats[i].param = params[i];
+  }
+
+  fprintf(f, "/* generated by fpc --arith */\n"
+          "#ifndef FPC_ARITH");
+  for(i = 0; i < n; i++) {
+    fprintf(f, "_");
+    for(const char *c = names[i]; *c; c++) fputc(toupper((unsigned char)*c), f);
+  }
+  fprintf(f, "_H\n"
+          "#define FPC_ARITH");
+  for(i = 0; i < n; i++) {
+    fprintf(f, "_");
+    for(const char *c = names[i]; *c; c++) fputc(toupper((unsigned char)*c), f);
+  }
+  fprintf(f, "_H\n\n"
+          "#include <stdint.h>\n\n");
+  for(i = 0; i < n && params[i].fixed_encoding_width < 128; i++);
+  if(i < n) gen_int128_types(f);
+  gen_arith_helpers(f);
+
+  for(i = 0; i < n; i++) {
+    struct fpc_parameters *p = &formats[i].param;
+    fprintf(f, "/* %s: [%.19Lg, %.19Lg] in steps of 2^%d",
+            names[i],
+            ldexpl(p->lower_bound, -p->fractional_bits),
+            ldexpl(p->upper_bound, -p->fractional_bits),
+            -p->fractional_bits);
+    if(p->offset) {
+      char buf[41];
+      fprintf(f, " with offset %s", int128_str(p->offset, buf));
+    }
+    fprintf(f, " */\n"
+            "typedef %s%d_t %s_t;\n\n", type_prefix(&formats[i]), p->fixed_encoding_width, names[i]);
+  }
+
+  for(i = 0; i < n; i++) {
+    for(j = 0; j < n; j++) {
+      struct format *a = &formats[i], *b = &formats[j];
+      for(k = 1; k >= 0; k--) {
+        gen_addsub(f, a, b, '+', k);
+        gen_addsub(f, a, b, '-', k);
+        gen_mul(f, a, b, k);
+        gen_div(f, a, b, k);
+        if(a != b) gen_from(f, a, b, k);
+      }
+      gen_cmp(f, a, b);
+    }
+  }
+  fprintf(f, "#endif\n");
+  free(formats);
+}
+
+/* the codes of x sampled by x_sample(k): its bounds, the code nearest
+   0 and then random codes */
+static
+void gen_check_sample(FILE *f, struct format *x) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  struct fpc_parameters *p = &x->param;
+  int128_t lo = p->lower_bound - p->offset, hi = p->upper_bound - p->offset;
+  int128_t zero = -p->offset < lo ? lo : -p->offset > hi ? hi : -p->offset;
+  printf("static %s_t %s_sample(int k) {\n"
+         "  unsigned __int128 span = (unsigned __int128)(", x->name, x->name);
+  gen_arith_const(f, hi);
+  printf(" - ");
+  gen_arith_const(f, lo);
+  printf(");\n"
+         "  if(k == 0) return (%s_t)", x->name);
+  gen_arith_const(f, lo);
+  printf(";\n"
+         "  if(k == 1) return (%s_t)", x->name);
+  gen_arith_const(f, hi);
+  printf(";\n"
+         "  if(k == 2) return (%s_t)", x->name);
+  gen_arith_const(f, zero);
+  printf(";\n"
+         "  unsigned __int128 r = (unsigned __int128)check_random() << 64 | check_random();\n"
+         "  return (%s_t)(", x->name);
+  gen_arith_const(f, lo);
+  printf(" + (__int128)(span + 1 == 0 ? r : r %% (span + 1)));\n"
+         "}\n\n");
+#undef printf
+}
+
+/* the checks of a op b against the reference */
+static
+void gen_check_pair(FILE *f, struct format *a, struct format *b) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  struct fpc_parameters *pa = &a->param, *pb = &b->param;
+  int fa = pa->fractional_bits, fb = pb->fractional_bits, m = fa > fb ? fa : fb;
+  const char *ops[] = { "add", "sub", "mul", "div" };
+  char name[128], call[300];
+  unsigned int i, k;
+
+  printf("  for(i = 0; i < CHECK_SAMPLES; i++) {\n"
+         "    %s_t x = %s_sample(i < 9 ? i / 3 : 3);\n"
+         "    %s_t y = %s_sample(i < 9 ? i %% 3 : 3);\n"
+         "    __int128 ra = (__int128)x + ", a->name, a->name, b->name, b->name);
+  gen_arith_const(f, pa->offset);
+  printf(", rb = (__int128)y + ");
+  gen_arith_const(f, pb->offset);
+  printf(", lo = ");
+  gen_arith_const(f, pa->lower_bound - pa->offset);
+  printf(", hi = ");
+  gen_arith_const(f, pa->upper_bound - pa->offset);
+  printf(", want;\n"
+         "    checks++;\n");
+  for(i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    // the exact scaled result in a before rounding to a code of a
+    if(i < 2) {
+      printf("    want = check_shift(check_shift(ra, %d) %c check_shift(rb, %d), %d);\n",
+             fa - m, i ? '-' : '+', fb - m, m - fa);
+    } else if(i == 2) {
+      printf("    want = check_shift(ra * rb, %d);\n", fb);
+    } else {
+      printf("    want = rb == 0 ? (ra > 0 ? ");
+      gen_arith_const(f, pa->upper_bound);
+      printf(" : ra < 0 ? ");
+      gen_arith_const(f, pa->lower_bound);
+      printf(" : 0) : check_div(check_shift(ra, %d), check_shift(rb, %d));\n",
+             -(fb > 0 ? fb : 0), fb < 0 ? fb : 0);
+    }
+    printf("    want -= ");
+    gen_arith_const(f, pa->offset);
+    printf(";\n");
+    for(k = 0; k < 2; k++) {
+      func_name(name, sizeof(name), a, ops[i], b, k ? "_wrap" : "_sat");
+      snprintf(call, sizeof(call), "(__int128)%s(x, y)", name);
+      if(k) {
+        // _wrap only where the result is in range
+        printf("    if(want >= lo && want <= hi) ");
+        printf("errors += check_result(\"%s\", x, y, %s, want);\n", name, call);
+      } else {
+        printf("    errors += check_result(\"%s\", x, y, %s, check_clamp(want, lo, hi));\n",
+               name, call);
+      }
+    }
+  }
+  if(a != b) {
+    printf("    want = check_shift(rb, %d) - ", fb - fa);
+    gen_arith_const(f, pa->offset);
+    printf(";\n");
+    printf("    errors += check_result(\"%s_from_%s_sat\", 0, y, (__int128)%s_from_%s_sat(y), "
+           "check_clamp(want, lo, hi));\n", a->name, b->name, a->name, b->name);
+    printf("    if(want >= lo && want <= hi) errors += check_result(\"%s_from_%s_wrap\", 0, y, "
+           "(__int128)%s_from_%s_wrap(y), want);\n", a->name, b->name, a->name, b->name);
+  }
+  func_name(name, sizeof(name), a, "cmp", b, "");
+  printf("    want = check_shift(ra, %d) - check_shift(rb, %d);\n"
+         "    errors += check_result(\"%s\", x, y, %s(x, y), (want > 0) - (want < 0));\n"
+         "  }\n", fa - m, fb - m, name, name);
+#undef printf
+}
+
+/* a program checking every function against an exact __int128
+   reference on the bounds, the codes nearest 0 and random codes of each
+   pair of formats, for the pairs whose reference fits 126 bits */
+static
+void gen_arith_check(struct format *formats, int n, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int i, j, pairs = 0;
+  printf("\n"
+         "#include <stdio.h>\n\n"
+         "#define CHECK_SAMPLES (1 << 16)\n\n"
+         "/* x / 2^s ties away from zero, or x * 2^-s for s < 0 */\n"
+         "static __int128 check_shift(__int128 x, int s) {\n"
+         "  if(s <= 0) return x * ((__int128)1 << -s);\n"
+         "  __int128 h = (__int128)1 << (s - 1);\n"
+         "  return x < 0 ? -((-x + h) >> s) : (x + h) >> s;\n"
+         "}\n\n"
+         "/* n / d ties away from zero */\n"
+         "static __int128 check_div(__int128 n, __int128 d) {\n"
+         "  __int128 q = n / d, r = n %% d;\n"
+         "  if(2 * (r < 0 ? -r : r) >= (d < 0 ? -d : d)) q += (n < 0) != (d < 0) ? -1 : 1;\n"
+         "  return q;\n"
+         "}\n\n"
+         "static __int128 check_clamp(__int128 x, __int128 lo, __int128 hi) {\n"
+         "  return x < lo ? lo : x > hi ? hi : x;\n"
+         "}\n\n"
+         "static unsigned long long int check_state = 1;\n\n"
+         "static unsigned long long int check_random(void) {\n"
+         "  check_state = check_state * 6364136223846793005ULL + 1442695040888963407ULL;\n"
+         "  return check_state ^ check_state >> 29;\n"
+         "}\n\n"
+         "static const char *check_str(__int128 x, char *buf) {\n"
+         "  unsigned __int128 u = x < 0 ? -(unsigned __int128)x : (unsigned __int128)x;\n"
+         "  char *p = buf + 47;\n"
+         "  *p = '\\0';\n"
+         "  do *--p = '0' + u %% 10; while(u /= 10);\n"
+         "  if(x < 0) *--p = '-';\n"
+         "  return p;\n"
+         "}\n\n"
+         "static long int check_errors;\n\n"
+         "static int check_result(const char *name, __int128 x, __int128 y, __int128 got, __int128 want) {\n"
+         "  char b[4][48];\n"
+         "  if(got == want) return 0;\n"
+         "  if(check_errors++ < 10) {\n"
+         "    printf(\"%%s(%%s, %%s) = %%s, expected %%s\\n\", name, check_str(x, b[0]), check_str(y, b[1]),\n"
+         "           check_str(got, b[2]), check_str(want, b[3]));\n"
+         "  }\n"
+         "  return 1;\n"
+         "}\n\n");
+  for(i = 0; i < n; i++) gen_check_sample(f, &formats[i]);
+  printf("int main(void) {\n"
+         "  long int i, checks = 0, errors = 0;\n");
+  for(i = 0; i < n; i++) {
+    for(j = 0; j < n; j++) {
+      struct format *a = &formats[i], *b = &formats[j];
+      int fa = a->param.fractional_bits, fb = b->param.fractional_bits, m = fa > fb ? fa : fb;
+      int va = value_bits(&a->param), vb = value_bits(&b->param);
+      // the widest reference: a sum, a product, a quotient's operands
+      int bits = (va + m - fa > vb + m - fb ? va + m - fa : vb + m - fb) + 1;
+      if(va + vb + (fb < 0 ? -fb : 0) > bits) bits = va + vb + (fb < 0 ? -fb : 0);
+      if(va + abs(fb) > bits) bits = va + abs(fb);
+      if(vb + abs(fb) > bits) bits = vb + abs(fb);
+      if(bits > 126) {
+        printf("  // %s and %s: the reference would need more than 126 bits\n", a->name, b->name);
+        continue;
+      }
+      gen_check_pair(f, a, b);
+      pairs++;
+    }
+  }
+  printf("  printf(\"%d pairs of formats, %%ld checks: %%ld errors\\n\", checks, errors);\n"
+         "  return errors != 0;\n"
+         "}\n", pairs);
+#undef printf
+}
+
+bool gen_valid_name(const char *s) {
+  if(!isalpha((unsigned char)*s) && *s != '_') return false;
+  for(; *s; s++) {
+    if(!isalnum((unsigned char)*s) && *s != '_') return false;
+  }
+  return true;
+}
+
+/* names whose name_t is a type of the C or POSIX headers generated code
+   includes, such as off_t from <sys/types.h> with <stdio.h> */
+static const char *reserved_types[] = {
+  "blkcnt", "blksize", "clock", "clockid", "dev", "div", "double", "float", "fpos",
+  "fsblkcnt", "fsfilcnt", "gid", "id", "ino", "key", "ldiv", "lldiv", "locale",
+  "max_align", "mbstate", "mode", "nlink", "off", "pid", "ptrdiff", "sig_atomic",
+  "sigset", "size", "ssize", "suseconds", "time", "timer", "uid", "useconds", "wchar", "wint"
+};
+
+bool gen_reserved_name(const char *s) {
+  unsigned int i;
+  const char *p = s + (*s == 'u');
+  if(strncmp(p, "int", 3) == 0) {
+    // intN_t, int_leastN_t, int_fastN_t, intptr_t, intmax_t and int128_t
+    p += 3;
+    if(strncmp(p, "_least", 6) == 0) p += 6;
+    else if(strncmp(p, "_fast", 5) == 0) p += 5;
+    if(strcmp(p, "ptr") == 0 || strcmp(p, "max") == 0) return true;
+    if(*p && strspn(p, "0123456789") == strlen(p)) return true;
+  }
+  if(strncmp(s, "pthread_", 8) == 0) return true;
+  for(i = 0; i < sizeof(reserved_types) / sizeof(reserved_types[0]); i++) {
+    if(strcmp(s, reserved_types[i]) == 0) return true;
+  }
+  return false;
+}
+
+int arith_main(int argc, char **argv) {
+  bool check = false;
+  int i, j, n;
+  if(argc && strcmp(argv[0], "--check") == 0) {
+    check = true;
+    argc--;
+    argv++;
+  }
+  n = argc / 4;
+  if(argc == 0 || argc % 4) {
+    fprintf(stderr, "fpc --arith [--check] [name] [min] [max] [precision] ...\n");
+    return -1;
+  }
+  const char **names = calloc(n, sizeof(*names));
+  struct fpc_parameters *params = calloc(n, sizeof(*params));
+  for(i = 0; i < n; i++) {
+    char **arg = argv + 4 * i;
+    if(!gen_valid_name(arg[0])) {
+      fprintf(stderr, "ERROR: %s: not a C identifier\n", arg[0]);
+      return -1;
+    }
+    if(gen_reserved_name(arg[0])) {
+      fprintf(stderr, "ERROR: %s: %s_t is a standard type\n", arg[0], arg[0]);
+      return -1;
+    }
+    for(j = 0; j < i; j++) {
+      if(strcmp(arg[0], names[j]) == 0) {
+        fprintf(stderr, "ERROR: %s: duplicate format\n", arg[0]);
+        return -1;
+      }
+    }
+    names[i] = arg[0];
+    if(!fpc_calculate_from_strings(arg[1], arg[2], arg[3], &params[i])) {
+      fprintf(stderr, "ERROR: %s: %s\n", arg[0], params[i].error);
+      return -1;
+    }
+  }
+  gen_arith(names, params, n, stdout);
+  if(check) {
+    struct format *formats = calloc(n, sizeof(*formats));
+    for(i = 0; i < n; i++) {
+      formats[i].name = names[i];
+      formats[i].param = params[i];
+    }
+    gen_arith_check(formats, n, stdout);
+    free(formats);
+  }
+  free(names);
+  free(params);
+  return 0;
+}
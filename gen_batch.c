@@ -0,0 +1,289 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <math.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "gen.h"
+
+/* The kernels are written as plain loops with no libm calls or
+   data-dependent branches so the compiler can vectorize them.  Each
+   kernel is inlined into an SSE2 and an AVX2 copy and the AVX2 one is
+   picked at runtime if the CPU supports it.  GCC will only if-convert
+   the floating point selects with -fno-trapping-math, so that is set
+   for this section of the output along with -O3. */
+
+/* codes up to this magnitude can be rounded by adding and subtracting 1.5 * 2^52 */
+#define MAGIC_ROUND_LIMIT (((int128_t)1) << 51)
+
+double gen_inward(long double x, double direction) {
+  double d = x;
+  if(d != x && (d > x) == (direction < 0)) d = nextafter(d, direction);
+  return d;
+}
+
+void gen_dispatch(const char *name, const char *kernel, const char *target,
+                  const char *args, const char *call, bool local, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  printf("#ifdef CONVERT_N_X86\n"
+         "__attribute__((target(\"%s\")))\n"
+         "static size_t %s_avx2(%s) {\n"
+         "  return %s(%s);\n"
+         "}\n\n", target, name, args, kernel, call);
+  printf("__attribute__((target(\"sse2\")))\n"
+         "static size_t %s_sse2(%s) {\n"
+         "  return %s(%s);\n"
+         "}\n"
+         "#endif\n\n", name, args, kernel, call);
+  printf("%ssize_t %s(%s) {\n"
+         "#ifdef CONVERT_N_X86\n"
+         "  if(__builtin_cpu_supports(\"avx2\")%s) {\n"
+         "    return %s_avx2(%s);\n"
+         "  }\n"
+         "  return %s_sse2(%s);\n"
+         "#else\n"
+         "  return %s(%s);\n"
+         "#endif\n"
+         "}\n", local ? "static " : "", name, args, strstr(target, "fma") ? " && __builtin_cpu_supports(\"fma\")" : "",
+         name, call, name, call, kernel, call);
+#undef printf
+}
+
+static
+void convert_to_double_n(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  int128_t
+    lb = param->lower_bound - param->offset,
+    ub = param->upper_bound - param->offset,
+    min_int = 0, max_int = -1; // 128 bit codes are always checked
+  if(w < 128) {
+    min_int = param->use_signed ? -(((int128_t)1) << (w - 1)) : 0;
+    max_int = (((int128_t)1) << (w - (param->use_signed ? 1 : 0))) - 1;
+  }
+  bool check = lb != min_int || ub != max_int;
+
+  printf("static inline __attribute__((always_inline))\n"
+         "size_t convert_to_double_n_kernel(const %s%d_t *restrict x, double *restrict y, size_t n) {\n",
+         s, w);
+  printf("  size_t i, errors = 0;\n"
+         "  for(i = 0; i < n; i++) {\n"
+         "    %s%d_t c = x[i];\n", s, w);
+  if(check) {
+    printf("    bool bad = ");
+    if(lb != min_int) {
+      printf("(c < ");
+      gen_code_const(param, lb, f);
+      printf(")");
+    }
+    if(lb != min_int && ub != max_int) printf(" | ");
+    if(ub != max_int) {
+      printf("(c > ");
+      gen_code_const(param, ub, f);
+      printf(")");
+    }
+    printf(";\n"
+           "    errors += bad;\n"
+           "    y[i] = bad ? NAN : ");
+  } else {
+    printf("    y[i] = ");
+  }
+  printf("c * 0x1p%d", -param->fractional_bits);
+  if(param->offset) {
+    printf(" + %.17g", (double)ldexpl(param->offset, -param->fractional_bits));
+  }
+  printf(";\n"
+         "  }\n"
+         "  return errors;\n"
+         "}\n\n");
+
+  char args[64];
+  snprintf(args, sizeof(args), "const %s%d_t *x, double *y, size_t n", s, w);
+  gen_dispatch("convert_to_double_n", "convert_to_double_n_kernel", "avx2", args, "x, y, n", false, f);
+#undef printf
+}
+
+static
+void convert_from_double_n(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  bool magic =
+    param->lower_bound > -MAGIC_ROUND_LIMIT && param->lower_bound < MAGIC_ROUND_LIMIT &&
+    param->upper_bound > -MAGIC_ROUND_LIMIT && param->upper_bound < MAGIC_ROUND_LIMIT;
+
+  printf("static inline __attribute__((always_inline))\n"
+         "size_t convert_from_double_n_kernel(const double *restrict x, %s%d_t *restrict y, size_t n,\n"
+         "                                    uint8_t *restrict err, bool mask) {\n",
+         s, w);
+  printf("  size_t i, errors = 0;\n"
+         "  for(i = 0; i < n; i++) {\n"
+         "    double v = x[i];\n");
+  double lo = gen_inward(param->lower_bound, INFINITY), hi = gen_inward(param->upper_bound, -INFINITY);
+  printf("    bool bad = !((v >= %.17g) & (v <= %.17g));\n",
+         (double)param->min, (double)param->max);
+  printf("    double c = v * 0x1p%d;\n", param->fractional_bits);
+  printf("    c = c >= %.17g ? c : %.17g;\n", lo, lo);
+  printf("    c = c <= %.17g ? c : %.17g;\n", hi, hi);
+  if(magic) {
+    printf("    c = (c + 0x1.8p52) - 0x1.8p52;\n");
+  } else {
+    printf("    c = rint(c);\n");
+  }
+  if(param->offset) {
+    printf("    c -= %.17g;\n", (double)param->offset);
+  }
+  if(w <= 16 || (w == 32 && param->use_signed)) {
+    printf("    y[i] = (%s%d_t)(int32_t)c;\n", s, w);
+  } else {
+    printf("    y[i] = (%s%d_t)c;\n", s, w);
+  }
+  printf("    errors += bad;\n"
+         "    if(mask) err[i] = bad;\n"
+         "  }\n"
+         "  return errors;\n"
+         "}\n\n");
+
+  printf("static inline __attribute__((always_inline))\n"
+         "size_t convert_from_double_n_masked(const double *x, %s%d_t *y, size_t n, uint8_t *err) {\n"
+         "  if(err) {\n"
+         "    return convert_from_double_n_kernel(x, y, n, err, true);\n"
+         "  }\n"
+         "  return convert_from_double_n_kernel(x, y, n, NULL, false);\n"
+         "}\n\n", s, w);
+
+  /* dispatch through the masked wrapper so each target gets both loops */
+  char args[80];
+  snprintf(args, sizeof(args), "const double *x, %s%d_t *y, size_t n, uint8_t *err", s, w);
+  gen_dispatch("convert_from_double_n", "convert_from_double_n_masked", "avx2", args, "x, y, n, err", false, f);
+#undef printf
+}
+
+void gen_batch_begin(FILE *f) {
+  fprintf(f,
+          "/* Array conversions.  These are exact: unlike convert_to_double()\n"
+          "   results are not rounded to the requested precision.\n"
+          "   convert_to_double_n() writes NAN for codes out of range.\n"
+          "   convert_from_double_n() saturates values out of [min, max] (and NAN)\n"
+          "   to the code range, rounds ties to even and, if err is not NULL,\n"
+          "   sets err[i] for each value that was out of range.\n"
+          "   Both return the number of out of range values. */\n"
+          "#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))\n"
+          "#define CONVERT_N_X86\n"
+          "#endif\n"
+          "#if defined(__GNUC__) && !defined(__clang__)\n"
+          "#pragma GCC push_options\n"
+          "#pragma GCC optimize(\"O3\", \"no-trapping-math\")\n"
+          "#endif\n\n");
+}
+
+void gen_batch_end(FILE *f) {
+  fprintf(f,
+          "\n"
+          "#if defined(__GNUC__) && !defined(__clang__)\n"
+          "#pragma GCC pop_options\n"
+          "#endif\n");
+}
+
+void gen_batch(struct fpc_parameters *param, FILE *f) {
+  gen_batch_begin(f);
+  convert_to_double_n(param, f);
+  fprintf(f, "\n");
+  convert_from_double_n(param, f);
+  gen_batch_end(f);
+}
+
+void gen_batch_bench(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  long long int
+    lb = param->lower_bound - param->offset,
+    ub = param->upper_bound - param->offset;
+  unsigned long long int span = (unsigned long long int)ub - lb;
+
+  printf("static double now(void) {\n"
+         "  struct timespec ts;\n"
+         "  clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+         "  return ts.tv_sec + ts.tv_nsec * 1e-9;\n"
+         "}\n\n");
+  printf("#define BENCH_N 4096\n"
+         "#define BENCH_REPS 4096\n\n"
+         "/* time the converters, as CSV rows for case label if it isn't NULL */\n"
+         "static void bench(const char *label) {\n"
+         "  static %s%d_t codes[BENCH_N], out[BENCH_N];\n"
+         "  static double values[BENCH_N];\n"
+         "  static uint8_t err[BENCH_N];\n"
+         "  double t, sum = 0;\n"
+         "  size_t i, r;\n", s, w);
+  if(w == 128) {
+    // spread over at most the first 2^62 codes
+    int128_t wide = param->upper_bound - param->lower_bound;
+    printf("  for(i = 0; i < BENCH_N; i++) {\n"
+           "    codes[i] = (%s%d_t)(", s, w);
+    gen_arith_const(f, param->lower_bound);
+    printf(" + (__int128)(i * 2654435761u %% %lluULL));\n"
+           "  }\n",
+           (unsigned long long int)(wide < ((int128_t)1 << 62) ? wide : (int128_t)1 << 62));
+  } else {
+    printf("  for(i = 0; i < BENCH_N; i++) {\n"
+           "    codes[i] = (%s%d_t)(%lldULL + i * 2654435761u %% %lluULL);\n"
+           "  }\n",
+           s, w, lb, span ? span : 1);
+  }
+
+  printf("\n"
+         "  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS; r++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) values[i] = convert_to_double(codes[i]);\n"
+         "    sum += values[r %% BENCH_N];\n"
+         "  }\n"
+         "  double scalar_to = (now() - t) / ((double)BENCH_N * BENCH_REPS);\n"
+         "  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS; r++) {\n"
+         "    convert_to_double_n(codes, values, BENCH_N);\n"
+         "    sum += values[r %% BENCH_N];\n"
+         "  }\n"
+         "  double batch_to = (now() - t) / ((double)BENCH_N * BENCH_REPS);\n");
+  printf("\n"
+         "  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS; r++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) err[i] = !convert_from_double(values[i], &out[i]);\n"
+         "    sum += out[r %% BENCH_N] + err[r %% BENCH_N];\n"
+         "  }\n"
+         "  double scalar_from = (now() - t) / ((double)BENCH_N * BENCH_REPS);\n"
+         "  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS; r++) {\n"
+         "    convert_from_double_n(values, out, BENCH_N, err);\n"
+         "    sum += out[r %% BENCH_N] + err[r %% BENCH_N];\n"
+         "  }\n"
+         "  double batch_from = (now() - t) / ((double)BENCH_N * BENCH_REPS);\n");
+  printf("\n"
+         "  if(label) {\n"
+         "    printf(\"convert_to_double,%%s,%%.3f,%%.3f\\n\", label, scalar_to * 1e9, 1e-6 / scalar_to);\n"
+         "    printf(\"convert_to_double_n,%%s,%%.3f,%%.3f\\n\", label, batch_to * 1e9, 1e-6 / batch_to);\n"
+         "    printf(\"convert_from_double,%%s,%%.3f,%%.3f\\n\", label, scalar_from * 1e9, 1e-6 / scalar_from);\n"
+         "    printf(\"convert_from_double_n,%%s,%%.3f,%%.3f\\n\", label, batch_from * 1e9, 1e-6 / batch_from);\n"
+         "  } else {\n"
+         "    printf(\"convert_to_double:   scalar %%.2f ns, batch %%.2f ns (%%.1fx)\\n\",\n"
+         "           scalar_to * 1e9, batch_to * 1e9, scalar_to / batch_to);\n"
+         "    printf(\"convert_from_double: scalar %%.2f ns, batch %%.2f ns (%%.1fx)\\n\",\n"
+         "           scalar_from * 1e9, batch_from * 1e9, scalar_from / batch_from);\n"
+         "  }\n"
+         "  if(sum == 42) printf(\"\\n\"); // keep the results live\n"
+         "}\n");
+#undef printf
+}
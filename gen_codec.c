@@ -0,0 +1,562 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "gen.h"
+#include "modes.h"
+
+/* A block codec for slowly changing streams of codes.
+
+   Codes are clamped to the format's code range [lo, hi] and stored as
+   u = code - lo, which needs the r bits of hi - lo rather than the
+   machine width.  Each block of up to B values is one header byte, a
+   base of ceil(r / 8) bytes and b bit fields packed little endian as
+   in --packed, in whichever of two modes is smaller:
+   - frame of reference: base = min u, the fields are u - base
+   - delta: base = the first u, the fields are the n - 1 zigzagged
+     differences (d << 1) ^ (d >> 63)
+   The header byte is the mode in bit 7 and b below it.
+
+   Decoding switches on b once per block to an unpacker where b is a
+   constant, so 8 fields (b bytes) take constant offsets and shifts and
+   the add or zigzag loops are left for the compiler to vectorize.  The
+   offsets of the blocks give random access, a block at a time. */
+
+struct codec {
+  const char *name;
+  struct fpc_parameters p;
+  int block; /* B */
+  int128_t lo, hi; /* the codes */
+  bool in_low, in_high; /* whether the type has codes below or above them */
+  int bits; /* r */
+  int base_bytes;
+  int max_field; /* the widest b, r + 1 for deltas of short blocks */
+};
+
+static
+int128_t type_min(struct fpc_parameters *p) {
+  return p->use_signed ? -((int128_t)1 << (p->fixed_encoding_width - 1)) : 0;
+}
+
+static
+int128_t type_max(struct fpc_parameters *p) {
+  return ((int128_t)1 << (p->fixed_encoding_width - p->use_signed)) - 1;
+}
+
+static
+int field_bits(uint64_t x) {
+  return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+static
+void plan(struct codec *c) {
+  c->lo = c->p.lower_bound - c->p.offset;
+  c->hi = c->p.upper_bound - c->p.offset;
+  c->in_low = c->lo > type_min(&c->p);
+  c->in_high = c->hi < type_max(&c->p);
+  c->bits = field_bits((uint64_t)(c->hi - c->lo));
+  c->base_bytes = c->bits > 8 ? (c->bits + 7) / 8 : 1;
+  c->max_field = c->bits + 1;
+}
+
+/* the bytes of a block of n values u, as the generated encoder picks */
+static
+size_t block_bytes(struct codec *c, const uint64_t *u, size_t n, bool *delta) {
+  uint64_t lo = UINT64_MAX, hi = 0, z = 0;
+  size_t i;
+  for(i = 0; i < n; i++) {
+    lo = u[i] < lo ? u[i] : lo;
+    hi = u[i] > hi ? u[i] : hi;
+  }
+  for(i = 1; i < n; i++) {
+    int64_t d = (int64_t)(u[i] - u[i - 1]);
+    z |= (uint64_t)d << 1 ^ (uint64_t)(d >> 63);
+  }
+  size_t fr = (n * field_bits(hi - lo) + 7) / 8, dl = ((n - 1) * field_bits(z) + 7) / 8;
+  *delta = dl < fr;
+  return 1 + c->base_bytes + (*delta ? dl : fr);
+}
+
+/* " + UINT64_C(x)" or " - UINT64_C(-x)", or nothing for 0 */
+static
+const char *add_const(int128_t x, char *buf) {
+  if(!x) return "";
+  snprintf(buf, 48, " %c UINT64_C(%llu)", x < 0 ? '-' : '+', (unsigned long long int)(x < 0 ? -x : x));
+  return buf;
+}
+
+static
+void print_format(FILE *f, struct codec *c) {
+  struct fpc_parameters *p = &c->p;
+  fprintf(f, "/* %s: [%.19Lg, %.19Lg] in steps of 2^%d", c->name,
+          ldexpl(p->lower_bound, -p->fractional_bits),
+          ldexpl(p->upper_bound, -p->fractional_bits), -p->fractional_bits);
+  if(p->offset) {
+    char buf[41];
+    fprintf(f, " with offset %s", int128_str(p->offset, buf));
+  }
+  fprintf(f, " */\n"
+          "typedef %s%d_t %s_t;\n\n", p->use_signed ? "int" : "uint", p->fixed_encoding_width, c->name);
+}
+
+static
+void gen_codec(struct codec *c, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const char *s = c->name;
+  char S[128], name[160], kernel[160], args[160];
+  int i, b;
+  bool wide = c->max_field + 7 > 64;
+  char add_lo[48], sub_lo[48];
+  add_const(c->lo, add_lo);
+  add_const(-c->lo, sub_lo);
+
+  for(i = 0; s[i] && i < (int)sizeof(S) - 1; i++) S[i] = toupper((unsigned char)s[i]);
+  S[i] = 0;
+  printf("/* generated by fpc --codec */\n"
+         "#ifndef FPC_CODEC_%s_H\n"
+         "#define FPC_CODEC_%s_H\n\n"
+         "#include <stdbool.h>\n"
+         "#include <stddef.h>\n"
+         "#include <stdint.h>\n"
+         "#include <string.h>\n\n", S, S);
+  print_format(f, c);
+
+  printf("/* Blocks of up to %s_BLOCK codes: a byte of mode (bit 7, set for\n"
+         "   deltas) and field width, a %d byte base and the fields.  Codes are\n"
+         "   stored as their distance from %lld in %d bits, or as zigzagged\n"
+         "   differences.  Decoding reads up to 16 bytes past a block, so\n"
+         "   buffers need %s_codec_bound(n) bytes. */\n"
+         "#define %s_BLOCK %d\n\n", S, c->base_bytes, (long long int)c->lo, c->bits, s, S, c->block);
+  printf("static inline size_t %s_codec_bound(size_t n) {\n"
+         "  return (n + %s_BLOCK - 1) / %s_BLOCK * %d + (n * %d + 7) / 8 + 16;\n"
+         "}\n\n", s, S, S, 2 + c->base_bytes, c->bits);
+
+  printf("static inline uint64_t %s_load(const uint8_t *p) {\n"
+         "  uint64_t v;\n"
+         "  memcpy(&v, p, sizeof(v));\n"
+         "  return v;\n"
+         "}\n\n", s);
+  if(wide) {
+    printf("static inline unsigned __int128 %s_load128(const uint8_t *p) {\n"
+           "  unsigned __int128 v;\n"
+           "  memcpy(&v, p, sizeof(v));\n"
+           "  return v;\n"
+           "}\n\n", s);
+  }
+  printf("/* the b bit field at bit of p */\n"
+         "static inline __attribute__((always_inline))\n"
+         "uint64_t %s_field(const uint8_t *p, size_t bit, int b) {\n"
+         "  uint64_t mask = ((uint64_t)1 << b) - 1;\n", s);
+  if(wide) {
+    printf("  if(b + 7 > 64) return (uint64_t)(%s_load128(p + bit / 8) >> (bit %% 8)) & mask;\n", s);
+  }
+  printf("  return %s_load(p + bit / 8) >> (bit %% 8) & mask;\n"
+         "}\n\n", s);
+  printf("static inline uint64_t %s_base(const uint8_t *p) {\n"
+         "  return %s_load(p + 1)", s, s);
+  if(c->base_bytes < 8) printf(" & UINT64_C(0x%llx)", (1ULL << (8 * c->base_bytes)) - 1);
+  printf(";\n"
+         "}\n\n");
+
+  // encoding
+  printf("/* write the n b bit fields of v from p, returns the end */\n"
+         "static inline uint8_t *%s_put(uint8_t *p, const uint64_t *v, size_t n, int b) {\n"
+         "  %s acc = 0;\n"
+         "  int fill = 0;\n"
+         "  size_t i;\n"
+         "  for(i = 0; i < n; i++) {\n"
+         "    acc |= (%s)v[i] << fill;\n"
+         "    for(fill += b; fill >= 8; fill -= 8, acc >>= 8) *p++ = (uint8_t)acc;\n"
+         "  }\n"
+         "  if(fill) *p++ = (uint8_t)acc;\n"
+         "  return p;\n"
+         "}\n\n", s, wide ? "unsigned __int128" : "uint64_t", wide ? "unsigned __int128" : "uint64_t");
+  printf("static inline int %s_bits(uint64_t x) {\n"
+         "  return x ? 64 - __builtin_clzll(x) : 0;\n"
+         "}\n\n", s);
+  printf("/* encode n codes to buf, clamping any outside [%lld, %lld], returns the\n"
+         "   bytes written; if index isn't NULL it gets the offset of each of the\n"
+         "   (n + %s_BLOCK - 1) / %s_BLOCK blocks */\n"
+         "static inline size_t %s_encode(const %s_t *x, size_t n, uint8_t *buf, size_t *index) {\n"
+         "  uint64_t u[%s_BLOCK], z[%s_BLOCK];\n"
+         "  uint8_t *p = buf;\n"
+         "  size_t i, j;\n"
+         "  for(i = 0; i < n; i += %s_BLOCK) {\n"
+         "    size_t count = n - i < %s_BLOCK ? n - i : %s_BLOCK;\n"
+         "    uint64_t lo = UINT64_MAX, hi = 0, zz = 0;\n"
+         "    for(j = 0; j < count; j++) {\n"
+         "      %s_t c = x[i + j];\n",
+         (long long int)c->lo, (long long int)c->hi, S, S, s, s, S, S, S, S, S, s);
+  if(c->in_low) {
+    printf("      c = c < ");
+    gen_arith_const(f, c->lo);
+    printf(" ? ");
+    gen_arith_const(f, c->lo);
+    printf(" : c;\n");
+  }
+  if(c->in_high) {
+    printf("      c = c > ");
+    gen_arith_const(f, c->hi);
+    printf(" ? ");
+    gen_arith_const(f, c->hi);
+    printf(" : c;\n");
+  }
+  printf("      u[j] = (uint64_t)c%s;\n"
+         "      lo = u[j] < lo ? u[j] : lo;\n"
+         "      hi = u[j] > hi ? u[j] : hi;\n"
+         "    }\n"
+         "    for(j = 1; j < count; j++) {\n"
+         "      int64_t d = (int64_t)(u[j] - u[j - 1]);\n"
+         "      z[j - 1] = (uint64_t)d << 1 ^ (uint64_t)(d >> 63);\n"
+         "      zz |= z[j - 1];\n"
+         "    }\n"
+         "    int fb = %s_bits(hi - lo), db = %s_bits(zz);\n"
+         "    bool delta = ((count - 1) * db + 7) / 8 < (count * fb + 7) / 8;\n"
+         "    uint64_t base = delta ? u[0] : lo;\n"
+         "    if(index) index[i / %s_BLOCK] = (size_t)(p - buf);\n"
+         "    *p++ = (uint8_t)(delta << 7 | (delta ? db : fb));\n"
+         "    for(j = 0; j < %d; j++) *p++ = (uint8_t)(base >> 8 * j);\n"
+         "    if(delta) {\n"
+         "      p = %s_put(p, z, count - 1, db);\n"
+         "    } else {\n"
+         "      for(j = 0; j < count; j++) u[j] -= lo;\n"
+         "      p = %s_put(p, u, count, fb);\n"
+         "    }\n"
+         "  }\n"
+         "  return (size_t)(p - buf);\n"
+         "}\n\n", sub_lo, s, s, S, c->base_bytes, s, s);
+
+  // decoding
+  printf("#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))\n"
+         "#define CONVERT_N_X86\n"
+         "#endif\n"
+         "#if defined(__GNUC__) && !defined(__clang__)\n"
+         "#pragma GCC push_options\n"
+         "#pragma GCC optimize(\"O3\")\n"
+         "#endif\n\n");
+  printf("/* the n b bit fields from p, 8 (b bytes) at a time */\n"
+         "static inline __attribute__((always_inline))\n"
+         "void %s_unpack(const uint8_t *p, uint64_t *v, size_t n, const int b) {\n"
+         "  size_t i, j;\n"
+         "  for(i = 0; i + 8 <= n; i += 8, p += b) {\n"
+         "    for(j = 0; j < 8; j++) v[i + j] = %s_field(p, j * b, b);\n"
+         "  }\n"
+         "  for(j = 0; i < n; i++, j++) v[i] = %s_field(p, j * b, b);\n"
+         "}\n\n", s, s, s);
+  printf("/* decode the block at p of count codes, returns its size in bytes */\n"
+         "static inline __attribute__((always_inline))\n"
+         "size_t %s_decode_block(const uint8_t *p, %s_t *restrict out, size_t count) {\n"
+         "  uint64_t v[%s_BLOCK], base = %s_base(p)%s;\n"
+         "  bool delta = p[0] >> 7;\n"
+         "  int b = p[0] & 127;\n"
+         "  size_t i, n = count - delta;\n"
+         "  switch(b) {\n", s, s, S, s, add_lo);
+  for(b = 0; b <= c->max_field; b++) {
+    printf("  case %d: %s_unpack(p + %d, v, n, %d); break;\n", b, s, 1 + c->base_bytes, b);
+  }
+  printf("  }\n"
+         "  if(delta) {\n"
+         "    for(i = 0; i < n; i++) v[i] = (v[i] >> 1) ^ -(v[i] & 1);\n"
+         "    out[0] = (%s_t)base;\n"
+         "    for(i = 0; i < n; i++) {\n"
+         "      base += v[i];\n"
+         "      out[i + 1] = (%s_t)base;\n"
+         "    }\n"
+         "  } else {\n"
+         "    for(i = 0; i < n; i++) out[i] = (%s_t)(v[i] + base);\n"
+         "  }\n"
+         "  return %d + (n * b + 7) / 8;\n"
+         "}\n\n", s, s, s, 1 + c->base_bytes);
+  printf("static inline __attribute__((always_inline))\n"
+         "size_t %s_decode_kernel(const uint8_t *buf, size_t n, %s_t *out) {\n"
+         "  const uint8_t *p = buf;\n"
+         "  size_t i;\n"
+         "  for(i = 0; i < n; i += %s_BLOCK) {\n"
+         "    p += %s_decode_block(p, out + i, n - i < %s_BLOCK ? n - i : %s_BLOCK);\n"
+         "  }\n"
+         "  return (size_t)(p - buf);\n"
+         "}\n\n"
+         "/* decode n codes from buf, returns the bytes read */\n", s, s, S, s, S, S);
+  snprintf(kernel, sizeof(kernel), "%s_decode_kernel", s);
+  snprintf(args, sizeof(args), "const uint8_t *buf, size_t n, %s_t *out", s);
+  snprintf(name, sizeof(name), "%s_decode", s);
+  gen_dispatch(name, kernel, "avx2", args, "buf, n, out", true, f);
+  printf("\n"
+         "#if defined(__GNUC__) && !defined(__clang__)\n"
+         "#pragma GCC pop_options\n"
+         "#endif\n\n");
+
+  printf("/* code i of buf, given the block offsets from %s_encode() */\n"
+         "static inline %s_t %s_get(const uint8_t *buf, const size_t *index, size_t i) {\n"
+         "  const uint8_t *p = buf + index[i / %s_BLOCK];\n"
+         "  uint64_t base = %s_base(p)%s;\n"
+         "  size_t j = i %% %s_BLOCK, k;\n"
+         "  int b = p[0] & 127;\n"
+         "  p += %d;\n"
+         "  if(!(p[-%d] >> 7)) return (%s_t)(base + %s_field(p, j * b, b));\n"
+         "  for(k = 0; k < j; k++) {\n"
+         "    uint64_t z = %s_field(p, k * b, b);\n"
+         "    base += (z >> 1) ^ -(z & 1);\n"
+         "  }\n"
+         "  return (%s_t)base;\n"
+         "}\n\n"
+         "#endif\n", s, s, s, S, s, add_lo, S, 1 + c->base_bytes, 1 + c->base_bytes, s, s, s, s);
+#undef printf
+}
+
+/* a program round tripping smooth, random and edge streams through the
+   codec, whole and at random, with -b timing decoding */
+static
+void gen_codec_check(struct codec *c, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const char *s = c->name;
+  uint64_t range = (uint64_t)(c->hi - c->lo);
+  char S[128], buf[48];
+  int i;
+
+  for(i = 0; s[i] && i < (int)sizeof(S) - 1; i++) S[i] = toupper((unsigned char)s[i]);
+  S[i] = 0;
+
+  printf("\n"
+         "#include <stdio.h>\n"
+         "#include <stdlib.h>\n"
+         "#include <string.h>\n"
+         "#include <time.h>\n\n"
+         "#define CODEC_N 100003\n\n");
+  printf("static uint64_t codec_state = UINT64_C(88172645463325252);\n\n"
+         "static uint64_t codec_random(void) {\n"
+         "  codec_state ^= codec_state << 13;\n"
+         "  codec_state ^= codec_state >> 7;\n"
+         "  codec_state ^= codec_state << 17;\n"
+         "  return codec_state;\n"
+         "}\n\n");
+  printf("static double codec_now(void) {\n"
+         "  struct timespec ts;\n"
+         "  clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+         "  return ts.tv_sec + ts.tv_nsec * 1e-9;\n"
+         "}\n\n");
+  printf("/* u in [0, %llu] as a code */\n"
+         "static %s_t codec_code(uint64_t u) {\n"
+         "  return (%s_t)(u%s);\n"
+         "}\n\n", (unsigned long long int)range, s, s, add_const(c->lo, buf));
+  printf("/* x clamped to the codes */\n"
+         "static %s_t codec_clamp(%s_t x) {\n"
+         "  return x < ", s, s);
+  gen_arith_const(f, c->lo);
+  printf(" ? ");
+  gen_arith_const(f, c->lo);
+  printf(" : x > ");
+  gen_arith_const(f, c->hi);
+  printf(" ? ");
+  gen_arith_const(f, c->hi);
+  printf(" : x;\n"
+         "}\n\n");
+
+  printf("static int codec_test(const char *name, const %s_t *in, %s_t *out, uint8_t *buf, size_t *index,\n"
+         "                      bool bench) {\n"
+         "  size_t i, bad = 0, bytes = %s_encode(in, CODEC_N, buf, index);\n"
+         "  if(bytes + 16 > %s_codec_bound(CODEC_N)) bad++;\n"
+         "  memset(out, 0, CODEC_N * sizeof(out[0]));\n"
+         "  if(%s_decode(buf, CODEC_N, out) != bytes) bad++;\n"
+         "  for(i = 0; i < CODEC_N; i++) {\n"
+         "    if(out[i] != codec_clamp(in[i])) {\n"
+         "      if(bad++ < 10) {\n"
+         "        printf(\"%%zu: %%lld, expected %%lld\\n\", i, (long long int)out[i],\n"
+         "               (long long int)codec_clamp(in[i]));\n"
+         "      }\n"
+         "    }\n"
+         "  }\n"
+         "  for(i = 0; i < 10000; i++) {\n"
+         "    size_t k = codec_random() %% CODEC_N;\n"
+         "    if(%s_get(buf, index, k) != codec_clamp(in[k])) bad++;\n"
+         "  }\n"
+         "  printf(\"%%s: %%d codes in %%zu bytes, %%.2f bits each: %%s\\n\", name, CODEC_N, bytes,\n"
+         "         8.0 * bytes / CODEC_N, bad ? \"FAIL\" : \"ok\");\n",
+         s, s, s, s, s, s);
+  printf("  if(bench) {\n"
+         "    int reps = 200, r;\n"
+         "    size_t sum = 0;\n"
+         "    double t = codec_now();\n"
+         "    for(r = 0; r < reps; r++) sum += %s_decode(buf, CODEC_N, out) + (size_t)out[r];\n"
+         "    double decode = (codec_now() - t) / ((double)reps * CODEC_N);\n"
+         "    t = codec_now();\n"
+         "    for(r = 0; r < reps; r++) sum += %s_encode(in, CODEC_N, buf, index);\n"
+         "    double encode = (codec_now() - t) / ((double)reps * CODEC_N);\n"
+         "    t = codec_now();\n"
+         "    for(r = 0; r < reps; r++) {\n"
+         "      for(i = 0; i < 1000; i++) sum += (size_t)%s_get(buf, index, codec_random() %% CODEC_N);\n"
+         "    }\n"
+         "    double get = (codec_now() - t) / ((double)reps * 1000);\n"
+         "    printf(\"  decode %%.3f ns, encode %%.3f ns per value, get %%.1f ns\\n\",\n"
+         "           decode * 1e9, encode * 1e9, get * 1e9);\n"
+         "    if(sum == 42) printf(\"\\n\"); // keep the results live\n"
+         "  }\n"
+         "  return bad != 0;\n"
+         "}\n\n", s, s, s);
+
+  printf("int main(int argc, char **argv) {\n"
+         "  %s_t *in = malloc(CODEC_N * sizeof(%s_t)), *out = malloc(CODEC_N * sizeof(%s_t));\n"
+         "  uint8_t *buf = malloc(%s_codec_bound(CODEC_N));\n"
+         "  size_t *index = malloc((CODEC_N + %s_BLOCK - 1) / %s_BLOCK * sizeof(size_t));\n"
+         "  bool bench = argc > 1 && strcmp(argv[1], \"-b\") == 0;\n"
+         "  uint64_t u = UINT64_C(%llu), step = UINT64_C(%llu);\n"
+         "  size_t i;\n"
+         "  int failed = 0;\n",
+         s, s, s, s, S, S, (unsigned long long int)(range / 2),
+         (unsigned long long int)(range / 1000 > 0 ? range / 1000 : 1));
+  printf("  // a random walk in small steps, bouncing off the ends\n"
+         "  for(i = 0; i < CODEC_N; i++) {\n"
+         "    uint64_t d = codec_random() %% (2 * step + 1);\n"
+         "    if(d >= step) {\n"
+         "      u = UINT64_C(%llu) - u < d - step ? u - (d - step) : u + (d - step);\n"
+         "    } else {\n"
+         "      u = u < step - d ? u + (step - d) : u - (step - d);\n"
+         "    }\n"
+         "    in[i] = codec_code(u);\n"
+         "  }\n", (unsigned long long int)range);
+  printf("  failed |= codec_test(\"smooth\", in, out, buf, index, bench);\n"
+         "  for(i = 0; i < CODEC_N; i++) in[i] = codec_code(codec_random() %% UINT64_C(%llu));\n"
+         "  failed |= codec_test(\"random\", in, out, buf, index, bench);\n"
+         "  for(i = 0; i < CODEC_N; i++) in[i] = codec_code(i / 1000 %% 2 ? UINT64_C(%llu) : 0);\n"
+         "  failed |= codec_test(\"steps\", in, out, buf, index, false);\n"
+         "  for(i = 0; i < CODEC_N; i++) in[i] = codec_code(i %% 2 ? UINT64_C(%llu) : 0);\n"
+         "  failed |= codec_test(\"edges\", in, out, buf, index, false);\n",
+         (unsigned long long int)(range + 1), (unsigned long long int)range, (unsigned long long int)range);
+  if(c->in_low || c->in_high) {
+    printf("  for(i = 0; i < CODEC_N; i++) in[i] = (%s_t)codec_random();\n"
+           "  failed |= codec_test(\"clamped\", in, out, buf, index, false);\n", s);
+  }
+  printf("  free(in);\n"
+         "  free(out);\n"
+         "  free(buf);\n"
+         "  free(index);\n"
+         "  return failed;\n"
+         "}\n");
+#undef printf
+}
+
+/* values from a sample file (or -), one per line, as codes to a
+   [CODEC] section comparing the codec to whole and packed codes */
+static
+int codec_report(struct codec *c, const char *path) {
+  FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  char line[256];
+  uint64_t *u = malloc(c->block * sizeof(uint64_t));
+  size_t values = 0, skipped = 0, clamped = 0, bytes = 0, deltas = 0, blocks = 0, n = 0;
+  if(!in || !u) {
+    fprintf(stderr, "ERROR: %s: cannot read\n", path);
+    free(u);
+    return -1;
+  }
+  for(;;) {
+    bool more = fgets(line, sizeof(line), in) != NULL;
+    if(more) {
+      char *p = line, *end;
+      while(isspace((unsigned char)*p)) p++;
+      if(!*p || *p == '#') continue;
+      long double v = strtold(p, &end);
+      while(isspace((unsigned char)*end)) end++;
+      if(end == p || *end || isnan(v)) {
+        skipped++;
+        continue;
+      }
+      v = roundl(ldexpl(v, c->p.fractional_bits));
+      int128_t code = v < ldexpl(1, 126) && v > -ldexpl(1, 126) ? (int128_t)v - c->p.offset : v < 0 ? c->lo - 1 : c->hi + 1;
+      clamped += code < c->lo || code > c->hi;
+      code = code < c->lo ? c->lo : code > c->hi ? c->hi : code;
+      u[n++] = (uint64_t)(code - c->lo);
+      values++;
+    }
+    if(n == (size_t)c->block || (!more && n)) {
+      bool delta;
+      bytes += block_bytes(c, u, n, &delta);
+      deltas += delta;
+      blocks++;
+      n = 0;
+    }
+    if(!more) break;
+  }
+  if(in != stdin) fclose(in);
+  free(u);
+
+  size_t raw = values * (c->p.fixed_encoding_width / 8);
+  size_t packed = (values * (c->p.integer_bits + c->p.fractional_bits) + 7) / 8;
+  printf("[CODEC]\n");
+  printf("  values: %zu (%zu clamped, %zu skipped)\n", values, clamped, skipped);
+  printf("  blocks: %zu of %d, %zu delta, %zu frame of reference\n", blocks, c->block, deltas, blocks - deltas);
+  printf("  raw: %zu bytes (%d bits per value)\n", raw, c->p.fixed_encoding_width);
+  printf("  packed: %zu bytes (%d bits per value)\n", packed, c->p.integer_bits + c->p.fractional_bits);
+  printf("  codec: %zu bytes (%.2f bits per value)\n", bytes, values ? 8.0 * bytes / values : 0.0);
+  printf("  ratio: %.2f (%.2f to packed)\n", bytes ? (double)raw / bytes : 0.0, bytes ? (double)packed / bytes : 0.0);
+  return 0;
+}
+
+int codec_main(int argc, char **argv) {
+  struct codec c;
+  bool check = false;
+  const char *sample = NULL;
+
+  memset(&c, 0, sizeof(c));
+  c.block = 128;
+  for(; argc > 0 && strncmp(argv[0], "--", 2) == 0; argc--, argv++) {
+    if(strcmp(argv[0], "--check") == 0) {
+      check = true;
+    } else if(strncmp(argv[0], "--block=", 8) == 0) {
+      char *end;
+      long n = strtol(argv[0] + 8, &end, 10);
+      if(*end || n < 8 || n > 4096 || n % 8) {
+        fprintf(stderr, "ERROR: %s: the block is a multiple of 8 from 8 to 4096\n", argv[0]);
+        return -1;
+      }
+      c.block = (int)n;
+    } else if(strncmp(argv[0], "--sample=", 9) == 0) {
+      sample = argv[0] + 9;
+    } else {
+      break;
+    }
+  }
+  if(argc != 4) {
+    fprintf(stderr, "fpc --codec [--check] [--block=n] [--sample=file] [name] [min] [max] [precision]\n");
+    return -1;
+  }
+  c.name = argv[0];
+  if(!gen_valid_name(c.name)) {
+    fprintf(stderr, "ERROR: %s: not a C identifier\n", c.name);
+    return -1;
+  }
+  if(gen_reserved_name(c.name)) {
+    fprintf(stderr, "ERROR: %s: %s_t is a standard type\n", c.name, c.name);
+    return -1;
+  }
+  if(!fpc_calculate_from_strings(argv[1], argv[2], argv[3], &c.p)) {
+    fprintf(stderr, "ERROR: %s: %s\n", c.name, c.p.error);
+    return -1;
+  }
+  plan(&c);
+  if(c.hi - c.lo >= (int128_t)1 << 62) {
+    fprintf(stderr, "ERROR: %s: codes wider than 62 bits\n", c.name);
+    return -1;
+  }
+  if(sample) return codec_report(&c, sample);
+  gen_codec(&c, stdout);
+  if(check) gen_codec_check(&c, stdout);
+  return 0;
+}
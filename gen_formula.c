@@ -0,0 +1,722 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "gen.h"
+#include "modes.h"
+
+/* Integer-only evaluation of a formula over fpc formats.
+
+   The formula is compiled by fpc_compile_expr() and each step becomes
+   an integer t standing for t * 2^-f.  Sums, differences, products and
+   constant integer powers are exact, while quotients and steps finer
+   than the working precision are rounded once, ties away from zero.
+   The rounding functions are monotonic, so the interval of every t
+   comes exactly from the ends of its operands' and the types chosen
+   from them can't overflow.  Each step also carries a bound on its
+   error from the exact value, and the working precision is the
+   coarsest that keeps the result within one step of its format. */
+
+#define MAX_STEPS 128 /* the length of an fpc_program */
+#define MAX_GUARD 64  /* working fractional bits beyond the result's */
+#define MAX_POWER 64
+#define MAX_BITS 126  /* for any integer, so rounding and signs have room */
+
+struct input {
+  char var;
+  struct fpc_parameters param;
+};
+
+struct step {
+  char op;            /* 'k': constant, 'v': input, or an operator */
+  int a, b;           /* operands */
+  int input;          /* for 'v' */
+  int n;              /* exponent for '^' */
+  long double value;  /* for 'k' */
+  int128_t k;         /* the constant as an integer */
+  int f;              /* fractional bits */
+  int align;          /* '/': left shift of the dividend if positive, else of the divisor */
+  int shift;          /* right shift rounding the result to the working precision */
+  int128_t lo, hi;    /* interval of t */
+  long double err;    /* bound on |t * 2^-f - exact| for the input codes */
+  long double in_err; /* the same for the values the input codes round */
+  int bits;           /* bits of the widest integer computing t */
+};
+
+struct formula {
+  const char *name;
+  char *expr;
+  struct input inputs[FPC_MAX_VARS];
+  int n_inputs;
+  struct fpc_program prog;
+  struct step steps[MAX_STEPS];
+  int n_steps;
+  int work;                     /* working fractional bits */
+  long double precision;
+  struct fpc_parameters out;    /* the result's format */
+  int out_shift;                /* from the last step to out, rounding if positive */
+  int128_t lo, hi;              /* interval of the result, fractional bits of out */
+  int out_bits;
+  long double err, in_err;
+  const char *error;
+};
+
+static
+int128_t max_abs(int128_t lo, int128_t hi) {
+  int128_t a = lo < 0 ? -lo : lo, b = hi < 0 ? -hi : hi;
+  return a > b ? a : b;
+}
+
+static
+int bits2(int128_t lo, int128_t hi) {
+  int a = gen_arith_bits(lo), b = gen_arith_bits(hi);
+  return a > b ? a : b;
+}
+
+/* x / 2^s and n / d, ties away from zero, the same as the generated helpers */
+static
+int128_t rshift(int128_t x, int s) {
+  int128_t h = (int128_t)1 << (s - 1);
+  return x >= 0 ? (x + h) >> s : -((-x + h) >> s);
+}
+
+static
+int128_t div_round(int128_t n, int128_t d) {
+  int128_t q = n / d, r = n % d;
+  int128_t ar = r < 0 ? -r : r, ad = d < 0 ? -d : d;
+  if(ar >= ad - ar) q += (n < 0) == (d < 0) ? 1 : -1;
+  return q;
+}
+
+/* |t| * 2^-f */
+static
+long double magnitude(const struct step *s) {
+  return ldexpl(max_abs(s->lo, s->hi), -s->f);
+}
+
+/* round a step finer than the working precision to it */
+static
+bool trim(struct formula *fm, struct step *s) {
+  if(s->bits < gen_arith_bits(s->lo) + 1) s->bits = gen_arith_bits(s->lo) + 1;
+  if(s->bits < gen_arith_bits(s->hi) + 1) s->bits = gen_arith_bits(s->hi) + 1;
+  if(s->f > fm->work) {
+    s->shift = s->f - fm->work;
+    s->lo = rshift(s->lo, s->shift);
+    s->hi = rshift(s->hi, s->shift);
+    s->f = fm->work;
+    s->err += ldexpl(0.5L, -fm->work);
+    s->in_err += ldexpl(0.5L, -fm->work);
+  }
+  if(s->bits > MAX_BITS) {
+    fm->error = "intermediate wider than 128 bits";
+    return false;
+  }
+  return true;
+}
+
+static
+bool constant(struct formula *fm, struct step *s, long double v) {
+  int f;
+  if(!isfinite(v)) {
+    fm->error = "constant isn't finite";
+    return false;
+  }
+  s->op = 'k';
+  s->value = v;
+  // exactly if it's a short enough binary fraction
+  for(f = 0; f <= fm->work && f <= 62; f++) {
+    long double x = ldexpl(v, f);
+    if(fabsl(x) >= 0x1p62L) break;
+    if(x == floorl(x)) {
+      s->f = f;
+      s->k = (int128_t)x;
+      s->lo = s->hi = s->k;
+      return trim(fm, s);
+    }
+  }
+  long double x = roundl(ldexpl(v, fm->work));
+  if(fabsl(x) >= 0x1p100L) {
+    fm->error = "constant too large";
+    return false;
+  }
+  s->f = fm->work;
+  s->k = (int128_t)x;
+  s->lo = s->hi = s->k;
+  s->err = s->in_err = fabsl(v - ldexpl(x, -fm->work));
+  return trim(fm, s);
+}
+
+static
+bool input(struct formula *fm, struct step *s, char var) {
+  int i;
+  for(i = 0; i < fm->n_inputs; i++) {
+    if(fm->inputs[i].var == var) break;
+  }
+  if(i == fm->n_inputs) {
+    fm->error = "variable without an input format";
+    return false;
+  }
+  const struct fpc_parameters *p = &fm->inputs[i].param;
+  s->op = 'v';
+  s->input = i;
+  s->f = p->fractional_bits;
+  s->lo = p->lower_bound;
+  s->hi = p->upper_bound;
+  s->in_err = ldexpl(0.5L, -s->f);
+  // the code before adding the offset
+  s->bits = bits2(p->lower_bound - p->offset, p->upper_bound - p->offset) + 1;
+  return trim(fm, s);
+}
+
+static
+bool add_sub(struct formula *fm, struct step *s, char op) {
+  const struct step *a = &fm->steps[s->a], *b = &fm->steps[s->b];
+  int m = a->f > b->f ? a->f : b->f;
+  s->f = m;
+  int ba = bits2(a->lo, a->hi) + m - a->f, bb = bits2(b->lo, b->hi) + m - b->f;
+  s->bits = (ba > bb ? ba : bb) + 1;
+  if(s->bits > MAX_BITS) {
+    fm->error = "intermediate wider than 128 bits";
+    return false;
+  }
+  int128_t alo = a->lo << (m - a->f), ahi = a->hi << (m - a->f);
+  int128_t blo = b->lo << (m - b->f), bhi = b->hi << (m - b->f);
+  s->lo = op == '+' ? alo + blo : alo - bhi;
+  s->hi = op == '+' ? ahi + bhi : ahi - blo;
+  s->err = a->err + b->err;
+  s->in_err = a->in_err + b->in_err;
+  return trim(fm, s);
+}
+
+/* the largest error of x * y when |x| <= X and |y| <= Y are off by ex and ey */
+static
+long double mul_err(long double x, long double ex, long double y, long double ey) {
+  return x * ey + y * ex + ex * ey;
+}
+
+static
+bool mul(struct formula *fm, struct step *s) {
+  const struct step *a = &fm->steps[s->a], *b = &fm->steps[s->b];
+  s->bits = bits2(a->lo, a->hi) + bits2(b->lo, b->hi);
+  if(s->bits > MAX_BITS) {
+    fm->error = "intermediate wider than 128 bits";
+    return false;
+  }
+  int128_t c[4] = { a->lo * b->lo, a->lo * b->hi, a->hi * b->lo, a->hi * b->hi };
+  int i;
+  s->lo = s->hi = c[0];
+  for(i = 1; i < 4; i++) {
+    if(c[i] < s->lo) s->lo = c[i];
+    if(c[i] > s->hi) s->hi = c[i];
+  }
+  s->f = a->f + b->f;
+  s->err = mul_err(magnitude(a), a->err, magnitude(b), b->err);
+  s->in_err = mul_err(magnitude(a), a->in_err, magnitude(b), b->in_err);
+  return trim(fm, s);
+}
+
+/* the largest error of x / y when |x| <= X and |y| >= Y are off by ex and ey */
+static
+long double div_err(long double x, long double ex, long double y, long double ey) {
+  return ex / (y - ey) + x * ey / (y * (y - ey));
+}
+
+static
+bool divide(struct formula *fm, struct step *s) {
+  const struct step *a = &fm->steps[s->a], *b = &fm->steps[s->b];
+  if(b->lo <= 0 && b->hi >= 0) {
+    fm->error = "divisor can be zero";
+    return false;
+  }
+  long double b_min = ldexpl(b->lo > 0 ? b->lo : -b->hi, -b->f);
+  if(b_min <= b->in_err) {
+    fm->error = "divisor within its error of zero";
+    return false;
+  }
+  // a / b * 2^work = (a * 2^align) / b or a / (b * 2^-align)
+  s->f = fm->work;
+  s->align = fm->work - a->f + b->f;
+  int128_t nlo = a->lo, nhi = a->hi, dlo = b->lo, dhi = b->hi;
+  int bn = bits2(nlo, nhi) + (s->align > 0 ? s->align : 0);
+  int bd = bits2(dlo, dhi) + (s->align < 0 ? -s->align : 0);
+  s->bits = (bn > bd ? bn : bd) + 1;
+  if(s->bits > MAX_BITS) {
+    fm->error = "intermediate wider than 128 bits";
+    return false;
+  }
+  if(s->align > 0) {
+    nlo <<= s->align;
+    nhi <<= s->align;
+  } else {
+    dlo <<= -s->align;
+    dhi <<= -s->align;
+  }
+  // the divisor doesn't change sign, so the ends are at the corners
+  int128_t c[4] = { div_round(nlo, dlo), div_round(nlo, dhi),
+                    div_round(nhi, dlo), div_round(nhi, dhi) };
+  int i;
+  s->lo = s->hi = c[0];
+  for(i = 1; i < 4; i++) {
+    if(c[i] < s->lo) s->lo = c[i];
+    if(c[i] > s->hi) s->hi = c[i];
+  }
+  long double half = ldexpl(0.5L, -fm->work);
+  s->err = div_err(magnitude(a), a->err, b_min, b->err) + half;
+  s->in_err = div_err(magnitude(a), a->in_err, b_min, b->in_err) + half;
+  return trim(fm, s);
+}
+
+static
+int128_t power(int128_t x, int n) {
+  int128_t r = 1;
+  while(n--) r *= x;
+  return r;
+}
+
+static
+bool raise(struct formula *fm, struct step *s) {
+  const struct step *a = &fm->steps[s->a];
+  int n = s->n;
+  s->bits = bits2(a->lo, a->hi) * n;
+  if(s->bits > MAX_BITS) {
+    fm->error = "intermediate wider than 128 bits";
+    return false;
+  }
+  int128_t l = power(a->lo, n), h = power(a->hi, n);
+  if(n % 2 || a->lo >= 0) {
+    s->lo = l;
+    s->hi = h;
+  } else if(a->hi <= 0) {
+    s->lo = h;
+    s->hi = l;
+  } else {
+    s->lo = 0;
+    s->hi = l > h ? l : h;
+  }
+  s->f = a->f * n;
+  long double x = magnitude(a);
+  s->err = powl(x + a->err, n) - powl(x, n);
+  s->in_err = powl(x + a->in_err, n) - powl(x, n);
+  return trim(fm, s);
+}
+
+/* the steps of the formula for the working precision fm->work */
+static
+bool plan(struct formula *fm) {
+  int stack[FPC_STACK_SIZE], top = 0;
+  unsigned int pc;
+  fm->n_steps = 0;
+  for(pc = 0; pc < fm->prog.length; pc++) {
+    char op = fm->prog.code[pc].op;
+    struct step *s = &fm->steps[fm->n_steps];
+    memset(s, 0, sizeof(*s));
+    if(op == 'k') {
+      if(!constant(fm, s, fm->prog.code[pc].value)) return false;
+    } else if(op == 'v') {
+      // each input is loaded once
+      int i;
+      for(i = 0; i < fm->n_steps; i++) {
+        const struct step *v = &fm->steps[i];
+        if(v->op == 'v' && fm->inputs[v->input].var == fm->prog.code[pc].var) break;
+      }
+      if(i < fm->n_steps) {
+        stack[top++] = i;
+        continue;
+      }
+      if(!input(fm, s, fm->prog.code[pc].var)) return false;
+    } else {
+      s->op = op;
+      s->b = stack[--top];
+      s->a = stack[--top];
+      if(op == '^') {
+        // the exponent is the constant just before, which the power replaces
+        const struct step *e = &fm->steps[s->b];
+        if(s->b != fm->n_steps - 1 || e->op != 'k' || e->f != 0 ||
+           e->k < 0 || e->k > MAX_POWER) {
+          fm->error = "powers must be constant integers from 0 to 64";
+          return false;
+        }
+        int a = s->a, n = (int)e->k;
+        s = &fm->steps[--fm->n_steps];
+        memset(s, 0, sizeof(*s));
+        s->op = '^';
+        s->a = a;
+        s->n = n;
+        if(n == 0) {
+          if(!constant(fm, s, 1)) return false;
+        } else if(!raise(fm, s)) return false;
+      } else if(op == '+' || op == '-') {
+        if(!add_sub(fm, s, op)) return false;
+      } else if(op == '*') {
+        if(!mul(fm, s)) return false;
+      } else if(op == '/') {
+        if(!divide(fm, s)) return false;
+      } else {
+        fm->error = "unknown operator";
+        return false;
+      }
+    }
+    stack[top++] = fm->n_steps++;
+  }
+
+  // the result in the fractional bits of its format
+  const struct step *r = &fm->steps[fm->n_steps - 1];
+  int f = -ilogbl(fm->precision);
+  fm->out_shift = r->f - f;
+  fm->err = r->err;
+  fm->in_err = r->in_err;
+  fm->out_bits = bits2(r->lo, r->hi) + 1;
+  if(fm->out_shift > 0) {
+    fm->lo = rshift(r->lo, fm->out_shift);
+    fm->hi = rshift(r->hi, fm->out_shift);
+    fm->err += ldexpl(0.5L, -f);
+    fm->in_err += ldexpl(0.5L, -f);
+  } else {
+    fm->out_bits -= fm->out_shift;
+    if(fm->out_bits > MAX_BITS) {
+      fm->error = "result wider than 128 bits";
+      return false;
+    }
+    fm->lo = r->lo << -fm->out_shift;
+    fm->hi = r->hi << -fm->out_shift;
+  }
+  memset(&fm->out, 0, sizeof(fm->out));
+  fm->out.min = ldexpl(fm->lo, -f);
+  fm->out.max = ldexpl(fm->hi, -f);
+  fm->out.precision = fm->precision;
+  if(fm->out.max < fm->out.min + fm->precision) fm->out.max = fm->out.min + fm->precision;
+  if(!fpc_calculate(&fm->out)) {
+    fm->error = fm->out.error;
+    return false;
+  }
+  return true;
+}
+
+/* the coarsest working precision keeping the result within one step */
+static
+bool compile(struct formula *fm) {
+  int g, f = -ilogbl(fm->precision);
+  if(!fpc_compile_expr(fm->expr, &fm->prog) || !fm->prog.length) {
+    fm->error = "syntax error";
+    return false;
+  }
+  for(g = 0; g <= MAX_GUARD; g++) {
+    fm->work = f + g;
+    fm->error = NULL;
+    if(!plan(fm)) return false;
+    if(fm->err - (fm->out_shift > 0 ? ldexpl(0.5L, -f) : 0) <= ldexpl(0.5L, -f)) return true;
+  }
+  fm->error = "can't reach the precision";
+  return false;
+}
+
+/* the storage type of a step, the narrowest signed type holding it */
+static
+const char *store_type(const struct step *s) {
+  int b = bits2(s->lo, s->hi);
+  return b <= 8 ? "int8_t" : b <= 16 ? "int16_t" : b <= 32 ? "int32_t" :
+    b <= 64 ? "int64_t" : "__int128";
+}
+
+/* (W)t_i aligned left by s */
+static
+void print_operand(FILE *f, int i, int s, int w) {
+  if(s > 0) fprintf(f, "(%s)t%d * ((%s)1 << %d)", gen_arith_type(w), i, gen_arith_type(w), s);
+  else fprintf(f, "(%s)t%d", gen_arith_type(w), i);
+}
+
+static
+void print_step(FILE *f, struct formula *fm, int i) {
+  struct step *s = &fm->steps[i];
+  int w = gen_arith_width(s->bits);
+  const char *t = store_type(s), *W = gen_arith_type(w);
+  struct fpc_parameters p;
+
+  fprintf(f, "  %s t%d = ", t, i);
+  if(s->op == 'k') {
+    gen_arith_const(f, s->k);
+    fprintf(f, "; /* %.19Lg */\n", ldexpl(s->k, -s->f));
+    return;
+  }
+  const struct input *in = s->op == 'v' ? &fm->inputs[s->input] : NULL;
+  if(in && !in->param.offset && !s->shift) {
+    fprintf(f, "(%s)%c; /* [%.19Lg, %.19Lg] in steps of 2^%d */\n", t, in->var,
+            ldexpl(s->lo, -s->f), ldexpl(s->hi, -s->f), -s->f);
+    return;
+  }
+  bool cast = strcmp(t, W) != 0;
+  if(cast) fprintf(f, "(%s)(", t);
+  if(s->shift) fprintf(f, "fpc_rshift%d(", w);
+  switch(s->op) {
+  case 'v':
+    fprintf(f, "(%s)%c", W, in->var);
+    if(in->param.offset) {
+      fprintf(f, " + ");
+      gen_arith_const(f, in->param.offset);
+    }
+    break;
+  case '+':
+  case '-': {
+    int fa = fm->steps[s->a].f, fb = fm->steps[s->b].f, m = fa > fb ? fa : fb;
+    print_operand(f, s->a, m - fa, w);
+    fprintf(f, " %c ", s->op);
+    print_operand(f, s->b, m - fb, w);
+    break;
+  }
+  case '*':
+    fprintf(f, "(%s)t%d * t%d", W, s->a, s->b);
+    break;
+  case '/':
+    fprintf(f, "fpc_div%d(", w);
+    print_operand(f, s->a, s->align, w);
+    fprintf(f, ", ");
+    print_operand(f, s->b, -s->align, w);
+    fprintf(f, ")");
+    break;
+  case '^': {
+    int k;
+    fprintf(f, "(%s)t%d", W, s->a);
+    for(k = 1; k < s->n; k++) fprintf(f, " * t%d", s->a);
+    break;
+  }
+  }
+  if(s->shift) fprintf(f, ", %d)", s->shift);
+  if(cast) fprintf(f, ")");
+
+  // the format fpc gives the step, for the comment
+  memset(&p, 0, sizeof(p));
+  p.min = ldexpl(s->lo, -s->f);
+  p.precision = ldexpl(1, -s->f);
+  p.max = s->hi > s->lo ? ldexpl(s->hi, -s->f) : p.min + p.precision;
+  fprintf(f, "; /* [%.19Lg, %.19Lg] in steps of 2^%d, %d bits */\n",
+          ldexpl(s->lo, -s->f), ldexpl(s->hi, -s->f), -s->f,
+          fpc_calculate(&p) ? p.integer_bits + p.fractional_bits : bits2(s->lo, s->hi));
+}
+
+/* the parameters of the function */
+static
+void print_args(FILE *f, struct formula *fm) {
+  int i;
+  for(i = 0; i < fm->n_inputs; i++) {
+    fprintf(f, "%s%s_%c_t %c", i ? ", " : "", fm->name, fm->inputs[i].var, fm->inputs[i].var);
+  }
+}
+
+static
+void print_format(FILE *f, const char *what, const struct fpc_parameters *p) {
+  fprintf(f, "/* %s: [%.19Lg, %.19Lg] in steps of 2^%d", what,
+          ldexpl(p->lower_bound, -p->fractional_bits),
+          ldexpl(p->upper_bound, -p->fractional_bits),
+          -p->fractional_bits);
+  if(p->offset) {
+    char buf[41];
+    fprintf(f, " with offset %s", int128_str(p->offset, buf));
+  }
+  fprintf(f, " */\n");
+}
+
+static
+void gen_formula(struct formula *fm, FILE *f) {
+  int i;
+  char upper[128];
+  for(i = 0; fm->name[i] && i < (int)sizeof(upper) - 1; i++) {
+    upper[i] = toupper((unsigned char)fm->name[i]);
+  }
+  upper[i] = 0;
+  fprintf(f, "/* generated by fpc --formula */\n"
+          "#ifndef FPC_FORMULA_%s_H\n"
+          "#define FPC_FORMULA_%s_H\n\n"
+          "#include <stdint.h>\n\n", upper, upper);
+  for(i = 0; i < fm->n_inputs && fm->inputs[i].param.fixed_encoding_width < 128; i++);
+  if(i < fm->n_inputs || fm->out.fixed_encoding_width == 128) gen_int128_types(f);
+  gen_arith_helpers(f);
+
+  for(i = 0; i < fm->n_inputs; i++) {
+    struct input *in = &fm->inputs[i];
+    char what[64];
+    snprintf(what, sizeof(what), "%c", in->var);
+    print_format(f, what, &in->param);
+    fprintf(f, "typedef %s%d_t %s_%c_t;\n\n", in->param.use_signed ? "int" : "uint",
+            in->param.fixed_encoding_width, fm->name, in->var);
+  }
+  print_format(f, fm->name, &fm->out);
+  fprintf(f, "typedef %s%d_t %s_t;\n\n", fm->out.use_signed ? "int" : "uint",
+          fm->out.fixed_encoding_width, fm->name);
+
+  fprintf(f, "/* %s = %s\n"
+          "   within %.3Lg of the exact value for the input codes and %.3Lg\n"
+          "   for the values they round, working to 2^%d */\n"
+          "static inline %s_t %s(", fm->name, fm->expr, fm->err, fm->in_err,
+          -fm->work, fm->name, fm->name);
+  print_args(f, fm);
+  fprintf(f, ") {\n");
+  for(i = 0; i < fm->n_steps; i++) print_step(f, fm, i);
+
+  int last = fm->n_steps - 1, w = gen_arith_width(fm->out_bits);
+  fprintf(f, "  %s out = ", gen_arith_type(w));
+  if(fm->out_shift > 0) {
+    fprintf(f, "fpc_rshift%d((%s)t%d, %d);\n", w, gen_arith_type(w), last, fm->out_shift);
+  } else {
+    print_operand(f, last, -fm->out_shift, w);
+    fprintf(f, ";\n");
+  }
+  if(fm->out.offset) {
+    fprintf(f, "  out -= ");
+    gen_arith_const(f, fm->out.offset);
+    fprintf(f, ";\n");
+  }
+  fprintf(f, "  return (%s_t)out;\n"
+          "}\n\n"
+          "#endif\n", fm->name);
+}
+
+/* a program comparing the function to a long double reference on the
+   corners of the inputs and random values, with names longer than a
+   letter so they can't hide the inputs */
+static
+void gen_formula_check(struct formula *fm, FILE *f) {
+  int i, n = fm->n_inputs;
+  fprintf(f, "\n"
+          "#include <math.h>\n"
+          "#include <stdio.h>\n\n"
+          "static long double reference(");
+  for(i = 0; i < n; i++) fprintf(f, "%slong double %c", i ? ", " : "", fm->inputs[i].var);
+  fprintf(f, ") {\n");
+  for(i = 0; i < fm->n_steps; i++) {
+    const struct step *s = &fm->steps[i];
+    fprintf(f, "  long double r%d = ", i);
+    if(s->op == 'k') fprintf(f, "%.21Lg", s->value);
+    else if(s->op == 'v') fprintf(f, "%c", fm->inputs[s->input].var);
+    else if(s->op == '^') fprintf(f, "powl(r%d, %d)", s->a, s->n);
+    else fprintf(f, "r%d %c r%d", s->a, s->op, s->b);
+    fprintf(f, ";\n");
+  }
+  fprintf(f, "  return r%d;\n"
+          "}\n\n", fm->n_steps - 1);
+
+  fprintf(f, "static unsigned long long int state = 1;\n\n"
+          "/* uniform in [0, 1) */\n"
+          "static long double uniform(void) {\n"
+          "  state = state * 6364136223846793005ULL + 1442695040888963407ULL;\n"
+          "  return (long double)(state >> 11) / (1ULL << 53);\n"
+          "}\n\n"
+          "int main(void) {\n"
+          "  long double max_err = 0, max_in_err = 0, values[%d], rounded[%d];\n"
+          "  long int sample, samples = 1 << 20, bad = 0;\n"
+          "  for(sample = 0; sample < samples; sample++) {\n", n, n);
+  for(i = 0; i < n; i++) {
+    const struct input *in = &fm->inputs[i];
+    const struct fpc_parameters *p = &in->param;
+    // the corners first, then random values, each rounded to its code
+    fprintf(f, "    values[%d] = sample < %d ? (sample >> %d & 1 ? %.21Lg : %.21Lg) :\n"
+            "      %.21Lg + uniform() * %.21Lg;\n",
+            i, 1 << n, i, p->max, p->min, p->min, p->max - p->min);
+    fprintf(f, "    %s_%c_t code_%c = (%s_%c_t)(rintl(ldexpl(values[%d], %d)) - %.21Lg);\n",
+            fm->name, in->var, in->var, fm->name, in->var, i, p->fractional_bits,
+            (long double)p->offset);
+    fprintf(f, "    rounded[%d] = ldexpl((long double)code_%c + %.21Lg, %d);\n",
+            i, in->var, (long double)p->offset, -p->fractional_bits);
+  }
+  fprintf(f, "    long double result = ldexpl((long double)%s(", fm->name);
+  for(i = 0; i < n; i++) fprintf(f, "%scode_%c", i ? ", " : "", fm->inputs[i].var);
+  fprintf(f, ") + %.21Lg, %d);\n", (long double)fm->out.offset, -fm->out.fractional_bits);
+  fprintf(f, "    long double err = fabsl(result - reference(");
+  for(i = 0; i < n; i++) fprintf(f, "%srounded[%d]", i ? ", " : "", i);
+  fprintf(f, "));\n"
+          "    long double in_err = fabsl(result - reference(");
+  for(i = 0; i < n; i++) fprintf(f, "%svalues[%d]", i ? ", " : "", i);
+  fprintf(f, "));\n"
+          "    if(err > max_err) max_err = err;\n"
+          "    if(in_err > max_in_err) max_in_err = in_err;\n"
+          "    // allowing for the reference's own rounding, which for 128 bit\n"
+          "    // results is a few units of a long double's 64 bit mantissa\n"
+          "    long double slack = fabsl(result) * 0x1p-58L;\n"
+          "    if(err > %.21Lg * (1 + 0x1p-40L) + slack || in_err > %.21Lg * (1 + 0x1p-40L) + slack) {\n"
+          "      if(bad++ < 10) printf(\"sample %%ld: %%.19Lg off by %%.3Lg and %%.3Lg\\n\",\n"
+          "                            sample, result, err, in_err);\n"
+          "    }\n"
+          "  }\n"
+          "  printf(\"%%ld samples, error %%.3Lg (bound %.3Lg), with inputs %%.3Lg (bound %.3Lg): %%s\\n\",\n"
+          "         samples, max_err, max_in_err, bad ? \"FAIL\" : \"ok\");\n"
+          "  return bad != 0;\n"
+          "}\n", fm->err, fm->in_err, fm->err, fm->in_err);
+}
+
+int formula_main(int argc, char **argv) {
+  struct formula fm;
+  bool check = false;
+  int i, j;
+  memset(&fm, 0, sizeof(fm));
+  if(argc && strcmp(argv[0], "--check") == 0) {
+    check = true;
+    argc--;
+    argv++;
+  }
+  if(argc < 7 || (argc - 3) % 4) {
+    fprintf(stderr, "fpc --formula [--check] [name] [expression] [precision] "
+            "[variable] [min] [max] [precision] ...\n");
+    return -1;
+  }
+  if(!gen_valid_name(argv[0])) {
+    fprintf(stderr, "ERROR: %s: not a C identifier\n", argv[0]);
+    return -1;
+  }
+  if(gen_reserved_name(argv[0])) {
+    fprintf(stderr, "ERROR: %s: %s_t is a standard type\n", argv[0], argv[0]);
+    return -1;
+  }
+  fm.name = argv[0];
+  fm.expr = argv[1];
+  fm.precision = fpc_eval_expr(argv[2]);
+  if(!(fm.precision > 0) || !isfinite(fm.precision)) {
+    fprintf(stderr, "ERROR: bad precision: %s\n", argv[2]);
+    return -1;
+  }
+  fm.n_inputs = (argc - 3) / 4;
+  if(fm.n_inputs > FPC_MAX_VARS) {
+    fprintf(stderr, "ERROR: more than %d inputs\n", FPC_MAX_VARS);
+    return -1;
+  }
+  for(i = 0; i < fm.n_inputs; i++) {
+    char **arg = argv + 3 + 4 * i;
+    struct input *in = &fm.inputs[i];
+    if(!isalpha((unsigned char)arg[0][0]) || arg[0][1]) {
+      fprintf(stderr, "ERROR: %s: variables are single letters\n", arg[0]);
+      return -1;
+    }
+    in->var = arg[0][0];
+    for(j = 0; j < i; j++) {
+      if(fm.inputs[j].var == in->var) {
+        fprintf(stderr, "ERROR: %c: duplicate input\n", in->var);
+        return -1;
+      }
+    }
+    if(!fpc_calculate_from_strings(arg[1], arg[2], arg[3], &in->param)) {
+      fprintf(stderr, "ERROR: %c: %s\n", in->var, in->param.error);
+      return -1;
+    }
+  }
+  if(!compile(&fm)) {
+    fprintf(stderr, "ERROR: %s\n", fm.error);
+    return -1;
+  }
+  gen_formula(&fm, stdout);
+  if(check) gen_formula_check(&fm, stdout);
+  return 0;
+}
@@ -0,0 +1,243 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <inttypes.h>
+
+#include "gen.h"
+
+/* Packed codes.  Value i is stored as code - lower bound in bits
+   [i * b, (i + 1) * b) of a little endian bitstream, where b is the
+   number of bits the format uses rather than its machine width.
+
+   Every access is one unaligned load (and store) of a word at byte
+   (i * b) / 8 shifted by (i * b) % 8, so the word must hold and shift
+   by b + 7 bits: uint64_t up to 56 bits, unsigned __int128 above.
+   Buffers are padded by a word so the last access stays in bounds.  The sequential
+   kernels keep a bit accumulator and advance by whole bytes, the
+   decoder handles 8 values (b bytes) per step with constant shifts. */
+
+unsigned int gen_pack_bits(struct fpc_parameters *param) {
+  return param->integer_bits + param->fractional_bits;
+}
+
+static
+unsigned int word_bits(struct fpc_parameters *param) {
+  return gen_pack_bits(param) <= 56 ? 64 : 128;
+}
+
+void gen_pack_report(struct fpc_parameters *param, FILE *f) {
+  unsigned int b = gen_pack_bits(param), w = param->fixed_encoding_width;
+  fprintf(f, "\n[PACKED]\n");
+  fprintf(f, "  bits per value: %u (%u unpacked)\n", b, w);
+  fprintf(f, "  bytes per million values: %u (%u unpacked)\n", b * 125000, w * 125000);
+  fprintf(f, "  memory saved: %.1f%%\n", 100.0 * (w - b) / w);
+}
+
+void gen_pack(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  const char *S = param->use_signed ? "INT" : "UINT";
+  unsigned int b = gen_pack_bits(param), W = word_bits(param), j;
+  long long int
+    lb = param->lower_bound - param->offset,
+    ub = param->upper_bound - param->offset;
+  const char *word = W == 64 ? "uint64_t" : "unsigned __int128";
+
+  printf("/* Packed codes, %u bits each: value i is code - %lld in bits\n"
+         "   [i * %u, (i + 1) * %u) of a little endian bitstream.  Buffers need\n"
+         "   convert_packed_size(n) bytes, which includes %u bytes of padding. */\n",
+         b, lb, b, b, W / 8);
+  printf("#define CONVERT_PACKED_BITS %u\n\n", b);
+  printf("typedef %s convert_word_t;\n"
+         "#define CONVERT_PACKED_MASK (((convert_word_t)1 << %u) - 1)\n\n", word, b);
+  printf("static inline convert_word_t convert_load(const uint8_t *p) {\n"
+         "  convert_word_t v;\n"
+         "  memcpy(&v, p, sizeof(v));\n"
+         "  return v;\n"
+         "}\n\n"
+         "static inline void convert_store(uint8_t *p, convert_word_t v) {\n"
+         "  memcpy(p, &v, sizeof(v));\n"
+         "}\n\n");
+
+  printf("size_t convert_packed_size(size_t n) {\n"
+         "  return (n * %u + 7) / 8 + sizeof(convert_word_t);\n"
+         "}\n\n", b);
+
+  // random access
+  printf("/* code i of buf */\n"
+         "%s%d_t convert_unpack(const uint8_t *buf, size_t i) {\n"
+         "  uint64_t bit = (uint64_t)i * %u;\n"
+         "  convert_word_t v = (convert_load(buf + bit / 8) >> (bit %% 8)) & CONVERT_PACKED_MASK;\n"
+         "  return (%s%d_t)((uint64_t)v + UINT64_C(%llu));\n"
+         "}\n\n", s, w, b, s, w, (unsigned long long int)lb);
+  printf("/* set code i of buf to x, returns false if x is out of range */\n"
+         "bool convert_pack(uint8_t *buf, size_t i, %s%d_t x) {\n"
+         "  uint64_t bit = (uint64_t)i * %u;\n"
+         "  convert_word_t v;\n"
+         "  if(x < %s%d_C(%lld) || x > %s%d_C(%lld)) {\n"
+         "    return false;\n"
+         "  }\n"
+         "  v = convert_load(buf + bit / 8) & ~(CONVERT_PACKED_MASK << (bit %% 8));\n"
+         "  v |= (convert_word_t)((uint64_t)x - UINT64_C(%llu)) << (bit %% 8);\n"
+         "  convert_store(buf + bit / 8, v);\n"
+         "  return true;\n"
+         "}\n\n", s, w, b, S, w, lb, S, w, ub, (unsigned long long int)lb);
+
+  // sequential
+  printf("#if defined(__GNUC__) && !defined(__clang__)\n"
+         "#pragma GCC push_options\n"
+         "#pragma GCC optimize(\"O3\")\n"
+         "#endif\n\n");
+  printf("/* pack n codes into buf, saturating codes out of range,\n"
+         "   returns the number out of range */\n"
+         "size_t convert_pack_n(const %s%d_t *x, uint8_t *buf, size_t n) {\n"
+         "  convert_word_t acc = 0;\n"
+         "  unsigned int fill = 0;\n"
+         "  size_t i, errors = 0;\n"
+         "  for(i = 0; i < n; i++) {\n"
+         "    %s%d_t c = x[i];\n"
+         "    bool low = c < %s%d_C(%lld), high = c > %s%d_C(%lld);\n"
+         "    errors += low | high;\n"
+         "    c = low ? %s%d_C(%lld) : high ? %s%d_C(%lld) : c;\n"
+         "    acc |= (convert_word_t)((uint64_t)c - UINT64_C(%llu)) << fill;\n"
+         "    fill += %u;\n"
+         "    convert_store(buf, acc);\n"
+         "    buf += fill / 8;\n"
+         "    acc >>= fill & ~7u;\n"
+         "    fill %%= 8;\n"
+         "  }\n"
+         "  convert_store(buf, acc);\n"
+         "  return errors;\n"
+         "}\n\n",
+         s, w, s, w, S, w, lb, S, w, ub, S, w, lb, S, w, ub,
+         (unsigned long long int)lb, b);
+
+  printf("/* unpack n codes from buf */\n"
+         "void convert_unpack_n(const uint8_t *buf, %s%d_t *x, size_t n) {\n"
+         "  size_t i;\n"
+         "  for(i = 0; i < n / 8; i++, buf += %u, x += 8) {\n", s, w, b);
+  for(j = 0; j < 8; j++) {
+    printf("    x[%u] = (%s%d_t)((uint64_t)((convert_load(buf + %u) >> %u) & CONVERT_PACKED_MASK) + UINT64_C(%llu));\n",
+           j, s, w, j * b / 8, j * b % 8, (unsigned long long int)lb);
+  }
+  printf("  }\n"
+         "  for(i = 0; i < n %% 8; i++) {\n"
+         "    x[i] = convert_unpack(buf, i);\n"
+         "  }\n"
+         "}\n\n");
+  printf("#if defined(__GNUC__) && !defined(__clang__)\n"
+         "#pragma GCC pop_options\n"
+         "#endif\n\n");
+
+#undef printf
+}
+
+void gen_pack_test(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  const char *S = param->use_signed ? "INT" : "UINT";
+  unsigned int b = gen_pack_bits(param);
+  long long int
+    lb = param->lower_bound - param->offset,
+    ub = param->upper_bound - param->offset;
+
+  printf("#define PACK_N 65536\n\n"
+         "/* PACK_N codes spread over the range in a scrambled order */\n"
+         "static void pack_codes(%s%d_t *codes) {\n"
+         "  size_t i;\n"
+         "  for(i = 0; i < PACK_N; i++) {\n"
+         "    unsigned __int128 k = i * 40503 %% PACK_N;\n"
+         "    codes[i] = (%s%d_t)(UINT64_C(%llu) + (uint64_t)(k * UINT64_C(%llu) / (PACK_N - 1)));\n"
+         "  }\n"
+         "}\n\n",
+         s, w, s, w, (unsigned long long int)lb, (unsigned long long int)ub - lb);
+  printf("/* pack and unpack codes sequentially and at random, returns non-zero on failure */\n"
+         "static int test_packed(void) {\n"
+         "  static %s%d_t codes[PACK_N], out[PACK_N];\n"
+         "  uint8_t *buf = calloc(1, convert_packed_size(PACK_N));\n"
+         "  uint8_t *rbuf = calloc(1, convert_packed_size(PACK_N));\n"
+         "  size_t i, n, bad = 0;\n"
+         "  pack_codes(codes);\n"
+         "  printf(\"%%d codes, %u bits each\\n\", PACK_N);\n", s, w, b);
+  printf("  for(n = PACK_N - 7; n <= PACK_N; n++) {\n"
+         "    if(convert_pack_n(codes, buf, n) != 0) bad++;\n"
+         "    memset(out, 0, sizeof(out));\n"
+         "    convert_unpack_n(buf, out, n);\n"
+         "    if(memcmp(codes, out, n * sizeof(out[0])) != 0) bad++;\n"
+         "  }\n"
+         "  printf(\"  sequential: %%s\\n\", bad ? \"FAIL\" : \"ok\");\n"
+         "  size_t seq_bad = bad;\n"
+         "  for(i = 0; i < PACK_N; i++) {\n"
+         "    size_t k = i * 40503 %% PACK_N; // every index, out of order\n"
+         "    if(!convert_pack(rbuf, k, codes[k])) bad++;\n"
+         "  }\n"
+         "  for(i = 0; i < PACK_N; i++) {\n"
+         "    if(convert_unpack(rbuf, i) != codes[i] || convert_unpack(buf, i) != codes[i]) bad++;\n"
+         "  }\n"
+         "  if(memcmp(buf, rbuf, convert_packed_size(PACK_N) - sizeof(convert_word_t)) != 0) bad++;\n"
+         "  printf(\"  random access: %%s\\n\", bad > seq_bad ? \"FAIL\" : \"ok\");\n");
+  if(param->lower_bound - param->offset > (param->use_signed ? -(((int128_t)1) << (w - 1)) : 0)) {
+    printf("  %s%d_t outside[2] = { %s%d_C(%lld) - 1, %s%d_C(%lld) };\n"
+           "  if(convert_pack_n(outside, buf, 2) != 1 || convert_unpack(buf, 0) != %s%d_C(%lld) ||\n"
+           "     convert_pack(buf, 0, outside[0])) bad++;\n",
+           s, w, S, w, lb, S, w, lb, S, w, lb);
+  }
+  printf("  printf(\"  out of range: %%s\\n\", bad ? \"FAIL\" : \"ok\");\n"
+         "  free(buf);\n"
+         "  free(rbuf);\n"
+         "  printf(\"%%s\\n\", bad ? \"FAIL\" : \"ok\");\n"
+         "  return bad != 0;\n"
+         "}\n\n");
+
+  printf("/* time the packed kernels, as CSV rows for case label if it isn't NULL */\n"
+         "static void bench_packed(const char *label) {\n"
+         "  static %s%d_t codes[PACK_N], out[PACK_N];\n"
+         "  uint8_t *buf = calloc(1, convert_packed_size(PACK_N));\n"
+         "  double t, sum = 0;\n"
+         "  size_t r, reps = 256;\n"
+         "  pack_codes(codes);\n"
+         "  t = now();\n"
+         "  for(r = 0; r < reps; r++) {\n"
+         "    convert_pack_n(codes, buf, PACK_N);\n"
+         "    sum += buf[r %% PACK_N];\n"
+         "  }\n"
+         "  double pack = (now() - t) / ((double)PACK_N * reps);\n"
+         "  t = now();\n"
+         "  for(r = 0; r < reps; r++) {\n"
+         "    convert_unpack_n(buf, out, PACK_N);\n"
+         "    sum += out[r %% PACK_N];\n"
+         "  }\n"
+         "  double unpack = (now() - t) / ((double)PACK_N * reps);\n"
+         "  t = now();\n"
+         "  for(r = 0; r < reps; r++) {\n"
+         "    size_t i;\n"
+         "    for(i = 0; i < PACK_N; i++) out[i] = convert_unpack(buf, i * 40503 %% PACK_N);\n"
+         "    sum += out[r %% PACK_N];\n"
+         "  }\n"
+         "  double random = (now() - t) / ((double)PACK_N * reps);\n", s, w);
+  printf("  if(label) {\n"
+         "    printf(\"convert_pack_n,%%s,%%.3f,%%.3f\\n\", label, pack * 1e9, 1e-6 / pack);\n"
+         "    printf(\"convert_unpack_n,%%s,%%.3f,%%.3f\\n\", label, unpack * 1e9, 1e-6 / unpack);\n"
+         "    printf(\"convert_unpack,%%s,%%.3f,%%.3f\\n\", label, random * 1e9, 1e-6 / random);\n"
+         "  } else {\n"
+         "    printf(\"packed:              pack_n %%.2f ns, unpack_n %%.2f ns, unpack %%.2f ns\\n\",\n"
+         "           pack * 1e9, unpack * 1e9, random * 1e9);\n"
+         "  }\n"
+         "  free(buf);\n"
+         "  if(sum == 42) printf(\"\\n\"); // keep the results live\n"
+         "}\n");
+#undef printf
+}
@@ -0,0 +1,573 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "gen.h"
+#include "modes.h"
+
+/* Packed records of several fpc formats.
+
+   Each field is stored as code - lower bound in the bits its range
+   needs, at a fixed bit offset of a little endian byte array.  Two
+   layouts are planned:
+   - words: fields are packed first fit, widest first, into 64-bit
+     words that no field straddles, and each word is trimmed to 8, 16
+     or 32 bits if that holds it, so every access is one aligned load
+   - stream: fields follow each other in schema order, so the record
+     has the fewest bytes, and an access loads the bytes the field
+     touches (or a whole power of two of them if the record has room)
+   --layout=auto takes the stream only if it saves bytes after padding
+   the record to --align bytes.  Whole records are encoded a word (or
+   8 bytes of stream) at a time, in registers, and stored once. */
+
+#define MAX_FIELDS 256
+
+struct field {
+  const char *name;
+  struct fpc_parameters param;
+  unsigned int bits;
+  long long int lb, ub;    /* the code range */
+  unsigned int bit;        /* offset in the record */
+  unsigned int word;       /* words layout: the chunk holding it */
+};
+
+struct chunk {
+  unsigned int byte, size; /* bytes */
+};
+
+struct record {
+  const char *name;
+  struct field fields[MAX_FIELDS];
+  int n;
+  bool stream;
+  unsigned int align, size, natural;
+  struct chunk chunks[MAX_FIELDS + 1]; /* whole record encoding units */
+  int n_chunks;
+};
+
+enum layout { LAYOUT_AUTO, LAYOUT_WORDS, LAYOUT_STREAM };
+
+static
+unsigned int pad(unsigned int size, unsigned int align) {
+  return (size + align - 1) / align * align;
+}
+
+static
+unsigned int pow2_bytes(unsigned int bits) {
+  return bits <= 8 ? 1 : bits <= 16 ? 2 : bits <= 32 ? 4 : 8;
+}
+
+/* the size of a struct of the codes at their machine widths, in schema order */
+static
+unsigned int natural_size(struct record *r) {
+  unsigned int size = 0, most = 1;
+  int i;
+  for(i = 0; i < r->n; i++) {
+    unsigned int w = r->fields[i].param.fixed_encoding_width / 8;
+    size = pad(size, w) + w;
+    if(w > most) most = w;
+  }
+  return pad(size, most);
+}
+
+static
+int by_bits(const void *a, const void *b) {
+  const struct field *x = *(const struct field *const *)a, *y = *(const struct field *const *)b;
+  if(x->bits != y->bits) return x->bits < y->bits ? 1 : -1;
+  return x < y ? -1 : 1; // stable
+}
+
+/* first fit decreasing into 64-bit words, returns the record size */
+static
+unsigned int plan_words(struct record *r) {
+  struct field *order[MAX_FIELDS];
+  unsigned int used[MAX_FIELDS], chunk_of[MAX_FIELDS], w, n_words = 0, byte = 0;
+  int i, j, k;
+  for(i = 0; i < r->n; i++) order[i] = &r->fields[i];
+  qsort(order, r->n, sizeof(order[0]), by_bits);
+  for(i = 0; i < r->n; i++) {
+    for(w = 0; w < n_words && used[w] + order[i]->bits > 64; w++);
+    if(w == n_words) used[n_words++] = 0;
+    order[i]->word = w;
+    order[i]->bit = used[w];
+    used[w] += order[i]->bits;
+  }
+  // lay the words out widest first, so each is aligned to its size
+  r->n_chunks = 0;
+  for(k = 8; k >= 1; k /= 2) {
+    for(w = 0; w < n_words; w++) {
+      if(pow2_bytes(used[w]) != (unsigned int)k) continue;
+      chunk_of[w] = r->n_chunks;
+      r->chunks[r->n_chunks].byte = byte;
+      r->chunks[r->n_chunks++].size = k;
+      byte += k;
+    }
+  }
+  for(j = 0; j < r->n; j++) {
+    r->fields[j].word = chunk_of[r->fields[j].word];
+    r->fields[j].bit += r->chunks[r->fields[j].word].byte * 8;
+  }
+  return byte;
+}
+
+/* one field after another, returns the record size */
+static
+unsigned int plan_stream(struct record *r) {
+  unsigned int bit = 0, byte;
+  int i;
+  for(i = 0; i < r->n; i++) {
+    r->fields[i].bit = bit;
+    bit += r->fields[i].bits;
+  }
+  r->n_chunks = 0;
+  for(byte = 0; byte < (bit + 7) / 8; byte += 8) {
+    r->chunks[r->n_chunks].byte = byte;
+    r->chunks[r->n_chunks++].size = (bit + 7) / 8 - byte < 8 ? (bit + 7) / 8 - byte : 8;
+  }
+  return (bit + 7) / 8;
+}
+
+static
+void plan(struct record *r, enum layout layout) {
+  unsigned int words = pad(plan_words(r), r->align);
+  unsigned int stream = pad(plan_stream(r), r->align);
+  r->natural = natural_size(r);
+  r->stream = layout == LAYOUT_STREAM || (layout == LAYOUT_AUTO && stream < words);
+  if(r->stream) {
+    r->size = stream;
+  } else {
+    plan_words(r);
+    r->size = words;
+  }
+}
+
+/* the n bytes at *byte loaded to access f, which starts at bit *shift
+   of them: its word, or in a stream the bytes it touches, rounded up to
+   a power of two if the record has room */
+static
+void field_access(struct record *r, struct field *f, unsigned int *byte, unsigned int *shift,
+                  unsigned int *n) {
+  unsigned int need;
+  if(!r->stream) {
+    *byte = r->chunks[f->word].byte;
+    *n = r->chunks[f->word].size;
+  } else {
+    *byte = f->bit / 8;
+    need = (f->bit % 8 + f->bits + 7) / 8;
+    for(*n = 1; *n < need; *n *= 2);
+    if(*byte + *n > r->size) *n = need;
+  }
+  *shift = f->bit - *byte * 8;
+}
+
+static
+const char *field_type(struct field *f) {
+  static char buf[4][16];
+  static int i;
+  i = (i + 1) % 4;
+  snprintf(buf[i], sizeof(buf[i]), "%s%d_t", f->param.use_signed ? "int" : "uint",
+           f->param.fixed_encoding_width);
+  return buf[i];
+}
+
+/* a code of f as a C constant of its type */
+static
+const char *field_const(struct field *f, long long int x) {
+  static char buf[4][48];
+  static int i;
+  int w = f->param.fixed_encoding_width;
+  i = (i + 1) % 4;
+  if(f->param.use_signed) snprintf(buf[i], sizeof(buf[i]), "INT%d_C(%lld)", w, x);
+  else snprintf(buf[i], sizeof(buf[i]), "UINT%d_C(%llu)", w, (unsigned long long int)x);
+  return buf[i];
+}
+
+/* whether the code range is narrower than the type at each end */
+static
+bool has_low(struct field *f) {
+  int w = f->param.fixed_encoding_width;
+  return f->param.use_signed ? f->lb > -(long long int)(UINT64_C(1) << (w - 1)) : f->lb > 0;
+}
+
+static
+bool has_high(struct field *f) {
+  int w = f->param.fixed_encoding_width;
+  unsigned long long int most = w == 64 ? ~UINT64_C(0) : (UINT64_C(1) << w) - 1;
+  if(f->param.use_signed) most >>= 1;
+  return (unsigned long long int)f->ub < most || (f->param.use_signed && f->ub < 0);
+}
+
+static
+const char *field_mask(struct field *f) {
+  static char buf[4][40];
+  static int i;
+  i = (i + 1) % 4;
+  if(f->bits == 64) snprintf(buf[i], sizeof(buf[i]), "UINT64_C(0xffffffffffffffff)");
+  else snprintf(buf[i], sizeof(buf[i]), "UINT64_C(0x%llx)", (unsigned long long int)((UINT64_C(1) << f->bits) - 1));
+  return buf[i];
+}
+
+/* " + lb" to turn a stored value into a code, or " - lb" back */
+static
+const char *field_bias(struct field *f, bool to_code) {
+  static char buf[2][48];
+  static int i;
+  unsigned long long int m = f->lb < 0 ? 0 - (unsigned long long int)f->lb : (unsigned long long int)f->lb;
+  i = !i;
+  if(f->lb == 0) return "";
+  snprintf(buf[i], sizeof(buf[i]), " %c UINT64_C(%llu)", (f->lb < 0) == to_code ? '-' : '+', m);
+  return buf[i];
+}
+
+static
+void gen_record(struct record *r, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const char *name = r->name;
+  char upper[128], buf[41];
+  int i, j;
+  for(i = 0; name[i] && i < (int)sizeof(upper) - 1; i++) {
+    upper[i] = toupper((unsigned char)name[i]);
+  }
+  upper[i] = 0;
+
+  printf("/* generated by fpc --record */\n"
+         "#ifndef FPC_RECORD_%s_H\n"
+         "#define FPC_RECORD_%s_H\n\n"
+         "#include <stdbool.h>\n"
+         "#include <stddef.h>\n"
+         "#include <stdint.h>\n"
+         "#include <string.h>\n\n", upper, upper);
+
+  printf("/* %s: %u byte%s per record (%u as a struct of codes), %s layout,\n"
+         "   each field stored as code - lower bound at a bit offset, little endian\n\n"
+         "   field            bits  byte.bit  format\n", name, r->size, r->size > 1 ? "s" : "", r->natural,
+         r->stream ? "stream" : "words");
+  for(i = 0; i < r->n; i++) {
+    struct field *x = &r->fields[i];
+    printf("   %-16s %4u  %4u.%u    [%.19Lg, %.19Lg] in steps of 2^%d", x->name, x->bits,
+           x->bit / 8, x->bit % 8, ldexpl(x->param.lower_bound, -x->param.fractional_bits),
+           ldexpl(x->param.upper_bound, -x->param.fractional_bits), -x->param.fractional_bits);
+    if(x->param.offset) printf(" with offset %s", int128_str(x->param.offset, buf));
+    printf("\n");
+  }
+  printf("*/\n"
+         "typedef struct {\n"
+         "  _Alignas(%u) uint8_t bytes[%u];\n"
+         "} %s_t;\n\n", r->align, r->size, name);
+
+  printf("/* the fields as codes */\n"
+         "typedef struct {\n");
+  for(i = 0; i < r->n; i++) printf("  %s %s;\n", field_type(&r->fields[i]), r->fields[i].name);
+  printf("} %s_fields_t;\n\n", name);
+
+  // single fields
+  for(i = 0; i < r->n; i++) {
+    struct field *x = &r->fields[i];
+    unsigned int byte, shift, n;
+    field_access(r, x, &byte, &shift, &n);
+    const char *word = n > 8 ? "unsigned __int128" : "uint64_t", *t = field_type(x);
+    printf("static inline %s %s_get_%s(const %s_t *r) {\n"
+           "  %s w = 0;\n"
+           "  memcpy(&w, r->bytes + %u, %u);\n", t, name, x->name, name, word, byte, n);
+    char load[64];
+    if(shift) snprintf(load, sizeof(load), "((uint64_t)(w >> %u) & %s)", shift, field_mask(x));
+    else snprintf(load, sizeof(load), "((uint64_t)w & %s)", field_mask(x));
+    if(*field_bias(x, true)) printf("  return (%s)(%s%s);\n", t, load, field_bias(x, true));
+    else printf("  return (%s)%s;\n", t, load);
+    printf("}\n\n"
+           "/* returns false, leaving r alone, if x is out of range */\n"
+           "static inline bool %s_set_%s(%s_t *r, %s x) {\n"
+           "  %s w = 0;\n", name, x->name, name, t, word);
+    if(has_low(x) || has_high(x)) {
+      printf("  if(");
+      if(has_low(x)) printf("x < %s%s", field_const(x, x->lb), has_high(x) ? " || " : "");
+      if(has_high(x)) printf("x > %s", field_const(x, x->ub));
+      printf(") {\n"
+             "    return false;\n"
+             "  }\n");
+    }
+    printf("  memcpy(&w, r->bytes + %u, %u);\n", byte, n);
+    if(shift) {
+      printf("  w &= ~((%s)%s << %u);\n"
+             "  w |= (%s)((uint64_t)x%s) << %u;\n", word, field_mask(x), shift, word,
+             field_bias(x, false), shift);
+    } else {
+      printf("  w &= ~%s;\n"
+             "  w |= (uint64_t)x%s;\n", field_mask(x), field_bias(x, false));
+    }
+    printf("  memcpy(r->bytes + %u, &w, %u);\n"
+           "  return true;\n"
+           "}\n\n", byte, n);
+  }
+
+  // whole records
+  printf("/* encode every field, saturating codes out of range,\n"
+         "   returns the number out of range */\n"
+         "static inline size_t %s_encode(%s_t *r, const %s_fields_t *v) {\n"
+         "  size_t errors = 0;\n", name, name, name);
+  for(i = 0; i < r->n; i++) {
+    struct field *x = &r->fields[i];
+    printf("  uint64_t f%d = (uint64_t)v->%s%s;\n", i, x->name, field_bias(x, false));
+    if(has_low(x)) {
+      printf("  if(v->%s < %s) {\n"
+             "    f%d = 0;\n"
+             "    errors++;\n"
+             "  }\n", x->name, field_const(x, x->lb), i);
+    }
+    if(has_high(x)) {
+      printf("  if(v->%s > %s) {\n"
+             "    f%d = UINT64_C(%llu);\n"
+             "    errors++;\n"
+             "  }\n", x->name, field_const(x, x->ub), i,
+             (unsigned long long int)x->ub - x->lb);
+    }
+  }
+  for(j = 0; j < r->n_chunks; j++) {
+    unsigned int cs = r->chunks[j].byte * 8, ce = cs + r->chunks[j].size * 8;
+    bool any = false;
+    printf("  uint64_t w%d = ", j);
+    for(i = 0; i < r->n; i++) {
+      struct field *x = &r->fields[i];
+      if(x->bit >= ce || x->bit + x->bits <= cs) continue;
+      printf("%s", any ? " | " : "");
+      if(x->bit > cs) printf("f%d << %u", i, x->bit - cs);
+      else if(x->bit < cs) printf("f%d >> %u", i, cs - x->bit);
+      else printf("f%d", i);
+      any = true;
+    }
+    printf("%s;\n"
+           "  memcpy(r->bytes + %u, &w%d, %u);\n", any ? "" : "0", r->chunks[j].byte, j,
+           r->chunks[j].size);
+  }
+  unsigned int used = r->chunks[r->n_chunks - 1].byte + r->chunks[r->n_chunks - 1].size;
+  if(used < r->size) printf("  memset(r->bytes + %u, 0, %u);\n", used, r->size - used);
+  printf("  return errors;\n"
+         "}\n\n");
+
+  printf("static inline void %s_decode(const %s_t *r, %s_fields_t *v) {\n", name, name, name);
+  for(i = 0; i < r->n; i++) printf("  v->%s = %s_get_%s(r);\n", r->fields[i].name, name, r->fields[i].name);
+  printf("}\n\n"
+         "#endif\n");
+#undef printf
+}
+
+/* a program encoding, decoding and setting random fields of RECORDS
+   records, and checking codes out of range are refused */
+static
+void gen_record_check(struct record *r, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const char *name = r->name;
+  int i;
+  printf("\n"
+         "#include <stdio.h>\n"
+         "#include <stdlib.h>\n\n"
+         "#define RECORDS 100000\n\n"
+         "static uint64_t record_state = UINT64_C(88172645463325252);\n\n"
+         "static uint64_t record_random(void) {\n"
+         "  record_state ^= record_state << 13;\n"
+         "  record_state ^= record_state >> 7;\n"
+         "  record_state ^= record_state << 17;\n"
+         "  return record_state;\n"
+         "}\n\n");
+  printf("/* a random code for field k of v */\n"
+         "static void record_random_field(%s_fields_t *v, int k) {\n"
+         "  switch(k) {\n", name);
+  for(i = 0; i < r->n; i++) {
+    struct field *x = &r->fields[i];
+    if((unsigned long long int)x->ub - x->lb == ~0ULL) {
+      printf("  case %d: v->%s = (%s)record_random(); break;\n", i, x->name, field_type(x));
+    } else {
+      printf("  case %d: v->%s = (%s)(UINT64_C(%llu) + record_random() %% UINT64_C(%llu)); break;\n",
+             i, x->name, field_type(x), (unsigned long long int)x->lb,
+             (unsigned long long int)x->ub - x->lb + 1);
+    }
+  }
+  printf("  }\n"
+         "}\n\n");
+  printf("/* set field k of r to the same field of v */\n"
+         "static bool record_set_field(%s_t *r, const %s_fields_t *v, int k) {\n"
+         "  switch(k) {\n", name, name);
+  for(i = 0; i < r->n; i++) {
+    printf("  case %d: return %s_set_%s(r, v->%s);\n", i, name, r->fields[i].name, r->fields[i].name);
+  }
+  printf("  }\n"
+         "  return false;\n"
+         "}\n\n");
+  printf("static bool record_same(const %s_fields_t *a, const %s_fields_t *b) {\n"
+         "  return true", name, name);
+  for(i = 0; i < r->n; i++) printf(" &&\n    a->%s == b->%s", r->fields[i].name, r->fields[i].name);
+  printf(";\n"
+         "}\n\n");
+
+  printf("int main(void) {\n"
+         "  %s_t *records = malloc(RECORDS * sizeof(%s_t));\n"
+         "  %s_fields_t *values = malloc(RECORDS * sizeof(%s_fields_t)), v;\n"
+         "  size_t i, bad = 0;\n"
+         "  int k;\n"
+         "  for(i = 0; i < RECORDS; i++) {\n"
+         "    for(k = 0; k < %d; k++) record_random_field(&values[i], k);\n"
+         "    if(%s_encode(&records[i], &values[i]) != 0) bad++;\n"
+         "  }\n"
+         "  for(i = 0; i < RECORDS; i++) {\n"
+         "    %s_decode(&records[i], &v);\n"
+         "    if(!record_same(&v, &values[i])) bad++;\n"
+         "  }\n"
+         "  printf(\"%s: %%d records of %%zu bytes: %%s\\n\", RECORDS, sizeof(%s_t), bad ? \"FAIL\" : \"ok\");\n",
+         name, name, name, name, r->n, name, name, name, name);
+  printf("  size_t whole_bad = bad;\n"
+         "  for(i = 0; i < RECORDS; i++) {\n"
+         "    k = (int)(i %% %d);\n"
+         "    record_random_field(&values[i], k);\n"
+         "    if(!record_set_field(&records[i], &values[i], k)) bad++;\n"
+         "    %s_decode(&records[i], &v);\n"
+         "    if(!record_same(&v, &values[i])) bad++;\n"
+         "  }\n"
+         "  printf(\"  set single fields: %%s\\n\", bad > whole_bad ? \"FAIL\" : \"ok\");\n"
+         "  whole_bad = bad;\n", r->n, name);
+  for(i = 0; i < r->n; i++) {
+    struct field *x = &r->fields[i];
+    if(!has_low(x)) continue;
+    printf("  v = values[0];\n"
+           "  v.%s = %s - 1;\n"
+           "  if(%s_set_%s(&records[0], v.%s) || %s_encode(&records[0], &v) != 1 ||\n"
+           "     %s_get_%s(&records[0]) != %s) bad++;\n",
+           x->name, field_const(x, x->lb), name, x->name, x->name, name, name, x->name,
+           field_const(x, x->lb));
+  }
+  printf("  printf(\"  out of range: %%s\\n\", bad > whole_bad ? \"FAIL\" : \"ok\");\n"
+         "  free(records);\n"
+         "  free(values);\n"
+         "  return bad != 0;\n"
+         "}\n");
+#undef printf
+}
+
+/* read "field min max precision" lines into args, returns the count */
+static
+int read_schema(FILE *in, char ***args) {
+  char *line = NULL;
+  size_t size = 0;
+  int n = 0;
+  *args = NULL;
+  while(getline(&line, &size, in) >= 0) {
+    char *p = line + strspn(line, " \t\r\n"), *save, *tok;
+    if(!*p || *p == '#') continue;
+    for(tok = strtok_r(p, " \t\r\n", &save); tok; tok = strtok_r(NULL, " \t\r\n", &save)) {
+      *args = realloc(*args, sizeof(**args) * (n + 1));
+      (*args)[n++] = strdup(tok);
+    }
+  }
+  free(line);
+  return n;
+}
+
+int record_main(int argc, char **argv) {
+  static struct record r;
+  enum layout layout = LAYOUT_AUTO;
+  bool check = false;
+  char **schema = NULL;
+  int i, j, n_schema = 0;
+
+  memset(&r, 0, sizeof(r));
+  r.align = 1;
+  for(; argc > 0 && argv[0][0] == '-' && argv[0][1] == '-'; argc--, argv++) {
+    if(strcmp(argv[0], "--check") == 0) {
+      check = true;
+    } else if(strncmp(argv[0], "--layout=", 9) == 0) {
+      const char *l = argv[0] + 9;
+      if(strcmp(l, "auto") == 0) layout = LAYOUT_AUTO;
+      else if(strcmp(l, "words") == 0) layout = LAYOUT_WORDS;
+      else if(strcmp(l, "stream") == 0) layout = LAYOUT_STREAM;
+      else {
+        fprintf(stderr, "ERROR: unknown layout: %s\n", l);
+        return -1;
+      }
+    } else if(strncmp(argv[0], "--align=", 8) == 0) {
+      r.align = atoi(argv[0] + 8);
+      if(r.align < 1 || r.align > 64 || (r.align & (r.align - 1))) {
+        fprintf(stderr, "ERROR: alignment must be a power of two up to 64: %s\n", argv[0] + 8);
+        return -1;
+      }
+    } else break;
+  }
+  if(argc == 2) {
+    FILE *in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "r");
+    if(!in) {
+      perror(argv[1]);
+      return -1;
+    }
+    n_schema = read_schema(in, &schema);
+    if(in != stdin) fclose(in);
+  } else if(argc > 2) {
+    schema = argv + 1;
+    n_schema = argc - 1;
+  }
+  if(argc < 2 || n_schema % 4) {
+    fprintf(stderr, "fpc --record [--check] [--layout=auto|words|stream] [--align=bytes]\n"
+            "             [name] [field] [min] [max] [precision] ...\n"
+            "fpc --record ... [name] [schema file of field min max precision lines, or -]\n");
+    return -1;
+  }
+  if(!gen_valid_name(argv[0])) {
+    fprintf(stderr, "ERROR: %s: not a C identifier\n", argv[0]);
+    return -1;
+  }
+  if(gen_reserved_name(argv[0])) {
+    fprintf(stderr, "ERROR: %s: %s_t is a standard type\n", argv[0], argv[0]);
+    return -1;
+  }
+  r.name = argv[0];
+  r.n = n_schema / 4;
+  if(r.n == 0 || r.n > MAX_FIELDS) {
+    fprintf(stderr, "ERROR: a record needs 1 to %d fields\n", MAX_FIELDS);
+    return -1;
+  }
+  for(i = 0; i < r.n; i++) {
+    struct field *x = &r.fields[i];
+    char **arg = schema + 4 * i;
+    if(!gen_valid_name(arg[0])) {
+      fprintf(stderr, "ERROR: %s: not a C identifier\n", arg[0]);
+      return -1;
+    }
+    for(j = 0; j < i; j++) {
+      if(strcmp(arg[0], r.fields[j].name) == 0) {
+        fprintf(stderr, "ERROR: %s: duplicate field\n", arg[0]);
+        return -1;
+      }
+    }
+    x->name = arg[0];
+    if(!fpc_calculate_from_strings(arg[1], arg[2], arg[3], &x->param)) {
+      fprintf(stderr, "ERROR: %s: %s\n", arg[0], x->param.error);
+      return -1;
+    }
+    if(x->param.fixed_encoding_width > 64) {
+      fprintf(stderr, "ERROR: %s: codes wider than 64 bits\n", arg[0]);
+      return -1;
+    }
+    x->lb = (long long int)(x->param.lower_bound - x->param.offset);
+    x->ub = (long long int)(x->param.upper_bound - x->param.offset);
+    x->bits = gen_arith_bits((int128_t)x->ub - x->lb) - 1;
+    if(x->bits == 0) x->bits = 1;
+  }
+
+  plan(&r, layout);
+  gen_record(&r, stdout);
+  if(check) gen_record_check(&r, stdout);
+  return 0;
+}
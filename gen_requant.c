@@ -0,0 +1,520 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "gen.h"
+#include "modes.h"
+
+/* Re-quantization from one fpc format to another in integers.
+
+   A code c of a format with fractional bits f and offset o stands for
+   (c + o) * 2^-f, so the code of the same value in the destination is
+   d = (c + oa) * 2^(fb - fa) - ob.  Going to more fractional bits that
+   is c * 2^s + (oa * 2^s - ob).  Going to fewer it rounds ties away
+   from zero, as --arith does: with oa = q * 2^k + rem,
+   d = ((c + rem + 2^(k-1) - neg) >> k) + (q - ob), where neg = c < -oa
+   is the sign of the value.  The shift is of a non-negative number, with
+   a multiple of 2^k moved from one constant to the other, so it can be
+   a logical one, which SSE2 and AVX2 have at 64 bits.  Large offsets
+   fold into the constants, so the work is in the narrowest of 32, 64
+   and 128 bits that holds the source codes, and the loop has no
+   branches for the compiler to vectorize like gen_batch.c's.
+
+   Source codes outside their range are clamped to it first, and d to
+   the destination's code range; the array kernel returns how many
+   values were clamped by either. */
+
+struct requant {
+  const char *from, *to;
+  struct fpc_parameters a, b;
+  int shift; /* fb - fa */
+  int w; /* the intermediate width */
+  int128_t tmin, tmax; /* the source codes */
+  bool in_low, in_high; /* whether the source type has codes below or above them */
+  int128_t add, rem, neg_below; /* the constants above, see plan() */
+  int neg; /* 0, 1 or -1 for c < neg_below */
+  int128_t lo, hi; /* the destination codes */
+  bool low, high; /* whether the result can be below lo or above hi */
+};
+
+static
+int128_t type_min(struct fpc_parameters *p) {
+  return p->use_signed ? -((int128_t)1 << (p->fixed_encoding_width - 1)) : 0;
+}
+
+static
+int128_t type_max(struct fpc_parameters *p) {
+  return ((int128_t)1 << (p->fixed_encoding_width - p->use_signed)) - 1;
+}
+
+/* floor(x / 2^k) */
+static
+int128_t floor_shift(int128_t x, int k) {
+  return x >> k;
+}
+
+static
+int max_bits(int bits, int128_t x) {
+  int b = gen_arith_bits(x);
+  return b > bits ? b : bits;
+}
+
+static
+bool plan(struct requant *r) {
+  int128_t oa = r->a.offset, ob = r->b.offset, lo, hi;
+  int bits = 0;
+  r->shift = r->b.fractional_bits - r->a.fractional_bits;
+  r->tmin = r->a.lower_bound - oa;
+  r->tmax = r->a.upper_bound - oa;
+  r->in_low = r->tmin > type_min(&r->a);
+  r->in_high = r->tmax < type_max(&r->a);
+  r->lo = r->b.lower_bound - ob;
+  r->hi = r->b.upper_bound - ob;
+  if(r->shift >= 0) {
+    if(gen_arith_bits(oa) + r->shift > 126 || r->shift > 62) return false;
+    r->add = oa * ((int128_t)1 << r->shift) - ob;
+    lo = r->tmin * ((int128_t)1 << r->shift) + r->add;
+    hi = r->tmax * ((int128_t)1 << r->shift) + r->add;
+    bits = max_bits(max_bits(bits, r->tmin * ((int128_t)1 << r->shift)), r->tmax * ((int128_t)1 << r->shift));
+  } else {
+    int k = -r->shift;
+    if(k > 126) return false;
+    int128_t q = floor_shift(oa, k), base;
+    r->rem = oa - q * ((int128_t)1 << k) + ((int128_t)1 << (k - 1));
+    r->add = q - ob;
+    r->neg_below = -oa;
+    r->neg = -oa <= r->tmin ? 0 : -oa > r->tmax ? 1 : -1;
+    // keep the shifted number non-negative
+    base = floor_shift(r->tmin + r->rem - (r->neg != 0), k);
+    r->rem -= base * ((int128_t)1 << k);
+    r->add += base;
+    bits = max_bits(max_bits(bits, r->tmin), r->tmax + r->rem);
+    lo = floor_shift(r->tmin + r->rem - (r->neg != 0), k) + r->add;
+    hi = floor_shift(r->tmax + r->rem, k) + r->add;
+  }
+  bits = max_bits(max_bits(bits, lo), hi);
+  bits = max_bits(max_bits(bits, r->lo), r->hi);
+  bits = max_bits(bits, r->add);
+  r->w = gen_arith_width(bits);
+  r->low = lo < r->lo;
+  r->high = hi > r->hi;
+  return r->w != 0;
+}
+
+static
+const char *type_of(struct fpc_parameters *p) {
+  static char buf[2][16];
+  static int i;
+  i = !i;
+  snprintf(buf[i], sizeof(buf[i]), "%s%d_t", p->use_signed ? "int" : "uint", p->fixed_encoding_width);
+  return buf[i];
+}
+
+/* the statements setting r to the clamped code of x and bad to whether
+   it was clamped */
+/* c, x clamped to the source codes */
+static
+void print_source(FILE *f, struct requant *r, const char *indent) {
+  fprintf(f, "%s%s_t c = ", indent, r->from);
+  if(r->in_low) {
+    fprintf(f, "x < ");
+    gen_arith_const(f, r->tmin);
+    fprintf(f, " ? ");
+    gen_arith_const(f, r->tmin);
+    fprintf(f, " : ");
+  }
+  if(r->in_high) {
+    fprintf(f, "x > ");
+    gen_arith_const(f, r->tmax);
+    fprintf(f, " ? ");
+    gen_arith_const(f, r->tmax);
+    fprintf(f, " : ");
+  }
+  fprintf(f, "x;\n");
+}
+
+/* " + x" or " - -x" */
+static
+void print_add(FILE *f, int128_t x) {
+  fprintf(f, x < 0 ? " - " : " + ");
+  gen_arith_const(f, x < 0 ? -x : x);
+}
+
+/* the statements setting v to the clamped code of x and, if count,
+   bad to whether either end was clamped */
+static
+void print_body(FILE *f, struct requant *r, const char *indent, bool count) {
+  bool clamp_in = r->in_low || r->in_high;
+  const char *t = gen_arith_type(r->w), *c = clamp_in ? "c" : "x";
+  if(clamp_in) print_source(f, r, indent);
+  if(r->shift >= 0) {
+    fprintf(f, "%s%s v = (%s)%s", indent, t, t, c);
+    if(r->shift) fprintf(f, " * ((%s)1 << %d)", t, r->shift);
+  } else {
+    fprintf(f, "%s%s v = (%s)((%s)((%s)%s", indent, t, t,
+            r->w == 128 ? "unsigned __int128" : r->w == 64 ? "uint64_t" : "uint32_t", t, c);
+    print_add(f, r->rem);
+    if(r->neg == 1) fprintf(f, " - 1");
+    if(r->neg == -1) {
+      fprintf(f, " - (%s < ", c);
+      gen_arith_const(f, r->neg_below);
+      fprintf(f, ")");
+    }
+    fprintf(f, ") >> %d)", -r->shift);
+  }
+  if(r->add) print_add(f, r->add);
+  fprintf(f, ";\n");
+  if(count) {
+    bool any = false;
+    fprintf(f, "%sbad = ", indent);
+    if(clamp_in) {
+      fprintf(f, "(c != x)");
+      any = true;
+    }
+    if(r->low) {
+      fprintf(f, "%s(v < ", any ? " | " : "");
+      gen_arith_const(f, r->lo);
+      fprintf(f, ")");
+      any = true;
+    }
+    if(r->high) {
+      fprintf(f, "%s(v > ", any ? " | " : "");
+      gen_arith_const(f, r->hi);
+      fprintf(f, ")");
+      any = true;
+    }
+    fprintf(f, "%s;\n", any ? "" : "false");
+  }
+  if(r->low) {
+    fprintf(f, "%sv = v < ", indent);
+    gen_arith_const(f, r->lo);
+    fprintf(f, " ? ");
+    gen_arith_const(f, r->lo);
+    fprintf(f, " : v;\n");
+  }
+  if(r->high) {
+    fprintf(f, "%sv = v > ", indent);
+    gen_arith_const(f, r->hi);
+    fprintf(f, " ? ");
+    gen_arith_const(f, r->hi);
+    fprintf(f, " : v;\n");
+  }
+}
+
+static
+void print_format(FILE *f, const char *name, struct fpc_parameters *p) {
+  fprintf(f, "/* %s: [%.19Lg, %.19Lg] in steps of 2^%d", name,
+          ldexpl(p->lower_bound, -p->fractional_bits),
+          ldexpl(p->upper_bound, -p->fractional_bits), -p->fractional_bits);
+  if(p->offset) {
+    char buf[41];
+    fprintf(f, " with offset %s", int128_str(p->offset, buf));
+  }
+  fprintf(f, " */\n"
+          "typedef %s %s_t;\n\n", type_of(p), name);
+}
+
+static
+void gen_requant(struct requant *r, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  char guard[128], name[128], kernel[160], args[160];
+  int i, n = 0;
+  for(i = 0; r->from[i] && n < (int)sizeof(guard) - 2; i++) guard[n++] = toupper((unsigned char)r->from[i]);
+  guard[n++] = '_';
+  for(i = 0; r->to[i] && n < (int)sizeof(guard) - 1; i++) guard[n++] = toupper((unsigned char)r->to[i]);
+  guard[n] = 0;
+  snprintf(name, sizeof(name), "%s_from_%s", r->to, r->from);
+
+  printf("/* generated by fpc --requant */\n"
+         "#ifndef FPC_REQUANT_%s_H\n"
+         "#define FPC_REQUANT_%s_H\n\n"
+         "#include <stdbool.h>\n"
+         "#include <stddef.h>\n"
+         "#include <stdint.h>\n\n", guard, guard);
+  print_format(f, r->from, &r->a);
+  print_format(f, r->to, &r->b);
+
+  printf("/* x in the format of %s, rounded ties away from zero and clamped to\n"
+         "   its codes, working in %d bits */\n"
+         "static inline %s_t %s(%s_t x) {\n", r->to, r->w, r->to, name, r->from);
+  print_body(f, r, "  ", false);
+  printf("  return (%s_t)v;\n"
+         "}\n\n", r->to);
+
+  printf("/* %s() for n codes, returns how many were clamped.  The loop is\n"
+         "   branch free for the compiler to vectorize%s; it is built at -O3\n"
+         "   with an AVX2 copy picked at run time where the CPU has it. */\n"
+         "#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))\n"
+         "#define CONVERT_N_X86\n"
+         "#endif\n"
+         "#if defined(__GNUC__) && !defined(__clang__)\n"
+         "#pragma GCC push_options\n"
+         "#pragma GCC optimize(\"O3\")\n"
+         "#endif\n\n", name, r->w == 128 ? " (not at 128 bits)" : "");
+  snprintf(kernel, sizeof(kernel), "%s_kernel", name);
+  // count in lanes as narrow as the codes, a block at a time
+  int count = r->a.fixed_encoding_width < r->b.fixed_encoding_width ?
+    r->a.fixed_encoding_width : r->b.fixed_encoding_width;
+  if(count < 16) count = 16;
+  printf("static inline __attribute__((always_inline))\n"
+         "size_t %s(const %s_t *restrict in, %s_t *restrict out, size_t n) {\n",
+         kernel, r->from, r->to);
+  if(count < 64) {
+    printf("  size_t i = 0, clamped = 0;\n"
+           "  while(i < n) {\n"
+           "    // a block of clamps fits the narrow counter\n"
+           "    size_t end = n - i < %lluu ? n : i + %lluu;\n"
+           "    uint%d_t block = 0;\n"
+           "    for(; i < end; i++) {\n"
+           "      %s_t x = in[i];\n"
+           "      bool bad;\n", 1ULL << (count - 1), 1ULL << (count - 1), count, r->from);
+    print_body(f, r, "      ", true);
+    printf("      block += bad;\n"
+           "      out[i] = (%s_t)v;\n"
+           "    }\n"
+           "    clamped += block;\n"
+           "  }\n", r->to);
+  } else {
+    printf("  size_t i, clamped = 0;\n"
+           "  for(i = 0; i < n; i++) {\n"
+           "    %s_t x = in[i];\n"
+           "    bool bad;\n", r->from);
+    print_body(f, r, "    ", true);
+    printf("    clamped += bad;\n"
+           "    out[i] = (%s_t)v;\n"
+           "  }\n", r->to);
+  }
+  printf("  return clamped;\n"
+         "}\n\n");
+  snprintf(name, sizeof(name), "%s_from_%s_n", r->to, r->from);
+  snprintf(args, sizeof(args), "const %s_t *in, %s_t *out, size_t n", r->from, r->to);
+  gen_dispatch(name, kernel, "avx2", args, "in, out, n", true, f);
+  printf("\n"
+         "#if defined(__GNUC__) && !defined(__clang__)\n"
+         "#pragma GCC pop_options\n"
+         "#endif\n\n"
+         "#endif\n");
+#undef printf
+}
+
+/* a program comparing both functions to an __int128 reference on every
+   source code, or 2^20 random ones and the edges, with -b timing the
+   kernel against the scalar function and a round trip through double */
+static
+void gen_requant_check(struct requant *r, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const char *from = r->from, *to = r->to;
+  int w = r->a.fixed_encoding_width, i, k = -r->shift;
+  bool all = w <= 16;
+
+  printf("\n"
+         "#include <stdio.h>\n"
+         "#include <stdlib.h>\n"
+         "#include <string.h>\n"
+         "#include <math.h>\n"
+         "#include <time.h>\n\n"
+         "#define REQUANT_N %d\n\n", all ? 1 << w : 1 << 20);
+  printf("static uint64_t requant_state = UINT64_C(88172645463325252);\n\n"
+         "static uint64_t requant_random(void) {\n"
+         "  requant_state ^= requant_state << 13;\n"
+         "  requant_state ^= requant_state >> 7;\n"
+         "  requant_state ^= requant_state << 17;\n"
+         "  return requant_state;\n"
+         "}\n\n");
+  printf("/* (x + offset) * 2^%d - offset exactly, clamped */\n"
+         "static %s_t requant_reference(%s_t x, bool *bad) {\n"
+         "  bool clamp = x < ", r->shift, to, from);
+  gen_arith_const(f, r->tmin);
+  printf(" || x > ");
+  gen_arith_const(f, r->tmax);
+  printf(";\n"
+         "  if(x < ");
+  gen_arith_const(f, r->tmin);
+  printf(") x = ");
+  gen_arith_const(f, r->tmin);
+  printf(";\n"
+         "  if(x > ");
+  gen_arith_const(f, r->tmax);
+  printf(") x = ");
+  gen_arith_const(f, r->tmax);
+  printf(";\n"
+         "  __int128 v = (__int128)x + ");
+  gen_arith_const(f, r->a.offset);
+  printf(";\n");
+  if(r->shift > 0) {
+    printf("  v *= (__int128)1 << %d;\n", r->shift);
+  } else if(r->shift < 0) {
+    printf("  __int128 h = (__int128)1 << %d;\n"
+           "  v = v >= 0 ? (v + h) >> %d : -((-v + h) >> %d);\n", k - 1, k, k);
+  }
+  printf("  v -= ");
+  gen_arith_const(f, r->b.offset);
+  printf(";\n"
+         "  *bad = clamp || v < ");
+  gen_arith_const(f, r->lo);
+  printf(" || v > ");
+  gen_arith_const(f, r->hi);
+  printf(";\n"
+         "  return (%s_t)(v < ", to);
+  gen_arith_const(f, r->lo);
+  printf(" ? ");
+  gen_arith_const(f, r->lo);
+  printf(" : v > ");
+  gen_arith_const(f, r->hi);
+  printf(" ? ");
+  gen_arith_const(f, r->hi);
+  printf(" : v);\n"
+         "}\n\n");
+
+  printf("/* the old way, through the value as a double */\n"
+         "static %s_t requant_double(%s_t x) {\n"
+         "  double d = ((double)x + %.17g) * 0x1p%d;\n"
+         "  d = round(d * 0x1p%d) - %.17g;\n"
+         "  d = d < %.17g ? %.17g : d > %.17g ? %.17g : d;\n"
+         "  return (%s_t)d;\n"
+         "}\n\n", to, from, (double)r->a.offset, -r->a.fractional_bits,
+         r->b.fractional_bits, (double)r->b.offset,
+         (double)r->lo, (double)r->lo, (double)r->hi, (double)r->hi, to);
+
+  printf("static double requant_now(void) {\n"
+         "  struct timespec ts;\n"
+         "  clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+         "  return ts.tv_sec + ts.tv_nsec * 1e-9;\n"
+         "}\n\n");
+
+  printf("int main(int argc, char **argv) {\n"
+         "  %s_t *in = malloc(REQUANT_N * sizeof(%s_t));\n"
+         "  %s_t *out = malloc(REQUANT_N * sizeof(%s_t));\n"
+         "  size_t i, j, clamped = 0, expected = 0, bad = 0;\n",
+         from, from, to, to);
+  if(all) {
+    printf("  for(i = 0; i < REQUANT_N; i++) in[i] = (%s_t)(", from);
+    gen_arith_const(f, type_min(&r->a));
+    printf(" + (int64_t)i);\n");
+  } else {
+    printf("  for(i = 0; i < REQUANT_N; i++) in[i] = (%s_t)requant_random();\n", from);
+    // the edges of the type and both ranges
+    int128_t edges[] = {
+      type_min(&r->a), type_max(&r->a), r->tmin, r->tmax, r->neg == -1 ? r->neg_below : r->tmin
+    };
+    for(i = 0; i < (int)(sizeof(edges) / sizeof(edges[0])); i++) {
+      printf("  in[%d] = (%s_t)(", 3 * i, from);
+      gen_arith_const(f, edges[i]);
+      printf(");\n"
+             "  in[%d] = (%s_t)(in[%d] - 1);\n"
+             "  in[%d] = (%s_t)(in[%d] + 1);\n", 3 * i + 1, from, 3 * i, 3 * i + 2, from, 3 * i);
+    }
+  }
+  printf("  // uneven pieces for the vector loop tails\n"
+         "  for(i = 0; i < REQUANT_N; i += j) {\n"
+         "    j = 1 + requant_random() %% 300;\n"
+         "    if(j > REQUANT_N - i) j = REQUANT_N - i;\n"
+         "    clamped += %s_from_%s_n(in + i, out + i, j);\n"
+         "  }\n"
+         "  for(i = 0; i < REQUANT_N; i++) {\n"
+         "    bool clamp;\n"
+         "    %s_t want = requant_reference(in[i], &clamp);\n"
+         "    expected += clamp;\n"
+         "    if(out[i] != want || %s_from_%s(in[i]) != want) {\n"
+         "      if(bad++ < 10) {\n"
+         "        printf(\"%%lld: %%lld, expected %%lld\\n\", (long long int)in[i],\n"
+         "               (long long int)out[i], (long long int)want);\n"
+         "      }\n"
+         "    }\n"
+         "  }\n"
+         "  bool failed = bad || clamped != expected;\n"
+         "  printf(\"%s -> %s: %%d codes, %%zu clamped: %%s\\n\", REQUANT_N, clamped,\n"
+         "         failed ? \"FAIL\" : \"ok\");\n",
+         to, from, to, to, from, from, to);
+  printf("  if(argc > 1 && strcmp(argv[1], \"-b\") == 0) {\n"
+         "    int reps = 100;\n"
+         "    double t = requant_now();\n"
+         "    for(i = 0; i < (size_t)reps; i++) clamped += %s_from_%s_n(in, out, REQUANT_N);\n"
+         "    double kernel = (requant_now() - t) / ((double)reps * REQUANT_N);\n"
+         "    t = requant_now();\n"
+         "    for(i = 0; i < (size_t)reps; i++) {\n"
+         "      for(j = 0; j < REQUANT_N; j++) out[j] = %s_from_%s(in[j]);\n"
+         "      clamped += out[i];\n"
+         "    }\n"
+         "    double scalar = (requant_now() - t) / ((double)reps * REQUANT_N);\n"
+         "    t = requant_now();\n"
+         "    for(i = 0; i < (size_t)reps; i++) {\n"
+         "      for(j = 0; j < REQUANT_N; j++) out[j] = requant_double(in[j]);\n"
+         "      clamped += out[i];\n"
+         "    }\n"
+         "    double through = (requant_now() - t) / ((double)reps * REQUANT_N);\n"
+         "    printf(\"  kernel %%.3f ns, scalar %%.3f ns, through double %%.3f ns per value\\n\",\n"
+         "           kernel * 1e9, scalar * 1e9, through * 1e9);\n"
+         "    if(clamped == 42) printf(\"\\n\"); // keep the results live\n"
+         "  }\n"
+         "  free(in);\n"
+         "  free(out);\n"
+         "  return failed;\n"
+         "}\n", to, from, to, from);
+#undef printf
+}
+
+int requant_main(int argc, char **argv) {
+  struct requant r;
+  bool check = false;
+
+  memset(&r, 0, sizeof(r));
+  for(; argc > 0 && strcmp(argv[0], "--check") == 0; argc--, argv++) check = true;
+  if(argc != 8) {
+    fprintf(stderr, "fpc --requant [--check] [from] [min] [max] [precision] [to] [min] [max] [precision]\n");
+    return -1;
+  }
+  r.from = argv[0];
+  r.to = argv[4];
+  if(!gen_valid_name(r.from) || !gen_valid_name(r.to)) {
+    fprintf(stderr, "ERROR: %s: not a C identifier\n", gen_valid_name(r.from) ? r.to : r.from);
+    return -1;
+  }
+  if(gen_reserved_name(r.from) || gen_reserved_name(r.to)) {
+    const char *name = gen_reserved_name(r.from) ? r.from : r.to;
+    fprintf(stderr, "ERROR: %s: %s_t is a standard type\n", name, name);
+    return -1;
+  }
+  if(strcmp(r.from, r.to) == 0) {
+    fprintf(stderr, "ERROR: %s: the formats need different names\n", r.to);
+    return -1;
+  }
+  if(!fpc_calculate_from_strings(argv[1], argv[2], argv[3], &r.a)) {
+    fprintf(stderr, "ERROR: %s: %s\n", r.from, r.a.error);
+    return -1;
+  }
+  if(!fpc_calculate_from_strings(argv[5], argv[6], argv[7], &r.b)) {
+    fprintf(stderr, "ERROR: %s: %s\n", r.to, r.b.error);
+    return -1;
+  }
+  if(r.a.fixed_encoding_width > 64 || r.b.fixed_encoding_width > 64) {
+    fprintf(stderr, "ERROR: %s: codes wider than 64 bits\n",
+            r.a.fixed_encoding_width > 64 ? r.from : r.to);
+    return -1;
+  }
+  if(!plan(&r)) {
+    fprintf(stderr, "ERROR: %s to %s needs more than 128 bits\n", r.from, r.to);
+    return -1;
+  }
+  gen_requant(&r, stdout);
+  if(check) gen_requant_check(&r, stdout);
+  return 0;
+}
@@ -0,0 +1,242 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gen.h"
+
+/* Converters without libm calls.  ldexp() becomes a multiply by an
+   exact power of two and round() one of the helpers below.  When the
+   display rounding in convert_to_double() can be done exactly in
+   integers it is, otherwise it is the same double expression as the
+   libm version, so convert_to_double() always matches it bit for bit.
+   convert_from_double() uses the selected rounding. */
+
+static const char *rounding_names[] = {
+  [ROUNDING_LIBM] = "libm",
+  [ROUNDING_NEAREST] = "nearest",
+  [ROUNDING_EVEN] = "even",
+  [ROUNDING_LRINT] = "lrint",
+  [ROUNDING_TRUNC] = "trunc",
+  [ROUNDING_FLOOR] = "floor"
+};
+
+static const char *rounding_helpers[] = {
+  [ROUNDING_NEAREST] = "round_nearest",
+  [ROUNDING_EVEN] = "round_even",
+  [ROUNDING_LRINT] = "round_lrint",
+  [ROUNDING_TRUNC] = "round_trunc",
+  [ROUNDING_FLOOR] = "round_floor"
+};
+
+bool gen_parse_rounding(const char *name, enum gen_rounding *rounding) {
+  unsigned int i;
+  for(i = 0; i < sizeof(rounding_names) / sizeof(rounding_names[0]); i++) {
+    if(strcmp(name, rounding_names[i]) == 0) {
+      *rounding = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* constants as the libm version prints them, and so as the compiler sees them */
+static
+double scale(struct fpc_parameters *param) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.19Lg", 1.0L / param->precision);
+  return strtod(buf, NULL);
+}
+
+/* can the display rounding be done as ((x + offset) * scale) >> fractional_bits? */
+static
+bool integer_rounding(struct fpc_parameters *param) {
+  double k = scale(param);
+  int128_t
+    limit = ((int128_t)1) << 53,
+    lb = param->lower_bound < 0 ? -param->lower_bound : param->lower_bound,
+    ub = param->upper_bound < 0 ? -param->upper_bound : param->upper_bound,
+    bound = lb > ub ? lb : ub;
+  return param->precision != 1.0L &&
+    param->fractional_bits > 0 &&
+    k == floor(k) && k < 0x1p53 &&
+    bound < limit / (int128_t)k;
+}
+
+static
+bool needs_nearest(struct fpc_parameters *param) {
+  return param->precision != 1.0L && !integer_rounding(param);
+}
+
+void gen_round_helpers(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  if(needs_nearest(param) || opt->rounding == ROUNDING_NEAREST) {
+    printf("/* same as round(), ties away from zero */\n"
+           "static inline double round_nearest(double v) {\n"
+           "  if(!(v > -0x1p52 && v < 0x1p52)) return v; // integral, inf or nan\n"
+           "  double t = (double)(int64_t)v, r = v - t;\n"
+           "  t += (r >= 0.5) - (r <= -0.5);\n"
+           "  return t == 0 ? v * 0 : t; // keep the sign of zero\n"
+           "}\n\n");
+  }
+  switch(opt->rounding) {
+  case ROUNDING_EVEN:
+    printf("/* ties to even, the additions must not be reassociated (-ffast-math) */\n"
+           "static inline double round_even(double v) {\n"
+           "  if(!(v > -0x1p52 && v < 0x1p52)) return v;\n"
+           "  return v < 0 ? (v - 0x1p52) + 0x1p52 : (v + 0x1p52) - 0x1p52;\n"
+           "}\n\n");
+    break;
+  case ROUNDING_LRINT:
+    printf("/* current rounding mode, usually ties to even: cvtsd2si on x86-64,\n"
+           "   elsewhere __builtin_llrint(), which is only inline with -fno-math-errno */\n"
+           "#if defined(__x86_64__) && defined(__SSE2__)\n"
+           "#include <emmintrin.h>\n"
+           "#endif\n"
+           "static inline double round_lrint(double v) {\n"
+           "  if(!(v > -0x1p63 && v < 0x1p63)) return v;\n"
+           "#if defined(__x86_64__) && defined(__SSE2__)\n"
+           "  return (double)_mm_cvtsd_si64(_mm_set_sd(v));\n"
+           "#else\n"
+           "  return (double)__builtin_llrint(v);\n"
+           "#endif\n"
+           "}\n\n");
+    break;
+  case ROUNDING_TRUNC:
+    printf("static inline double round_trunc(double v) {\n"
+           "  if(!(v > -0x1p63 && v < 0x1p63)) return v;\n"
+           "  return (double)(int64_t)v;\n"
+           "}\n\n");
+    break;
+  case ROUNDING_FLOOR:
+    printf("static inline double round_floor(double v) {\n"
+           "  if(!(v > -0x1p63 && v < 0x1p63)) return v;\n"
+           "  double t = (double)(int64_t)v;\n"
+           "  return t > v ? t - 1 : t;\n"
+           "}\n\n");
+    break;
+  default:
+    break;
+  }
+#undef printf
+}
+
+void gen_round_to_double(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int fb = param->fractional_bits;
+  if(integer_rounding(param)) {
+    printf("  int64_t n = (int64_t)x");
+    if(param->offset) printf(" + INT64_C(%lld)", (long long int)param->offset);
+    printf(";\n"
+           "  n *= %.0f;\n", scale(param));
+    printf("  n = n < 0 ? -((-n + INT64_C(%lld)) >> %d) : (n + INT64_C(%lld)) >> %d;\n",
+           1LL << (fb - 1), fb, 1LL << (fb - 1), fb);
+    printf("  return n * %.19Lg;\n", param->precision);
+    return;
+  }
+
+  printf("  return ");
+  if(param->precision != 1.0L) {
+    printf("round_nearest(");
+  }
+  if(param->offset) printf("(");
+  if(fb) {
+    printf("x * 0x1p%d", -fb);
+  } else {
+    printf("x");
+  }
+  if(param->offset) {
+    printf(" + %.19Lg)", ldexpl(param->offset, -fb));
+  }
+  if(param->precision != 1.0L) {
+    printf(" * %.19Lg) * %.19Lg",
+           1.0L / param->precision,
+           param->precision);
+  }
+  printf(";\n");
+#undef printf
+}
+
+void gen_round_from_double(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  printf("    *y = %s(x * 0x1p%d)",
+         rounding_helpers[opt->rounding], param->fractional_bits);
+  if(param->offset != 0) {
+    printf(" - %.19Lg", (long double)param->offset);
+  }
+  printf(";\n");
+#undef printf
+}
+
+void gen_round_test(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  long long int lb = param->lower_bound - param->offset;
+  unsigned long long int
+    span = (unsigned long long int)(param->upper_bound - param->lower_bound),
+    step = span >> 32 ? (span >> 32) + 1 : 1;
+
+  printf("/* Compare against the libm converters for every code (every %lluth\n"
+         "   above 2^32 codes).  convert_from_double() is also given the values\n"
+         "   half a code either side, where the rounding modes differ. */\n", step);
+  printf("static int test(void) {\n"
+         "  const uint64_t span = UINT64_C(%llu), step = UINT64_C(%llu);\n"
+         "  unsigned long n = 0, to_bad = 0, from_bad = 0, from_far = 0;\n"
+         "  uint64_t i;\n"
+         "  int j;\n", span, step);
+  printf("  for(i = 0; ; i += step) {\n"
+         "    %s%d_t c = (%s%d_t)(UINT64_C(%llu) + i);\n",
+         s, w, s, w, (unsigned long long int)lb);
+  printf("    double r = convert_to_double_ref(c), d = convert_to_double(c);\n"
+         "    n++;\n"
+         "    if(memcmp(&r, &d, sizeof(d)) != 0 && to_bad++ < 10) {\n"
+         "      printf(\"convert_to_double(%%lld) = %%.17g, reference %%.17g\\n\", (long long)c, d, r);\n"
+         "    }\n");
+  printf("    double exact = c * 0x1p%d", -param->fractional_bits);
+  if(param->offset) printf(" + %.19Lg", ldexpl(param->offset, -param->fractional_bits));
+  printf(";\n"
+         "    double probes[3] = { r, exact - 0x1p%d, exact + 0x1p%d };\n",
+         -param->fractional_bits - 1, -param->fractional_bits - 1);
+  printf("    for(j = 0; j < 3; j++) {\n"
+         "      %s%d_t y = 0, y_ref = 0;\n"
+         "      if(isnan(probes[j])) continue;\n"
+         "      bool ok = convert_from_double(probes[j], &y);\n"
+         "      bool ok_ref = convert_from_double_ref(probes[j], &y_ref);\n"
+         "      if(ok == ok_ref && y == y_ref) continue;\n"
+         "      from_bad++;\n"
+         "      if(ok != ok_ref || fabsl((long double)y - y_ref) > 1) {\n"
+         "        if(from_far++ < 10) {\n"
+         "          printf(\"convert_from_double(%%.17g) = %%lld, reference %%lld\\n\",\n"
+         "                 probes[j], (long long)y, (long long)y_ref);\n"
+         "        }\n"
+         "      }\n"
+         "    }\n"
+         "    if(span - i < step) break;\n"
+         "  }\n", s, w);
+  printf("  printf(\"%%lu codes, %s rounding\\n\", n);\n"
+         "  printf(\"  convert_to_double: %%lu differences\\n\", to_bad);\n"
+         "  printf(\"  convert_from_double: %%lu differences, %%lu by more than one code\\n\",\n"
+         "         from_bad, from_far);\n",
+         rounding_names[opt->rounding]);
+  if(opt->rounding == ROUNDING_NEAREST) {
+    printf("  return to_bad || from_bad;\n");
+  } else {
+    printf("  return to_bad || from_far;\n");
+  }
+  printf("}\n");
+#undef printf
+}
@@ -0,0 +1,303 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <math.h>
+#include <string.h>
+
+#include "gen.h"
+
+/* Converters for scales other than a power of two, value = (code +
+   offset) * NUM / DEN.  fpc_calculate_scaled() keeps codes times NUM
+   within 2^52 so they, and the midpoints between them times NUM, are
+   exact doubles: convert_to_double() is a single correctly rounded
+   division.  convert_from_double() estimates the code by multiplying by
+   the reciprocal and corrects it by one either way from the signs of
+   x * DEN less the midpoints either side times NUM, each one fma and so
+   exact in sign, so codes are the nearest with ties to even, the same
+   for the scalar and batch converters.  The AVX2 batch kernels are also
+   compiled for FMA. */
+
+/* codes up to this magnitude can be rounded by adding and subtracting 1.5 * 2^52 */
+#define MAGIC_ROUND_LIMIT (((int128_t)1) << 51)
+
+bool gen_parse_scale(const char *name, enum fpc_scale *scale) {
+  int i;
+  for(i = FPC_SCALE_POW2; i <= FPC_SCALE_AUTO; i++) {
+    if(strcmp(name, fpc_scale_names[i]) == 0) {
+      *scale = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* num / den, or just num */
+static
+const char *step_str(const struct fpc_scaled *s, char *buf) {
+  if(s->den == 1) sprintf(buf, "%lld", s->num);
+  else sprintf(buf, "%lld/%lld", s->num, s->den);
+  return buf;
+}
+
+void gen_scale_report(const struct fpc_parameters *param, enum fpc_scale chosen, FILE *f) {
+  struct fpc_scaled s;
+  char step[48];
+  int i;
+  fprintf(f, "\n[SCALES]\n");
+  for(i = FPC_SCALE_POW2; i < FPC_SCALE_AUTO; i++) {
+    if(!fpc_calculate_scaled(param, i, &s)) {
+      fprintf(f, "  %s: %s\n", fpc_scale_names[i], s.param.error);
+      continue;
+    }
+    fprintf(f, "  %s: step %s, %d bits, %s%d_t, code density %.1Lf%%%s\n",
+            fpc_scale_names[i], step_str(&s, step),
+            s.param.integer_bits + s.param.fractional_bits,
+            s.param.use_signed ? "int" : "uint", s.param.fixed_encoding_width,
+            100.0L * s.num / s.den / param->precision,
+            (int)chosen == i ? " (used)" : "");
+  }
+}
+
+static
+bool magic(const struct fpc_parameters *p) {
+  return p->lower_bound > -MAGIC_ROUND_LIMIT && p->lower_bound < MAGIC_ROUND_LIMIT &&
+    p->upper_bound > -MAGIC_ROUND_LIMIT && p->upper_bound < MAGIC_ROUND_LIMIT;
+}
+
+/* the value of code c as a double */
+static
+void to_double_expr(const struct fpc_scaled *s, const char *c, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const struct fpc_parameters *p = &s->param;
+  if(p->offset) printf("((double)%s + %.17g)", c, (double)p->offset);
+  else printf("(double)%s", c);
+  if(s->num != 1) printf(" * %lld.0", s->num);
+  if(s->den != 1) printf(" / %lld.0", s->den);
+#undef printf
+}
+
+void gen_scale_to_double(const struct fpc_scaled *s, FILE *f) {
+  fprintf(f, "  return ");
+  to_double_expr(s, "x", f);
+  fprintf(f, ";\n");
+}
+
+/* statements setting the double c to the code for double v, saturated,
+   nearest with ties to even */
+static
+void round_code(const struct fpc_scaled *s, const char *indent, FILE *f) {
+#define printf(...) fprintf(f, "%s", indent), fprintf(f, __VA_ARGS__)
+  const struct fpc_parameters *p = &s->param;
+  double lo = gen_inward(p->lower_bound, INFINITY), hi = gen_inward(p->upper_bound, -INFINITY);
+  printf("double c = v * %a;\n", (double)s->den / s->num);
+  printf("c = c >= %.17g ? c : %.17g;\n", lo, lo);
+  printf("c = c <= %.17g ? c : %.17g;\n", hi, hi);
+  if(magic(p)) {
+    printf("c = (c + 0x1.8p52) - 0x1.8p52;\n");
+    printf("double odd = c - ((c * 0.5 + 0x1.8p52) - 0x1.8p52) * 2;\n");
+  } else {
+    printf("c = rint(c);\n");
+    printf("double odd = c - rint(c * 0.5) * 2;\n");
+  }
+  // the signs of v * DEN less the midpoints either side of c, times DEN
+  if(s->num == 1) {
+    printf("double above = fma(v, %lld.0, -(c + 0.5));\n", s->den);
+    printf("double below = fma(v, %lld.0, -(c - 0.5));\n", s->den);
+  } else {
+    printf("double above = fma(v, %lld.0, -(c + 0.5) * %lld.0);\n", s->den, s->num);
+    printf("double below = fma(v, %lld.0, -(c - 0.5) * %lld.0);\n", s->den, s->num);
+  }
+  printf("c += above > 0 || (above == 0 && odd != 0) ? 1.0 : 0.0;\n");
+  printf("c -= below < 0 || (below == 0 && odd != 0) ? 1.0 : 0.0;\n");
+  printf("c = c >= %.17g ? c : %.17g;\n", lo, lo);
+  printf("c = c <= %.17g ? c : %.17g;\n", hi, hi);
+  if(p->offset) printf("c -= %.17g;\n", (double)p->offset);
+#undef printf
+}
+
+/* the cast of the double c to the code type */
+static
+void cast_code(const struct fpc_parameters *p, FILE *f) {
+  int w = p->fixed_encoding_width;
+  const char *s = p->use_signed ? "int" : "uint";
+  if(w <= 16 || (w == 32 && p->use_signed)) fprintf(f, "(%s%d_t)(int32_t)c", s, w);
+  else fprintf(f, "(%s%d_t)c", s, w);
+}
+
+void gen_scale_from_double(const struct fpc_scaled *s, FILE *f) {
+  fprintf(f, "    double v = x;\n");
+  round_code(s, "    ", f);
+  fprintf(f, "    *y = ");
+  cast_code(&s->param, f);
+  fprintf(f, ";\n");
+}
+
+void gen_scale_batch(const struct fpc_scaled *s, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const struct fpc_parameters *p = &s->param;
+  int w = p->fixed_encoding_width;
+  const char *t = p->use_signed ? "int" : "uint", *T = p->use_signed ? "INT" : "UINT";
+  long long int
+    lb = p->lower_bound - p->offset,
+    ub = p->upper_bound - p->offset;
+  char args[80];
+
+  gen_batch_begin(f);
+  printf("static inline __attribute__((always_inline))\n"
+         "size_t convert_to_double_n_kernel(const %s%d_t *restrict x, double *restrict y, size_t n) {\n"
+         "  size_t i, errors = 0;\n"
+         "  for(i = 0; i < n; i++) {\n"
+         "    %s%d_t c = x[i];\n"
+         "    bool bad = (c < %s%d_C(%lld)) | (c > %s%d_C(%lld));\n"
+         "    errors += bad;\n"
+         "    y[i] = bad ? NAN : ", t, w, t, w, T, w, lb, T, w, ub);
+  to_double_expr(s, "c", f);
+  printf(";\n"
+         "  }\n"
+         "  return errors;\n"
+         "}\n\n");
+  snprintf(args, sizeof(args), "const %s%d_t *x, double *y, size_t n", t, w);
+  gen_dispatch("convert_to_double_n", "convert_to_double_n_kernel", "avx2", args, "x, y, n", false, f);
+
+  printf("\n"
+         "static inline __attribute__((always_inline))\n"
+         "size_t convert_from_double_n_kernel(const double *restrict x, %s%d_t *restrict y, size_t n,\n"
+         "                                    uint8_t *restrict err, bool mask) {\n"
+         "  size_t i, errors = 0;\n"
+         "  for(i = 0; i < n; i++) {\n"
+         "    double v = x[i];\n"
+         "    bool bad = !((v >= %.17g) & (v <= %.17g));\n", t, w, (double)p->min, (double)p->max);
+  round_code(s, "    ", f);
+  printf("    y[i] = ");
+  cast_code(p, f);
+  printf(";\n"
+         "    errors += bad;\n"
+         "    if(mask) err[i] = bad;\n"
+         "  }\n"
+         "  return errors;\n"
+         "}\n\n");
+  printf("static inline __attribute__((always_inline))\n"
+         "size_t convert_from_double_n_masked(const double *x, %s%d_t *y, size_t n, uint8_t *err) {\n"
+         "  if(err) {\n"
+         "    return convert_from_double_n_kernel(x, y, n, err, true);\n"
+         "  }\n"
+         "  return convert_from_double_n_kernel(x, y, n, NULL, false);\n"
+         "}\n\n", t, w);
+  snprintf(args, sizeof(args), "const double *x, %s%d_t *y, size_t n, uint8_t *err", t, w);
+  gen_dispatch("convert_from_double_n", "convert_from_double_n_masked", "avx2,fma",
+               args, "x, y, n, err", false, f);
+  gen_batch_end(f);
+#undef printf
+}
+
+void gen_scale_verify(const struct fpc_scaled *s, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const struct fpc_parameters *p = &s->param;
+  int w = p->fixed_encoding_width;
+  const char *t = p->use_signed ? "int" : "uint";
+  long long int lb = p->lower_bound - p->offset;
+  unsigned long long int span = (unsigned long long int)(p->upper_bound - p->lower_bound);
+
+  printf("/* the sign of d - n * %lld / %lld exactly, for n from 2 * (code + offset) */\n"
+         "static int cmp_exact(long double d, __int128 n) {\n"
+         "  if(d == 0) return n > 0 ? -1 : n < 0;\n"
+         "  if(n == 0) return d > 0 ? 1 : -1;\n"
+         "  int e;\n"
+         "  __int128 l = (__int128)ldexpl(frexpl(d, &e), 64), r = n * %lld;\n"
+         "  l *= 2 * %lld;\n"
+         "  e -= 64;\n"
+         "  // if a shift would overflow they are far apart\n"
+         "  if(e > 0) {\n"
+         "    if(e > 126 || (l << e) >> e != l) return d > 0 ? 1 : -1;\n"
+         "    l <<= e;\n"
+         "  } else {\n"
+         "    if(-e > 126 || (r << -e) >> -e != r) return r > 0 ? -1 : 1;\n"
+         "    r <<= -e;\n"
+         "  }\n"
+         "  return (l > r) - (l < r);\n"
+         "}\n\n", s->num, s->den, s->num, s->den);
+
+  printf("/* the code for v, from the exact comparison with the midpoint n */\n"
+         "static %s%d_t nearest(double v, __int128 n) {\n"
+         "  int c = cmp_exact(v, n);\n"
+         "  __int128 below = (n - 1) / 2;\n"
+         "  if(c > 0 || (c == 0 && below %% 2 != 0)) below++;\n"
+         "  return (%s%d_t)(below - %lld);\n"
+         "}\n\n", t, w, t, w, (long long int)p->offset);
+
+  printf("#define VERIFY_N (1 << 20)\n\n"
+         "/* check up to VERIFY_N codes spread over the range: convert_to_double()\n"
+         "   is correctly rounded, values come back to the same code, and the\n"
+         "   values either side of each midpoint go to the nearest code, all\n"
+         "   exactly and the same for the batch converters */\n"
+         "static int verify(int threads) {\n"
+         "  static %s%d_t codes[VERIFY_N], expect[3 * VERIFY_N], out[3 * VERIFY_N];\n"
+         "  static double values[3 * VERIFY_N], back[VERIFY_N];\n"
+         "  size_t i, n = 0, m = 0, bad = 0;\n"
+         "  uint64_t k, step = %lluULL / (VERIFY_N - 1) + 1;\n"
+         "  (void)threads;\n", t, w, span);
+  printf("  for(k = 0; n < VERIFY_N; k += step) {\n"
+         "    codes[n++] = (%s%d_t)(%lldLL + (k < %lluULL ? k : %lluULL));\n"
+         "    if(k >= %lluULL) break;\n"
+         "  }\n", t, w, lb, span, span, span);
+  printf("  for(i = 0; i < n; i++) {\n"
+         "    __int128 c = (__int128)codes[i] + %lld;\n"
+         "    double d = convert_to_double(codes[i]);\n"
+         "    back[i] = d;\n"
+         "    long double below = ((long double)d + nextafter(d, -INFINITY)) / 2;\n"
+         "    long double above = ((long double)d + nextafter(d, INFINITY)) / 2;\n"
+         "    if(cmp_exact(below, 2 * c) > 0 || cmp_exact(above, 2 * c) < 0) {\n"
+         "      if(bad++ < 10) printf(\"convert_to_double(%%lld) = %%.17g isn't correctly rounded\\n\",\n"
+         "                            (long long int)codes[i], d);\n"
+         "    }\n"
+         "    values[m] = d;\n"
+         "    expect[m++] = codes[i];\n"
+         "    if(codes[i] == %s%d_C(%lld)) continue;\n"
+         "    // the double nearest the midpoint with the next code, and its neighbours\n"
+         "    __int128 mid = 2 * c + 1;\n"
+         "    double v = (double)mid * %lld.0 / (2 * %lld.0);\n"
+         "    values[m] = nextafter(v, -INFINITY);\n"
+         "    expect[m] = nearest(values[m], mid);\n"
+         "    m++;\n"
+         "    values[m] = v;\n"
+         "    expect[m] = nearest(v, mid);\n"
+         "    m++;\n"
+         "  }\n",
+         (long long int)p->offset, p->use_signed ? "INT" : "UINT", w,
+         (long long int)(p->upper_bound - p->offset), s->num, s->den);
+  // values out of [min, max] only go through the batch converter
+  printf("  for(i = 0; i < m; i++) {\n"
+         "    %s%d_t y;\n"
+         "    if(!(values[i] >= %.17g && values[i] <= %.17g)) continue;\n"
+         "    if(!convert_from_double(values[i], &y) || y != expect[i]) {\n"
+         "      if(bad++ < 10) printf(\"convert_from_double(%%a) = %%lld, expected %%lld\\n\",\n"
+         "                            values[i], (long long int)y, (long long int)expect[i]);\n"
+         "    }\n"
+         "  }\n",
+         t, w, (double)p->min, (double)p->max);
+  printf("  convert_from_double_n(values, out, m, NULL);\n"
+         "  if(memcmp(out, expect, m * sizeof(out[0])) != 0) {\n"
+         "    bad++;\n"
+         "    printf(\"convert_from_double_n() differs\\n\");\n"
+         "  }\n"
+         "  convert_to_double_n(codes, values, n);\n"
+         "  if(memcmp(values, back, n * sizeof(values[0])) != 0) {\n"
+         "    bad++;\n"
+         "    printf(\"convert_to_double_n() differs\\n\");\n"
+         "  }\n"
+         "  printf(\"%%zu codes, %%zu values: %%s\\n\", n, m, bad ? \"FAIL\" : \"ok\");\n"
+         "  return bad != 0;\n"
+         "}\n");
+#undef printf
+}
@@ -0,0 +1,183 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "gen.h"
+
+/* Instrumented converters.  convert_to_double() and
+   convert_from_double() become wrappers around the usual functions,
+   renamed with a _raw suffix, that count into a thread local struct:
+   calls, values rejected below, above or as NaN, codes given NAN, the
+   smallest and largest values converted and rejected, and a histogram
+   of codes in at most 64 buckets.  There are no locks or atomics: each
+   thread dumps its own counts and fpc --feedback (feedback.c) adds them
+   up. */
+
+/* the histogram has the code range shifted right by this */
+int gen_stats_shift(struct fpc_parameters *param) {
+  uint64_t range = (uint64_t)(param->upper_bound - param->lower_bound);
+  int bits = range ? 64 - __builtin_clzll(range) : 0;
+  return bits > 6 ? bits - 6 : 0;
+}
+
+void gen_stats_report(struct fpc_parameters *param, FILE *f) {
+  int shift = gen_stats_shift(param);
+  uint64_t range = (uint64_t)(param->upper_bound - param->lower_bound);
+  fprintf(f, "\n[INSTRUMENT]\n");
+  fprintf(f, "  counters: calls, below, above, NaN, codes out of range, extreme values\n");
+  fprintf(f, "  histogram: %" PRIu64 " buckets of %" PRIu64 " codes\n",
+          (range >> shift) + 1, (uint64_t)1 << shift);
+}
+
+/* %.19Lg, or all 21 digits if it doesn't read back as x */
+static
+const char *exact(long double x, char *buf) {
+  snprintf(buf, 32, "%.19Lg", x);
+  if(strtold(buf, NULL) != x) snprintf(buf, 32, "%.21Lg", x);
+  return buf;
+}
+
+void gen_stats(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width, shift = gen_stats_shift(param);
+  const char *s = param->use_signed ? "int" : "uint";
+  uint64_t range = (uint64_t)(param->upper_bound - param->lower_bound);
+  unsigned long long int lb = (uint64_t)(param->lower_bound - param->offset);
+  char min[32], max[32], precision[32];
+
+  printf("/* Instrumentation, see --instrument.  Each thread counts its own\n"
+         "   conversions; convert_stats_dump() writes the calling thread's\n"
+         "   counts for fpc --feedback, which adds up any number of dumps. */\n"
+         "#define CONVERT_STATS_BUCKETS %" PRIu64 "\n"
+         "#define CONVERT_STATS_SHIFT %d\n\n", (range >> shift) + 1, shift);
+  printf("struct convert_stats {\n"
+         "  uint64_t from_calls, low, high, nan; /* convert_from_double() and its failures */\n"
+         "  uint64_t to_calls, bad_codes; /* convert_to_double() and the codes it gave NAN */\n"
+         "  double min, max; /* the values converted */\n"
+         "  double rejected_min, rejected_max; /* the finite values convert_from_double() rejected */\n"
+         "  uint64_t histogram[CONVERT_STATS_BUCKETS]; /* codes by (code - lower bound) >> shift */\n"
+         "};\n\n"
+         "static _Thread_local struct convert_stats convert_stats = {\n"
+         "  .min = INFINITY, .max = -INFINITY, .rejected_min = INFINITY, .rejected_max = -INFINITY\n"
+         "};\n\n");
+  printf("static inline void convert_stats_code(%s%d_t y) {\n"
+         "  convert_stats.histogram[((uint64_t)y - UINT64_C(%llu)) >> CONVERT_STATS_SHIFT]++;\n"
+         "}\n\n"
+         "static inline void convert_stats_value(double x) {\n"
+         "  convert_stats.min = x < convert_stats.min ? x : convert_stats.min;\n"
+         "  convert_stats.max = x > convert_stats.max ? x : convert_stats.max;\n"
+         "}\n\n", s, w, lb);
+  printf("double convert_to_double(%s%d_t x) {\n"
+         "  double d = convert_to_double_raw(x);\n"
+         "  convert_stats.to_calls++;\n"
+         "  if(isnan(d)) {\n"
+         "    convert_stats.bad_codes++;\n"
+         "  } else {\n"
+         "    convert_stats_code(x);\n"
+         "    convert_stats_value(d);\n"
+         "  }\n"
+         "  return d;\n"
+         "}\n\n", s, w);
+  printf("bool convert_from_double(double x, %s%d_t *y) {\n"
+         "  convert_stats.from_calls++;\n"
+         "  if(!convert_from_double_raw(x, y)) {\n"
+         "    // outside [%.19Lg, %.19Lg], or NaN\n"
+         "    convert_stats.low += x < %.17g;\n"
+         "    convert_stats.high += x > %.17g;\n"
+         "    convert_stats.nan += isnan(x);\n"
+         "    if(isfinite(x)) {\n"
+         "      convert_stats.rejected_min = x < convert_stats.rejected_min ? x : convert_stats.rejected_min;\n"
+         "      convert_stats.rejected_max = x > convert_stats.rejected_max ? x : convert_stats.rejected_max;\n"
+         "    }\n"
+         "    return false;\n"
+         "  }\n"
+         "  convert_stats_code(*y);\n"
+         "  convert_stats_value(x);\n"
+         "  return true;\n"
+         "}\n\n", s, w, param->min, param->max,
+         (double)((param->min + param->max) / 2), (double)((param->min + param->max) / 2));
+  printf("/* the calling thread's counts */\n"
+         "void convert_stats_get(struct convert_stats *out) {\n"
+         "  *out = convert_stats;\n"
+         "}\n\n"
+         "void convert_stats_reset(void) {\n"
+         "  memset(&convert_stats, 0, sizeof(convert_stats));\n"
+         "  convert_stats.min = INFINITY;\n"
+         "  convert_stats.max = -INFINITY;\n"
+         "  convert_stats.rejected_min = INFINITY;\n"
+         "  convert_stats.rejected_max = -INFINITY;\n"
+         "}\n\n");
+  printf("/* write the calling thread's counts for fpc --feedback */\n"
+         "void convert_stats_dump(FILE *f) {\n"
+         "  const struct convert_stats *s = &convert_stats;\n"
+         "  int i;\n"
+         "  fprintf(f, \"fpc-stats %s %s %s %s\\n\");\n"
+         "  fprintf(f, \"from_double %%llu %%llu %%llu %%llu\\n\", (unsigned long long)s->from_calls,\n"
+         "          (unsigned long long)s->low, (unsigned long long)s->high, (unsigned long long)s->nan);\n"
+         "  fprintf(f, \"to_double %%llu %%llu\\n\", (unsigned long long)s->to_calls,\n"
+         "          (unsigned long long)s->bad_codes);\n"
+         "  fprintf(f, \"values %%.17g %%.17g %%.17g %%.17g\\n\", s->min, s->max, s->rejected_min, s->rejected_max);\n"
+         "  fprintf(f, \"histogram %%d\", CONVERT_STATS_SHIFT);\n"
+         "  for(i = 0; i < CONVERT_STATS_BUCKETS; i++) fprintf(f, \" %%llu\", (unsigned long long)s->histogram[i]);\n"
+         "  fprintf(f, \"\\nend\\n\");\n"
+         "}\n", exact(param->min, min), exact(param->max, max), exact(param->precision, precision),
+         fpc_scale_names[opt->scale]);
+#undef printf
+}
+
+/* convert -I: conversions in the middle fifth of the range and one of
+   each failure, checked against the counters, then dumped to stdout */
+void gen_stats_test(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  int128_t
+    lb = param->lower_bound - param->offset,
+    min_int = param->use_signed ? -(((int128_t)1) << (w - 1)) : 0;
+  // out of range by more than a double's rounding, even for large offsets
+  long double span = param->max - param->min, far = span + fabsl(param->max) * 0x1p-40L;
+
+  printf("static int test_stats(void) {\n"
+         "  struct convert_stats s;\n"
+         "  double lo = %.17g, hi = %.17g;\n"
+         "  %s%d_t y;\n"
+         "  int i, in = 0, bad_codes = 0;\n"
+         "  convert_stats_reset();\n"
+         "  for(i = 0; i < 1000; i++) in += convert_from_double(lo + (hi - lo) * i / 999, &y);\n"
+         "  convert_from_double(%.17g, &y);\n"
+         "  convert_from_double(%.17g, &y);\n"
+         "  convert_from_double(NAN, &y);\n",
+         (double)(param->min + span * 2 / 5), (double)(param->min + span * 3 / 5), s, w,
+         (double)(param->min - far), (double)(param->max + far));
+  if(lb > min_int) {
+    printf("  bad_codes += isnan(convert_to_double(%s%d_C(%lld) - 1));\n",
+           param->use_signed ? "INT" : "UINT", w, (long long int)lb);
+  }
+  printf("  convert_stats_get(&s);\n"
+         "  uint64_t sum = 0;\n"
+         "  for(i = 0; i < CONVERT_STATS_BUCKETS; i++) sum += s.histogram[i];\n"
+         "  bool ok = s.from_calls == 1003 && s.low == 1 && s.high == 1 && s.nan == 1 && in == 1000 &&\n"
+         "    s.to_calls == (uint64_t)bad_codes && s.bad_codes == (uint64_t)bad_codes && sum == 1000 &&\n"
+         "    s.min == lo && s.max == lo + (hi - lo) * 999 / 999 &&\n"
+         "    s.rejected_min == %.17g && s.rejected_max == %.17g;\n"
+         "  fprintf(stderr, \"stats: %%s\\n\", ok ? \"ok\" : \"FAIL\");\n"
+         "  convert_stats_dump(stdout);\n"
+         "  return !ok;\n"
+         "}\n",
+         (double)(param->min - far), (double)(param->max + far));
+#undef printf
+}
@@ -0,0 +1,713 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gen.h"
+
+/* Decimal strings for one format, the same as show_fixed() and
+   read_fixed() from fixnum_string.c with every constant folded in.
+
+   A value v * 2^-f has D = ceil(f * log10 2) decimals, so
+   convert_fixed_to_string() rounds |v| * 5^D / 2^(f - D) ties away
+   from zero, splits it with constant divisors and writes a fixed
+   number of digits with a table of pairs.  The lengths come from sums
+   of comparisons rather than loops.  --strings=fixed pads every string
+   to the same width, right aligned, with all D decimals.
+
+   convert_string_to_fixed() keeps f + 1 decimals, enough to tell a tie
+   from the values either side of it, so rounding is exact for any
+   number of digits: the fraction is r / 10^(f + 1) and the code is
+   (r + 5^(f + 1)) / (2 * 5^(f + 1)) codes above the whole part.
+
+   Both need the format's values to fit an int64_t and f <= 37, so the
+   kept decimals fit an unsigned __int128.  128 bit formats instead
+   call show_fixed128() and read_fixed128(), so their converters need
+   fixnum_string.c, shortest strings and f <= 63. */
+
+#define STRING_MAX_BITS 37
+#define STRING_WIDE_MAX_BITS 63
+
+typedef unsigned __int128 uint128_t;
+
+static const char *string_modes[] = {
+  [STRINGS_SHORTEST] = "shortest",
+  [STRINGS_FIXED] = "fixed"
+};
+
+bool gen_parse_strings(const char *name, enum gen_strings *strings) {
+  unsigned int i;
+  for(i = 0; i < sizeof(string_modes) / sizeof(string_modes[0]); i++) {
+    if(strcmp(name, string_modes[i]) == 0) {
+      *strings = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool gen_string_eligible(struct fpc_parameters *param, struct gen_options *opt) {
+  if(param->fixed_encoding_width == 128) {
+    return !opt->scaled && opt->strings == STRINGS_SHORTEST &&
+      param->fractional_bits >= 0 && param->fractional_bits <= STRING_WIDE_MAX_BITS;
+  }
+  return !opt->scaled && !param->large_offset &&
+    param->fractional_bits >= 0 && param->fractional_bits <= STRING_MAX_BITS &&
+    param->lower_bound >= INT64_MIN && param->upper_bound <= INT64_MAX;
+}
+
+static
+uint128_t pow_u(unsigned int base, int n) {
+  uint128_t p = 1;
+  while(n-- > 0) p *= base;
+  return p;
+}
+
+static
+int decimal_digits(uint128_t x) {
+  int n = 1;
+  while(x >= 10) {
+    x /= 10;
+    n++;
+  }
+  return n;
+}
+
+/* x as a C constant, unsigned __int128 above 64 bits */
+static
+void emit_unsigned(FILE *f, uint128_t x) {
+  if(x >> 64) {
+    fprintf(f, "((unsigned __int128)UINT64_C(%llu) << 64 | UINT64_C(%llu))",
+            (unsigned long long int)(x >> 64), (unsigned long long int)x);
+  } else {
+    fprintf(f, "UINT64_C(%llu)", (unsigned long long int)x);
+  }
+}
+
+/* the format's constants */
+struct string_format {
+  int f, d, k; /* fractional bits, decimals shown, decimals kept reading */
+  int whole_digits, size; /* most digits before the point, longest string + 1 */
+  bool sign; /* whether values can be negative */
+  int64_t lo, hi; /* values, code + offset */
+  uint64_t max_mag; /* the largest magnitude */
+  bool wide_show; /* |v| * 5^d needs 128 bits */
+  bool wide_n; /* so does it rounded to d decimals, |v| * 10^d */
+};
+
+static
+void string_format(struct fpc_parameters *param, struct string_format *s) {
+  uint128_t n;
+  s->f = param->fractional_bits;
+  s->d = ((uint64_t)s->f * 1292913986 + 0xFFFFFFFF) >> 32; // as show_fixed()
+  s->k = s->f + 1;
+  s->lo = param->lower_bound;
+  s->hi = param->upper_bound;
+  s->sign = s->lo < 0;
+  s->max_mag = s->lo < 0 ? -(uint64_t)s->lo : (uint64_t)s->lo;
+  if((uint64_t)(s->hi < 0 ? -(uint64_t)s->hi : (uint64_t)s->hi) > s->max_mag) {
+    s->max_mag = s->hi < 0 ? -(uint64_t)s->hi : (uint64_t)s->hi;
+  }
+  s->wide_show = ((uint128_t)s->max_mag * pow_u(5, s->d)) >> 64 != 0;
+  n = (uint128_t)s->max_mag * pow_u(5, s->d);
+  if(s->f > s->d) n = (n + ((uint128_t)1 << (s->f - s->d - 1))) >> (s->f - s->d);
+  s->wide_n = n >> 64 != 0;
+  s->whole_digits = decimal_digits(n / pow_u(10, s->d));
+  s->size = s->sign + s->whole_digits + (s->d ? 1 + s->d : 0) + 1;
+}
+
+/* write digits of q (a uint64_t variable) backwards, ending before end */
+static
+void emit_digits(FILE *f, const char *q, const char *end, int digits) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int i;
+  for(i = 0; i + 2 <= digits; i += 2) {
+    printf("  memcpy(%s - %d, convert_digit_pairs + 2 * (%s %% 100), 2);\n", end, i + 2, q);
+    if(i + 2 < digits) printf("  %s /= 100;\n", q);
+  }
+  if(digits % 2) printf("  %s[-%d] = '0' + %s;\n", end, digits, q);
+#undef printf
+}
+
+/* the sum of comparisons counting the digits of whole */
+static
+void emit_count(FILE *f, int digits) {
+  int i;
+  fprintf(f, "1");
+  for(i = 1; i < digits; i++) {
+    fprintf(f, " + (whole >= UINT64_C(%llu))", (unsigned long long int)pow_u(10, i));
+  }
+}
+
+static
+void gen_to_string(struct fpc_parameters *param, struct gen_options *opt,
+                   struct string_format *s, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width, i;
+  const char *t = param->use_signed ? "int" : "uint";
+  bool fixed = opt->strings == STRINGS_FIXED;
+  int64_t offset = param->offset;
+  // whole fits 64 bits, but whole * 10^d need not
+  const char *n_type = s->wide_n ? "unsigned __int128" : "uint64_t";
+
+  if(fixed) {
+    printf("/* x as [-]whole[.fraction], its exact value rounded to %d decimals ties\n"
+           "   away from zero and right aligned in CONVERT_STRING_SIZE - 1 characters.\n"
+           "   Returns the length or -EOVERFLOW if size can't hold the string and\n"
+           "   its terminator. */\n", s->d);
+  } else {
+    printf("/* x as [-]whole[.fraction], its exact value rounded to %d decimals ties\n"
+           "   away from zero with trailing zeroes dropped: the same string as\n"
+           "   show_fixed(buf, size, %d, x%s).  Returns the length or -EOVERFLOW if\n"
+           "   size can't hold the string and its terminator. */\n",
+           s->d, s->f, offset ? " + offset" : "");
+  }
+  printf("int convert_fixed_to_string(char *buf, size_t size, %s%d_t x) {\n", t, w);
+  printf("  char tmp[%d], *p = tmp + %d, *e;\n", s->whole_digits + s->size, s->whole_digits);
+  if(offset) {
+    printf("  int64_t v = (int64_t)((uint64_t)x + UINT64_C(%llu));\n",
+           (unsigned long long int)(uint64_t)offset);
+  } else {
+    printf("  int64_t v = x;\n");
+  }
+  if(s->sign) {
+    printf("  bool neg = v < 0;\n"
+           "  uint64_t m = neg ? -(uint64_t)v : (uint64_t)v;\n");
+  } else {
+    printf("  uint64_t m = v;\n");
+  }
+  if(s->d == 0) {
+    printf("  uint64_t n = m;\n");
+  } else if(s->f == s->d) {
+    printf("  %s n = (%s)m * %llu;\n", n_type, n_type, (unsigned long long int)pow_u(5, s->d));
+  } else if(s->wide_show) {
+    printf("  %s n = ((unsigned __int128)m * UINT64_C(%llu) + UINT64_C(%llu)) >> %d;\n",
+           n_type, (unsigned long long int)pow_u(5, s->d),
+           1ULL << (s->f - s->d - 1), s->f - s->d);
+  } else {
+    printf("  uint64_t n = (m * UINT64_C(%llu) + UINT64_C(%llu)) >> %d;\n",
+           (unsigned long long int)pow_u(5, s->d),
+           1ULL << (s->f - s->d - 1), s->f - s->d);
+  }
+  if(s->d) {
+    printf("  uint64_t whole = (uint64_t)(n / UINT64_C(%llu)), frac = (uint64_t)(n %% UINT64_C(%llu));\n",
+           (unsigned long long int)pow_u(10, s->d), (unsigned long long int)pow_u(10, s->d));
+  } else {
+    printf("  uint64_t whole = n;\n");
+  }
+  printf("  int digits = ");
+  emit_count(f, s->whole_digits);
+  printf(";\n");
+  if(s->d && !fixed) {
+    printf("  // the point and decimals to drop, the trailing zeroes or all of them\n"
+           "  int drop = frac ? ");
+    for(i = 1; i < s->d; i++) {
+      printf("%s(frac %% UINT64_C(%llu) == 0)", i > 1 ? " + " : "",
+             (unsigned long long int)pow_u(10, i));
+    }
+    printf("%s : %d;\n", s->d == 1 ? "0" : "", s->d + 1);
+  }
+  if(fixed) {
+    printf("  if(size < CONVERT_STRING_SIZE) {\n"
+           "    return -EOVERFLOW;\n"
+           "  }\n");
+    printf("  e = p + %d;\n", s->sign + s->whole_digits);
+    emit_digits(f, "whole", "e", s->whole_digits);
+    printf("  memset(p, ' ', %d - digits);\n", s->sign + s->whole_digits);
+    if(s->sign) printf("  e[-digits - 1] = neg ? '-' : ' ';\n");
+  } else {
+    printf("  e = p + %sdigits;\n", s->sign ? "neg + " : "");
+    emit_digits(f, "whole", "e", s->whole_digits);
+    if(s->sign) printf("  p[0] = neg ? '-' : p[0];\n");
+  }
+  if(s->d) {
+    printf("  e[0] = '.';\n"
+           "  e += %d;\n", s->d + 1);
+    emit_digits(f, "frac", "e", s->d);
+    if(!fixed) printf("  e -= drop;\n");
+  }
+  printf("  *e = '\\0';\n"
+         "  int length = e - p;\n");
+  if(!fixed) {
+    printf("  if((size_t)length >= size) {\n"
+           "    return -EOVERFLOW;\n"
+           "  }\n");
+  }
+  printf("  memcpy(buf, p, length + 1);\n"
+         "  return length;\n"
+         "}\n\n");
+#undef printf
+}
+
+static
+void gen_from_string(struct fpc_parameters *param, struct string_format *s, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width, i;
+  const char *t = param->use_signed ? "int" : "uint";
+  const char *ft = s->k <= 19 ? "uint64_t" : "unsigned __int128";
+  uint64_t whole_max = s->max_mag >> s->f, saturate = UINT64_MAX / 10 - 1;
+  int64_t offset = param->offset;
+
+  if(whole_max < saturate) saturate = whole_max;
+
+  if(s->k >= 8) {
+    printf("/* eight digits at once, first digit in the low byte */\n"
+           "static inline bool convert_eight_digits(uint64_t v) {\n"
+           "  return ((v & 0xF0F0F0F0F0F0F0F0ULL) |\n"
+           "          (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==\n"
+           "    0x3333333333333333ULL;\n"
+           "}\n\n"
+           "static inline uint64_t convert_parse_eight(uint64_t v) {\n"
+           "  const uint64_t mask = 0x000000FF000000FFULL;\n"
+           "  v -= 0x3030303030303030ULL;\n"
+           "  v = v * 10 + (v >> 8);\n"
+           "  return ((v & mask) * (100 + (1000000ULL << 32)) +\n"
+           "          ((v >> 16) & mask) * (1 + (10000ULL << 32))) >> 32;\n"
+           "}\n\n");
+  }
+  printf("static const %s convert_decimal_scale[%d] = {\n", ft, s->k + 1);
+  for(i = 0; i <= s->k; i++) {
+    printf("  ");
+    emit_unsigned(f, pow_u(10, s->k - i));
+    printf("%s\n", i < s->k ? "," : "");
+  }
+  printf("};\n\n");
+
+  printf("/* Leading spaces then [-]digits[.digits] to the nearest code, ties away\n"
+         "   from zero, for any number of digits.  Returns the characters read,\n"
+         "   -EINVAL without digits or -EOVERFLOW outside [%lld, %lld] * 2^-%d. */\n",
+         (long long int)s->lo, (long long int)s->hi, s->f);
+  printf("int convert_string_to_fixed(const char *buf, size_t size, %s%d_t *x) {\n", t, w);
+  printf("  const char *p = buf, *end = buf + size, *digits;\n"
+         "  uint64_t whole = 0, mag;\n"
+         "  %s frac = 0;\n"
+         "  int k = 0;\n"
+         "  bool neg, big = false;\n"
+         "  while(p < end && *p == ' ') p++;\n"
+         "  neg = p < end && *p == '-';\n"
+         "  p += neg;\n"
+         "  digits = p;\n"
+         "  for(; p < end && (unsigned char)(*p - '0') < 10; p++) {\n"
+         "    big |= whole > UINT64_C(%llu);\n"
+         "    whole = whole * 10 + (*p - '0');\n"
+         "  }\n"
+         "  bool any = p > digits;\n"
+         "  if(p < end && *p == '.') {\n"
+         "    digits = ++p;\n", ft, (unsigned long long int)saturate);
+  if(s->k >= 8) {
+    printf("    for(; k <= %d && end - p >= 8; p += 8, k += 8) {\n"
+           "      uint64_t v;\n"
+           "      memcpy(&v, p, 8);\n"
+           "#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__\n"
+           "      v = __builtin_bswap64(v);\n"
+           "#endif\n"
+           "      if(!convert_eight_digits(v)) break;\n"
+           "      frac = frac * 100000000 + convert_parse_eight(v);\n"
+           "    }\n", s->k - 8);
+  }
+  printf("    for(; p < end && (unsigned char)(*p - '0') < 10; p++) {\n"
+         "      // later digits can't change the rounding\n"
+         "      if(k < %d) {\n"
+         "        frac = frac * 10 + (*p - '0');\n"
+         "        k++;\n"
+         "      }\n"
+         "    }\n"
+         "    any |= p > digits;\n"
+         "  }\n"
+         "  if(!any) {\n"
+         "    return -EINVAL;\n"
+         "  }\n"
+         "  if(big || whole > UINT64_C(%llu)) {\n"
+         "    return -EOVERFLOW;\n"
+         "  }\n", s->k, (unsigned long long int)whole_max);
+  printf("  frac *= convert_decimal_scale[k];\n"
+         "  mag = (whole << %d) + (uint64_t)((frac + ", s->f);
+  emit_unsigned(f, pow_u(5, s->k));
+  printf(") / ");
+  emit_unsigned(f, 2 * pow_u(5, s->k));
+  printf(");\n"
+         "  int64_t v = neg ? (int64_t)-mag : (int64_t)mag;\n"
+         "  if(mag > UINT64_C(%llu)", (unsigned long long int)s->max_mag);
+  if(s->lo > INT64_MIN) printf(" || v < INT64_C(%lld)", (long long int)s->lo);
+  if(s->hi < INT64_MAX) printf(" || v > INT64_C(%lld)", (long long int)s->hi);
+  printf(") {\n"
+         "    return -EOVERFLOW;\n"
+         "  }\n");
+  if(offset) {
+    printf("  *x = (%s%d_t)((uint64_t)v - UINT64_C(%llu));\n", t, w,
+           (unsigned long long int)(uint64_t)offset);
+  } else {
+    printf("  *x = v;\n");
+  }
+  printf("  return p - buf;\n"
+         "}\n");
+#undef printf
+}
+
+/* the longest show_fixed128() string + 1 for a 128 bit format */
+static
+int wide_size(struct fpc_parameters *param) {
+  int f = param->fractional_bits, d = ((uint64_t)f * 1292913986 + 0xFFFFFFFF) >> 32;
+  uint128_t lo = param->lower_bound < 0 ? -(uint128_t)param->lower_bound : param->lower_bound;
+  uint128_t hi = param->upper_bound < 0 ? -(uint128_t)param->upper_bound : param->upper_bound;
+  // + 1 for a fraction rounding up into the whole part
+  return (param->lower_bound < 0) + decimal_digits(((lo > hi ? lo : hi) >> f) + 1) + (d ? 1 + d : 0) + 1;
+}
+
+/* 128 bit formats through fixnum_string.c */
+static
+void gen_wide_string(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const char *t = param->use_signed ? "int" : "uint";
+  int fb = param->fractional_bits;
+
+  printf("#define CONVERT_STRING_SIZE %d // the longest string and its terminator\n\n",
+         wide_size(param));
+  printf("/* x as [-]whole[.fraction]: show_fixed128(buf, size, %d, x).  Returns\n"
+         "   the length or -EOVERFLOW if size can't hold the string and its\n"
+         "   terminator. */\n"
+         "int convert_fixed_to_string(char *buf, size_t size, %s128_t x) {\n"
+         "  return show_fixed128(buf, size, %d, x);\n"
+         "}\n\n", fb, t, fb);
+  printf("/* Leading spaces then [-]digits[.digits] to the nearest code, ties away\n"
+         "   from zero, with read_fixed128().  Returns the characters read,\n"
+         "   -EINVAL without digits or -EOVERFLOW outside the format. */\n"
+         "int convert_string_to_fixed(const char *buf, size_t size, %s128_t *x) {\n"
+         "  const char *p = buf, *end = buf + size;\n"
+         "  __int128 v;\n"
+         "  while(p < end && *p == ' ') p++;\n"
+         "  int n = read_fixed128(p, end - p, %d, &v);\n"
+         "  if(n < 0) {\n"
+         "    return n;\n"
+         "  }\n"
+         "  if(v < ", t, fb);
+  gen_arith_const(f, param->lower_bound);
+  printf(" || v > ");
+  gen_arith_const(f, param->upper_bound);
+  printf(") {\n"
+         "    return -EOVERFLOW;\n"
+         "  }\n"
+         "  *x = v;\n"
+         "  return p - buf + n;\n"
+         "}\n");
+#undef printf
+}
+
+int gen_string_size(struct fpc_parameters *param) {
+  struct string_format s;
+  if(param->fixed_encoding_width == 128) return wide_size(param);
+  string_format(param, &s);
+  return s.size;
+}
+
+void gen_string(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+  struct string_format s;
+  int i, j;
+  if(!gen_string_eligible(param, opt)) {
+    fprintf(f, "/* no convert_fixed_to_string() or convert_string_to_fixed(): they need\n"
+               "   a power of two scale, 0 to %d fractional bits and values that fit\n"
+               "   an int64_t, or shortest strings and 0 to %d for 128 bit codes */\n",
+            STRING_MAX_BITS, STRING_WIDE_MAX_BITS);
+    return;
+  }
+  if(param->fixed_encoding_width == 128) {
+    gen_wide_string(param, f);
+    return;
+  }
+  string_format(param, &s);
+  fprintf(f, "#define CONVERT_STRING_SIZE %d // the longest string and its terminator\n\n", s.size);
+  if(s.whole_digits >= 2 || s.d >= 2) {
+    fprintf(f, "static const char convert_digit_pairs[] =\n");
+    for(i = 0; i < 100; i += 10) {
+      fprintf(f, "  \"");
+      for(j = i; j < i + 10; j++) fprintf(f, "%02d", j);
+      fprintf(f, "\"%s\n", i == 90 ? ";" : "");
+    }
+    fprintf(f, "\n");
+  }
+  gen_to_string(param, opt, &s, f);
+  gen_from_string(param, &s, f);
+}
+
+/* test_strings() and bench_strings() for 128 bit formats */
+static
+void gen_wide_string_test(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  const char *t = param->use_signed ? "int" : "uint";
+  int fb = param->fractional_bits, d = ((uint64_t)fb * 1292913986 + 0xFFFFFFFF) >> 32;
+  int128_t span = param->upper_bound - param->lower_bound;
+
+  printf("/* the string converters on 2^20 codes across the range: each read back\n"
+         "   as itself, and the same as show_fixed() where it fits an int64_t */\n"
+         "int test_strings(void) {\n"
+         "  unsigned __int128 span = ");
+  gen_arith_const(f, span);
+  printf(";\n"
+         "  uint64_t count = (1 << 20) + 1, i;\n"
+         "  long long int errors = 0;\n"
+         "  char want[128], got[128];\n"
+         "  %s128_t y;\n"
+         "  for(i = 0; i < count; i++) {\n"
+         "    %s128_t x = (%s128_t)(", t, t, t);
+  gen_arith_const(f, param->lower_bound);
+  printf(" + (span >> 20) * i + ((span & 0xFFFFF) * i >> 20));\n"
+         "    int n = convert_fixed_to_string(got, sizeof(got), x);\n"
+         "    want[0] = '\\0';\n"
+         "    if(x >= INT64_MIN && x <= INT64_MAX) show_fixed(want, sizeof(want), %d, (int64_t)x);\n"
+         "    if(n < 0 || convert_fixed_to_string(got, n, x) != -EOVERFLOW ||\n"
+         "       convert_string_to_fixed(got, n, &y) != n || y != x || (want[0] && strcmp(got, want) != 0)) {\n"
+         "      if(errors++ < 10) {\n"
+         "        printf(\"convert_fixed_to_string() = %%d \\\"%%s\\\", show_fixed() \\\"%%s\\\"\\n\", n, got, want);\n"
+         "      }\n"
+         "    }\n"
+         "  }\n", fb);
+  printf("  const char *bad[] = { \"\", \"-\", \".\", \"-.\", \" \", \"x\", \"+1\" };\n"
+         "  for(i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {\n"
+         "    if(convert_string_to_fixed(bad[i], strlen(bad[i]), &y) != -EINVAL) {\n"
+         "      printf(\"convert_string_to_fixed(\\\"%%s\\\") should be -EINVAL\\n\", bad[i]);\n"
+         "      errors++;\n"
+         "    }\n"
+         "  }\n"
+         "  const char *big = \"123456789012345678901234567890123456789012345\";\n"
+         "  if(convert_string_to_fixed(big, strlen(big), &y) != -EOVERFLOW) {\n"
+         "    printf(\"convert_string_to_fixed(\\\"%%s\\\") should be -EOVERFLOW\\n\", big);\n"
+         "    errors++;\n"
+         "  }\n");
+  printf("  show_fixed128(want, sizeof(want), %d, ", fb);
+  gen_arith_const(f, param->lower_bound - 1);
+  printf(");\n"
+         "  if(convert_string_to_fixed(want, strlen(want), &y) != -EOVERFLOW) {\n"
+         "    printf(\"convert_string_to_fixed(\\\"%%s\\\") should be -EOVERFLOW\\n\", want);\n"
+         "    errors++;\n"
+         "  }\n");
+  printf("  show_fixed128(want, sizeof(want), %d, ", fb);
+  gen_arith_const(f, param->upper_bound + 1);
+  printf(");\n"
+         "  if(convert_string_to_fixed(want, strlen(want), &y) != -EOVERFLOW) {\n"
+         "    printf(\"convert_string_to_fixed(\\\"%%s\\\") should be -EOVERFLOW\\n\", want);\n"
+         "    errors++;\n"
+         "  }\n"
+         "  printf(\"%%llu codes, %d decimal%s, up to %%d characters: %%lld errors\\n\",\n"
+         "         (unsigned long long int)count, CONVERT_STRING_SIZE - 1, errors);\n"
+         "  return errors != 0;\n"
+         "}\n\n", d, d == 1 ? "" : "s");
+
+  printf("/* time the string converters */\n"
+         "static void bench_strings(void) {\n"
+         "  static %s128_t codes[BENCH_N];\n"
+         "  static char strings[BENCH_N][CONVERT_STRING_SIZE];\n"
+         "  char buf[128];\n"
+         "  double t;\n"
+         "  size_t i, r, sum = 0;\n"
+         "  for(i = 0; i < BENCH_N; i++) {\n"
+         "    codes[i] = (%s128_t)(", t, t);
+  gen_arith_const(f, param->lower_bound);
+  printf(" + (__int128)(i * 2654435761u %% %lluULL));\n"
+         "    convert_fixed_to_string(strings[i], CONVERT_STRING_SIZE, codes[i]);\n"
+         "  }\n",
+         (unsigned long long int)(span < ((int128_t)1 << 62) ? span : (int128_t)1 << 62));
+  printf("  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS / 16; r++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) sum += convert_fixed_to_string(buf, sizeof(buf), codes[i]);\n"
+         "  }\n"
+         "  double show = (now() - t) / ((double)BENCH_N * (BENCH_REPS / 16));\n"
+         "  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS / 16; r++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) {\n"
+         "      sum += convert_string_to_fixed(strings[i], strlen(strings[i]), &codes[i]);\n"
+         "    }\n"
+         "  }\n"
+         "  double read = (now() - t) / ((double)BENCH_N * (BENCH_REPS / 16));\n"
+         "  printf(\"convert_fixed_to_string: %%.2f ns (show_fixed128)\\n\", show * 1e9);\n"
+         "  printf(\"convert_string_to_fixed: %%.2f ns (read_fixed128)\\n\", read * 1e9);\n"
+         "  if(sum == 42) printf(\"\\n\"); // keep the results live\n"
+         "}\n");
+#undef printf
+}
+
+void gen_string_test(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *t = param->use_signed ? "int" : "uint";
+  bool fixed = opt->strings == STRINGS_FIXED;
+  uint64_t span, offset = (uint64_t)(int64_t)param->offset;
+  struct string_format s;
+  bool ties;
+
+  if(!gen_string_eligible(param, opt)) return;
+  if(w == 128) {
+    gen_wide_string_test(param, f);
+    return;
+  }
+  string_format(param, &s);
+  span = (uint64_t)s.hi - (uint64_t)s.lo;
+  // the exact decimal of a tie, (2v + 1) * 5^(f + 1) / 10^(f + 1), if the
+  // numerator fits an __int128 (checked by division, as the product needn't)
+  ties = 2 * (uint128_t)s.max_mag + 1 <= (((uint128_t)1 << 127) - 1) / pow_u(5, s.k);
+
+  if(fixed) {
+    printf("/* a show_fixed() string padded like --strings=fixed */\n"
+           "static void convert_pad_string(char *s) {\n"
+           "  char *point = strchr(s, '.');\n"
+           "  size_t n = strlen(s), decimals = point ? n - (point - s) - 1 : 0;\n");
+    if(s.d) {
+      printf("  if(!point) s[n++] = '.';\n"
+             "  for(; decimals < %d; decimals++) s[n++] = '0';\n", s.d);
+    } else {
+      printf("  (void)decimals;\n");
+    }
+    printf("  s[n] = '\\0';\n"
+           "  memmove(s + CONVERT_STRING_SIZE - 1 - n, s, n + 1);\n"
+           "  memset(s, ' ', CONVERT_STRING_SIZE - 1 - n);\n"
+           "}\n\n");
+  }
+
+  printf("/* convert_string_to_fixed() on s should read it all as value v */\n"
+         "static long long int convert_test_read(const char *s, int64_t v) {\n"
+         "  %s%d_t x = 0;\n"
+         "  int n = convert_string_to_fixed(s, strlen(s), &x);\n"
+         "  if(n != (int)strlen(s) || x != (%s%d_t)((uint64_t)v - UINT64_C(%llu))) {\n"
+         "    printf(\"convert_string_to_fixed(\\\"%%s\\\") = %%d, %%lld, expected %%lld\\n\",\n"
+         "           s, n, (long long int)x, (long long int)((uint64_t)v - UINT64_C(%llu)));\n"
+         "    return 1;\n"
+         "  }\n"
+         "  return 0;\n"
+         "}\n\n", t, w, t, w, (unsigned long long int)offset, (unsigned long long int)offset);
+
+  printf("/* the string converters against show_fixed() and read_fixed() on every\n"
+         "   code, or 2^20 of them across the range, with the ties between codes */\n"
+         "int test_strings(void) {\n"
+         "  uint64_t span = UINT64_C(%llu), count = span < (1 << 20) ? span + 1 : (1 << 20) + 1, i;\n"
+         "  long long int errors = 0;\n"
+         "  char want[128], got[128];\n"
+         "  %s%d_t y;\n", (unsigned long long int)span, t, w);
+  printf("  for(i = 0; i < count; i++) {\n"
+         "    uint64_t c = span < (1 << 20) ? i : (uint64_t)((unsigned __int128)span * i >> 20);\n"
+         "    int64_t v = (int64_t)(UINT64_C(%llu) + c);\n"
+         "    %s%d_t x = (%s%d_t)((uint64_t)v - UINT64_C(%llu));\n"
+         "    show_fixed(want, sizeof(want), %d, v);\n",
+         (unsigned long long int)s.lo, t, w, t, w, (unsigned long long int)offset, s.f);
+  if(fixed) printf("    convert_pad_string(want);\n");
+  printf("    int n = convert_fixed_to_string(got, sizeof(got), x);\n"
+         "    if(n != (int)strlen(want) || strcmp(got, want) != 0 ||\n"
+         "       convert_fixed_to_string(got, n, x) != -EOVERFLOW) {\n"
+         "      if(errors++ < 10) {\n"
+         "        printf(\"convert_fixed_to_string(%%lld) = %%d \\\"%%s\\\", expected \\\"%%s\\\"\\n\",\n"
+         "               (long long int)x, n, got, want);\n"
+         "      }\n"
+         "      continue;\n"
+         "    }\n"
+         "    errors += convert_test_read(want, v);\n");
+  if(ties) {
+    printf("    if(c < span) {\n"
+           "      // ties round away from zero, anything either side to the nearer code\n"
+           "      int64_t away = v < 0 ? v : v + 1, toward = v < 0 ? v + 1 : v;\n"
+           "      n = show_float128(want, sizeof(want) - 2, -%d,\n"
+           "                        (2 * (__int128)v + 1) * ", s.k);
+    emit_unsigned(f, pow_u(5, s.k));
+    printf(");\n"
+           "      errors += convert_test_read(want, away);\n"
+           "      strcpy(want + n, \"1\");\n"
+           "      errors += convert_test_read(want, away);\n"
+           "      strcpy(want + n - 1, \"49\");\n"
+           "      errors += convert_test_read(want, toward);\n"
+           "    }\n");
+  }
+  printf("  }\n");
+
+  // errors
+  printf("  const char *bad[] = { \"\", \"-\", \".\", \"-.\", \" \", \"x\", \"+1\" };\n"
+         "  for(i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {\n"
+         "    if(convert_string_to_fixed(bad[i], strlen(bad[i]), &y) != -EINVAL) {\n"
+         "      printf(\"convert_string_to_fixed(\\\"%%s\\\") should be -EINVAL\\n\", bad[i]);\n"
+         "      errors++;\n"
+         "    }\n"
+         "  }\n"
+         "  const char *big = \"123456789012345678901234567890\";\n"
+         "  if(convert_string_to_fixed(big, strlen(big), &y) != -EOVERFLOW) {\n"
+         "    printf(\"convert_string_to_fixed(\\\"%%s\\\") should be -EOVERFLOW\\n\", big);\n"
+         "    errors++;\n"
+         "  }\n");
+  if(s.lo > INT64_MIN) {
+    printf("  show_fixed(want, sizeof(want), %d, INT64_C(%lld) - 1);\n"
+           "  if(convert_string_to_fixed(want, strlen(want), &y) != -EOVERFLOW) {\n"
+           "    printf(\"convert_string_to_fixed(\\\"%%s\\\") should be -EOVERFLOW\\n\", want);\n"
+           "    errors++;\n"
+           "  }\n", s.f, (long long int)s.lo);
+  }
+  if(s.hi < INT64_MAX) {
+    printf("  show_fixed(want, sizeof(want), %d, INT64_C(%lld) + 1);\n"
+           "  if(convert_string_to_fixed(want, strlen(want), &y) != -EOVERFLOW) {\n"
+           "    printf(\"convert_string_to_fixed(\\\"%%s\\\") should be -EOVERFLOW\\n\", want);\n"
+           "    errors++;\n"
+           "  }\n", s.f, (long long int)s.hi);
+  }
+  printf("  printf(\"%%llu codes%s, %d decimal%s, up to %%d characters: %%lld errors\\n\",\n"
+         "         (unsigned long long int)count, CONVERT_STRING_SIZE - 1, errors);\n"
+         "  return errors != 0;\n"
+         "}\n\n", ties ? " and ties" : "", s.d, s.d == 1 ? "" : "s");
+
+  // timing
+  printf("/* time the string converters against show_fixed() and read_fixed() */\n"
+         "static void bench_strings(void) {\n"
+         "  static %s%d_t codes[BENCH_N];\n"
+         "  static char strings[BENCH_N][CONVERT_STRING_SIZE];\n"
+         "  char buf[128];\n"
+         "  int64_t v;\n"
+         "  double t;\n"
+         "  size_t i, r, sum = 0;\n"
+         "  for(i = 0; i < BENCH_N; i++) {\n"
+         "    codes[i] = (%s%d_t)(UINT64_C(%llu) + i * 2654435761u %% UINT64_C(%llu));\n"
+         "    show_fixed(strings[i], CONVERT_STRING_SIZE, %d, (int64_t)((uint64_t)codes[i] + UINT64_C(%llu)));\n"
+         "  }\n", t, w, t, w,
+         (unsigned long long int)(s.lo - offset), (unsigned long long int)(span ? span : 1),
+         s.f, (unsigned long long int)offset);
+  printf("  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS / 16; r++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) sum += convert_fixed_to_string(buf, sizeof(buf), codes[i]);\n"
+         "  }\n"
+         "  double show = (now() - t) / ((double)BENCH_N * (BENCH_REPS / 16));\n"
+         "  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS / 16; r++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) {\n"
+         "      sum += show_fixed(buf, sizeof(buf), %d, (int64_t)((uint64_t)codes[i] + UINT64_C(%llu)));\n"
+         "    }\n"
+         "  }\n"
+         "  double show_ref = (now() - t) / ((double)BENCH_N * (BENCH_REPS / 16));\n",
+         s.f, (unsigned long long int)offset);
+  printf("  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS / 16; r++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) {\n"
+         "      sum += convert_string_to_fixed(strings[i], CONVERT_STRING_SIZE - 1, &codes[i]);\n"
+         "    }\n"
+         "  }\n"
+         "  double read = (now() - t) / ((double)BENCH_N * (BENCH_REPS / 16));\n"
+         "  t = now();\n"
+         "  for(r = 0; r < BENCH_REPS / 16; r++) {\n"
+         "    for(i = 0; i < BENCH_N; i++) {\n"
+         "      sum += read_fixed(strings[i], CONVERT_STRING_SIZE - 1, %d, &v) + v;\n"
+         "    }\n"
+         "  }\n"
+         "  double read_ref = (now() - t) / ((double)BENCH_N * (BENCH_REPS / 16));\n",
+         s.f);
+  printf("  printf(\"convert_fixed_to_string: %%.2f ns, show_fixed %%.2f ns (%%.1fx)\\n\",\n"
+         "         show * 1e9, show_ref * 1e9, show_ref / show);\n"
+         "  printf(\"convert_string_to_fixed: %%.2f ns, read_fixed %%.2f ns (%%.1fx)\\n\",\n"
+         "         read * 1e9, read_ref * 1e9, read_ref / read);\n"
+         "  if(sum == 42) printf(\"\\n\"); // keep the results live\n"
+         "}\n");
+#undef printf
+}
@@ -0,0 +1,272 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gen.h"
+
+/* Lookup tables for 8 and 16 bit formats.
+
+   convert_to_double() reads a table of the values the arithmetic
+   version returns, and convert_to_string() one of the shortest decimal
+   strings that read back as those values.
+
+   convert_from_double() uses buckets half a code wide, so each one
+   lies within a single rounding interval and the index is just a
+   truncating conversion, with no round().  Rounding is ties away from
+   zero, so intervals are closed at the bottom for x >= 0 and at the
+   top for x < 0; negative values have their own buckets indexed by -x
+   to match.
+
+   --tables=auto uses a table if it fits in a typical L1 data cache. */
+
+#define TABLE_AUTO_LIMIT 32768 // bytes
+#define TABLE_EXACT_LIMIT (((int128_t)1) << 52)
+
+static const char *table_modes[] = {
+  [TABLES_OFF] = "off",
+  [TABLES_ON] = "on",
+  [TABLES_AUTO] = "auto"
+};
+
+bool gen_parse_tables(const char *name, enum gen_tables *tables) {
+  unsigned int i;
+  for(i = 0; i < sizeof(table_modes) / sizeof(table_modes[0]); i++) {
+    if(strcmp(name, table_modes[i]) == 0) {
+      *tables = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static
+int128_t codes(struct fpc_parameters *param) {
+  return param->upper_bound - param->lower_bound + 1;
+}
+
+static
+bool eligible(struct fpc_parameters *param, struct gen_options *opt, enum gen_table kind) {
+  int128_t
+    lb = param->lower_bound < 0 ? -param->lower_bound : param->lower_bound,
+    ub = param->upper_bound < 0 ? -param->upper_bound : param->upper_bound;
+  if(param->fixed_encoding_width > 16 || lb >= TABLE_EXACT_LIMIT || ub >= TABLE_EXACT_LIMIT) {
+    return false;
+  }
+  // the buckets round ties away from zero
+  return kind != TABLE_FROM_DOUBLE ||
+    opt->rounding == ROUNDING_LIBM || opt->rounding == ROUNDING_NEAREST;
+}
+
+/* what the arithmetic convert_to_double() returns for code c */
+static
+double table_value(struct fpc_parameters *param, int128_t c) {
+  char buf[32];
+  double v = ldexp((double)c, -param->fractional_bits);
+  if(param->offset) {
+    snprintf(buf, sizeof(buf), "%.19Lg", ldexpl(param->offset, -param->fractional_bits));
+    v = v + strtod(buf, NULL);
+  }
+  if(param->precision != 1.0L) {
+    double k, p;
+    snprintf(buf, sizeof(buf), "%.19Lg", 1.0L / param->precision);
+    k = strtod(buf, NULL);
+    snprintf(buf, sizeof(buf), "%.19Lg", param->precision);
+    p = strtod(buf, NULL);
+    v = round(v * k) * p;
+  }
+  return v;
+}
+
+/* the fewest decimals that read back as v */
+static
+int table_string(double v, char *buf, size_t size) {
+  int d, n = 0;
+  for(d = 0; d <= 40; d++) {
+    n = snprintf(buf, size, "%.*f", d, v);
+    if(strtod(buf, NULL) == v) break;
+  }
+  return n;
+}
+
+/* bucket index ranges [*lo, *hi] for x >= 0 (sign 1) or x < 0 (sign -1)
+   in units of half a code, false if the range has no such values */
+static
+bool bucket_range(struct fpc_parameters *param, int sign, int128_t *lo, int128_t *hi) {
+  long double
+    min = sign > 0 ? param->min : -param->max,
+    max = sign > 0 ? param->max : -param->min;
+  if(sign < 0 && min <= 0) min = 0x1p-16000L; // x < 0 only
+  if(max < 0 || min > max) return false;
+  if(min < 0) min = 0;
+  *lo = floorl(ldexpl(min, param->fractional_bits + 1));
+  *hi = floorl(ldexpl(max, param->fractional_bits + 1));
+  return true;
+}
+
+static
+size_t code_size(struct fpc_parameters *param) {
+  return param->fixed_encoding_width / 8;
+}
+
+size_t gen_table_size(struct fpc_parameters *param, enum gen_table kind) {
+  int128_t lo, hi, n = codes(param), i;
+  size_t size = 0, strings = 0;
+  char buf[64];
+  int sign;
+  switch(kind) {
+  case TABLE_TO_DOUBLE:
+    return n * sizeof(double);
+  case TABLE_TO_STRING:
+    for(i = 0; i < n; i++) {
+      strings += table_string(table_value(param, param->lower_bound - param->offset + i),
+                              buf, sizeof(buf)) + 1;
+    }
+    return strings + n * (strings > 65535 ? 4 : 2);
+  case TABLE_FROM_DOUBLE:
+    for(sign = 1; sign >= -1; sign -= 2) {
+      if(bucket_range(param, sign, &lo, &hi)) size += (hi - lo + 1) * code_size(param);
+    }
+    return size;
+  }
+  return 0;
+}
+
+bool gen_table_use(struct fpc_parameters *param, struct gen_options *opt, enum gen_table kind) {
+  if(opt->tables == TABLES_OFF || !eligible(param, opt, kind)) return false;
+  return opt->tables == TABLES_ON || gen_table_size(param, kind) <= TABLE_AUTO_LIMIT;
+}
+
+void gen_table_report(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+  static const char *names[] = {
+    [TABLE_TO_DOUBLE] = "convert_to_double",
+    [TABLE_TO_STRING] = "convert_to_string",
+    [TABLE_FROM_DOUBLE] = "convert_from_double"
+  };
+  enum gen_table kind;
+  size_t total = 0;
+  fprintf(f, "\n[TABLES]\n");
+  for(kind = TABLE_TO_DOUBLE; kind <= TABLE_FROM_DOUBLE; kind++) {
+    if(!eligible(param, opt, kind)) {
+      fprintf(f, "  %s: %s (no table for this format)\n", names[kind],
+              kind == TABLE_TO_STRING ? "none" : "arithmetic");
+      continue;
+    }
+    size_t size = gen_table_size(param, kind);
+    if(gen_table_use(param, opt, kind)) {
+      fprintf(f, "  %s: table, %zu bytes\n", names[kind], size);
+      total += size;
+    } else if(kind == TABLE_TO_STRING) {
+      fprintf(f, "  %s: none (table would be %zu bytes)\n", names[kind], size);
+    } else {
+      fprintf(f, "  %s: arithmetic (table would be %zu bytes)\n", names[kind], size);
+    }
+  }
+  fprintf(f, "  total: %zu bytes\n", total);
+}
+
+static
+void emit_buckets(struct fpc_parameters *param, int sign, int128_t lo, int128_t hi, FILE *f) {
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  int128_t j;
+  fprintf(f, "static const %s%d_t convert_buckets_%s[%lld] = {",
+          s, w, sign > 0 ? "pos" : "neg", (long long int)(hi - lo + 1));
+  for(j = lo; j <= hi; j++) {
+    // half codes j and j + 1 round to (j + 1) / 2 away from zero
+    int128_t code = sign * ((j + 1) / 2) - param->offset;
+    fprintf(f, "%s%lld,", (j - lo) % 16 ? " " : "\n  ", (long long int)code);
+  }
+  fprintf(f, "\n};\n\n");
+}
+
+void gen_tables(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  const char *S = param->use_signed ? "INT" : "UINT";
+  long long int lb = param->lower_bound - param->offset, ub = param->upper_bound - param->offset;
+  int128_t n = codes(param), i, lo, hi;
+  char buf[64];
+  int sign;
+
+  if(gen_table_use(param, opt, TABLE_TO_DOUBLE)) {
+    printf("static const double convert_to_double_table[%lld] = {", (long long int)n);
+    for(i = 0; i < n; i++) {
+      printf("%s%a,", i % 4 ? " " : "\n  ", table_value(param, lb + i));
+    }
+    printf("\n};\n\n");
+  }
+
+  if(gen_table_use(param, opt, TABLE_TO_STRING)) {
+    size_t offset = 0, total = gen_table_size(param, TABLE_TO_STRING) - n * 2;
+    const char *type = total > 65535 ? "uint32_t" : "uint16_t";
+    printf("static const char convert_strings[] =");
+    for(i = 0; i < n; i++) {
+      table_string(table_value(param, lb + i), buf, sizeof(buf));
+      printf("%s\"%s\\0\"", i % 8 ? " " : "\n  ", buf);
+    }
+    printf(";\n\n"
+           "static const %s convert_string_offsets[%lld] = {", type, (long long int)n);
+    for(i = 0; i < n; i++) {
+      printf("%s%zu,", i % 12 ? " " : "\n  ", offset);
+      offset += table_string(table_value(param, lb + i), buf, sizeof(buf)) + 1;
+    }
+    printf("\n};\n\n");
+    printf("/* the shortest decimal string for convert_to_double(x), NULL out of range */\n"
+           "const char *convert_to_string(%s%d_t x) {\n"
+           "  if(x < %s%d_C(%lld) || x > %s%d_C(%lld)) {\n"
+           "    return NULL;\n"
+           "  }\n"
+           "  return convert_strings + convert_string_offsets[x - %s%d_C(%lld)];\n"
+           "}\n\n", s, w, S, w, lb, S, w, ub, S, w, lb);
+  }
+
+  if(gen_table_use(param, opt, TABLE_FROM_DOUBLE)) {
+    for(sign = 1; sign >= -1; sign -= 2) {
+      if(bucket_range(param, sign, &lo, &hi)) emit_buckets(param, sign, lo, hi, f);
+    }
+  }
+#undef printf
+}
+
+void gen_table_to_double(struct fpc_parameters *param, FILE *f) {
+  const char *S = param->use_signed ? "INT" : "UINT";
+  fprintf(f, "  return convert_to_double_table[x - %s%d_C(%lld)];\n",
+          S, param->fixed_encoding_width, (long long int)(param->lower_bound - param->offset));
+}
+
+void gen_table_from_double(struct fpc_parameters *param, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int128_t pos_lo, pos_hi, neg_lo, neg_hi;
+  bool pos = bucket_range(param, 1, &pos_lo, &pos_hi);
+  bool neg = bucket_range(param, -1, &neg_lo, &neg_hi);
+  int fb = param->fractional_bits + 1;
+  if(pos && neg) printf("    if(x >= 0) {\n  ");
+  if(pos) {
+    printf("    *y = convert_buckets_pos[(int64_t)(x * 0x1p%d)", fb);
+    if(pos_lo) printf(" - INT64_C(%lld)", (long long int)pos_lo);
+    printf("];\n");
+  }
+  if(pos && neg) printf("    } else {\n  ");
+  if(neg) {
+    printf("    *y = convert_buckets_neg[(int64_t)(-x * 0x1p%d)", fb);
+    if(neg_lo) printf(" - INT64_C(%lld)", (long long int)neg_lo);
+    printf("];\n");
+  }
+  if(pos && neg) printf("    }\n");
+#undef printf
+}
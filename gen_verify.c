@@ -0,0 +1,343 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <math.h>
+
+#include "gen.h"
+
+/* A verify() function for the generated converters.  Codes are split
+   into units claimed by worker threads: chunks of consecutive codes
+   when there are at most 2^32, otherwise strata each sampled at random
+   offsets, 128 bits wide for 128 bit formats.  Every code is checked for
+
+   - the error of convert_to_double() against the exact value, which
+     should be within half the requested precision
+   - convert_from_double() taking the result back to a code with the
+     same value (the code itself may differ if precision > 2^-f), or
+     with --rounding=trunc or floor, which may land a code below the
+     rounded result, taking the exact value back to the code
+   - convert_to_double() being monotonic
+   - the batch converters taking the code to its exact value and back
+
+   and values outside [min, max] must be rejected. */
+
+#define EXHAUSTIVE_LIMIT (((int128_t)1) << 32)
+#define EXACT_LIMIT (((int128_t)1) << 53)
+
+void gen_verify(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  int w = param->fixed_encoding_width;
+  const char *s = param->use_signed ? "int" : "uint";
+  int128_t
+    lb = param->lower_bound - param->offset,
+    ub = param->upper_bound - param->offset,
+    min_int = 0, max_int = -1, // 128 bit codes are always checked
+    lb_abs = param->lower_bound < 0 ? -param->lower_bound : param->lower_bound,
+    ub_abs = param->upper_bound < 0 ? -param->upper_bound : param->upper_bound,
+    bound = lb_abs > ub_abs ? lb_abs : ub_abs;
+  bool exhaustive = ub - lb < EXHAUSTIVE_LIMIT;
+  bool batch = bound < EXACT_LIMIT;
+  bool directed = opt->rounding == ROUNDING_TRUNC || opt->rounding == ROUNDING_FLOOR;
+  bool wide = w == 128;
+  if(!wide) {
+    min_int = param->use_signed ? -(((int128_t)1) << (w - 1)) : 0;
+    max_int = (((int128_t)1) << (w - (param->use_signed ? 1 : 0))) - 1;
+  }
+
+  printf("#define VERIFY_CHUNK 65536\n"
+         "#define VERIFY_STRATA 1048576\n"
+         "#define VERIFY_SAMPLES 128\n\n");
+  printf("typedef %s%d_t code_t;\n"
+         "typedef %s verify_offset_t; /* from the lowest code */\n"
+         "static const verify_offset_t verify_span = ", s, w, wide ? "unsigned __int128" : "uint64_t");
+  if(wide) gen_arith_const(f, ub - lb);
+  else printf("UINT64_C(%llu)", (unsigned long long int)(ub - lb));
+  printf(";\n"
+         "static const bool verify_exhaustive = %s;\n\n", exhaustive ? "true" : "false");
+
+  printf("/* failures and the lowest offset from the first code that had one */\n"
+         "struct verify_count {\n"
+         "  uint64_t n;\n"
+         "  verify_offset_t first;\n"
+         "};\n\n"
+         "struct verify_stats {\n"
+         "  uint64_t codes;\n"
+         "  long double max_error;\n"
+         "  verify_offset_t worst;\n"
+         "  struct verify_count nan, rejected, changed, monotonic, batch;\n"
+         "};\n\n"
+         "struct verify_state {\n"
+         "  uint64_t next, units;\n"
+         "  pthread_mutex_t lock;\n"
+         "  struct verify_stats total;\n"
+         "};\n\n");
+
+  printf("static void verify_fail(struct verify_count *c, verify_offset_t i) {\n"
+         "  if(!c->n++ || i < c->first) c->first = i;\n"
+         "}\n\n"
+         "static void verify_merge_count(struct verify_count *to, const struct verify_count *c) {\n"
+         "  if(c->n && (!to->n || c->first < to->first)) to->first = c->first;\n"
+         "  to->n += c->n;\n"
+         "}\n\n");
+
+  printf("static code_t verify_code(verify_offset_t i) {\n"
+         "  return (code_t)(");
+  if(wide) {
+    printf("(verify_offset_t)");
+    gen_arith_const(f, lb);
+  } else {
+    printf("UINT64_C(%llu)", (unsigned long long int)lb);
+  }
+  printf(" + i);\n"
+         "}\n\n");
+
+  printf("/* the code at offset i in decimal */\n"
+         "static const char *verify_code_str(verify_offset_t i, char *buf) {\n");
+  if(wide) {
+    printf("  code_t c = verify_code(i);\n"
+           "  unsigned __int128 u = c < 0 ? -(unsigned __int128)c : (unsigned __int128)c;\n"
+           "  char tmp[40];\n"
+           "  int n = 0;\n"
+           "  do {\n"
+           "    tmp[n++] = '0' + u %% 10;\n"
+           "    u /= 10;\n"
+           "  } while(u);\n"
+           "  char *p = buf;\n"
+           "  if(c < 0) *p++ = '-';\n"
+           "  while(n) *p++ = tmp[--n];\n"
+           "  *p = 0;\n");
+  } else {
+    printf("  sprintf(buf, \"%%%s\", (%s)verify_code(i));\n",
+           param->use_signed ? "lld" : "llu", param->use_signed ? "long long" : "unsigned long long");
+  }
+  printf("  return buf;\n"
+         "}\n\n");
+
+  printf("static long double verify_exact(code_t c) {\n"
+         "  return c * 0x1p%dL", -param->fractional_bits);
+  if(param->offset) printf(" + %.21LgL", ldexpl(param->offset, -param->fractional_bits));
+  printf(";\n"
+         "}\n\n");
+
+  printf("/* splitmix64 */\n"
+         "static uint64_t verify_random(uint64_t x) {\n"
+         "  x += UINT64_C(0x9E3779B97F4A7C15);\n"
+         "  x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);\n"
+         "  x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);\n"
+         "  return x ^ (x >> 31);\n"
+         "}\n\n");
+
+  printf("/* offsets of the codes in unit u, returns how many */\n"
+         "static size_t verify_unit(uint64_t u, verify_offset_t *offsets) {\n"
+         "  size_t n = 0;\n"
+         "  if(verify_exhaustive) {\n"
+         "    verify_offset_t i = u * VERIFY_CHUNK;\n"
+         "    do {\n"
+         "      offsets[n++] = i;\n"
+         "    } while(i++ < verify_span && n < VERIFY_CHUNK);\n"
+         "    return n;\n"
+         "  }\n"
+         "  // total * u / VERIFY_STRATA without overflowing 128 bits\n"
+         "  unsigned __int128 total = (unsigned __int128)verify_span + 1, q = total / VERIFY_STRATA,\n"
+         "    r = total %% VERIFY_STRATA;\n"
+         "  verify_offset_t start = q * u + r * u / VERIFY_STRATA,\n"
+         "    end = q * (u + 1) + r * (u + 1) / VERIFY_STRATA - 1;\n"
+         "  offsets[n++] = start;\n"
+         "  while(n < VERIFY_SAMPLES - 1) {\n"
+         "    verify_offset_t x = verify_random(u * VERIFY_SAMPLES + n);\n");
+  if(wide) printf("    x = x << 64 | verify_random(~(u * VERIFY_SAMPLES + n));\n");
+  printf("    offsets[n++] = start + x %% (end - start + 1);\n"
+         "  }\n"
+         "  offsets[n++] = end;\n"
+         "  return n;\n"
+         "}\n\n");
+
+  printf("static void verify_run(struct verify_stats *st, const verify_offset_t *offsets, size_t n,\n"
+         "                       code_t *codes, double *values, double *exact, code_t *back) {\n"
+         "  size_t k;\n"
+         "  for(k = 0; k < n; k++) {\n"
+         "    codes[k] = verify_code(offsets[k]);\n"
+         "    values[k] = convert_to_double(codes[k]);\n"
+         "  }\n");
+  if(batch) {
+    printf("  convert_to_double_n(codes, exact, n);\n"
+           "  convert_from_double_n(exact, back, n, NULL);\n");
+  } else {
+    printf("  (void)exact;\n"
+           "  (void)back;\n");
+  }
+  printf("  for(k = 0; k < n; k++) {\n"
+         "    verify_offset_t i = offsets[k];\n"
+         "    double d = values[k];\n"
+         "    st->codes++;\n"
+         "    if(isnan(d)) {\n"
+         "      verify_fail(&st->nan, i);\n"
+         "      continue;\n"
+         "    }\n"
+         "    long double error = fabsl(d - verify_exact(codes[k]));\n"
+         "    if(error > st->max_error || (error == st->max_error && i < st->worst)) {\n"
+         "      st->max_error = error;\n"
+         "      st->worst = i;\n"
+         "    }\n");
+  if(!directed) {
+    printf("    code_t y;\n"
+           "    if(!convert_from_double(d, &y)) {\n"
+           "      verify_fail(&st->rejected, i);\n"
+           "    } else if(convert_to_double(y) != d) {\n"
+           "      verify_fail(&st->changed, i);\n"
+           "    }\n");
+  } else if(batch) {
+    printf("    code_t y;\n"
+           "    if(!convert_from_double((double)verify_exact(codes[k]), &y)) {\n"
+           "      verify_fail(&st->rejected, i);\n"
+           "    } else if(y != codes[k]) {\n"
+           "      verify_fail(&st->changed, i);\n"
+           "    }\n");
+  }
+  printf("    if(i < verify_span) {\n"
+         "      double next = verify_exhaustive && k + 1 < n ? values[k + 1] : convert_to_double(verify_code(i + 1));\n"
+         "      if(next < d) verify_fail(&st->monotonic, i);\n"
+         "    }\n");
+  if(batch) {
+    printf("    if(exact[k] != (double)verify_exact(codes[k]) || back[k] != codes[k]) {\n"
+           "      verify_fail(&st->batch, i);\n"
+           "    }\n");
+  }
+  printf("  }\n"
+         "}\n\n");
+
+  printf("static void *verify_work(void *arg) {\n"
+         "  struct verify_state *vs = arg;\n"
+         "  struct verify_stats st;\n"
+         "  size_t size = verify_exhaustive ? VERIFY_CHUNK : VERIFY_SAMPLES;\n"
+         "  verify_offset_t *offsets = malloc(size * sizeof(verify_offset_t));\n"
+         "  uint64_t u;\n"
+         "  code_t *codes = malloc(size * sizeof(code_t)), *back = malloc(size * sizeof(code_t));\n"
+         "  double *values = malloc(size * sizeof(double)), *exact = malloc(size * sizeof(double));\n"
+         "  memset(&st, 0, sizeof(st));\n"
+         "  while((u = __atomic_fetch_add(&vs->next, 1, __ATOMIC_RELAXED)) < vs->units) {\n"
+         "    size_t n = verify_unit(u, offsets);\n"
+         "    verify_run(&st, offsets, n, codes, values, exact, back);\n"
+         "  }\n");
+  printf("  pthread_mutex_lock(&vs->lock);\n"
+         "  struct verify_stats *t = &vs->total;\n"
+         "  t->codes += st.codes;\n"
+         "  if(st.max_error > t->max_error || (st.max_error == t->max_error && st.worst < t->worst)) {\n"
+         "    t->max_error = st.max_error;\n"
+         "    t->worst = st.worst;\n"
+         "  }\n"
+         "  verify_merge_count(&t->nan, &st.nan);\n"
+         "  verify_merge_count(&t->rejected, &st.rejected);\n"
+         "  verify_merge_count(&t->changed, &st.changed);\n"
+         "  verify_merge_count(&t->monotonic, &st.monotonic);\n"
+         "  verify_merge_count(&t->batch, &st.batch);\n"
+         "  pthread_mutex_unlock(&vs->lock);\n"
+         "  free(offsets);\n"
+         "  free(codes);\n"
+         "  free(back);\n"
+         "  free(values);\n"
+         "  free(exact);\n"
+         "  return NULL;\n"
+         "}\n\n");
+
+  printf("static int verify_report(const char *what, const struct verify_count *c) {\n"
+         "  if(!c->n) {\n"
+         "    printf(\"  %%s: ok\\n\", what);\n"
+         "    return 0;\n"
+         "  }\n"
+         "  char buf[48];\n"
+         "  printf(\"  %%s: %%llu failures, first at code %%s\\n\",\n"
+         "         what, (unsigned long long)c->n, verify_code_str(c->first, buf));\n"
+         "  return 1;\n"
+         "}\n\n");
+
+  printf("/* a value out of range must be rejected by both converters */\n"
+         "static int verify_reject(double x) {\n"
+         "  code_t y;\n"
+         "  uint8_t err = 0;\n"
+         "  bool scalar = convert_from_double(x, &y);\n"
+         "  convert_from_double_n(&x, &y, 1, &err);\n"
+         "  if(!scalar && err) return 0;\n"
+         "  printf(\"  out of range: %%.17g accepted by the %%s converter\\n\", x,\n"
+         "         scalar && !err ? \"scalar and batch\" : scalar ? \"scalar\" : \"batch\");\n"
+         "  return 1;\n"
+         "}\n\n");
+
+  printf("static int verify(int threads) {\n"
+         "  struct verify_state vs;\n"
+         "  int i, bad = 0;\n"
+         "  if(threads < 1) threads = sysconf(_SC_NPROCESSORS_ONLN);\n"
+         "  if(threads < 1) threads = 1;\n"
+         "  memset(&vs, 0, sizeof(vs));\n"
+         "  vs.units = verify_exhaustive ? verify_span / VERIFY_CHUNK + 1 : VERIFY_STRATA;\n"
+         "  pthread_mutex_init(&vs.lock, NULL);\n"
+         "  pthread_t *workers = calloc(threads, sizeof(*workers));\n"
+         "  for(i = 0; i < threads; i++) pthread_create(&workers[i], NULL, verify_work, &vs);\n"
+         "  for(i = 0; i < threads; i++) pthread_join(workers[i], NULL);\n"
+         "  free(workers);\n"
+         "  pthread_mutex_destroy(&vs.lock);\n\n");
+  printf("  struct verify_stats *t = &vs.total;\n"
+         "  char buf[48];\n"
+         "  printf(\"%%llu codes %%s, %%d threads\\n\", (unsigned long long)t->codes,\n"
+         "         verify_exhaustive ? \"(all)\" : \"(stratified sample)\", threads);\n"
+         "  printf(\"  max error: %%.6Lg at code %%s, %%.3g of the precision\\n\",\n"
+         "         t->max_error, verify_code_str(t->worst, buf), (double)(t->max_error / %.19LgL));\n",
+         param->precision);
+  printf("  if(t->max_error > %.19LgL) {\n"
+         "    printf(\"  max error: more than half the precision\\n\");\n"
+         "    bad++;\n"
+         "  }\n", param->precision / 2 * (1 + 0x1p-40L) + ldexpl(bound, -param->fractional_bits) * 0x1p-52L);
+  printf("  bad += verify_report(\"in range codes\", &t->nan);\n");
+  if(!directed) {
+    printf("  bad += verify_report(\"round trip rejected\", &t->rejected);\n"
+           "  bad += verify_report(\"round trip changed\", &t->changed);\n");
+  } else if(batch) {
+    printf("  bad += verify_report(\"exact round trip rejected\", &t->rejected);\n"
+           "  bad += verify_report(\"exact round trip changed\", &t->changed);\n");
+  } else {
+    printf("  printf(\"  exact round trip: skipped, values are not exact doubles\\n\");\n");
+  }
+  printf("  bad += verify_report(\"monotonic\", &t->monotonic);\n");
+  if(batch) {
+    printf("  bad += verify_report(\"batch round trip\", &t->batch);\n");
+  } else {
+    printf("  printf(\"  batch round trip: skipped, values are not exact doubles\\n\");\n");
+  }
+  if(lb != min_int) {
+    printf("  if(!isnan(convert_to_double(verify_code(-1)))) {\n"
+           "    printf(\"  out of range: code %%s converted\\n\", verify_code_str(-1, buf));\n"
+           "    bad++;\n"
+           "  }\n");
+  }
+  if(ub != max_int) {
+    printf("  if(!isnan(convert_to_double(verify_code(verify_span + 1)))) {\n"
+           "    printf(\"  out of range: code %%s converted\\n\", verify_code_str(verify_span + 1, buf));\n"
+           "    bad++;\n"
+           "  }\n");
+  }
+  // a step of the precision may be lost to rounding in large formats
+  double below = param->min - param->precision, above = param->max + param->precision;
+  if(below >= (double)param->min) below = nextafter(param->min, -INFINITY);
+  if(above <= (double)param->max) above = nextafter(param->max, INFINITY);
+  printf("  bad += verify_reject(NAN);\n"
+         "  bad += verify_reject(INFINITY);\n"
+         "  bad += verify_reject(-INFINITY);\n"
+         "  bad += verify_reject(%.17g);\n"
+         "  bad += verify_reject(%.17g);\n",
+         below, above);
+  printf("  printf(\"%%s\\n\", bad ? \"FAILED\" : \"ok\");\n"
+         "  return bad != 0;\n"
+         "}\n");
+#undef printf
+}
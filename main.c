@@ -18,41 +18,74 @@
 #include <inttypes.h>
 
 #include "fpc.h"
+#include "gen.h"
+#include "modes.h"
 
 #define max(x, y) ((y) > (x) ? (y) : (x))
 
+/* %.19Lg, but as a floating point literal if it would be too large for an integer one */
 static
-void convert_to_double(struct fpc_parameters *param, FILE *f) {
+const char *literal(long double x, char *buf) {
+  int n = sprintf(buf, "%.19Lg", x);
+  if(strspn(buf, "-0123456789") == (size_t)n && fabsl(x) >= 0x1p62L) strcpy(buf + n, ".0");
+  return buf;
+}
+
+/* x codes as a value */
+static
+long double value(struct fpc_parameters *param, struct gen_options *opt, int128_t x) {
+  if(opt->scaled) return (long double)x * opt->scaled->num / opt->scaled->den;
+  return ldexpl(x, -param->fractional_bits);
+}
+
+static
+void convert_to_double(struct fpc_parameters *param, struct gen_options *opt,
+                       const char *name, FILE *f) {
 #define printf(...) fprintf(f, __VA_ARGS__)
   int128_t
     lb = param->lower_bound - param->offset,
     ub = param->upper_bound - param->offset,
-    min_int = param->use_signed ? -(1 << (param->fixed_encoding_width - 1)) : 0,
-    max_int = (1 << (param->fixed_encoding_width - (param->use_signed ? 1 : 0))) - 1;
-  printf("double convert_to_double(%s%d_t x) {\n",
+    min_int = 0, max_int = -1; // 128 bit codes stay within 2^126, see fit()
+  if(param->fixed_encoding_width < 128) {
+    min_int = param->use_signed ? -(((int128_t)1) << (param->fixed_encoding_width - 1)) : 0;
+    max_int = (((int128_t)1) << (param->fixed_encoding_width - (param->use_signed ? 1 : 0))) - 1;
+  }
+  printf("double %s(%s%d_t x) {\n", name,
          param->use_signed ? "int" : "uint", param->fixed_encoding_width);
 
   // Check bounds
   if(lb != min_int || ub != max_int) {
     printf("  if(");
     if(lb != min_int) {
-      printf("x < %s%d_C(%lld)",
-             param->use_signed ? "INT" : "UINT",
-             param->fixed_encoding_width,
-             (long long int)lb);
+      printf("x < ");
+      gen_code_const(param, lb, f);
       if(ub != max_int) printf(" ||\n     ");
     }
     if(ub != max_int) {
-      printf("x > %s%d_C(%lld)",
-             param->use_signed ? "INT" : "UINT",
-             param->fixed_encoding_width,
-             (long long int)ub);
+      printf("x > ");
+      gen_code_const(param, ub, f);
     }
     printf(") {\n"
       "    return NAN;\n"
       "  }\n");
   }
 
+  if(opt->scaled) {
+    gen_scale_to_double(opt->scaled, f);
+    printf("}\n");
+    return;
+  }
+  if(gen_table_use(param, opt, TABLE_TO_DOUBLE)) {
+    gen_table_to_double(param, f);
+    printf("}\n");
+    return;
+  }
+  if(opt->rounding != ROUNDING_LIBM) {
+    gen_round_to_double(param, f);
+    printf("}\n");
+    return;
+  }
+
   printf("  return ");
   if(param->precision != 1.0l) {
     printf("round(");
@@ -78,20 +111,45 @@ void convert_to_double(struct fpc_parameters *param, FILE *f) {
 }
 
 static
-void convert_from_double(struct fpc_parameters *param, FILE *f) {
+void convert_from_double(struct fpc_parameters *param, struct gen_options *opt,
+                         const char *name, FILE *f) {
 #define printf(...) fprintf(f, __VA_ARGS__)
-  printf("bool convert_from_double(double x, %s%d_t *y) {\n",
+  printf("bool %s(double x, %s%d_t *y) {\n", name,
          param->use_signed ? "int" : "uint", param->fixed_encoding_width);
 
   // Check bounds
-  printf("  if(x < %Lg || x > %Lg) {\n", param->min, param->max);
-  printf("    return false;\n"
-         "  } else {\n");
-  printf("    *y = round(ldexp(x, %d))", param->fractional_bits);
-  if(param->offset != 0) {
-    printf(" - %.19Lg", (long double)param->offset);
+  char min[32], max[32];
+  printf("  if(!(x >= %s && x <= %s)) {\n", literal(param->min, min), literal(param->max, max));
+  printf("    return false;\n");
+  // a bound that isn't a double rounds outward, past the code range
+  if((double)param->min < param->min && (double)param->min < value(param, opt, param->lower_bound)) {
+    printf("  } else if(x < %.17g) {\n"
+           "    *y = ", gen_inward(param->min, INFINITY));
+    gen_code_const(param, param->lower_bound - param->offset, f);
+    printf(";\n"
+           "    return true;\n");
+  }
+  if((double)param->max > param->max && (double)param->max > value(param, opt, param->upper_bound)) {
+    printf("  } else if(x > %.17g) {\n"
+           "    *y = ", gen_inward(param->max, -INFINITY));
+    gen_code_const(param, param->upper_bound - param->offset, f);
+    printf(";\n"
+           "    return true;\n");
+  }
+  printf("  } else {\n");
+  if(opt->scaled) {
+    gen_scale_from_double(opt->scaled, f);
+  } else if(gen_table_use(param, opt, TABLE_FROM_DOUBLE)) {
+    gen_table_from_double(param, f);
+  } else if(opt->rounding != ROUNDING_LIBM) {
+    gen_round_from_double(param, opt, f);
+  } else {
+    printf("    *y = round(ldexp(x, %d))", param->fractional_bits);
+    if(param->offset != 0) {
+      printf(" - %.19Lg", (long double)param->offset);
+    }
+    printf(";\n");
   }
-  printf(";\n");
   printf("    return true;\n"
          "  }\n"
          "}\n");
@@ -100,59 +158,232 @@ void convert_from_double(struct fpc_parameters *param, FILE *f) {
 }
 
 static
-void print_params(struct fpc_parameters *param) {
+void print_params(struct fpc_parameters *param, struct gen_options *opt) {
   printf("[PARAMETERS]\n");
   printf("  min: %.19Lg (%.19Lg requested)\n",
-         ldexpl(param->lower_bound, -param->fractional_bits),
+         value(param, opt, param->lower_bound),
          param->min);
   printf("  max: %.19Lg (%.19Lg requested)\n",
-         ldexpl(param->upper_bound, -param->fractional_bits),
+         value(param, opt, param->upper_bound),
          param->max);
-  long double actual_precision = ldexpl(1.0L, -param->fractional_bits);
+  long double actual_precision = value(param, opt, 1);
   printf("  precision: %.19Lg (%.19Lg requested)\n",
          actual_precision,
          param->precision);
   printf("\n[CODE]\n");
   printf("  code density: %.1Lf%%\n", 100L * actual_precision / param->precision);
-  if(param->large_offset) {
-    printf("  offset: about %.19Lg\n", (long double)param->offset);
-  } else {
-    printf("  offset: %" PRId64 "\n", (int64_t)param->offset);
-  }
-  printf("  code range: [%" PRId64 ", %" PRId64 "]\n",
-         (int64_t)(param->lower_bound - param->offset),
-         (int64_t)(param->upper_bound - param->offset));
+  char buf[3][41];
+  printf("  offset: %s\n", int128_str(param->offset, buf[0]));
+  printf("  code range: [%s, %s]\n",
+         int128_str(param->lower_bound - param->offset, buf[1]),
+         int128_str(param->upper_bound - param->offset, buf[2]));
   printf("\n[ENCODING]\n");
   printf("  machine bit width: %d (%d used)\n", param->fixed_encoding_width, param->integer_bits + param->fractional_bits);
-  printf("    fractional bits: %d\n", param->fractional_bits);
-  printf("    integer bits: %d\n", param->integer_bits);
+  if(opt->scaled) {
+    printf("    scale: %lld/%lld\n", opt->scaled->num, opt->scaled->den);
+  } else {
+    printf("    fractional bits: %d\n", param->fractional_bits);
+    printf("    integer bits: %d\n", param->integer_bits);
+  }
   printf("  use signed: %s\n", param->use_signed ? "yes" : "no");
   printf("  machine integer type: %s%d_t\n", param->use_signed ? "int" : "uint", param->fixed_encoding_width);
-  printf("  Q notation: Q%c%d.%d\n", param->use_signed ? 's' : 'u', param->fixed_encoding_width - param->fractional_bits - (param->use_signed ? 1 : 0), param->fractional_bits);
+  if(!opt->scaled) {
+    printf("  Q notation: Q%c%d.%d\n", param->use_signed ? 's' : 'u', param->fixed_encoding_width - param->fractional_bits - (param->use_signed ? 1 : 0), param->fractional_bits);
+  }
+  if(opt->tables != TABLES_OFF) gen_table_report(param, opt, stdout);
+  if(opt->packed) gen_pack_report(param, stdout);
+  if(opt->instrument) gen_stats_report(param, stdout);
+  if(opt->scale != FPC_SCALE_POW2) {
+    gen_scale_report(opt->scaled ? &opt->scaled->param : param,
+                     opt->scaled ? opt->scaled->scale : FPC_SCALE_POW2, stdout);
+  }
   printf("\n[CONVERSION]\n");
-  convert_to_double(param, stdout);
+  if(opt->rounding != ROUNDING_LIBM) gen_round_helpers(param, opt, stdout);
+  convert_to_double(param, opt, "convert_to_double", stdout);
   printf("\n");
-  convert_from_double(param, stdout);
+  convert_from_double(param, opt, "convert_from_double", stdout);
+}
+
+void gen_library(struct fpc_parameters *param, struct gen_options *opt, FILE *f) {
+  if(opt->rounding != ROUNDING_LIBM) {
+    gen_round_helpers(param, opt, f);
+  }
+  gen_tables(param, opt, f);
+  convert_to_double(param, opt, opt->instrument ? "convert_to_double_raw" : "convert_to_double", f);
+  fprintf(f, "\n");
+  convert_from_double(param, opt, opt->instrument ? "convert_from_double_raw" : "convert_from_double", f);
+  fprintf(f, "\n");
+  if(opt->instrument) {
+    gen_stats(param, opt, f);
+    fprintf(f, "\n");
+  }
+  if(opt->scaled) gen_scale_batch(opt->scaled, f);
+  else gen_batch(param, f);
+  fprintf(f, "\n");
+  gen_string(param, opt, f);
+  if(opt->packed) {
+    fprintf(f, "\n");
+    gen_pack(param, f);
+  }
+}
+
+int gen_parse_option(const char *arg, struct gen_options *opt) {
+  if(strncmp(arg, "--rounding=", 11) == 0) {
+    if(!gen_parse_rounding(arg + 11, &opt->rounding)) {
+      fprintf(stderr, "ERROR: unknown rounding: %s\n", arg + 11);
+      return -1;
+    }
+  } else if(strncmp(arg, "--scale=", 8) == 0) {
+    if(!gen_parse_scale(arg + 8, &opt->scale)) {
+      fprintf(stderr, "ERROR: unknown scale: %s\n", arg + 8);
+      return -1;
+    }
+  } else if(strcmp(arg, "--packed") == 0) {
+    opt->packed = true;
+  } else if(strcmp(arg, "--instrument") == 0) {
+    opt->instrument = true;
+  } else if(strncmp(arg, "--tables=", 9) == 0) {
+    if(!gen_parse_tables(arg + 9, &opt->tables)) {
+      fprintf(stderr, "ERROR: unknown tables: %s\n", arg + 9);
+      return -1;
+    }
+  } else if(strncmp(arg, "--strings=", 10) == 0) {
+    if(!gen_parse_strings(arg + 10, &opt->strings)) {
+      fprintf(stderr, "ERROR: unknown strings: %s\n", arg + 10);
+      return -1;
+    }
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+struct fpc_parameters *gen_calculate(char *min, char *max, char *precision,
+                                     struct gen_options *opt, struct fpc_parameters *param,
+                                     struct fpc_scaled *scaled) {
+  if(!fpc_calculate_from_strings(min, max, precision, param)) {
+    fprintf(stderr, "ERROR: %s\n", param->error);
+    return NULL;
+  }
+  if(param->fixed_encoding_width == 128 &&
+     (opt->rounding != ROUNDING_LIBM || opt->packed || opt->instrument || opt->scale != FPC_SCALE_POW2)) {
+    fprintf(stderr, "ERROR: --rounding, --packed, --instrument and --scale need codes of at most 64 bits\n");
+    return NULL;
+  }
+  if(opt->scale == FPC_SCALE_POW2) return param;
+  if(!fpc_calculate_scaled(param, opt->scale, scaled)) {
+    fprintf(stderr, "ERROR: %s\n", scaled->param.error);
+    return NULL;
+  }
+  if(scaled->scale == FPC_SCALE_POW2) return param;
+  if(scaled->param.fixed_encoding_width == 128) {
+    fprintf(stderr, "ERROR: --rounding, --packed, --instrument and --scale need codes of at most 64 bits\n");
+    return NULL;
+  }
+  if(opt->rounding != ROUNDING_LIBM || opt->tables != TABLES_OFF) {
+    fprintf(stderr, "ERROR: --rounding and --tables need a power of two scale\n");
+    return NULL;
+  }
+  opt->scaled = scaled;
+  return &scaled->param;
 }
 
 static
-void gen_converter(struct fpc_parameters *param) {
+void gen_converter(struct fpc_parameters *param, struct gen_options *opt) {
+  struct gen_options ref = { .rounding = ROUNDING_LIBM };
+  bool strings = gen_string_eligible(param, opt);
   FILE *f = fopen("convert.c", "w");
   fprintf(f,
+          "#include <errno.h>\n"
           "#include <math.h>\n"
           "#include <stdint.h>\n"
           "#include <stdbool.h>\n"
           "#include <stdio.h>\n"
           "#include <stdlib.h>\n"
-          "#include <string.h>\n\n");
-  convert_to_double(param, f);
+          "#include <string.h>\n"
+          "#include <time.h>\n"
+          "#include <pthread.h>\n"
+          "#include <unistd.h>\n"
+          "%s\n", strings ? "#include \"fixnum_string.h\"\n" : "");
+  if(param->fixed_encoding_width == 128) gen_int128_types(f);
+  gen_library(param, opt, f);
   fprintf(f, "\n");
-  convert_from_double(param, f);
+  if(opt->rounding != ROUNDING_LIBM) {
+    // keep the libm versions to test against
+    convert_to_double(param, &ref, "convert_to_double_ref", f);
+    fprintf(f, "\n");
+    convert_from_double(param, &ref, "convert_from_double_ref", f);
+    fprintf(f, "\n");
+  }
+  gen_batch_bench(param, f);
+  fprintf(f, "\n");
+  if(opt->scaled) gen_scale_verify(opt->scaled, f);
+  else gen_verify(param, opt, f);
+  if(strings) {
+    fprintf(f, "\n");
+    gen_string_test(param, opt, f);
+  }
+  if(opt->packed) {
+    fprintf(f, "\n");
+    gen_pack_test(param, f);
+  }
+  if(opt->rounding != ROUNDING_LIBM) {
+    fprintf(f, "\n");
+    gen_round_test(param, opt, f);
+  }
+  if(opt->instrument) {
+    fprintf(f, "\n");
+    gen_stats_test(param, f);
+  }
   fprintf(f,
           "\n"
           "int main(int argc, char **argv) {\n"
           "  int i;\n"
           "  argv++; argc--; // skip first arg\n"
+          "  if(argc == 1 && strcmp(argv[0], \"-b\") == 0) {\n"
+          "    bench(NULL);\n"
+          "%s"
+          "    return 0;\n"
+          "  }\n"
+          "  if(argc == 2 && strcmp(argv[0], \"-B\") == 0) {\n"
+          "    bench(argv[1]);\n"
+          "%s"
+          "    return 0;\n"
+          "  }\n"
+          "  if(argc >= 1 && strcmp(argv[0], \"-v\") == 0) {\n"
+          "    return verify(argc > 1 ? atoi(argv[1]) : 0);\n"
+          "  }\n",
+          opt->packed ? "    bench_packed(NULL);\n" : "",
+          opt->packed ? "    bench_packed(argv[1]);\n" : "");
+  if(opt->packed) {
+    fprintf(f,
+            "  if(argc == 1 && strcmp(argv[0], \"-P\") == 0) {\n"
+            "    return test_packed();\n"
+            "  }\n");
+  }
+  if(strings) {
+    fprintf(f,
+            "  if(argc == 1 && strcmp(argv[0], \"-s\") == 0) {\n"
+            "    return test_strings();\n"
+            "  }\n"
+            "  if(argc == 1 && strcmp(argv[0], \"-S\") == 0) {\n"
+            "    bench_strings();\n"
+            "    return 0;\n"
+            "  }\n");
+  }
+  if(opt->rounding != ROUNDING_LIBM) {
+    fprintf(f,
+            "  if(argc == 1 && strcmp(argv[0], \"-t\") == 0) {\n"
+            "    return test();\n"
+            "  }\n");
+  }
+  if(opt->instrument) {
+    fprintf(f,
+            "  if(argc == 1 && strcmp(argv[0], \"-I\") == 0) {\n"
+            "    return test_stats();\n"
+            "  }\n");
+  }
+  fprintf(f,
           "  for(i = 0; i < argc; i++) {\n"
           "    char *s = argv[i];\n"
           "    if(strchr(s, '.')) {\n"
@@ -177,30 +408,84 @@ void gen_converter(struct fpc_parameters *param) {
 int main(int argc, char **argv) {
   struct fpc_parameters param;
   memset(&param, 0, sizeof(param));
+  struct gen_options opt = { .rounding = ROUNDING_LIBM, .tables = TABLES_OFF,
+                              .strings = STRINGS_SHORTEST, .packed = false, .instrument = false,
+                              .scale = FPC_SCALE_POW2 };
+  struct fpc_scaled scaled;
   bool gen = false;
 
+  if(argc >= 2 && strcmp(argv[1], "--sweep") == 0) {
+    return sweep_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+    return batch_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--convert") == 0) {
+    return bulk_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--arith") == 0) {
+    return arith_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--formula") == 0) {
+    return formula_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--approx") == 0) {
+    return approx_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--record") == 0) {
+    return record_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--requant") == 0) {
+    return requant_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--codec") == 0) {
+    return codec_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--feedback") == 0) {
+    return feedback_main(argc - 2, argv + 2);
+  }
+  if(argc >= 2 && strcmp(argv[1], "--manifest") == 0) {
+    return manifest_main(argc - 2, argv + 2);
+  }
+
   if(argc == 2) {
     // simple expression evaluator
     printf("%.19Lg\n", fpc_eval_expr(argv[1]));
     return 0;
   }
 
-  if(argc <= 3) {
-    printf("fpc [min] [max] [precision]\n");
-    return -1;
-  }
-
-  if(strcmp(argv[1], "-g") == 0) {
-    gen = true;
-    argv++;
+  for(; argc > 4; argc--, argv++) {
+    if(strcmp(argv[1], "-g") == 0) {
+      gen = true;
+    } else {
+      int r = gen_parse_option(argv[1], &opt);
+      if(r < 0) return -1;
+      if(r == 0) break;
+    }
   }
 
-  if(fpc_calculate_from_strings(argv[1], argv[2], argv[3], &param)) {
-    print_params(&param);
-    if(gen) gen_converter(&param);
-    return 0;
-  } else {
-    fprintf(stderr, "ERROR: %s\n", param.error);
+  if(argc != 4) {
+    printf("fpc [-g] [--rounding=nearest|even|lrint|trunc|floor] [--tables=on|off|auto]\n"
+           "    [--strings=shortest|fixed] [--packed] [--instrument]\n"
+           "    [--scale=pow2|decimal|exact|auto]\n"
+           "    [min] [max] [precision]\n"
+           "fpc --sweep ...\n"
+           "fpc --batch ...\n"
+           "fpc --arith ...\n"
+           "fpc --formula ...\n"
+           "fpc --approx ...\n"
+           "fpc --record ...\n"
+           "fpc --requant ...\n"
+           "fpc --codec ...\n"
+           "fpc --feedback ...\n"
+           "fpc --manifest ...\n"
+           "fpc [expression]\n");
     return -1;
   }
+
+  struct fpc_parameters *format = gen_calculate(argv[1], argv[2], argv[3], &opt, &param, &scaled);
+  if(!format) return -1;
+  print_params(format, &opt);
+  if(gen) gen_converter(format, &opt);
+  return 0;
 }
@@ -0,0 +1,421 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen.h"
+#include "modes.h"
+
+/* Converters for many formats from a manifest.
+
+   Each line of the manifest is "name [options] min max precision" with
+   the options of fpc -g, # starts a comment.  Every spec gets name.h
+   declaring its converters and name.c defining them: the code of -g
+   without the tests and main(), with the convert_ and CONVERT_ prefixes
+   of its identifiers renamed to name_ and NAME_ so that any number of
+   formats link together.  With --library=lib all of them go to one
+   lib.h and lib.c instead.
+
+   The first line of each file has a hash of the spec and of fpc itself.
+   Specs whose files already have their hash are skipped, and files are
+   only written when their contents change, so a build that depends on
+   the outputs recompiles just what changed.  --depfile writes the
+   outputs' dependency on the manifest for make or ninja.
+
+   The string converters of 128 bit formats call fixnum_string.c, which
+   must then be linked in too. */
+
+#define MAX_LINE 1024
+#define MAX_NAME 64
+
+struct spec {
+  char name[MAX_NAME];
+  char text[MAX_LINE]; /* the spec with single spaces, which is hashed */
+  unsigned long line;
+  struct gen_options opt;
+  struct fpc_parameters param;
+  struct fpc_scaled scaled;
+  struct fpc_parameters *format; /* param or scaled.param */
+  uint64_t hash;
+};
+
+#define FNV_OFFSET UINT64_C(14695981039346656037)
+#define FNV_PRIME UINT64_C(1099511628211)
+
+static
+uint64_t fnv1a(uint64_t h, const void *data, size_t n) {
+  const unsigned char *p = data;
+  size_t i;
+  for(i = 0; i < n; i++) {
+    h ^= p[i];
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+/* a hash of the fpc binary, so a new fpc regenerates everything */
+static
+uint64_t fpc_hash(void) {
+  FILE *in = fopen("/proc/self/exe", "rb");
+  unsigned char buf[65536];
+  uint64_t h = FNV_OFFSET;
+  size_t n;
+  if(!in) return h;
+  while((n = fread(buf, 1, sizeof(buf), in)) > 0) h = fnv1a(h, buf, n);
+  fclose(in);
+  return h;
+}
+
+/* parse line n of path into s, false after printing an error */
+static
+bool parse_spec(char *line, const char *path, unsigned long n, struct spec *s) {
+  char *arg[16];
+  int argc = 0, i;
+  char *t;
+  for(t = strtok(line, " \t\r\n"); t; t = strtok(NULL, " \t\r\n")) {
+    if(argc == 16) {
+      fprintf(stderr, "ERROR: %s:%lu: too many words\n", path, n);
+      return false;
+    }
+    arg[argc++] = t;
+  }
+  memset(s, 0, sizeof(*s));
+  s->line = n;
+  s->opt = (struct gen_options){ .rounding = ROUNDING_LIBM, .tables = TABLES_OFF,
+                                 .strings = STRINGS_SHORTEST, .scale = FPC_SCALE_POW2 };
+  if(argc < 4 || !gen_valid_name(arg[0]) || strlen(arg[0]) >= MAX_NAME) {
+    fprintf(stderr, "ERROR: %s:%lu: expected name [options] min max precision\n", path, n);
+    return false;
+  }
+  if(gen_reserved_name(arg[0])) {
+    fprintf(stderr, "ERROR: %s:%lu: %s_t is a standard type\n", path, n, arg[0]);
+    return false;
+  }
+  strcpy(s->name, arg[0]);
+  strcpy(s->text, arg[0]);
+  for(i = 1; i < argc; i++) {
+    strcat(s->text, " ");
+    strcat(s->text, arg[i]);
+  }
+  for(i = 1; i < argc - 3; i++) {
+    int r = gen_parse_option(arg[i], &s->opt);
+    if(r == 0) fprintf(stderr, "ERROR: %s:%lu: unknown option: %s\n", path, n, arg[i]);
+    if(r <= 0) return false;
+  }
+  s->format = gen_calculate(arg[argc - 3], arg[argc - 2], arg[argc - 1], &s->opt, &s->param, &s->scaled);
+  if(!s->format) {
+    fprintf(stderr, "ERROR: %s:%lu: in the spec of %s\n", path, n, s->name);
+    return false;
+  }
+  return true;
+}
+
+/* the specs of the manifest at path, NULL after printing an error */
+static
+struct spec **read_manifest(const char *path, int *count) {
+  FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  char line[MAX_LINE];
+  unsigned long n = 0;
+  struct spec **specs = NULL;
+  int i;
+  bool failed = false;
+  *count = 0;
+  if(!in) {
+    fprintf(stderr, "ERROR: %s: cannot read\n", path);
+    return NULL;
+  }
+  while(!failed && fgets(line, sizeof(line), in)) {
+    char *p = line;
+    n++;
+    while(isspace((unsigned char)*p)) p++;
+    if(!*p || *p == '#') continue;
+    specs = realloc(specs, (*count + 1) * sizeof(*specs));
+    specs[*count] = malloc(sizeof(struct spec));
+    failed = !parse_spec(p, path, n, specs[*count]);
+    for(i = 0; !failed && i < *count; i++) {
+      if(strcmp(specs[i]->name, specs[*count]->name) == 0) {
+        fprintf(stderr, "ERROR: %s:%lu: %s is already on line %lu\n", path, n, specs[i]->name,
+                specs[i]->line);
+        failed = true;
+      }
+    }
+    (*count)++;
+  }
+  if(in != stdin) fclose(in);
+  if(!failed && *count == 0) {
+    fprintf(stderr, "ERROR: %s: no specs\n", path);
+    failed = true;
+  }
+  if(failed) {
+    for(i = 0; i < *count; i++) free(specs[i]);
+    free(specs);
+    return NULL;
+  }
+  return specs;
+}
+
+/* code with the convert_ and CONVERT_ prefixes of identifiers replaced
+   by name_ and NAME_ */
+static
+void rename_prefix(const char *code, const char *name, FILE *f) {
+  const char *p = code;
+  const char *q;
+  while(*p) {
+    bool start = p == code || !(isalnum((unsigned char)p[-1]) || p[-1] == '_');
+    if(start && strncmp(p, "convert_", 8) == 0) {
+      fputs(name, f);
+      p += 7;
+    } else if(start && strncmp(p, "CONVERT_", 8) == 0) {
+      for(q = name; *q; q++) fputc(toupper((unsigned char)*q), f);
+      p += 7;
+    } else {
+      fputc(*p++, f);
+    }
+  }
+}
+
+static
+void upper(const char *s, char *out) {
+  while((*out++ = toupper((unsigned char)*s++)));
+}
+
+/* the declarations of the converters of s */
+static
+void declare(struct spec *s, FILE *f) {
+#define printf(...) fprintf(f, __VA_ARGS__)
+  struct fpc_parameters *p = s->format;
+  const char *n = s->name;
+  char N[MAX_NAME];
+  upper(n, N);
+
+  printf("// %s\n"
+         "typedef %s%d_t %s_t;\n\n", s->text, p->use_signed ? "int" : "uint", p->fixed_encoding_width, n);
+  printf("double %s_to_double(%s_t x);\n"
+         "bool %s_from_double(double x, %s_t *y);\n"
+         "size_t %s_to_double_n(const %s_t *x, double *y, size_t n);\n"
+         "size_t %s_from_double_n(const double *x, %s_t *y, size_t n, uint8_t *err);\n",
+         n, n, n, n, n, n, n, n);
+  if(gen_table_use(p, &s->opt, TABLE_TO_STRING)) {
+    printf("const char *%s_to_string(%s_t x);\n", n, n);
+  }
+  if(gen_string_eligible(p, &s->opt)) {
+    printf("\n"
+           "#define %s_STRING_SIZE %d\n"
+           "int %s_fixed_to_string(char *buf, size_t size, %s_t x);\n"
+           "int %s_string_to_fixed(const char *buf, size_t size, %s_t *x);\n",
+           N, gen_string_size(p), n, n, n, n);
+  }
+  if(s->opt.packed) {
+    printf("\n"
+           "#define %s_PACKED_BITS %u\n"
+           "size_t %s_packed_size(size_t n);\n"
+           "%s_t %s_unpack(const uint8_t *buf, size_t i);\n"
+           "bool %s_pack(uint8_t *buf, size_t i, %s_t x);\n"
+           "size_t %s_pack_n(const %s_t *x, uint8_t *buf, size_t n);\n"
+           "void %s_unpack_n(const uint8_t *buf, %s_t *x, size_t n);\n",
+           N, gen_pack_bits(p), n, n, n, n, n, n, n, n, n);
+  }
+  if(s->opt.instrument) {
+    printf("\n"
+           "void %s_stats_reset(void);\n"
+           "void %s_stats_dump(FILE *f);\n", n, n);
+  }
+#undef printf
+}
+
+/* the first line of generated files */
+static
+void stamp(uint64_t hash, char *buf, size_t size) {
+  snprintf(buf, size, "// generated by fpc --manifest, hash %016" PRIx64 "\n", hash);
+}
+
+/* name.h (or name.c if !header) for specs[0..n) in a malloc'd string */
+static
+char *generate(struct spec **specs, int n, const char *name, uint64_t hash, bool header) {
+  char *out = NULL, *code = NULL;
+  size_t size;
+  FILE *f = open_memstream(&out, &size);
+  char N[MAX_NAME], line[64];
+  bool wide = false, strings = false;
+  int i;
+  upper(name, N);
+  for(i = 0; i < n; i++) {
+    if(specs[i]->format->fixed_encoding_width < 128) continue;
+    wide = true;
+    strings |= gen_string_eligible(specs[i]->format, &specs[i]->opt);
+  }
+  stamp(hash, line, sizeof(line));
+  fputs(line, f);
+  if(header) {
+    fprintf(f, "\n"
+               "#ifndef FPC_%s_H\n"
+               "#define FPC_%s_H\n\n"
+               "#include <stdbool.h>\n"
+               "#include <stddef.h>\n"
+               "#include <stdint.h>\n"
+               "#include <stdio.h>\n", N, N);
+    if(wide) {
+      fprintf(f, "\n");
+      gen_int128_types(f);
+    }
+    for(i = 0; i < n; i++) {
+      if(i || !wide) fprintf(f, "\n");
+      declare(specs[i], f);
+    }
+    fprintf(f, "\n#endif\n");
+  } else {
+    fprintf(f, "\n"
+               "#include <errno.h>\n"
+               "#include <math.h>\n"
+               "#include <stdint.h>\n"
+               "#include <stdbool.h>\n"
+               "#include <stdio.h>\n"
+               "#include <stdlib.h>\n"
+               "#include <string.h>\n\n"
+               "%s"
+               "#include \"%s.h\"\n", strings ? "#include \"fixnum_string.h\"\n" : "", name);
+    for(i = 0; i < n; i++) {
+      FILE *g = open_memstream(&code, &size);
+      gen_library(specs[i]->format, &specs[i]->opt, g);
+      fclose(g);
+      fprintf(f, "\n// %s\n", specs[i]->text);
+      rename_prefix(code, specs[i]->name, f);
+      free(code);
+    }
+  }
+  fclose(f);
+  return out;
+}
+
+/* whether the file at path starts with the line of hash */
+static
+bool current(const char *path, uint64_t hash) {
+  FILE *in = fopen(path, "r");
+  char line[64], want[64];
+  bool ok;
+  if(!in) return false;
+  stamp(hash, want, sizeof(want));
+  ok = fgets(line, sizeof(line), in) && strcmp(line, want) == 0;
+  fclose(in);
+  return ok;
+}
+
+/* write text to path unless it already holds it, false on an error */
+static
+bool update(const char *path, const char *text) {
+  FILE *f = fopen(path, "r");
+  size_t n = strlen(text);
+  if(f) {
+    char *old = malloc(n + 1);
+    size_t got = fread(old, 1, n + 1, f);
+    bool same = got == n && memcmp(old, text, n) == 0;
+    free(old);
+    fclose(f);
+    if(same) return true;
+  }
+  f = fopen(path, "w");
+  if(!f || fwrite(text, 1, n, f) != n) {
+    fprintf(stderr, "ERROR: %s: cannot write\n", path);
+    if(f) fclose(f);
+    return false;
+  }
+  return fclose(f) == 0;
+}
+
+/* name.h and name.c in dir for specs[0..n), unless they're current */
+static
+int output(struct spec **specs, int n, const char *dir, const char *name, uint64_t hash,
+           bool force, FILE *dep) {
+  char h[4096], c[4096];
+  bool ok = true;
+  int header;
+  snprintf(h, sizeof(h), "%s%s%s.h", dir ? dir : "", dir ? "/" : "", name);
+  snprintf(c, sizeof(c), "%s%s%s.c", dir ? dir : "", dir ? "/" : "", name);
+  if(dep) fprintf(dep, " %s %s", h, c);
+  if(!force && current(h, hash) && current(c, hash)) return 0;
+  for(header = 1; ok && header >= 0; header--) {
+    char *text = generate(specs, n, name, hash, header);
+    ok = update(header ? h : c, text);
+    free(text);
+  }
+  return ok ? 1 : -1;
+}
+
+int manifest_main(int argc, char **argv) {
+  const char *dir = NULL, *library = NULL, *depfile = NULL;
+  bool force = false;
+  struct spec **specs;
+  char *deps = NULL;
+  size_t deps_size;
+  FILE *dep = NULL;
+  uint64_t fpc;
+  int n, i, generated = 0, r = 0;
+
+  for(; argc > 0 && strncmp(argv[0], "--", 2) == 0; argc--, argv++) {
+    if(strncmp(argv[0], "--out=", 6) == 0) {
+      dir = argv[0] + 6;
+    } else if(strncmp(argv[0], "--library=", 10) == 0) {
+      library = argv[0] + 10;
+      if(!gen_valid_name(library) || strlen(library) >= MAX_NAME) {
+        fprintf(stderr, "ERROR: %s: not a C identifier\n", library);
+        return -1;
+      }
+    } else if(strncmp(argv[0], "--depfile=", 10) == 0) {
+      depfile = argv[0] + 10;
+    } else if(strcmp(argv[0], "--force") == 0) {
+      force = true;
+    } else {
+      break;
+    }
+  }
+  if(argc != 1) {
+    fprintf(stderr, "fpc --manifest [--out=dir] [--library=name] [--depfile=file] [--force] manifest\n");
+    return -1;
+  }
+  specs = read_manifest(argv[0], &n);
+  if(!specs) return -1;
+
+  fpc = fpc_hash();
+  for(i = 0; i < n; i++) {
+    specs[i]->hash = fnv1a(fpc, specs[i]->text, strlen(specs[i]->text) + 1);
+  }
+  if(depfile) dep = open_memstream(&deps, &deps_size);
+  if(library) {
+    uint64_t hash = fpc;
+    for(i = 0; i < n; i++) hash = fnv1a(hash, &specs[i]->hash, sizeof(specs[i]->hash));
+    r = output(specs, n, dir, library, hash, force, dep);
+    if(r >= 0) printf("%s: %s, %d formats\n", library, r ? "generated" : "up to date", n);
+    generated = r > 0 ? n : 0;
+  } else {
+    for(i = 0; r >= 0 && i < n; i++) {
+      r = output(specs + i, 1, dir, specs[i]->name, specs[i]->hash, force, dep);
+      if(r >= 0) printf("%s: %s\n", specs[i]->name, r ? "generated" : "up to date");
+      generated += r > 0;
+    }
+  }
+  if(dep) {
+    fprintf(dep, ": %s\n", argv[0]);
+    fclose(dep);
+    if(r >= 0 && !update(depfile, deps + 1)) r = -1;
+    free(deps);
+  }
+  for(i = 0; i < n; i++) free(specs[i]);
+  free(specs);
+  if(r < 0) return -1;
+  printf("%d of %d formats generated\n", generated, n);
+  return 0;
+}
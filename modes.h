@@ -0,0 +1,108 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#ifndef __FPC_MODES__
+#define __FPC_MODES__
+
+#include <stdio.h>
+#include <pthread.h>
+#include "fpc.h"
+
+/* command line modes, each is passed the arguments after its flag
+   and returns the exit status */
+
+/* fpc --sweep [--json] [--pareto] [-j threads] [min] [max] [precision]
+   each argument is a value or a range start:stop:step or start:stop:*factor */
+int sweep_main(int argc, char **argv);
+
+/* fpc --batch [-j threads] [file]
+   read one [min] [max] [precision] spec per line from file or stdin
+   and write one JSON object per spec, in input order */
+int batch_main(int argc, char **argv);
+
+/* fpc --convert [-j threads] [--from=type] [--to=type] [min] [max] [precision] [in] [out]
+   convert a file (or stdin to stdout) between values and codes, type is
+   f64, f32, csv, csv:column or codes and one side must be codes */
+int bulk_main(int argc, char **argv);
+
+/* fpc --arith [name] [min] [max] [precision] ...
+   write a header of static inline arithmetic on the named formats */
+int arith_main(int argc, char **argv);
+
+/* fpc --formula [--check] [name] [expression] [precision] [variable] [min] [max] [precision] ...
+   write a header with an integer-only function evaluating the expression
+   over the named single letter inputs, or with --check a program testing it */
+int formula_main(int argc, char **argv);
+
+/* fpc --approx [--check] [--max-table=bytes] [name] [function] [min] [max] [precision] [output precision]
+   write a header with an integer-only approximation of the function on
+   the input format, or with --check a program measuring and timing it */
+int approx_main(int argc, char **argv);
+
+/* fpc --record [--check] [--layout=auto|words|stream] [--align=bytes] [name] [field] [min] [max] [precision] ...
+   write a header with a packed record of the fields, their accessors and
+   whole record encode and decode, or with --check a program testing them;
+   the fields can also come from a schema file (or -) of lines of four */
+int record_main(int argc, char **argv);
+
+/* fpc --requant [--check] [from] [min] [max] [precision] [to] [min] [max] [precision]
+   write a header converting codes of one format to another in integers,
+   one at a time and in vectorized arrays that count clamped values, or
+   with --check a program testing them */
+int requant_main(int argc, char **argv);
+
+/* fpc --codec [--check] [--block=n] [--sample=file] [name] [min] [max] [precision]
+   write a header with a block codec for streams of codes, frame of
+   reference or delta and zigzag, bit packed, or with --check a program
+   testing it; with --sample report its compression of a file of values */
+int codec_main(int argc, char **argv);
+
+/* fpc --feedback [--margin=percent] [--outliers] [dump file] ...
+   add up the counters dumped by converters generated with --instrument
+   and propose a format for the values they saw */
+int feedback_main(int argc, char **argv);
+
+/* fpc --manifest [--out=dir] [--library=name] [--depfile=file] [--force] manifest
+   writes name.h and name.c with the converters of each "name [options]
+   min max precision" line of manifest whose files are out of date */
+int manifest_main(int argc, char **argv);
+
+/* machine readable output shared by the modes */
+
+/* write x in decimal, buf must hold at least 41 characters */
+char *int128_str(int128_t x, char *buf);
+
+/* write a calculated format as a CSV row or a JSON object, like snprintf */
+int format_csv(char *buf, size_t size, const struct fpc_parameters *param);
+int format_json(char *buf, size_t size, const struct fpc_parameters *param);
+
+/* header matching format_csv() */
+extern const char csv_header[];
+
+/* lets worker threads write numbered chunks of output in sequence */
+struct ordered_output {
+  FILE *f;
+  unsigned long next;
+  pthread_mutex_t lock;
+  pthread_cond_t turn;
+};
+
+void ordered_init(struct ordered_output *out, FILE *f);
+void ordered_destroy(struct ordered_output *out);
+
+/* block until chunks 0 .. seq - 1 are written, then write this one */
+void ordered_write(struct ordered_output *out, unsigned long seq,
+                   const char *buf, size_t len);
+
+#endif
@@ -0,0 +1,165 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fpc.h"
+#include "fpc_plan.h"
+
+/* plan_test [spec ...]
+   check fpc_plan.c against a long double reference for each spec
+   "min max precision", over codes spread across the range, the values
+   half way between them, and values out of range */
+
+#define N 4099
+
+/* load and store a code of the plan's type as an int128 */
+static int128_t load(const struct fpc_plan *plan, const void *codes, size_t i) {
+  switch(plan->fixed_encoding_width * (plan->use_signed ? -1 : 1)) {
+  case 8: return ((const uint8_t *)codes)[i];
+  case -8: return ((const int8_t *)codes)[i];
+  case 16: return ((const uint16_t *)codes)[i];
+  case -16: return ((const int16_t *)codes)[i];
+  case 32: return ((const uint32_t *)codes)[i];
+  case -32: return ((const int32_t *)codes)[i];
+  case 64: return ((const uint64_t *)codes)[i];
+  default: return ((const int64_t *)codes)[i];
+  }
+}
+
+static void store(const struct fpc_plan *plan, void *codes, size_t i, int128_t c) {
+  switch(plan->fixed_encoding_width * (plan->use_signed ? -1 : 1)) {
+  case 8: ((uint8_t *)codes)[i] = c; break;
+  case -8: ((int8_t *)codes)[i] = c; break;
+  case 16: ((uint16_t *)codes)[i] = c; break;
+  case -16: ((int16_t *)codes)[i] = c; break;
+  case 32: ((uint32_t *)codes)[i] = c; break;
+  case -32: ((int32_t *)codes)[i] = c; break;
+  case 64: ((uint64_t *)codes)[i] = c; break;
+  default: ((int64_t *)codes)[i] = c; break;
+  }
+}
+
+/* the code for v: scaled, saturated, rounded ties to even */
+static int128_t reference_code(const struct fpc_plan *plan, const struct fpc_parameters *p,
+                               double v) {
+  long double c = ldexpl(v, p->fractional_bits);
+  if(!(c >= plan->lower_bound)) c = plan->lower_bound;
+  if(c > plan->upper_bound) c = plan->upper_bound;
+  return (int128_t)rintl(c) - p->offset;
+}
+
+static
+bool check(char *spec) {
+  char min[64], max[64], precision[64];
+  struct fpc_parameters p;
+  struct fpc_plan plan;
+  static uint64_t codes[N], out[N];
+  static double values[N];
+  static uint8_t err[N];
+  size_t i, n = 0, errors, expected = 0;
+  bool ok = true;
+
+  memset(&p, 0, sizeof(p));
+  if(sscanf(spec, "%63s %63s %63s", min, max, precision) != 3 ||
+     !fpc_calculate_from_strings(min, max, precision, &p)) {
+    printf("%s: ERROR: bad spec\n", spec);
+    return false;
+  }
+  if(!fpc_plan_init(&plan, &p)) {
+    printf("%s: %s\n", spec, plan.error);
+    return true;
+  }
+  printf("%s: %s%d_t%s\n", spec, p.use_signed ? "int" : "uint", p.fixed_encoding_width,
+         p.offset ? " with offset" : "");
+
+  // every code in range and the two either side of it, if there are any
+  uint64_t span = (uint64_t)(p.upper_bound - p.lower_bound), step = span / (N - 4) + 1, k;
+  for(k = 0; n < N - 3; k += step) {
+    store(&plan, codes, n++, p.lower_bound - p.offset + (k < span ? k : span));
+    if(k >= span) break;
+  }
+  int w = p.fixed_encoding_width;
+  int128_t type_min = p.use_signed ? -((int128_t)1 << (w - 1)) : 0;
+  int128_t type_max = ((int128_t)1 << (w - !!p.use_signed)) - 1;
+  if(p.lower_bound - p.offset > type_min) {
+    store(&plan, codes, n++, p.lower_bound - p.offset - 1);
+    expected++;
+  }
+  if(p.upper_bound - p.offset < type_max) {
+    store(&plan, codes, n++, p.upper_bound - p.offset + 1);
+    expected++;
+  }
+
+  errors = fpc_plan_to_double(&plan, codes, values, n);
+  for(i = 0; i < n; i++) {
+    int128_t c = load(&plan, codes, i) + p.offset;
+    bool bad = c < p.lower_bound || c > p.upper_bound;
+    double r = bad ? NAN : (double)ldexpl(c, -p.fractional_bits);
+    if(!p.large_offset && !(values[i] == r || (isnan(r) && isnan(values[i])))) {
+      printf("  fpc_plan_to_double(%lld) = %a, expected %a\n",
+             (long long int)load(&plan, codes, i), values[i], r);
+      ok = false;
+      break;
+    }
+  }
+  if(errors != expected) {
+    printf("  fpc_plan_to_double() counted %zu errors, expected %zu\n", errors, expected);
+    ok = false;
+  }
+
+  /* the values back, the values half way to the next code (ties), and
+     values out of range */
+  for(i = 0; i + 1 < n; i++) {
+    if(isnan(values[i + 1])) values[i] = NAN;
+    else if(i % 2) values[i] += ldexp(0.5, -p.fractional_bits);
+  }
+  values[n - 1] = -INFINITY;
+  if(n > 2) values[n - 2] = INFINITY;
+  errors = fpc_plan_from_double(&plan, values, out, n, err);
+  expected = 0;
+  for(i = 0; i < n; i++) {
+    bool bad = !(values[i] >= (double)p.min && values[i] <= (double)p.max);
+    int128_t r = reference_code(&plan, &p, values[i]);
+    expected += bad;
+    if(p.large_offset) continue;
+    if(load(&plan, out, i) != r || err[i] != bad) {
+      printf("  fpc_plan_from_double(%a) = %lld (%d), expected %lld (%d)\n", values[i],
+             (long long int)load(&plan, out, i), err[i], (long long int)r, bad);
+      ok = false;
+      break;
+    }
+  }
+  if(errors != expected) {
+    printf("  fpc_plan_from_double() counted %zu errors, expected %zu\n", errors, expected);
+    ok = false;
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int i, failures = 0;
+  for(i = 1; i < argc; i++) {
+    if(!check(argv[i])) failures++;
+  }
+  if(failures) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,104 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fpc.h"
+
+/* program_test
+   fpc_run_program_n() against fpc_eval_expr() row by row, over columns
+   a, b and c of lengths that aren't multiples of its blocks, with d
+   unlisted so it reads as NAN.  fpc_run_program_n() computes in double
+   and fpc_eval_expr() in long double, so results can differ in the last
+   bits: they must be within 2^-40 of each other, relative to the larger
+   of 1 and the result, or both NaN. */
+
+static const char *exprs[] = {
+  "a+b*c",
+  "2^(a/4)-c",
+  "(a-b)/(c+3)",
+  "-(a*a)+b^3",
+  "3*4+a",
+  "a*d+1",
+  "7/2",
+};
+#define N_EXPRS (sizeof(exprs) / sizeof(exprs[0]))
+
+static const size_t lengths[] = { 1, 63, 65, 1000 };
+#define MAX_LENGTH 1000
+
+static unsigned long long int state = 1;
+
+/* uniform in [lo, hi) */
+static
+double uniform(double lo, double hi) {
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return lo + (hi - lo) * (double)(state >> 11) / (1ULL << 53);
+}
+
+int main(void) {
+  static double a[MAX_LENGTH], b[MAX_LENGTH], c[MAX_LENGTH];
+  const double *columns[] = { a, b, c };
+  unsigned int e, l;
+  size_t i;
+  int failures = 0;
+
+  for(i = 0; i < MAX_LENGTH; i++) {
+    a[i] = uniform(-10, 10);
+    b[i] = uniform(0.5, 4);
+    c[i] = uniform(-2, 2);
+  }
+  for(e = 0; e < N_EXPRS; e++) {
+    struct fpc_program prog;
+    char str[64];
+    unsigned long rows = 0, inexact = 0, bad = 0;
+    snprintf(str, sizeof(str), "%s", exprs[e]);
+    if(!fpc_compile_expr(str, &prog)) {
+      printf("%s: doesn't compile\n", exprs[e]);
+      failures++;
+      continue;
+    }
+    for(l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+      size_t n = lengths[l];
+      // exactly n, with a guard after it
+      double *out = malloc((n + 1) * sizeof(*out));
+      out[n] = 42;
+      fpc_run_program_n(&prog, "abc", columns, out, n);
+      bad += out[n] != 42;
+      for(i = 0; i < n; i++) {
+        fpc_set_var('a', a[i]);
+        fpc_set_var('b', b[i]);
+        fpc_set_var('c', c[i]);
+        snprintf(str, sizeof(str), "%s", exprs[e]);
+        long double want = fpc_eval_expr(str);
+        if(isnan(want) || isnan(out[i])) {
+          bad += isnan(want) != isnan(out[i]);
+        } else {
+          long double err = fabsl(out[i] - want), scale = fabsl(want) > 1 ? fabsl(want) : 1;
+          bad += err > scale * 0x1p-40L;
+          inexact += out[i] != (double)want;
+        }
+        rows++;
+      }
+      free(out);
+    }
+    printf("%s: %lu rows, %lu differ in the last bits, %lu bad\n", exprs[e], rows, inexact, bad);
+    failures += bad != 0;
+  }
+  printf("%s\n", failures ? "FAIL" : "ok");
+  return failures != 0;
+}
@@ -0,0 +1,91 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <math.h>
+
+#include "modes.h"
+
+char *int128_str(int128_t x, char *buf) {
+  char tmp[40];
+  unsigned __int128 n = x < 0 ? -(unsigned __int128)x : (unsigned __int128)x;
+  int i = 0;
+  do {
+    tmp[i++] = '0' + n % 10;
+    n /= 10;
+  } while(n);
+  char *p = buf;
+  if(x < 0) *p++ = '-';
+  while(i) *p++ = tmp[--i];
+  *p = 0;
+  return buf;
+}
+
+const char csv_header[] =
+  "min,max,precision,width,bits,fractional_bits,integer_bits,density,signed,offset\n";
+
+int format_csv(char *buf, size_t size, const struct fpc_parameters *param) {
+  char offset[41];
+  return snprintf(buf, size, "%.19Lg,%.19Lg,%.19Lg,%d,%d,%d,%d,%.6Lg,%d,%s\n",
+                  param->min, param->max, param->precision,
+                  param->fixed_encoding_width,
+                  param->integer_bits + param->fractional_bits,
+                  param->fractional_bits,
+                  param->integer_bits,
+                  ldexpl(1.0L, -param->fractional_bits) / param->precision,
+                  param->use_signed,
+                  int128_str(param->offset, offset));
+}
+
+int format_json(char *buf, size_t size, const struct fpc_parameters *param) {
+  char offset[41], lb[41], ub[41];
+  return snprintf(buf, size,
+                  "{\"min\":%.19Lg,\"max\":%.19Lg,\"precision\":%.19Lg,"
+                  "\"width\":%d,\"bits\":%d,\"fractional_bits\":%d,\"integer_bits\":%d,"
+                  "\"density\":%.6Lg,\"signed\":%s,\"offset\":%s,"
+                  "\"code_range\":[%s,%s]}\n",
+                  param->min, param->max, param->precision,
+                  param->fixed_encoding_width,
+                  param->integer_bits + param->fractional_bits,
+                  param->fractional_bits,
+                  param->integer_bits,
+                  ldexpl(1.0L, -param->fractional_bits) / param->precision,
+                  param->use_signed ? "true" : "false",
+                  int128_str(param->offset, offset),
+                  int128_str(param->lower_bound - param->offset, lb),
+                  int128_str(param->upper_bound - param->offset, ub));
+}
+
+void ordered_init(struct ordered_output *out, FILE *f) {
+  out->f = f;
+  out->next = 0;
+  pthread_mutex_init(&out->lock, NULL);
+  pthread_cond_init(&out->turn, NULL);
+}
+
+void ordered_destroy(struct ordered_output *out) {
+  pthread_mutex_destroy(&out->lock);
+  pthread_cond_destroy(&out->turn);
+}
+
+void ordered_write(struct ordered_output *out, unsigned long seq,
+                   const char *buf, size_t len) {
+  pthread_mutex_lock(&out->lock);
+  while(out->next != seq) {
+    pthread_cond_wait(&out->turn, &out->lock);
+  }
+  fwrite(buf, 1, len, out->f);
+  out->next++;
+  pthread_cond_broadcast(&out->turn);
+  pthread_mutex_unlock(&out->lock);
+}
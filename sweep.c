@@ -0,0 +1,299 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "modes.h"
+
+/* Sweep fpc_calculate() over a grid of (min, max, precision).
+   The grid is cut into chunks which the workers claim in order, each
+   worker formats its chunk into a private buffer and then waits for
+   its turn to write, so output is streamed in grid order. */
+
+#define LENGTH(x) (sizeof(x)/sizeof(x[0]))
+
+#define CHUNK 1024
+#define ROW_SIZE 320
+
+struct axis {
+  long double start, stop, step;
+  bool geometric;
+  unsigned long count;
+  long double *values;
+};
+
+/* the frontier entry for one used bit count */
+struct best {
+  bool valid;
+  int fractional_bits;
+  long double range;
+  unsigned long index;
+};
+
+struct sweep {
+  struct axis axes[3];
+  unsigned long total, chunks;
+  unsigned long next_chunk;
+  unsigned long errors, long_rows;
+  bool json, pareto;
+  struct ordered_output out;
+};
+
+struct worker {
+  pthread_t thread;
+  struct sweep *sweep;
+  struct best best[129];
+  unsigned long errors, long_rows;
+};
+
+static
+bool parse_axis(char *arg, struct axis *a) {
+  char *part[3] = { arg, NULL, NULL };
+  int n = 1;
+  char *p = arg;
+  while((p = strchr(p, ':')) && n < 3) {
+    *p++ = 0;
+    part[n++] = p;
+  }
+  if(n == 2) return false;
+  a->start = fpc_eval_expr(part[0]);
+  if(isnan(a->start)) return false;
+  if(n == 1) {
+    a->stop = a->start;
+    a->step = 1;
+    a->geometric = false;
+    a->count = 1;
+    return true;
+  }
+  a->stop = fpc_eval_expr(part[1]);
+  a->geometric = *part[2] == '*';
+  a->step = fpc_eval_expr(part[2] + a->geometric);
+  if(isnan(a->stop) || isnan(a->step)) return false;
+  long double steps;
+  if(a->geometric) {
+    if(a->step <= 0 || a->step == 1 || a->start == 0) return false;
+    steps = logl(a->stop / a->start) / logl(a->step);
+  } else {
+    if(a->step == 0) return false;
+    steps = (a->stop - a->start) / a->step;
+  }
+  if(!(steps >= 0)) return false;
+  a->count = (unsigned long)floorl(steps * (1 + 1e-12L) + 1e-12L) + 1;
+  return true;
+}
+
+/* Steps like 0.1 or *10 are not exact in binary so the grid drifts a
+   few ulps off the decimal values the user meant, which matters when
+   that lands on the wrong side of a power of two.  Snap values that
+   are within a few ulps of a 17 digit decimal back onto it. */
+static
+long double snap(long double x) {
+  char buf[32];
+  if(x == 0 || !isfinite(x)) return x;
+  snprintf(buf, sizeof(buf), "%.17Lg", x);
+  long double y = strtold(buf, NULL);
+  return fabsl(y - x) <= ldexpl(8.0L, ilogbl(x) - 63) ? y : x;
+}
+
+static
+bool fill_axis(struct axis *a) {
+  unsigned long i;
+  a->values = malloc(a->count * sizeof(*a->values));
+  if(!a->values) return false;
+  a->values[0] = a->start;
+  for(i = 1; i < a->count; i++) {
+    a->values[i] = snap(a->geometric ?
+                        a->start * powl(a->step, i) :
+                        a->start + i * a->step);
+  }
+  return true;
+}
+
+static
+void grid_point(const struct sweep *s, unsigned long index, struct fpc_parameters *param) {
+  memset(param, 0, sizeof(*param));
+  param->precision = s->axes[2].values[index % s->axes[2].count];
+  index /= s->axes[2].count;
+  param->max = s->axes[1].values[index % s->axes[1].count];
+  index /= s->axes[1].count;
+  param->min = s->axes[0].values[index];
+}
+
+static
+void update_best(struct best *best, const struct fpc_parameters *param, unsigned long index) {
+  struct best *b = &best[param->integer_bits + param->fractional_bits];
+  long double range = param->max - param->min;
+  if(!b->valid ||
+     param->fractional_bits > b->fractional_bits ||
+     (param->fractional_bits == b->fractional_bits && range > b->range)) {
+    b->valid = true;
+    b->fractional_bits = param->fractional_bits;
+    b->range = range;
+    b->index = index;
+  }
+}
+
+static
+void *work(void *arg) {
+  struct worker *w = arg;
+  struct sweep *s = w->sweep;
+  char *buf = s->pareto ? NULL : malloc(CHUNK * ROW_SIZE);
+  struct fpc_parameters param;
+  unsigned long chunk, i;
+
+  // leave the chunks to the other workers
+  if(!s->pareto && !buf) return NULL;
+  while((chunk = __atomic_fetch_add(&s->next_chunk, 1, __ATOMIC_RELAXED)) < s->chunks) {
+    unsigned long end = (chunk + 1) * CHUNK;
+    size_t len = 0;
+    if(end > s->total) end = s->total;
+    for(i = chunk * CHUNK; i < end; i++) {
+      grid_point(s, i, &param);
+      if(!fpc_calculate(&param)) {
+        w->errors++;
+        continue;
+      }
+      update_best(w->best, &param, i);
+      if(buf) {
+        int n = (s->json ? format_json : format_csv)(buf + len, ROW_SIZE, &param);
+        // a row snprintf() truncated would end the chunk early, drop it
+        if(n < 0 || n >= ROW_SIZE) {
+          w->long_rows++;
+          continue;
+        }
+        len += n;
+      }
+    }
+    if(buf) ordered_write(&s->out, chunk, buf, len);
+  }
+  free(buf);
+  return NULL;
+}
+
+static
+void print_pareto(struct sweep *s, struct worker *workers, int n_workers) {
+  struct fpc_parameters param;
+  char row[ROW_SIZE];
+  int bits, i, finest = INT_MIN;
+  for(bits = 0; bits < (int)LENGTH(workers->best); bits++) {
+    struct best b = { .valid = false };
+    for(i = 0; i < n_workers; i++) {
+      struct best *c = &workers[i].best[bits];
+      if(!c->valid) continue;
+      if(!b.valid ||
+         c->fractional_bits > b.fractional_bits ||
+         (c->fractional_bits == b.fractional_bits &&
+          (c->range > b.range || (c->range == b.range && c->index < b.index)))) {
+        b = *c;
+      }
+    }
+    // only keep entries more precise than every narrower one
+    if(!b.valid || b.fractional_bits <= finest) continue;
+    finest = b.fractional_bits;
+    grid_point(s, b.index, &param);
+    fpc_calculate(&param);
+    (s->json ? format_json : format_csv)(row, sizeof(row), &param);
+    fputs(row, stdout);
+  }
+}
+
+static
+void usage(void) {
+  fprintf(stderr,
+          "fpc --sweep [--json] [--pareto] [-j threads] [min] [max] [precision]\n"
+          "  each of min, max and precision is a value or a range:\n"
+          "    start:stop:step     start, start + step, ... stop\n"
+          "    start:stop:*factor  start, start * factor, ... stop\n");
+}
+
+int sweep_main(int argc, char **argv) {
+  struct sweep s;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int i;
+
+  memset(&s, 0, sizeof(s));
+  for(; argc > 3; argc--, argv++) {
+    if(strcmp(argv[0], "--json") == 0) {
+      s.json = true;
+    } else if(strcmp(argv[0], "--pareto") == 0) {
+      s.pareto = true;
+    } else if(strcmp(argv[0], "-j") == 0 && argc > 4) {
+      threads = atol(argv[1]);
+      argc--, argv++;
+    } else break;
+  }
+  if(argc != 3) {
+    usage();
+    return -1;
+  }
+  s.total = 1;
+  for(i = 0; i < 3; i++) {
+    if(!parse_axis(argv[i], &s.axes[i])) {
+      fprintf(stderr, "ERROR: bad range: %s\n", argv[i]);
+      return -1;
+    }
+    if(!fill_axis(&s.axes[i])) {
+      fprintf(stderr, "ERROR: out of memory\n");
+      return -1;
+    }
+    s.total *= s.axes[i].count;
+  }
+  s.chunks = (s.total + CHUNK - 1) / CHUNK;
+  if(threads < 1) threads = 1;
+  if((unsigned long)threads > s.chunks) threads = s.chunks ? s.chunks : 1;
+
+  struct worker *workers = calloc(threads, sizeof(*workers));
+  if(!workers) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    for(i = 0; i < 3; i++) free(s.axes[i].values);
+    return -1;
+  }
+  ordered_init(&s.out, stdout);
+  if(!s.json) fputs(csv_header, stdout);
+  // chunks are claimed as workers go, so fewer threads still cover them
+  for(i = 0; i < threads; i++) {
+    workers[i].sweep = &s;
+    if(pthread_create(&workers[i].thread, NULL, work, &workers[i]) != 0) break;
+  }
+  if(i == 0) {
+    work(&workers[0]);
+    threads = 1;
+  } else {
+    threads = i;
+    for(i = 0; i < threads; i++) pthread_join(workers[i].thread, NULL);
+  }
+  for(i = 0; i < threads; i++) {
+    s.errors += workers[i].errors;
+    s.long_rows += workers[i].long_rows;
+  }
+  if(s.pareto) print_pareto(&s, workers, threads);
+  fflush(stdout);
+  if(s.errors) {
+    fprintf(stderr, "%lu of %lu points skipped: no valid encoding\n", s.errors, s.total);
+  }
+  if(s.long_rows) {
+    fprintf(stderr, "ERROR: %lu rows longer than %d characters skipped\n", s.long_rows, ROW_SIZE - 1);
+  }
+  // every worker's buffer failed, so some chunks were never claimed
+  bool unclaimed = s.next_chunk < s.chunks;
+  if(unclaimed) fprintf(stderr, "ERROR: out of memory\n");
+  free(workers);
+  for(i = 0; i < 3; i++) free(s.axes[i].values);
+  ordered_destroy(&s.out);
+  return s.long_rows || unclaimed ? -1 : 0;
+}
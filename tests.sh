@@ -20,6 +20,141 @@ fpc() {
     ./fpc $@
 }
 
+verify() {
+    echo
+    echo ___[ verify $@ ]___
+    ./fpc -g $@ > /dev/null && rm -f convert.o && make -s convert && ./convert -v 1
+}
+
+# the libm-free converters against the libm ones
+rounding() {
+    echo
+    echo ___[ rounding $@ ]___
+    ./fpc -g $@ > /dev/null && rm -f convert.o && make -s convert && ./convert -t
+}
+
+# values of type $1 from stdin to codes, then back from a file
+bulk() {
+    echo
+    echo ___[ bulk $@ ]___
+    local codes=$(mktemp)
+    ./fpc --convert --from=$1 "${@:2}" - $codes
+    # raw arrays back as text
+    ./fpc --convert --from=codes --to=$1 "${@:2}" $codes |
+        case $1 in f64) od -A n -t f8 -v;; f32) od -A n -t f4 -v;; *) cat;; esac
+    rm -f $codes
+}
+
+arith() {
+    echo
+    echo ___[ arith $@ ]___
+    ./fpc --arith --check $@ > arith_check.c && rm -f arith_check && make -s arith_check && ./arith_check
+}
+
+formula() {
+    echo
+    echo ___[ formula $@ ]___
+    ./fpc --formula --check "$@" > formula_check.c && rm -f formula_check && make -s formula_check && ./formula_check
+}
+
+approx() {
+    echo
+    echo ___[ approx $@ ]___
+    ./fpc --approx --check $@ > approx_check.c && rm -f approx_check && make -s approx_check && ./approx_check
+}
+
+record() {
+    echo
+    echo ___[ record $@ ]___
+    ./fpc --record --check "$@" > record_check.c && rm -f record_check && make -s record_check && ./record_check
+}
+
+requant() {
+    echo
+    echo ___[ requant $@ ]___
+    ./fpc --requant --check $@ > requant_check.c && rm -f requant_check && make -s requant_check && ./requant_check
+}
+
+# converters counting their use, fed back to fpc
+instrument() {
+    echo
+    echo ___[ instrument $@ ]___
+    ./fpc -g --instrument $@ > /dev/null && rm -f convert.o && make -s convert && ./convert -I | ./fpc --feedback -
+}
+
+codec() {
+    echo
+    echo ___[ codec $@ ]___
+    ./fpc --codec --check $@ > codec_check.c && rm -f codec_check && make -s codec_check && ./codec_check
+}
+
+# the manifest $1 generated, regenerated after its first spec changes,
+# and the converters of every format linked together
+manifest() {
+    echo
+    echo ___[ manifest "$@" ]___
+    local fpc=$PWD/fpc dir=$(mktemp -d)
+    mkdir $dir/lib && cp fixnum_string.c fixnum_string.h $dir/lib # for 128 bit strings
+    (cd $dir && printf "$1" > specs.txt &&
+     $fpc --manifest --depfile=specs.d "${@:2}" specs.txt && cat specs.d &&
+     sed -i '0,/^[a-z]/s/ [^ ]*$/ 0.5/' specs.txt && $fpc --manifest "${@:2}" specs.txt &&
+     local names=$(awk '/^[a-z]/ { print $1 }' specs.txt) &&
+     (echo '#include <math.h>'; for h in *.h; do echo "#include \"$h\""; done
+      echo 'int main(void) {'
+      echo '  int n = 0, bad = 0;'
+      for n in $names; do
+          echo "  { ${n}_t y; double x = ${n}_to_double(0); n++;"
+          echo "    bad += !isnan(x) && !(${n}_from_double(x, &y) && y == 0); }"
+      done
+      echo '  printf("%d formats, %d bad\n", n, bad);'
+      echo '  return bad;'
+      echo '}') > main.c &&
+     cc -Wall -O2 -I. -Ilib *.c lib/fixnum_string.c -lm -o main && ./main && grep -v '^// generated' $(ls *.h | head -1))
+    rm -rf $dir
+}
+
+strings() {
+    echo
+    echo ___[ strings $@ ]___
+    ./fpc -g $@ > /dev/null && rm -f convert.o && make -s convert && ./convert -s
+}
+
+packed() {
+    echo
+    echo ___[ packed $@ ]___
+    ./fpc -g --packed $@ > /dev/null && rm -f convert.o && make -s convert && ./convert -P
+}
+
+fpc_hpp_test() {
+    echo
+    echo ___[ fpc_hpp_test ]___
+    ./fpc_hpp_test
+}
+
+plan_test() {
+    echo
+    echo ___[ plan_test ]___
+    ./plan_test "$@"
+}
+
+program_test() {
+    echo
+    echo ___[ program_test ]___
+    ./program_test
+}
+
+context_test() {
+    echo
+    echo ___[ context_test $@ ]___
+    ./context_test $@
+}
+
+fixnum_string() {
+    echo
+    echo ___[ fixnum_string $@ ]___
+    ./fixnum_string $@
+}
+
 fpc -256 -l-p 0.01
 fpc -512 -l-p 1
 fpc 2^70 l+256 1
@@ -33,8 +168,169 @@ fpc -2^7
 fpc -h-p 2^8-p 0.01
 fpc -2^63 -l-p 1
 fpc -2^63 -l 1
+fpc -2^100 2^100 2^-20
+fpc 0 2^130 1
+fpc 2^126 l+2^63 1
+fpc 2^126 l+2^70 1
 fpc 2^-7
 fpc '-(1)'
 fpc '-2^-(2)'
+fpc --rounding=nearest 30 1800 0.1
+fpc --rounding=even -1 1 0.003
+fpc --rounding=floor 2^70 l+256 1
+fpc --rounding=even -2^100 2^100 1
+fpc --tables=auto -1 1 0.003
+fpc --tables=on --rounding=even -100 100 1
+fpc --tables=on -2^40 2^40 1
+fpc --tables=bogus 30 1800 0.1
+fpc --strings=bogus 30 1800 0.1
+fpc --packed -1 1 0.003
+fpc --instrument -1 1 0.003
+fpc --scale=auto 0 25.5 0.1
+fpc --scale=decimal -40 125 0.01
+fpc --packed --scale=exact -1 1 0.003
+fpc --scale=exact 0 1 0.1234567890123456789
+fpc --scale=decimal 2^70 l+256 1
+fpc --scale=decimal --rounding=even 0 1 0.1
+fpc --sweep -256 255 0.001:1:*10
+fpc --sweep --json -1:1:0.5 1 2^-8
+fpc --sweep --pareto 0 1000:2000:100 0.001:1:*2
+printf '30 1800 0.1\n# comment\n\n-h-p 2^8-p 0.01\n1 2 3\n1 2\n' | fpc --batch
+fpc --arith angle -180 180 0.01
+fpc --arith big -2^40 2^40 2^-20 price 1000 1001 0.001
+fpc --arith a 0 1 0.01 a 0 2 0.01
+fpc --arith off 1000 1001 0.001
+fpc --arith ledger -2^100 2^100 2^-20 cents 0 1000 0.01
+fpc --formula f '(a*b+c)/d' 0.001 a -1 1 2^-10 b 0 100 0.1 c -5 5 0.01 d 1 10 0.01
+fpc --formula g 'x^2-3*x+0.1' 0.0001 x -2 2 0.001
+fpc --formula h 'a/b' 0.01 a -1 1 0.01 b -1 1 0.01
+fpc --formula h 'a^b' 0.01 a -1 1 0.01 b 1 2 1
+fpc --formula h 'a+b' 0.01 a -1 1 0.01
+fpc --formula x 'a' 0.01 a 1 2 0.01 a 1 3 0.01
+fpc --approx e exp2 0 1 2^-8 2^-8
+fpc --approx w sqrt 1000 1100 0.01 0.0001
+fpc --approx q recip 2^40 2^40+1000 1 2^-60
+fpc --approx l log -1 1 0.01 0.01
+fpc --approx l log2 1 2^16 1 2^-8
+fpc --approx l lgamma 1 2 0.01 0.01
+fpc --record tel temp -40 125 0.01 hum 0 100 0.1 flags 0 255 1
+fpc --record --layout=stream --align=4 tel temp -40 125 0.01 hum 0 100 0.1 flags 0 255 1
+fpc --record tel a 0 1 1 a 0 2 1
+fpc --record --align=3 tel a 0 1 1
+printf 'temp -40 125 0.01\n# comment\n\nbad 1 0 1\n' | fpc --record tel -
+fpc --requant sensor -256 255 2^-7 storage 0 4095 2^-4
+fpc --requant a 2^70 l+256 1 b 2^70 l+1000 0.25
+fpc --requant a 0 1 1 a 0 2 1
+fpc --requant a -2^100 2^100 1 b 0 1 1
+fpc --codec --block=12 t 0 1 1
+fpc --codec b -2^62 2^62 1
+(awk 'BEGIN { for(i = 0; i < 1000; i++) printf "%.2f\n", 20 + 5 * sin(i / 50) }'; printf 'x\n# comment\n200\n') | \
+    fpc --codec --sample=- t -40 125 0.01
+printf 'log\nfpc-stats 0 1000 1 pow2\nfrom_double 10 1 0 0\nto_double 5 0\nvalues 20.5 80.25 -50 1500\nhistogram 4 0 5 10 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\nend\nlog\nfpc-stats 0 1000 1 pow2\nfrom_double 10 0 2 0\nto_double 0 0\nvalues 3 40 1200 1300\nhistogram 4 10 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\nend\n' > stats.txt
+fpc --feedback stats.txt
+fpc --feedback --margin=10 --outliers stats.txt
+printf 'fpc-stats 0 1000 0.5 pow2\nend\n' | cat stats.txt - | fpc --feedback -
+printf 'fpc-stats 0 1000 1 pow2\nvalues 1 2\nend\n' | fpc --feedback -
+printf 'fpc-stats 0 1000 1 pow2\nhistogram 4 0 1\nend\n' | fpc --feedback -
+fpc --feedback /dev/null
+rm -f stats.txt
+printf 'a 0 1 1\na 0 2 1\n' | fpc --manifest -
+printf 'a --bogus 0 1 1\n' | fpc --manifest -
+printf 'a 1 0 1\n' | fpc --manifest -
+printf '# comment\n' | fpc --manifest -
+verify 30 1800 0.1
+verify -1 1 0.003
+verify 2^70 l+256 1
+verify --tables=on -3 -1 0.01
+verify --tables=on -2 2 0.001
+verify --scale=decimal 0 25.5 0.1
+verify --scale=exact -1 1 0.003
+verify --scale=decimal 0 2^40 300
+verify -2^100 2^100 1
+verify 0 2^120 2^-3
+verify -2^63 -l-p 1
+verify 0 2^64-2 1
+verify --rounding=floor -5 5 0.001
+verify --rounding=trunc 2^70 l+256 1
+rounding --rounding=nearest 30 1800 0.1
+rounding --rounding=even -1 1 0.003
+rounding --rounding=lrint -5 5 0.001
+rounding --rounding=trunc -5 5 0.001
+rounding --rounding=floor -1 1 0.003
+rounding --rounding=floor 2^70 l+256 1
+printf '30\n1800\n21.55\nx\n# comment\n\n1799.96\n 100.05\r\n' | bulk csv 30 1800 0.1
+printf 'a,1.5\nb,-2.25,x\nc\nd,?\n' | bulk csv:2 -180 180 0.01
+printf '0.5\n-0.25\n2' | bulk csv -1 1 2^-20
+printf '1180591620717411303424\n1.1805916207174113e21\n0\n' | bulk csv -j 3 2^70 l+256 1
+# 30, 21.55, 1800, 2000 and 100.05 as little endian doubles, then 0.5, -0.25 and 2 as floats
+printf '\0\0\0\0\0\0\x3e\x40\xcd\xcc\xcc\xcc\xcc\x8c\x35\x40\0\0\0\0\0\x20\x9c\x40\0\0\0\0\0\x40\x9f\x40\x33\x33\x33\x33\x33\x03\x59\x40' |
+    bulk f64 30 1800 0.1
+printf '\0\0\0\x3f\0\0\x80\xbe\0\0\0\x40' | bulk f32 -j 2 -1 1 2^-20
+arith s -1 1 2^-15 k 0 100000 16
+arith angle -180 180 0.01 big -2^40 2^40 2^-20 price 1000 1001 0.001 w -2^70 2^70 1
+formula f '(a*b + c)/d' 0.001 a -1 1 2^-10 b 0 100 0.1 c -5 5 0.01 d 1 10 0.01
+formula g 'x^2 - 3*x + 0.1' 0.0001 x -2 2 0.001
+formula h '-a/b' 1 a 2^40 2^40+1000 1 b -3 -1 0.5
+formula k 'a*b*c*d' 2^-30 a -1 1 2^-30 b -1 1 2^-30 c -1 1 2^-30 d -1 1 2^-30
+formula q '(x+y)^3/(1+x^2)' 0.001 x -1 1 0.001 y 0 10 0.01
+formula w 'a*b - c/d' 2^-10 a -2^60 2^60 2^-10 b -2^40 2^40 1 c -2^90 2^90 1 d 1 2^10 1
+approx s sin -3.2 3.2 0.001 0.001
+approx e exp -4 4 2^-12 2^-12
+approx t tanh -4 4 0.001 0.01
+approx c cos -1 1 2^-20 2^-24
+approx n rsqrt 1 4 2^-16 2^-16
+record tel temp -40 125 0.01 hum 0 100 0.1 press 300 1100 0.01 volt 0 5 0.001 \
+       lat -90 90 1e-6 lon -180 180 1e-6 alt -500 9000 0.1 flags 0 255 1
+record --layout=words tel temp -40 125 0.01 hum 0 100 0.1 press 300 1100 0.01 volt 0 5 0.001 \
+       lat -90 90 1e-6 lon -180 180 1e-6 alt -500 9000 0.1 flags 0 255 1
+printf 'b -2^62 2^62 1\nbit 0 1 1\nq 2^70 l+256 1\n' | record --align=8 s -
+record s b -2^63 2^63-1 1
+requant sensor -256 255 2^-7 storage 0 4095 2^-4
+requant a 2^70 l+256 1 b 2^70 l+1000 0.25
+requant a -2^40 2^40 2^-20 b -1000 1000 0.001
+requant a 0 2^32 2^-8 b -2^63 -l-p 1
+requant a -1 1 2^-7 b -1 1 2^-15
+instrument -40 125 0.01
+instrument --scale=decimal --tables=off 0 25.5 0.1
+instrument --rounding=even 2^70 l+256 1
+codec t -40 125 0.01
+codec --block=8 b 0 1 1
+codec x -2^40 2^40 2^-20
+codec o 2^70 l+256 1
+manifest 'temp -40 125 0.01\nhum --packed --instrument 0 100 0.1\nangle --rounding=even --tables=auto -180 180 0.01\nprice --scale=decimal 0 1000 0.01\nbig 2^70 l+256 1\n'
+manifest '# sensors\nt -40 125 0.01\n\np --packed 300 1100 0.01\n' --library=sensors
+manifest 'ledger -2^100 2^100 2^-20\ncents 0 1000 0.01\n' --library=money
+strings 30 1800 0.1
+strings -1 1 0.5
+strings --strings=fixed -1 1 0.003
+strings -2^40 2^40 2^-20
+strings --strings=fixed 1000 1001 0.001
+strings 0 1 2^-37
+strings -2^41 2^41 2^-20
+strings --strings=fixed -2^25 2^25 2^-37
+strings -2^100 2^100 2^-20
+strings 0 2^120 2^-3
+packed 0 20 1
+packed 2^70 l+256 1
+packed -2^40 2^40 2^-20
+packed --scale=exact -1 1 0.003
+fpc_hpp_test
+context_test 8 500
+program_test
+plan_test "-100 100 1" "0 20 1" "1000 1100 1" "-180 180 0.01" "30 1800 0.1" \
+          "1000 1001 0.001" "-2^31 2^31-1 1" "0 1 2^-31" "2^40 2^40+2^20 2^-8" \
+          "-2^63 -l-p 1" "0 2^60 2^-3" "2^70 l+2^60 1" "2^70 l+256 1"
+fixnum_string 3.14159
+fixnum_string -f 0 -9223372036854775808
+fixnum_string -f 63 0.12345678901234567890123456789
+fixnum_string -f 20 -123456789012345678901234567890.5
+fixnum_string 12345678901234567890123456789012345678901
+fixnum_string -f 20 12345.12345678901234567890123456789012300
+fixnum_string -f 63 0.123456789012345678901234567890123456789012345
+fixnum_string -f 8 9.99999999999999999999999999999999999999999
+fixnum_string -f 8 1.
+fixnum_string -f 8 -.
+printf '0.5\n-1.25\n00017.0078125\n0.000\n' | fixnum_string -f 8
+printf '1\n2\nx\n3\n' | fixnum_string
 
 exit 0